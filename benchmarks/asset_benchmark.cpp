@@ -0,0 +1,482 @@
+/*
+Asset pipeline benchmark.
+
+Measures the CPU side of loading a model and its textures with common/, on
+procedural meshes from 1K triangles to [max triangles], ten times more at
+every size (1M by default : 10M needs 2.5 GB and a couple of minutes) :
+ - loadOBJ, of a .obj file written for the run
+ - computeTangentBasis
+ - indexVBO, and indexVBO_slow and indexVBO_TBN, which are quadratic, up to
+   10K triangles
+ - readBMP and readDDS, what loadBMP_custom and loadDDS do before OpenGL, on a
+   2048x2048 image
+ - buildText2D, the quads printText2D sends, for 10k strings
+None of it needs an OpenGL context.
+
+For every step : vertices per second (pixels for BMP, bytes for DDS, glyphs
+for text), MB per second of input (of output for text), the allocations and
+bytes allocated per run, counted by operator new, and the peak RSS of the
+step (reset before every step on Linux, else the peak of the process).
+The same results go to [results.json], so that runs of different versions can
+be compared. Past 65536 vertices, the unsigned short indices of indexVBO wrap :
+the time is still the one of the search.
+
+Checks that indexVBO and indexVBO_slow merge the same vertices, and that the
+images are read back at the size they were written with.
+
+Usage : asset_benchmark [max triangles] [results.json]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+// Include GLEW : only for the types of texture.hpp
+#include <GL/glew.h>
+
+// Include GLM
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <common/objloader.hpp>
+#include <common/tangentspace.hpp>
+#include <common/text2D.hpp>
+#include <common/texture.hpp>
+#include <common/vboindexer.hpp>
+
+// Every allocation of the program goes through these
+unsigned long long allocationCount = 0;
+unsigned long long allocatedBytes = 0;
+
+// Every new and new[] mallocs here, and every delete frees what it got, so that no operator hands its memory to
+// another one
+static void *countedMalloc(size_t size)
+{
+    allocationCount++;
+    allocatedBytes += size;
+    void *memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+void *operator new(size_t size)
+{
+    return countedMalloc(size);
+}
+void *operator new[](size_t size)
+{
+    return countedMalloc(size);
+}
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+void operator delete[](void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+#ifdef __linux__
+// Writing 5 to clear_refs resets VmHWM, the peak RSS
+void resetPeakMemory()
+{
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if (file != NULL)
+    {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+double peakMemoryMB()
+{
+    FILE *file = fopen("/proc/self/status", "r");
+    double kB = 0.0;
+    char line[256];
+    while (file != NULL && fgets(line, sizeof(line), file) != NULL)
+    {
+        if (strncmp(line, "VmHWM:", 6) == 0)
+        {
+            kB = atof(line + 6);
+        }
+    }
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    return kB / 1024.0;
+}
+#else
+void resetPeakMemory()
+{
+}
+double peakMemoryMB()
+{
+    return 0.0;
+}
+#endif
+
+struct StepResult
+{
+    std::string name;
+    unsigned int triangles;
+    double items; // vertices, pixels, bytes or glyphs
+    double bytes;
+    unsigned int runs;
+    double seconds;     // per run
+    double allocations; // per run
+    double allocatedMB; // per run
+    double peakMB;
+};
+
+std::vector<StepResult> results;
+
+// Runs the step until it took a quarter of a second, at least once and at most maxRuns times
+template <typename Step>
+void measure(const char *name, unsigned int triangles, double items, double bytes, Step step,
+             unsigned int maxRuns = 1000000)
+{
+    resetPeakMemory();
+    unsigned long long allocationsBefore = allocationCount;
+    unsigned long long bytesBefore = allocatedBytes;
+    unsigned int runs = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds = 0.0;
+    do
+    {
+        step();
+        runs++;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < 0.25 && runs < maxRuns);
+
+    StepResult result;
+    result.name = name;
+    result.triangles = triangles;
+    result.items = items;
+    result.bytes = bytes;
+    result.runs = runs;
+    result.seconds = seconds / runs;
+    result.allocations = double(allocationCount - allocationsBefore) / runs;
+    result.allocatedMB = double(allocatedBytes - bytesBefore) / runs / 1048576.0;
+    result.peakMB = peakMemoryMB();
+    results.push_back(result);
+
+    printf("%-14s %10u %12.0f %11.3f %14.2f %10.1f %12.0f %13.1f %10.1f\n", name, triangles, items,
+           1000.0 * result.seconds, items / result.seconds / 1e6, bytes / result.seconds / 1048576.0,
+           result.allocations, result.allocatedMB, result.peakMB);
+}
+
+// A torus of side x side quads, as loadOBJ returns it : three vertices per triangle
+void buildTorus(unsigned int side, std::vector<glm::vec3> &positions, std::vector<glm::vec2> &uvs,
+                std::vector<glm::vec3> &normals)
+{
+    positions.resize((side + 1) * (side + 1));
+    uvs.resize(positions.size());
+    normals.resize(positions.size());
+    for (unsigned int j = 0; j <= side; j++)
+    {
+        for (unsigned int i = 0; i <= side; i++)
+        {
+            float u = float(i) / side, v = float(j) / side;
+            float theta = 6.2831853f * u, phi = 6.2831853f * v;
+            glm::vec3 center = glm::vec3(cosf(theta), 0.0f, sinf(theta));
+            glm::vec3 normal = cosf(phi) * center + glm::vec3(0.0f, sinf(phi), 0.0f);
+            positions[j * (side + 1) + i] = center + 0.4f * normal;
+            uvs[j * (side + 1) + i] = glm::vec2(u, v);
+            normals[j * (side + 1) + i] = normal;
+        }
+    }
+}
+
+// Corner k of triangle t of the torus, in the grid of buildTorus
+unsigned int torusCorner(unsigned int side, unsigned int t, unsigned int k)
+{
+    static const unsigned int corners[6][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+    unsigned int quad = t / 2;
+    unsigned int i = quad % side, j = quad / side;
+    const unsigned int *corner = corners[(t % 2) * 3 + k];
+    return (j + corner[1]) * (side + 1) + i + corner[0];
+}
+
+// Returns the size of the file
+long writeTorusOBJ(const char *path, unsigned int side)
+{
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> uvs;
+    buildTorus(side, positions, uvs, normals);
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    fprintf(file, "# asset_benchmark torus, %u triangles\n", 2 * side * side);
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        fprintf(file, "v %f %f %f\n", positions[i].x, positions[i].y, positions[i].z);
+    }
+    for (size_t i = 0; i < uvs.size(); i++)
+    {
+        fprintf(file, "vt %f %f\n", uvs[i].x, -uvs[i].y); // loadOBJ flips V back
+    }
+    for (size_t i = 0; i < normals.size(); i++)
+    {
+        fprintf(file, "vn %f %f %f\n", normals[i].x, normals[i].y, normals[i].z);
+    }
+    for (unsigned int t = 0; t < 2 * side * side; t++)
+    {
+        unsigned int a = torusCorner(side, t, 0) + 1, b = torusCorner(side, t, 1) + 1, c = torusCorner(side, t, 2) + 1;
+        fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+    }
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+void writeBMP(const char *path, unsigned int width, unsigned int height)
+{
+    unsigned int imageSize = width * height * 3;
+    unsigned char header[54] = {'B', 'M'};
+    *(unsigned int *)&header[0x02] = 54 + imageSize;
+    *(unsigned int *)&header[0x0A] = 54;
+    *(unsigned int *)&header[0x0E] = 40;
+    *(unsigned int *)&header[0x12] = width;
+    *(unsigned int *)&header[0x16] = height;
+    *(unsigned short *)&header[0x1A] = 1;
+    *(unsigned short *)&header[0x1C] = 24;
+    *(unsigned int *)&header[0x22] = imageSize;
+    std::vector<unsigned char> pixels(imageSize);
+    for (unsigned int i = 0; i < imageSize; i++)
+    {
+        pixels[i] = (unsigned char)(i * 2654435761u >> 24);
+    }
+    FILE *file = fopen(path, "wb");
+    if (file != NULL)
+    {
+        fwrite(header, 1, sizeof(header), file);
+        fwrite(&pixels[0], 1, pixels.size(), file);
+        fclose(file);
+    }
+}
+
+// DXT1, with every mipmap
+void writeDDS(const char *path, unsigned int width, unsigned int height, unsigned int &mipMapCount)
+{
+    unsigned int linearSize = ((width + 3) / 4) * ((height + 3) / 4) * 8;
+    unsigned int size = 0;
+    mipMapCount = 0;
+    for (unsigned int w = width, h = height; w > 0 || h > 0; w /= 2, h /= 2)
+    {
+        size += ((std::max(w, 1u) + 3) / 4) * ((std::max(h, 1u) + 3) / 4) * 8;
+        mipMapCount++;
+    }
+    unsigned char header[124] = {124};
+    *(unsigned int *)&header[8] = height;
+    *(unsigned int *)&header[12] = width;
+    *(unsigned int *)&header[16] = linearSize;
+    *(unsigned int *)&header[24] = mipMapCount;
+    memcpy(&header[80], "DXT1", 4);
+    std::vector<unsigned char> blocks(size);
+    for (unsigned int i = 0; i < size; i++)
+    {
+        blocks[i] = (unsigned char)(i * 2654435761u >> 24);
+    }
+    FILE *file = fopen(path, "wb");
+    if (file != NULL)
+    {
+        fwrite("DDS ", 1, 4, file);
+        fwrite(header, 1, sizeof(header), file);
+        fwrite(&blocks[0], 1, blocks.size(), file);
+        fclose(file);
+    }
+}
+
+void writeResults(const char *path, unsigned int maxTriangles)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return;
+    }
+    fprintf(file, "{\n  \"benchmark\": \"asset_benchmark\",\n  \"max_triangles\": %u,\n  \"results\": [\n",
+            maxTriangles);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const StepResult &r = results[i];
+        fprintf(file,
+                "    {\"step\": \"%s\", \"triangles\": %u, \"items\": %.0f, \"bytes\": %.0f, \"runs\": %u, "
+                "\"ms\": %.6f, \"items_per_s\": %.1f, \"mb_per_s\": %.3f, \"allocations\": %.1f, "
+                "\"allocated_mb\": %.3f, \"peak_rss_mb\": %.1f}%s\n",
+                r.name.c_str(), r.triangles, r.items, r.bytes, r.runs, 1000.0 * r.seconds, r.items / r.seconds,
+                r.bytes / r.seconds / 1048576.0, r.allocations, r.allocatedMB, r.peakMB,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int maxTriangles = argc > 1 ? atoi(argv[1]) : 1000000;
+    const char *resultsPath = argc > 2 ? argv[2] : "asset_benchmark.json";
+    const unsigned int quadraticLimit = 20000; // the 10K triangles mesh has a few more
+    const char *objPath = "asset_benchmark.obj";
+    int errors = 0;
+
+    printf("%-14s %10s %12s %11s %14s %10s %12s %13s %10s\n", "step", "triangles", "items", "ms", "M items/s",
+           "MB/s", "allocations", "allocated MB", "peak MB");
+
+    for (unsigned int target = 1000; target <= maxTriangles; target *= 10)
+    {
+        unsigned int side = (unsigned int)(sqrt(target / 2.0) + 0.5);
+        unsigned int triangles = 2 * side * side;
+        double vertices = 3.0 * triangles;
+
+        long fileSize = writeTorusOBJ(objPath, side);
+        if (fileSize == 0)
+        {
+            fprintf(stderr, "Cannot write %s\n", objPath);
+            return 1;
+        }
+
+        // loadOBJ prints a line every time : not too many
+        std::vector<glm::vec3> positions, normals;
+        std::vector<glm::vec2> uvs;
+        bool loaded = true;
+        measure("loadOBJ", triangles, vertices, fileSize, [&]() {
+            std::vector<glm::vec3> runPositions, runNormals;
+            std::vector<glm::vec2> runUVs;
+            loaded = loaded && loadOBJ(objPath, runPositions, runUVs, runNormals);
+            positions.swap(runPositions);
+            uvs.swap(runUVs);
+            normals.swap(runNormals);
+        }, 5);
+        remove(objPath);
+        if (!loaded || positions.size() != vertices)
+        {
+            fprintf(stderr, "loadOBJ read %u vertices instead of %.0f\n", (unsigned int)positions.size(), vertices);
+            errors++;
+            continue;
+        }
+
+        std::vector<glm::vec3> tangents, bitangents;
+        measure("tangents", triangles, vertices, vertices * 32.0, [&]() {
+            std::vector<glm::vec3> runTangents, runBitangents;
+            computeTangentBasis(positions, uvs, normals, runTangents, runBitangents);
+            tangents.swap(runTangents);
+            bitangents.swap(runBitangents);
+        });
+
+        std::vector<unsigned short> indices;
+        std::vector<glm::vec3> indexedPositions, indexedNormals;
+        std::vector<glm::vec2> indexedUVs;
+        measure("indexVBO", triangles, vertices, vertices * 32.0, [&]() {
+            std::vector<unsigned short> runIndices;
+            std::vector<glm::vec3> runPositions, runNormals;
+            std::vector<glm::vec2> runUVs;
+            indexVBO(positions, uvs, normals, runIndices, runPositions, runUVs, runNormals);
+            indices.swap(runIndices);
+            indexedPositions.swap(runPositions);
+            indexedUVs.swap(runUVs);
+            indexedNormals.swap(runNormals);
+        });
+        // The grid of buildTorus : its seams are not merged, the UVs differ
+        errors += indexedPositions.size() != (side + 1) * (side + 1);
+
+        if (triangles > quadraticLimit)
+        {
+            continue;
+        }
+
+        std::vector<unsigned short> slowIndices;
+        std::vector<glm::vec3> slowPositions, slowNormals;
+        std::vector<glm::vec2> slowUVs;
+        measure("indexVBO_slow", triangles, vertices, vertices * 32.0, [&]() {
+            std::vector<unsigned short> runIndices;
+            std::vector<glm::vec3> runPositions, runNormals;
+            std::vector<glm::vec2> runUVs;
+            indexVBO_slow(positions, uvs, normals, runIndices, runPositions, runUVs, runNormals);
+            slowIndices.swap(runIndices);
+            slowPositions.swap(runPositions);
+            slowUVs.swap(runUVs);
+            slowNormals.swap(runNormals);
+        });
+        errors += slowPositions.size() != indexedPositions.size() || slowIndices.size() != indices.size();
+        for (size_t i = 0; i < indices.size() && i < slowIndices.size(); i++)
+        {
+            errors += glm::length(indexedPositions[indices[i]] - slowPositions[slowIndices[i]]) > 0.01f;
+        }
+
+        measure("indexVBO_TBN", triangles, vertices, vertices * 56.0, [&]() {
+            std::vector<unsigned short> runIndices;
+            std::vector<glm::vec3> runPositions, runNormals, runTangents, runBitangents;
+            std::vector<glm::vec2> runUVs;
+            indexVBO_TBN(positions, uvs, normals, tangents, bitangents, runIndices, runPositions, runUVs, runNormals,
+                         runTangents, runBitangents);
+            errors += runPositions.size() != slowPositions.size();
+        });
+    }
+
+    // Textures
+    const unsigned int imageSide = 2048;
+    writeBMP("asset_benchmark.bmp", imageSide, imageSide);
+    double bmpBytes = 54.0 + imageSide * imageSide * 3;
+    measure("readBMP", 0, double(imageSide) * imageSide, bmpBytes, [&]() {
+        BMPImage image;
+        errors += !readBMP("asset_benchmark.bmp", image) || image.width != imageSide || image.height != imageSide ||
+                  image.data.size() != imageSide * imageSide * 3;
+    });
+    remove("asset_benchmark.bmp");
+
+    unsigned int mipMapCount;
+    writeDDS("asset_benchmark.dds", imageSide, imageSide, mipMapCount);
+    double ddsBytes = 128.0 + imageSide * imageSide / 2 * 4 / 3;
+    measure("readDDS", 0, ddsBytes, ddsBytes, [&]() {
+        DDSImage image;
+        errors += !readDDS("asset_benchmark.dds", image) || image.width != imageSide || image.height != imageSide ||
+                  image.mipMapCount != mipMapCount;
+    });
+    remove("asset_benchmark.dds");
+
+    // Text : 10k strings of 50 characters
+    const unsigned int stringCount = 10000, stringLength = 50;
+    std::vector<std::string> strings(stringCount);
+    for (unsigned int s = 0; s < stringCount; s++)
+    {
+        for (unsigned int i = 0; i < stringLength; i++)
+        {
+            strings[s] += (char)(32 + (s * 7 + i) % 95);
+        }
+    }
+    double glyphs = double(stringCount) * stringLength;
+    std::vector<Text2DVertex> quads(stringLength * 4);
+    measure("buildText2D", 0, glyphs, glyphs * 4 * sizeof(Text2DVertex), [&]() {
+        for (unsigned int s = 0; s < stringCount; s++)
+        {
+            buildText2D(strings[s].c_str(), stringLength, (s % 2) * 400, (s / 2) % 100 * 6, 8, &quads[0]);
+        }
+    });
+    errors += quads[4].position.x != quads[0].position.x + 8;
+
+    writeResults(resultsPath, maxTriangles);
+    printf("%u steps written to %s\n", (unsigned int)results.size(), resultsPath);
+    printf("Asset pipeline checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    return errors == 0 ? 0 : 1;
+}
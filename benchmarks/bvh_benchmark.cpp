@@ -0,0 +1,282 @@
+/*
+BVH benchmark.
+
+Scatters 1M boxes in a 1000 units wide cube, builds a BVH over them
+(common/bvh.cpp), and compares it with brute-force scans over all the boxes :
+ - frustum culling, for a camera turning around in several directions,
+   against the scalar and SIMD kernels of common/culling.cpp
+ - sphere and box overlap queries, and closest-hit ray casts
+then moves every box for a few frames and compares keeping the tree up to
+date with refit(), with refit() + rotate(), and with a full build, in time
+and in SAH cost.
+
+Every query checks that the BVH returns exactly the same boxes as the scan.
+
+Usage : bvh_benchmark [instances] [queries]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+#include <common/clock.hpp>
+#include <common/culling.hpp>
+#include <common/bvh.hpp>
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+glm::vec3 boxMin(const BoundingBoxes &boxes, unsigned int i)
+{
+    return glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]);
+}
+
+glm::vec3 boxMax(const BoundingBoxes &boxes, unsigned int i)
+{
+    return glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]);
+}
+
+void bruteForceSphere(const BoundingBoxes &boxes, const glm::vec3 &center, float radius,
+                      std::vector<unsigned int> &result)
+{
+    result.clear();
+    for (unsigned int i = 0; i < boxes.size(); i++)
+    {
+        glm::vec3 d = center - glm::clamp(center, boxMin(boxes, i), boxMax(boxes, i));
+        if (glm::dot(d, d) <= radius * radius)
+        {
+            result.push_back(i);
+        }
+    }
+}
+
+void bruteForceBox(const BoundingBoxes &boxes, const glm::vec3 &min, const glm::vec3 &max,
+                   std::vector<unsigned int> &result)
+{
+    result.clear();
+    for (unsigned int i = 0; i < boxes.size(); i++)
+    {
+        if (min.x <= boxes.maxX[i] && boxes.minX[i] <= max.x && min.y <= boxes.maxY[i] && boxes.minY[i] <= max.y &&
+            min.z <= boxes.maxZ[i] && boxes.minZ[i] <= max.z)
+        {
+            result.push_back(i);
+        }
+    }
+}
+
+bool bruteForceRay(const BoundingBoxes &boxes, const glm::vec3 &origin, const glm::vec3 &direction,
+                   float maxDistance, unsigned int &hit, float &distance)
+{
+    glm::vec3 inverseDirection = 1.0f / direction;
+    float closest = maxDistance;
+    bool found = false;
+    for (unsigned int i = 0; i < boxes.size(); i++)
+    {
+        glm::vec3 t0 = (boxMin(boxes, i) - origin) * inverseDirection;
+        glm::vec3 t1 = (boxMax(boxes, i) - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, closest));
+        if (enter <= exit && (!found || enter < closest))
+        {
+            closest = enter;
+            hit = i;
+            found = true;
+        }
+    }
+    if (found)
+    {
+        distance = closest;
+    }
+    return found;
+}
+
+// The BVH returns its results in tree order
+bool sameSet(std::vector<unsigned int> &a, const std::vector<unsigned int> &b)
+{
+    std::sort(a.begin(), a.end());
+    return a == b;
+}
+
+void printRow(const char *query, double bruteForce, double bvh, int runs, double results)
+{
+    printf("%-16s %14.4f %12.4f %8.1fx %12.1f\n", query, 1000.0 * bruteForce / runs, 1000.0 * bvh / runs,
+           bruteForce / bvh, results / runs);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int queries = argc > 2 ? atoi(argv[2]) : 100;
+
+    srand(1234);
+    BoundingBoxes boxes;
+    boxes.resize(count);
+    std::vector<glm::vec3> centers(count), extents(count), velocities(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        centers[i] = glm::vec3(randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f));
+        extents[i] = glm::vec3(randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f));
+        velocities[i] = glm::vec3(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+        boxes.set(i, centers[i] - extents[i], centers[i] + extents[i]);
+    }
+
+    BVH bvh;
+    double start = clockTime();
+    bvh.build(boxes);
+    double buildTime = clockTime() - start;
+    printf("%u boxes : SAH build %.1f ms, %u nodes, depth %u, SAH cost %.1f\n", count, 1000.0 * buildTime,
+           bvh.nodeCount(), bvh.depth(), bvh.sahCost());
+
+    std::vector<unsigned int> reference, result;
+    int mismatches = 0;
+
+    printf("%-16s %14s %12s %9s %12s\n", "query", "brute force ms", "BVH ms", "speedup", "results");
+
+    // Frustum culling : against both brute-force kernels
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 500.0f);
+    double times[3] = {0.0, 0.0, 0.0}; // scalar, SIMD, BVH
+    double visible = 0.0;
+    int views = 16;
+    for (int view = 0; view < views; view++)
+    {
+        float angle = 6.2831853f * view / views;
+        glm::vec3 direction(cos(angle), 0.3f * sin(3.0f * angle), sin(angle));
+        glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f), direction, glm::vec3(0, 1, 0));
+        Frustum frustum = extractFrustumPlanes(projection * viewMatrix);
+
+        double t0 = clockTime();
+        cullBoxesScalar(frustum, boxes, reference);
+        double t1 = clockTime();
+        cullBoxes(frustum, boxes, result);
+        double t2 = clockTime();
+        bvh.cullFrustum(frustum, result);
+        double t3 = clockTime();
+        times[0] += t1 - t0;
+        times[1] += t2 - t1;
+        times[2] += t3 - t2;
+        visible += result.size();
+        mismatches += !sameSet(result, reference);
+    }
+    printRow("frustum (scalar)", times[0], times[2], views, visible);
+    printRow("frustum (SIMD)", times[1], times[2], views, visible);
+
+    // Sphere and box queries, around random points
+    double bruteForceTime = 0.0, bvhTime = 0.0, results = 0.0;
+    for (int q = 0; q < queries; q++)
+    {
+        glm::vec3 center(randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f));
+        float radius = randomFloat(5.0f, 50.0f);
+        double t0 = clockTime();
+        bruteForceSphere(boxes, center, radius, reference);
+        double t1 = clockTime();
+        bvh.querySphere(center, radius, result);
+        double t2 = clockTime();
+        bruteForceTime += t1 - t0;
+        bvhTime += t2 - t1;
+        results += result.size();
+        mismatches += !sameSet(result, reference);
+    }
+    printRow("sphere", bruteForceTime, bvhTime, queries, results);
+
+    bruteForceTime = bvhTime = results = 0.0;
+    for (int q = 0; q < queries; q++)
+    {
+        glm::vec3 center(randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f));
+        glm::vec3 extent(randomFloat(5.0f, 50.0f), randomFloat(5.0f, 50.0f), randomFloat(5.0f, 50.0f));
+        double t0 = clockTime();
+        bruteForceBox(boxes, center - extent, center + extent, reference);
+        double t1 = clockTime();
+        bvh.queryBox(center - extent, center + extent, result);
+        double t2 = clockTime();
+        bruteForceTime += t1 - t0;
+        bvhTime += t2 - t1;
+        results += result.size();
+        mismatches += !sameSet(result, reference);
+    }
+    printRow("box", bruteForceTime, bvhTime, queries, results);
+
+    // Rays from random points in random directions ; 'results' counts the hits
+    bruteForceTime = bvhTime = results = 0.0;
+    for (int q = 0; q < queries; q++)
+    {
+        glm::vec3 origin(randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f));
+        glm::vec3 direction(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+        unsigned int referenceHit = 0, hit = 0;
+        float referenceDistance = 0.0f, distance = 0.0f;
+        double t0 = clockTime();
+        bool referenceFound = bruteForceRay(boxes, origin, direction, 1000.0f, referenceHit, referenceDistance);
+        double t1 = clockTime();
+        bool found = bvh.raycast(origin, direction, 1000.0f, hit, distance);
+        double t2 = clockTime();
+        bruteForceTime += t1 - t0;
+        bvhTime += t2 - t1;
+        results += found;
+        mismatches += found != referenceFound || (found && (hit != referenceHit || distance != referenceDistance));
+    }
+    printRow("ray", bruteForceTime, bvhTime, queries, results);
+
+    // Moving instances : 'bvh' is only refitted, 'rotated' is refitted and rotated
+    BVH rotated;
+    rotated.build(boxes);
+    BVH rebuilt;
+    int frames = 10;
+    double refitTime = 0.0, rotateTime = 0.0, rebuildTime = 0.0;
+    unsigned int rotations = 0;
+    printf("\nmoving every box by up to 1 unit per axis per frame, %d frames\n", frames);
+    printf("%-6s %12s %14s %12s\n", "frame", "refit cost", "+rotate cost", "build cost");
+    for (int frame = 1; frame <= frames; frame++)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            centers[i] += velocities[i];
+            boxes.set(i, centers[i] - extents[i], centers[i] + extents[i]);
+        }
+
+        double t0 = clockTime();
+        bvh.refit();
+        double t1 = clockTime();
+        rotated.refit();
+        double t2 = clockTime();
+        rotations += rotated.rotate();
+        double t3 = clockTime();
+        rebuilt.build(boxes);
+        double t4 = clockTime();
+        refitTime += t1 - t0;
+        rotateTime += t3 - t2;
+        rebuildTime += t4 - t3;
+        printf("%-6d %12.1f %14.1f %12.1f\n", frame, bvh.sahCost(), rotated.sahCost(), rebuilt.sahCost());
+    }
+    printf("per frame : refit %.2f ms, rotate %.2f ms (%u rotations), full build %.1f ms\n",
+           1000.0 * refitTime / frames, 1000.0 * rotateTime / frames, rotations / frames,
+           1000.0 * rebuildTime / frames);
+
+    // The updated trees must still find everything
+    for (int view = 0; view < 4; view++)
+    {
+        glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f), glm::vec3(cos(view * 1.5f), 0.0f, sin(view * 1.5f)),
+                                           glm::vec3(0, 1, 0));
+        Frustum frustum = extractFrustumPlanes(projection * viewMatrix);
+        cullBoxesScalar(frustum, boxes, reference);
+        bvh.cullFrustum(frustum, result);
+        mismatches += !sameSet(result, reference);
+        rotated.cullFrustum(frustum, result);
+        mismatches += !sameSet(result, reference);
+    }
+
+    printf("BVH results %s the brute-force scans (%d mismatches)\n", mismatches == 0 ? "match" : "DIFFER FROM",
+           mismatches);
+
+    return mismatches == 0 ? 0 : 1;
+}
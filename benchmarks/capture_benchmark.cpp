@@ -0,0 +1,353 @@
+/*
+Frame capture benchmark.
+
+Captures frames of two halves of a color that changes every frame, at
+1280x720 and at an odd size, 641x479, with :
+ - no capture, for the frame time without it
+ - a glReadPixels and a BMP written every frame on the GL thread, which is
+   what distrib/screenshot.h does for one frame
+ - common/framecapture.cpp, to BMP, PNG and Y4M
+
+and measures the time the GL thread spends capturing each frame, and the
+frames the writer thread drops. It checks that :
+ - every frame is either written or dropped, and no frame twice
+ - the written files have the colors of their frame, the right way up,
+   which for Y4M is within the rounding of the conversion to YCbCr
+ - the files have the size of their format
+
+Frames are paced to 'frame ms' (60 fps), like a game that captures itself.
+With a 'frame ms' of 0, they are not : the writer falls behind, and frames
+are dropped.
+
+Usage : capture_benchmark [frames] [frame ms]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+#define DISTRIB_SCREENSHOT_NO_MACROS
+#include <distrib/screenshot.h>
+
+#include <common/framecapture.hpp>
+
+const char *const FilePattern = "capture_benchmark_%04u.%s";
+
+// The two halves of frame 'frame' : the top one is mostly green, the bottom one mostly blue
+void frameColor(unsigned int frame, bool bottom, unsigned char rgb[3])
+{
+    rgb[0] = (frame * 16) & 0xFF;
+    rgb[1] = bottom ? 40 : 200;
+    rgb[2] = bottom ? 200 : 40;
+}
+
+void drawFrame(unsigned int frame, int width, int height)
+{
+    unsigned char top[3], bottom[3];
+    frameColor(frame, false, top);
+    frameColor(frame, true, bottom);
+    glClearColor(top[0] / 255.0f, top[1] / 255.0f, top[2] / 255.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, width, height / 2);
+    glClearColor(bottom[0] / 255.0f, bottom[1] / 255.0f, bottom[2] / 255.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+std::vector<unsigned char> readFile(const char *path)
+{
+    std::vector<unsigned char> data;
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return data;
+    }
+    fseek(file, 0, SEEK_END);
+    data.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    if (!data.empty() && fread(&data[0], 1, data.size(), file) != data.size())
+    {
+        data.clear();
+    }
+    fclose(file);
+    return data;
+}
+
+bool sameColor(const unsigned char *pixel, const unsigned char rgb[3], bool bgr)
+{
+    return pixel[0] == rgb[bgr ? 2 : 0] && pixel[1] == rgb[1] && pixel[2] == rgb[bgr ? 0 : 2];
+}
+
+// The first and the last row of a BMP or PNG written by FrameCapture
+int checkImage(const std::vector<unsigned char> &data, FrameCaptureFormat format, unsigned int frame, int width,
+               int height)
+{
+    unsigned char top[3], bottom[3];
+    frameColor(frame, false, top);
+    frameColor(frame, true, bottom);
+    int errors = 0;
+    if (format == CaptureBMP)
+    {
+        size_t rowSize = (3 * width + 3) & ~3;
+        if (data.size() != 54 + rowSize * height)
+        {
+            return 1;
+        }
+        errors += !sameColor(&data[54], bottom, true);
+        errors += !sameColor(&data[54 + rowSize * (height - 1) + 3 * (width - 1)], top, true);
+        return errors;
+    }
+
+    // Signature, IHDR, then the IDAT : its length, its type, the zlib header, and 5 bytes before every 65535
+    size_t rowSize = 1 + 3 * (size_t)width;
+    size_t raw = rowSize * height;
+    size_t blocks = (raw + 65534) / 65535;
+    if (data.size() != 8 + 25 + 8 + 2 + raw + 5 * blocks + 4 + 4 + 12 || memcmp(&data[1], "PNG", 3) != 0)
+    {
+        return 1;
+    }
+    size_t offsets[2] = {1, raw - 3};
+    const unsigned char *colors[2] = {top, bottom};
+    for (int i = 0; i < 2; i++)
+    {
+        size_t offset = 8 + 25 + 8 + 2 + offsets[i] + 5 * (offsets[i] / 65535 + 1);
+        errors += !sameColor(&data[offset], colors[i], false);
+    }
+    return errors;
+}
+
+// Within the rounding of the conversion of FrameCapture, and a little more
+bool closeTo(int value, int expected)
+{
+    return value >= expected - 2 && value <= expected + 2;
+}
+
+// The frames of a Y4M must be those of increasing frame numbers : 'written' of them, in order
+int checkVideo(const std::vector<unsigned char> &data, unsigned int frames, unsigned int written, int width,
+               int height)
+{
+    char header[128];
+    snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 C420jpeg\n", width, height);
+    size_t headerSize = strlen(header);
+    size_t lumaSize = (size_t)width * height;
+    size_t chromaSize = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    size_t frameSize = 6 + lumaSize + 2 * chromaSize;
+    if (data.size() != headerSize + written * frameSize || memcmp(&data[0], header, headerSize) != 0)
+    {
+        return 1;
+    }
+    int errors = 0;
+    unsigned int frame = 0;
+    for (unsigned int i = 0; i < written; i++)
+    {
+        const unsigned char *y4mFrame = &data[headerSize + i * frameSize];
+        errors += memcmp(y4mFrame, "FRAME\n", 6) != 0;
+        const unsigned char *luma = y4mFrame + 6;
+        const unsigned char *cb = luma + lumaSize;
+        int topLuma = luma[0], bottomLuma = luma[lumaSize - 1];
+        for (; frame < frames; frame++)
+        {
+            unsigned char top[3], bottom[3];
+            frameColor(frame, false, top);
+            frameColor(frame, true, bottom);
+            if (closeTo(topLuma, ((66 * top[0] + 129 * top[1] + 25 * top[2] + 128) >> 8) + 16)
+                && closeTo(bottomLuma, ((66 * bottom[0] + 129 * bottom[1] + 25 * bottom[2] + 128) >> 8) + 16))
+            {
+                break;
+            }
+        }
+        errors += frame == frames;
+        // Blue at the bottom, green at the top
+        errors += !(cb[chromaSize - 1] > 128 && cb[0] < 128);
+        frame++;
+    }
+    return errors;
+}
+
+struct CaptureRun
+{
+    const char *name;
+    double frameTime;   // seconds per frame, on the GL thread
+    double captureTime; // seconds per frame, capturing, on the GL thread
+    FrameCaptureStats stats;
+};
+
+void printRun(const CaptureRun &run, int width, int height)
+{
+    printf("%4dx%-4d %-24s %8.3f ms/frame %8.3f ms capturing", width, height, run.name, 1000.0 * run.frameTime,
+           1000.0 * run.captureTime);
+    if (run.stats.frames > 0)
+    {
+        printf(", %3u written, %3u dropped, %u stalls, %6.2f ms/frame writing, %.1f MB", run.stats.written,
+               run.stats.dropped, run.stats.stalls, 1000.0 * run.stats.writeTime / run.stats.written,
+               run.stats.bytes / 1e6);
+    }
+    printf("\n");
+}
+
+// The frames are 'frameTime' apart, the next one drawn once the last one has been captured
+void waitForNextFrame(double frameStart, double frameTime)
+{
+    double left = frameStart + frameTime - glfwGetTime();
+    if (left > 0.0)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(left));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int frames = argc > 1 ? atoi(argv[1]) : 120;
+    double frameTime = argc > 2 ? atof(argv[2]) / 1000.0 : 1.0 / 60.0;
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // The odd size is captured from the bottom left corner of the window
+    const int sizes[2][2] = {{1280, 720}, {641, 479}};
+    window = glfwCreateWindow(sizes[0][0], sizes[0][1], "Capture benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open GLFW window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    printf("%u frames, %s\n", frames, frameTime > 0.0 ? "paced" : "not paced");
+    int errors = 0;
+    const FrameCaptureFormat formats[3] = {CaptureBMP, CapturePNG, CaptureY4M};
+    const char *extensions[3] = {"bmp", "png", "y4m"};
+    const char *names[3] = {"FrameCapture BMP", "FrameCapture PNG", "FrameCapture Y4M"};
+    char path[256];
+    for (int size = 0; size < 2; size++)
+    {
+        int width = sizes[size][0], height = sizes[size][1];
+        glViewport(0, 0, width, height);
+
+        // No capture, then a synchronous one
+        for (int synchronous = 0; synchronous < 2; synchronous++)
+        {
+            CaptureRun run = {synchronous ? "glReadPixels + BMP" : "no capture", 0.0, 0.0, FrameCaptureStats()};
+            double start = glfwGetTime();
+            for (unsigned int frame = 0; frame < frames; frame++)
+            {
+                double frameStart = glfwGetTime();
+                drawFrame(frame, width, height);
+                if (synchronous)
+                {
+                    double captureStart = glfwGetTime();
+                    snprintf(path, sizeof(path), FilePattern, frame, "bmp");
+                    SaveScreenshot(path, width, height);
+                    run.captureTime += glfwGetTime() - captureStart;
+                }
+                glfwSwapBuffers(window);
+                waitForNextFrame(frameStart, frameTime);
+            }
+            run.frameTime = (glfwGetTime() - start) / frames;
+            run.captureTime /= frames;
+            printRun(run, width, height);
+            for (unsigned int frame = 0; synchronous && frame < frames; frame++)
+            {
+                snprintf(path, sizeof(path), FilePattern, frame, "bmp");
+                errors += checkImage(readFile(path), CaptureBMP, frame, width, height);
+                remove(path);
+            }
+        }
+
+        for (int f = 0; f < 3; f++)
+        {
+            FrameCapture capture;
+            // A pattern with the frame number for the images, a file for the video
+            char capturePath[256];
+            if (formats[f] == CaptureY4M)
+            {
+                snprintf(capturePath, sizeof(capturePath), "capture_benchmark.y4m");
+            }
+            else
+            {
+                snprintf(capturePath, sizeof(capturePath), "capture_benchmark_%%04u.%s", extensions[f]);
+            }
+            if (!capture.create(width, height, capturePath, formats[f]))
+            {
+                fprintf(stderr, "Cannot write %s\n", capturePath);
+                errors++;
+                continue;
+            }
+            CaptureRun run = {names[f], 0.0, 0.0, FrameCaptureStats()};
+            double start = glfwGetTime();
+            for (unsigned int frame = 0; frame < frames; frame++)
+            {
+                double frameStart = glfwGetTime();
+                drawFrame(frame, width, height);
+                capture.capture();
+                glfwSwapBuffers(window);
+                waitForNextFrame(frameStart, frameTime);
+            }
+            run.frameTime = (glfwGetTime() - start) / frames;
+            capture.destroy();
+            run.stats = capture.stats();
+            run.captureTime = run.stats.captureTime / frames;
+            printRun(run, width, height);
+
+            errors += run.stats.frames != frames || run.stats.written + run.stats.dropped != frames;
+            if (formats[f] == CaptureY4M)
+            {
+                errors += checkVideo(readFile(capturePath), frames, run.stats.written, width, height);
+                remove(capturePath);
+                continue;
+            }
+            unsigned int found = 0;
+            for (unsigned int frame = 0; frame < frames; frame++)
+            {
+                snprintf(path, sizeof(path), FilePattern, frame, extensions[f]);
+                std::vector<unsigned char> data = readFile(path);
+                if (!data.empty())
+                {
+                    found++;
+                    errors += checkImage(data, formats[f], frame, width, height);
+                    remove(path);
+                }
+            }
+            errors += found != run.stats.written;
+        }
+    }
+
+    printf("Capture checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    glfwTerminate();
+
+    return errors == 0 ? 0 : 1;
+}
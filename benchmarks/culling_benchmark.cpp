@@ -0,0 +1,95 @@
+/*
+Frustum culling benchmark.
+
+Culls 1M bounding spheres and 1M bounding boxes, scattered in a 1000 units
+wide cube around the camera, with the scalar reference and with the SIMD
+kernels of common/culling.cpp (SSE, or AVX when compiled with USE_AVX),
+for a camera turning around in several directions. Reports the time per
+cull, the number of visible instances, and checks that both versions
+return exactly the same visible list.
+
+Usage : culling_benchmark [instances] [views]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+#include <common/clock.hpp>
+#include <common/culling.hpp>
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int views = argc > 2 ? atoi(argv[2]) : 16;
+
+    srand(1234);
+    BoundingSpheres spheres;
+    BoundingBoxes boxes;
+    spheres.resize(count);
+    boxes.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm::vec3 center(randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f));
+        glm::vec3 extent(randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f));
+        spheres.set(i, center, glm::length(extent));
+        boxes.set(i, center - extent, center + extent);
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 500.0f);
+
+    std::vector<unsigned int> reference, visible;
+    double times[4] = {0.0, 0.0, 0.0, 0.0}; // spheres scalar, spheres SIMD, boxes scalar, boxes SIMD
+    unsigned int visibleSpheres = 0, visibleBoxes = 0;
+    int mismatches = 0;
+
+    for (int view = 0; view < views; view++)
+    {
+        float angle = 6.2831853f * view / views;
+        glm::vec3 direction(cos(angle), 0.3f * sin(3.0f * angle), sin(angle));
+        glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f), direction, glm::vec3(0, 1, 0));
+        Frustum frustum = extractFrustumPlanes(projection * viewMatrix);
+
+        double t0 = clockTime();
+        cullSpheresScalar(frustum, spheres, reference);
+        double t1 = clockTime();
+        cullSpheres(frustum, spheres, visible);
+        double t2 = clockTime();
+        times[0] += t1 - t0;
+        times[1] += t2 - t1;
+        visibleSpheres += visible.size();
+        mismatches += visible != reference;
+
+        t0 = clockTime();
+        cullBoxesScalar(frustum, boxes, reference);
+        t1 = clockTime();
+        cullBoxes(frustum, boxes, visible);
+        t2 = clockTime();
+        times[2] += t1 - t0;
+        times[3] += t2 - t1;
+        visibleBoxes += visible.size();
+        mismatches += visible != reference;
+    }
+
+    printf("%u instances, %d views, SIMD kernels : %s\n", count, views, cullingInstructionSet());
+    printf("%-8s %12s %12s %9s %12s\n", "bounds", "scalar ms", "SIMD ms", "speedup", "visible");
+    printf("%-8s %12.3f %12.3f %8.2fx %12u\n", "spheres", 1000.0 * times[0] / views, 1000.0 * times[1] / views,
+           times[0] / times[1], visibleSpheres / views);
+    printf("%-8s %12.3f %12.3f %8.2fx %12u\n", "boxes", 1000.0 * times[2] / views, 1000.0 * times[3] / views,
+           times[2] / times[3], visibleBoxes / views);
+    printf("SIMD visible lists %s the scalar reference (%d mismatches)\n", mismatches == 0 ? "match" : "DIFFER FROM",
+           mismatches);
+
+    return mismatches == 0 ? 0 : 1;
+}
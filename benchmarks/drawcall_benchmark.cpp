@@ -0,0 +1,255 @@
+/*
+Draw-call microbenchmark.
+
+Measures the CPU time the driver spends submitting many small draw calls, with
+the two ways the tutorials have used to describe vertex attributes :
+ - "respecify" : one global VAO, and before every draw call the 3 attributes
+   are enabled, their buffers bound and their pointers set, then disabled again
+   (what tutorial09 did before common/mesh.cpp)
+ - "vao" : each Mesh has its own VAO, configured once, so a draw call is just
+   glBindVertexArray + glDrawElements
+
+Two different meshes are drawn alternately, so that every draw call really
+changes the vertex layout. The meshes are tiny and the viewport is 1x1 pixel, so
+that the GPU side (or llvmpipe's rasterizer) stays negligible.
+
+Usage : drawcall_benchmark [draws per frame] [frames]
+Run it from tutorial09_vbo_indexing/ so that it finds StandardShading.*
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+// Include GLM
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <common/mesh.hpp>
+#include <common/shader.hpp>
+
+// Raw buffers for the "respecify" path
+struct RawMesh
+{
+    GLuint vertexbuffer;
+    GLuint uvbuffer;
+    GLuint normalbuffer;
+    GLuint elementbuffer;
+    unsigned int indexCount;
+};
+
+RawMesh createRawMesh(const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs,
+                      const std::vector<glm::vec3> &normals, const std::vector<unsigned short> &indices)
+{
+    RawMesh mesh;
+    glGenBuffers(1, &mesh.vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mesh.uvbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.uvbuffer);
+    glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mesh.normalbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.normalbuffer);
+    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mesh.elementbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.elementbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+
+    mesh.indexCount = indices.size();
+    return mesh;
+}
+
+void drawRawMesh(const RawMesh &mesh)
+{
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexbuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.uvbuffer);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.normalbuffer);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.elementbuffer);
+    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, (void *)0);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+}
+
+void deleteRawMesh(RawMesh &mesh)
+{
+    glDeleteBuffers(1, &mesh.vertexbuffer);
+    glDeleteBuffers(1, &mesh.uvbuffer);
+    glDeleteBuffers(1, &mesh.normalbuffer);
+    glDeleteBuffers(1, &mesh.elementbuffer);
+}
+
+// A flat polygon with 'sides' vertices around the origin, as a triangle fan
+void buildPolygon(int sides, std::vector<glm::vec3> &vertices, std::vector<glm::vec2> &uvs,
+                  std::vector<glm::vec3> &normals, std::vector<unsigned short> &indices)
+{
+    for (int i = 0; i < sides; i++)
+    {
+        float angle = 6.2831853f * i / sides;
+        vertices.push_back(glm::vec3(cos(angle), sin(angle), 0.0f));
+        uvs.push_back(glm::vec2(0.5f + 0.5f * cos(angle), 0.5f + 0.5f * sin(angle)));
+        normals.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+    for (int i = 1; i + 1 < sides; i++)
+    {
+        indices.push_back(0);
+        indices.push_back(i);
+        indices.push_back(i + 1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int drawsPerFrame = argc > 1 ? atoi(argv[1]) : 10000;
+    int frames = argc > 2 ? atoi(argv[2]) : 50;
+    int warmupFrames = 5;
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy; should not be needed
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(64, 64, "Draw call benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open GLFW window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    glViewport(0, 0, 1, 1);
+    glEnable(GL_DEPTH_TEST);
+
+    GLuint programID = LoadShaders("StandardShading.vertexshader", "StandardShading.fragmentshader");
+    GLuint MatrixID = glGetUniformLocation(programID, "MVP");
+    glUseProgram(programID);
+
+    // Two small meshes, drawn alternately
+    std::vector<glm::vec3> vertices[2];
+    std::vector<glm::vec2> uvs[2];
+    std::vector<glm::vec3> normals[2];
+    std::vector<unsigned short> indices[2];
+    buildPolygon(3, vertices[0], uvs[0], normals[0], indices[0]);
+    buildPolygon(8, vertices[1], uvs[1], normals[1], indices[1]);
+
+    RawMesh rawMeshes[2];
+    Mesh meshes[2];
+    for (int m = 0; m < 2; m++)
+    {
+        rawMeshes[m] = createRawMesh(vertices[m], uvs[m], normals[m], indices[m]);
+        meshes[m].create(vertices[m], uvs[m], normals[m], indices[m]);
+    }
+
+    // The "respecify" path needs some VAO bound in a core profile
+    GLuint globalVertexArrayID;
+    glGenVertexArrays(1, &globalVertexArrayID);
+
+    printf("%d draw calls per frame, %d frames\n", drawsPerFrame, frames);
+    printf("%-10s %14s %14s %12s\n", "path", "CPU ms/frame", "ns/draw", "GL calls/draw");
+
+    const char *pathNames[2] = {"respecify", "vao"};
+    const int callsPerDraw[2] = {14, 2}; // not counting the MVP upload, common to both
+    double nsPerDraw[2];
+
+    for (int path = 0; path < 2; path++)
+    {
+        double submitTime = 0.0;
+
+        for (int frame = 0; frame < warmupFrames + frames; frame++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (path == 0)
+            {
+                glBindVertexArray(globalVertexArrayID);
+            }
+
+            double start = glfwGetTime();
+            for (int i = 0; i < drawsPerFrame; i++)
+            {
+                glm::mat4 MVP = glm::mat4(1.0f);
+                MVP[3][0] = 0.001f * (i % 100);
+                glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
+
+                if (path == 0)
+                {
+                    drawRawMesh(rawMeshes[i & 1]);
+                }
+                else
+                {
+                    meshes[i & 1].bind();
+                    meshes[i & 1].draw();
+                }
+            }
+            double end = glfwGetTime();
+
+            // Don't let the queued work of this frame spill into the next one
+            glFinish();
+
+            if (frame >= warmupFrames)
+            {
+                submitTime += end - start;
+            }
+        }
+
+        double msPerFrame = 1000.0 * submitTime / frames;
+        nsPerDraw[path] = 1e9 * submitTime / ((double)frames * drawsPerFrame);
+        printf("%-10s %14.3f %14.1f %12d\n", pathNames[path], msPerFrame, nsPerDraw[path], callsPerDraw[path]);
+    }
+
+    printf("VAO path removes %.1f ns of CPU time per draw call (%.2fx faster)\n", nsPerDraw[0] - nsPerDraw[1],
+           nsPerDraw[0] / nsPerDraw[1]);
+
+    // Cleanup
+    for (int m = 0; m < 2; m++)
+    {
+        deleteRawMesh(rawMeshes[m]);
+        meshes[m].destroy();
+    }
+    glDeleteVertexArrays(1, &globalVertexArrayID);
+    glDeleteProgram(programID);
+
+    glfwTerminate();
+
+    return 0;
+}
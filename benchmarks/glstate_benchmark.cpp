@@ -0,0 +1,265 @@
+/*
+GL state cache benchmark.
+
+Runs GLStateCache on a table of GLStateFunctions that only record the calls,
+so no GL context (and no display) is needed. Then times 10M redundant and 10M
+changing calls through the cache, and reports the nanoseconds per call.
+
+Checks that :
+ - every first call for a piece of state is issued, and repeating it is
+   elided, with the issued and elided counts of each step exact
+ - the calls recorded by the table are exactly the ones counted as issued,
+   with the arguments they were given
+ - bindVertexArray() makes the element array binding unknown again, and
+   only that one
+ - invalidate() makes the next call for each piece of state issued
+ - beginFrame() moves the counters to lastFrameCounters()
+
+Usage : glstate_benchmark [calls]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Include GLEW, for the GL types and enums only : nothing is called
+#include <GL/glew.h>
+
+#include <common/glstate.hpp>
+
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Every call that reaches "GL", as text
+static std::vector<std::string> recorded;
+
+static void record(const char *format, unsigned int a, unsigned int b = 0, unsigned int c = 0, unsigned int d = 0)
+{
+    char call[128];
+    snprintf(call, sizeof(call), format, a, b, c, d);
+    recorded.push_back(call);
+}
+static void recordUseProgram(GLuint program)
+{
+    record("useProgram %u", program);
+}
+static void recordActiveTexture(GLenum unit)
+{
+    record("activeTexture %u", unit - GL_TEXTURE0);
+}
+static void recordBindTexture(GLenum target, GLuint texture)
+{
+    record("bindTexture %x %u", target, texture);
+}
+static void recordBindBuffer(GLenum target, GLuint buffer)
+{
+    record("bindBuffer %x %u", target, buffer);
+}
+static void recordBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    record("bindBufferBase %x %u %u", target, index, buffer);
+}
+static void recordBindVertexArray(GLuint vertexArray)
+{
+    record("bindVertexArray %u", vertexArray);
+}
+static void recordEnable(GLenum capability)
+{
+    record("enable %x", capability);
+}
+static void recordDisable(GLenum capability)
+{
+    record("disable %x", capability);
+}
+static void recordBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    record("blendFunc %x %x", sfactor, dfactor);
+}
+static void recordDepthFunc(GLenum func)
+{
+    record("depthFunc %x", func);
+}
+static void recordDepthMask(GLboolean flag)
+{
+    record("depthMask %u", flag);
+}
+static void recordCullFace(GLenum mode)
+{
+    record("cullFace %x", mode);
+}
+static void recordViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    record("viewport %u %u %u %u", x, y, width, height);
+}
+
+// Counts calls without recording them, for the timings
+static unsigned int stubCalls = 0;
+static void countUseProgram(GLuint)
+{
+    stubCalls++;
+}
+
+GLStateFunctions recordingFunctions()
+{
+    GLStateFunctions functions;
+    functions.useProgram = recordUseProgram;
+    functions.activeTexture = recordActiveTexture;
+    functions.bindTexture = recordBindTexture;
+    functions.bindBuffer = recordBindBuffer;
+    functions.bindBufferBase = recordBindBufferBase;
+    functions.bindVertexArray = recordBindVertexArray;
+    functions.enable = recordEnable;
+    functions.disable = recordDisable;
+    functions.blendFunc = recordBlendFunc;
+    functions.depthFunc = recordDepthFunc;
+    functions.depthMask = recordDepthMask;
+    functions.cullFace = recordCullFace;
+    functions.viewport = recordViewport;
+    return functions;
+}
+
+// The counters since the last step, against what the step expects, and the
+// calls recorded since then against the ones it expects, in order
+int checkStep(const char *name, GLStateCache &cache, unsigned int issued, unsigned int elided,
+              const std::vector<std::string> &calls)
+{
+    const GLStateCounters &counters = cache.frameCounters();
+    int errors = counters.issued != issued || counters.elided != elided || recorded != calls;
+    if (errors != 0)
+    {
+        printf("%s : %u issued, %u elided, expected %u and %u\n", name, counters.issued, counters.elided, issued,
+               elided);
+        for (size_t i = 0; i < recorded.size(); i++)
+        {
+            printf("    %s\n", recorded[i].c_str());
+        }
+    }
+    cache.beginFrame();
+    recorded.clear();
+    return errors;
+}
+
+std::vector<std::string> calls(const char *a = NULL, const char *b = NULL, const char *c = NULL,
+                               const char *d = NULL)
+{
+    std::vector<std::string> result;
+    const char *all[4] = {a, b, c, d};
+    for (int i = 0; i < 4 && all[i] != NULL; i++)
+    {
+        result.push_back(all[i]);
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int count = argc > 1 ? atoi(argv[1]) : 10000000;
+    int errors = 0;
+
+    GLStateCache cache(recordingFunctions());
+
+    // Everything is unknown at first, then known
+    cache.useProgram(3);
+    cache.useProgram(3);
+    cache.bindTexture(0, GL_TEXTURE_2D, 5);
+    cache.bindTexture(0, GL_TEXTURE_2D, 5);
+    errors += checkStep("first calls", cache, 3, 2,
+                        calls("useProgram 3", "activeTexture 0", "bindTexture de1 5"));
+
+    // A texture on another unit changes the active unit, one on the same unit doesn't
+    cache.bindTexture(1, GL_TEXTURE_2D, 6);
+    cache.bindTexture(1, GL_TEXTURE_2D, 7);
+    cache.bindTexture(0, GL_TEXTURE_2D, 5);
+    errors += checkStep("texture units", cache, 3, 1,
+                        calls("activeTexture 1", "bindTexture de1 6", "bindTexture de1 7"));
+
+    cache.enable(GL_DEPTH_TEST);
+    cache.enable(GL_DEPTH_TEST);
+    cache.disable(GL_DEPTH_TEST);
+    cache.disable(GL_DEPTH_TEST);
+    errors += checkStep("capabilities", cache, 2, 2, calls("enable b71", "disable b71"));
+
+    cache.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    cache.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    cache.depthFunc(GL_LESS);
+    cache.depthFunc(GL_LESS);
+    cache.depthMask(GL_FALSE);
+    cache.depthMask(GL_FALSE);
+    cache.viewport(0, 0, 640, 480);
+    cache.viewport(0, 0, 640, 480);
+    errors += checkStep("fixed function state", cache, 4, 4,
+                        calls("blendFunc 302 303", "depthFunc 201", "depthMask 0", "viewport 0 0 640 480"));
+
+    // The element array binding belongs to the VAO, the array binding doesn't
+    cache.bindVertexArray(1);
+    cache.bindBuffer(GL_ARRAY_BUFFER, 8);
+    cache.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 9);
+    cache.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 9);
+    errors += checkStep("buffers", cache, 3, 1,
+                        calls("bindVertexArray 1", "bindBuffer 8892 8", "bindBuffer 8893 9"));
+    cache.bindVertexArray(2);
+    cache.bindVertexArray(2);
+    cache.bindBuffer(GL_ARRAY_BUFFER, 8);
+    cache.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 9);
+    errors += checkStep("bindVertexArray", cache, 2, 2, calls("bindVertexArray 2", "bindBuffer 8893 9"));
+
+    // bindBufferBase is always issued, and binds the generic target too
+    cache.bindBufferBase(GL_UNIFORM_BUFFER, 0, 4);
+    cache.bindBufferBase(GL_UNIFORM_BUFFER, 0, 4);
+    cache.bindBuffer(GL_UNIFORM_BUFFER, 4);
+    errors += checkStep("bindBufferBase", cache, 2, 1,
+                        calls("bindBufferBase 8a11 0 4", "bindBufferBase 8a11 0 4"));
+
+    // After invalidate(), the same calls again are all issued
+    cache.invalidate();
+    cache.useProgram(3);
+    cache.bindTexture(0, GL_TEXTURE_2D, 5);
+    cache.bindVertexArray(2);
+    errors += checkStep("invalidate", cache, 4, 0,
+                        calls("useProgram 3", "activeTexture 0", "bindTexture de1 5", "bindVertexArray 2"));
+    cache.invalidate();
+    cache.disable(GL_DEPTH_TEST);
+    cache.depthFunc(GL_LESS);
+    cache.viewport(0, 0, 640, 480);
+    cache.bindBuffer(GL_ARRAY_BUFFER, 8);
+    errors += checkStep("invalidate", cache, 4, 0,
+                        calls("disable b71", "depthFunc 201", "viewport 0 0 640 480", "bindBuffer 8892 8"));
+
+    // The counters of the frame that ended
+    cache.useProgram(3);
+    cache.useProgram(3);
+    cache.beginFrame();
+    errors += cache.lastFrameCounters().issued != 1 || cache.lastFrameCounters().elided != 1 ||
+              cache.frameCounters().issued != 0 || cache.frameCounters().elided != 0;
+    recorded.clear();
+
+    // The cost of a call that is elided, and of one that is not
+    GLStateFunctions counting = recordingFunctions();
+    counting.useProgram = countUseProgram;
+    GLStateCache timed(counting);
+    double start = now();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        timed.useProgram(1);
+    }
+    double elidedTime = now() - start;
+    start = now();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        timed.useProgram(i & 1);
+    }
+    double issuedTime = now() - start;
+    errors += stubCalls != count + 1 || timed.frameCounters().issued != count + 1 ||
+              timed.frameCounters().elided != count - 1;
+
+    printf("%u calls : %.2f ns per elided call, %.2f ns per issued call (to a stub)\n", count,
+           1e9 * elidedTime / count, 1e9 * issuedTime / count);
+    printf("GL state checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+/*
+GPU culling benchmark.
+
+Scatters 1k, 10k, 100k and 1M instances of a small mesh around the camera
+and, for a camera turning around in several directions, compares :
+ - "CPU" : cullSpheres (common/culling.cpp), upload of the visible model
+   matrices, one instanced draw call
+ - "GPU" : GpuCuller (common/gpuculling.cpp), where a compute shader culls
+   the instances uploaded once, packs the visible matrices and writes the
+   instance count of a glDrawElementsIndirect ; the CPU reads nothing back
+and reports the time per frame of each, up to glFinish.
+
+Checks, outside of the timings, that the compute shader finds exactly the
+same visible instances as the scalar CPU reference, and that the indirect
+draw really draws that many instances (GL_PRIMITIVES_GENERATED query).
+
+Needs GL 4.3 (Mesa's llvmpipe has it).
+
+Usage : gpuculling_benchmark [views]
+Run it from tutorial09_vbo_indexing/ so that it finds the shaders
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+#include <common/culling.hpp>
+#include <common/glstate.hpp>
+#include <common/gpuculling.hpp>
+#include <common/instancing.hpp>
+#include <common/mesh.hpp>
+#include <common/shader.hpp>
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+    int views = argc > 1 ? atoi(argv[1]) : 16;
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(64, 64, "GPU culling benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open a GL 4.3 window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+    if (!GpuCuller::isSupported())
+    {
+        fprintf(stderr, "Compute shaders are not supported\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    glViewport(0, 0, 1, 1);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    GLuint programID = LoadShaders("StandardShadingInstanced.vertexshader", "StandardShading.fragmentshader");
+    GLuint VPID = glGetUniformLocation(programID, "VP");
+    GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
+
+    // A single triangle : the cost is in the instances, not the vertices
+    std::vector<glm::vec3> vertices;
+    vertices.push_back(glm::vec3(-1.0f, -1.0f, 0.0f));
+    vertices.push_back(glm::vec3(1.0f, -1.0f, 0.0f));
+    vertices.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<glm::vec2> uvs(3, glm::vec2(0.0f));
+    std::vector<glm::vec3> normals(3, glm::vec3(0.0f, 0.0f, 1.0f));
+    std::vector<unsigned short> indices;
+    indices.push_back(0);
+    indices.push_back(1);
+    indices.push_back(2);
+    glm::vec3 meshCenter;
+    float meshRadius;
+    computeBoundingSphere(vertices, meshCenter, meshRadius);
+
+    // Same mesh twice, as each VAO points its instance attributes at a different buffer
+    Mesh cpuMesh, gpuMesh;
+    cpuMesh.create(vertices, uvs, normals, indices);
+    gpuMesh.create(vertices, uvs, normals, indices);
+
+    const unsigned int sizes[4] = {1000, 10000, 100000, 1000000};
+
+    InstanceBuffer cpuInstances;
+    createInstanceBuffer(cpuInstances, 3, 1); // grows with the visible instances
+    cpuMesh.bind();
+    enableInstanceAttributes(cpuInstances);
+
+    GpuCuller culler;
+    if (!culler.create("CullInstances.computeshader", 3, sizes[3]))
+    {
+        fprintf(stderr, "Failed to build the culling compute shader\n");
+        glfwTerminate();
+        return -1;
+    }
+    gpuMesh.bind();
+    enableInstanceAttributes(culler.visibleInstances());
+    glBindVertexArray(0);
+
+    GLuint primitivesQuery;
+    glGenQueries(1, &primitivesQuery);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 500.0f);
+    GLStateCache state;
+    int mismatches = 0;
+
+    printf("%d views per size\n", views);
+    printf("%9s %10s %12s %12s %9s\n", "instances", "visible", "CPU ms", "GPU ms", "speedup");
+
+    for (int s = 0; s < 4; s++)
+    {
+        unsigned int count = sizes[s];
+
+        srand(1234);
+        std::vector<glm::mat4> models(count);
+        BoundingSpheres bounds;
+        bounds.resize(count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            glm::vec3 position(randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f));
+            models[i] = glm::translate(glm::mat4(1.0f), position);
+            bounds.set(i, glm::vec3(models[i] * glm::vec4(meshCenter, 1.0f)), meshRadius);
+        }
+
+        // The scene does not move : the GPU path uploads it once
+        culler.upload(bounds, models, state);
+
+        std::vector<unsigned int> cpuVisible, gpuVisible;
+        std::vector<glm::mat4> visibleModels;
+        double times[2] = {0.0, 0.0};
+        unsigned int visibleCount = 0;
+
+        // View -1 warms up both paths (shader compilation on first use, buffer growth) and is not counted
+        for (int view = -1; view < views; view++)
+        {
+            float angle = 6.2831853f * view / views;
+            glm::vec3 direction(cos(angle), 0.3f * sin(3.0f * angle), sin(angle));
+            glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f), direction, glm::vec3(0, 1, 0));
+            glm::mat4 VP = projection * viewMatrix;
+            Frustum frustum = extractFrustumPlanes(VP);
+
+            for (int path = 0; path < 2; path++)
+            {
+                glFinish();
+                double start = glfwGetTime();
+                if (path == 0)
+                {
+                    cullSpheres(frustum, bounds, cpuVisible);
+                    visibleModels.resize(cpuVisible.size());
+                    for (unsigned int i = 0; i < cpuVisible.size(); i++)
+                    {
+                        visibleModels[i] = models[cpuVisible[i]];
+                    }
+                    uploadInstanceMatrices(cpuInstances, visibleModels, state);
+                }
+                else
+                {
+                    culler.cull(frustum, gpuMesh, state);
+                }
+
+                state.useProgram(programID);
+                glUniformMatrix4fv(VPID, 1, GL_FALSE, &VP[0][0]);
+                glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &viewMatrix[0][0]);
+                glBeginQuery(GL_PRIMITIVES_GENERATED, primitivesQuery);
+                if (path == 0)
+                {
+                    if (!cpuVisible.empty())
+                    {
+                        state.bindVertexArray(cpuMesh.vertexArray());
+                        cpuMesh.drawInstanced(cpuVisible.size());
+                    }
+                }
+                else
+                {
+                    culler.draw(gpuMesh, state);
+                }
+                glEndQuery(GL_PRIMITIVES_GENERATED);
+                glFinish();
+                if (view >= 0)
+                {
+                    times[path] += glfwGetTime() - start;
+                }
+
+                GLuint primitives = 0;
+                glGetQueryObjectuiv(primitivesQuery, GL_QUERY_RESULT, &primitives);
+                if (path == 1)
+                {
+                    mismatches += primitives != cpuVisible.size();
+                }
+            }
+
+            // Exactly the same set as the scalar reference
+            cullSpheresScalar(frustum, bounds, cpuVisible);
+            culler.readVisibleIndices(gpuVisible, state);
+            std::sort(gpuVisible.begin(), gpuVisible.end());
+            mismatches += gpuVisible != cpuVisible;
+            if (view >= 0)
+            {
+                visibleCount += cpuVisible.size();
+            }
+        }
+
+        printf("%9u %10u %12.3f %12.3f %8.2fx\n", count, visibleCount / views, 1000.0 * times[0] / views,
+               1000.0 * times[1] / views, times[0] / times[1]);
+    }
+
+    printf("GPU visibility and draws %s the CPU reference (%d mismatches)\n", mismatches == 0 ? "match" : "DIFFER FROM",
+           mismatches);
+
+    // Cleanup
+    glDeleteQueries(1, &primitivesQuery);
+    culler.destroy();
+    deleteInstanceBuffer(cpuInstances);
+    cpuMesh.destroy();
+    gpuMesh.destroy();
+    glDeleteProgram(programID);
+
+    glfwTerminate();
+
+    return mismatches == 0 ? 0 : 1;
+}
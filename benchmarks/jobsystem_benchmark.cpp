@@ -0,0 +1,284 @@
+/*
+Job system benchmark.
+
+Measures common/jobsystem.cpp :
+ - spawn overhead : the time per job for many empty jobs, spawned from the
+   main thread under one parent, and spawned recursively from inside jobs
+ - parallelFor scaling : building 1M instance matrices (what the heads of
+   tutorial09_AssImp need every frame), with 0, 1, 3, 7 ... worker threads
+   and several grains, against a plain loop. The instrumentation hooks
+   measure how busy each thread was.
+
+and checks, with every worker count, that every job runs exactly once, that
+dependencies are respected, that main thread jobs run on the main thread
+and that parallelFor visits every index exactly once.
+
+Usage : jobsystem_benchmark [jobs] [instances]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+#include <common/clock.hpp>
+#include <common/jobsystem.hpp>
+
+// Same placement as buildHeadRing() in tutorial09_AssImp.cpp
+void buildInstanceMatrices(unsigned int count, unsigned int first, unsigned int last, glm::mat4 *matrices)
+{
+    float radius = 3.75f * count / 8.0f;
+    float anglePerHead = 360.0f / count;
+    for (unsigned int i = first; i < last; i++)
+    {
+        float angle = glm::radians(anglePerHead * i);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(radius * cos(angle), radius * sin(angle), 1.0f));
+        model = glm::rotate(model, angle + glm::radians(90.0f), glm::vec3(0, 0, 1));
+        matrices[i] = glm::rotate(model, glm::radians(90.0f), glm::vec3(1, 0, 0));
+    }
+}
+
+// Busy time of each thread, from the instrumentation hooks
+struct Timeline
+{
+    double started[64];
+    double busy[64];
+};
+
+void timelineJobStarted(const Job *, unsigned int worker, void *user)
+{
+    Timeline *timeline = static_cast<Timeline *>(user);
+    timeline->started[worker] = clockTime();
+}
+
+void timelineJobFinished(const Job *, unsigned int worker, void *user)
+{
+    Timeline *timeline = static_cast<Timeline *>(user);
+    timeline->busy[worker] += clockTime() - timeline->started[worker];
+}
+
+// A binary tree of 'depth' levels of jobs, each spawning its two children from inside
+void spawnTree(JobSystem &jobs, Job *parent, int depth, std::atomic<unsigned int> *counter)
+{
+    counter->fetch_add(1, std::memory_order_relaxed);
+    if (depth > 0)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            JobSystem *system = &jobs;
+            Job *child = jobs.createJob(
+                [system, parent, depth, counter]() { spawnTree(*system, parent, depth - 1, counter); }, parent);
+            jobs.run(child);
+        }
+    }
+}
+
+int checkJobSystem(JobSystem &jobs)
+{
+    int errors = 0;
+
+    // Every job exactly once, with jobs spawning jobs
+    const unsigned int count = 20000;
+    std::vector<std::atomic<unsigned int> > runs(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        runs[i] = 0;
+    }
+    Job *root = jobs.createJob([]() {});
+    for (unsigned int i = 0; i < count; i += 10)
+    {
+        std::atomic<unsigned int> *batch = &runs[i];
+        Job *job = jobs.createJob(
+            [&jobs, root, batch]() {
+                for (unsigned int k = 0; k < 10; k++)
+                {
+                    std::atomic<unsigned int> *run = batch + k;
+                    jobs.run(jobs.createJob([run]() { run->fetch_add(1); }, root));
+                }
+            },
+            root);
+        jobs.run(job);
+    }
+    jobs.run(root);
+    jobs.wait(root);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        errors += runs[i] != 1;
+    }
+
+    // Dependencies : a chain of diamonds, every job checks that what it depends on is done
+    std::atomic<unsigned int> sequence(0);
+    std::vector<unsigned int> order(3 * 100, 0);
+    std::vector<Job *> diamonds;
+    Job *previous = NULL;
+    for (unsigned int d = 0; d < 100; d++)
+    {
+        unsigned int *slots = &order[3 * d];
+        Job *left = jobs.createJob([slots, &sequence]() { slots[0] = ++sequence; });
+        Job *right = jobs.createJob([slots, &sequence]() { slots[1] = ++sequence; });
+        Job *join = jobs.createJob([slots, &sequence]() { slots[2] = ++sequence; });
+        jobs.addDependency(join, left);
+        jobs.addDependency(join, right);
+        if (previous != NULL)
+        {
+            jobs.addDependency(left, previous);
+            jobs.addDependency(right, previous);
+        }
+        diamonds.push_back(join);
+        diamonds.push_back(right);
+        diamonds.push_back(left);
+        previous = join;
+    }
+    // Everything is wired before anything runs
+    for (unsigned int i = 0; i < diamonds.size(); i++)
+    {
+        jobs.run(diamonds[i]);
+    }
+    jobs.wait(previous);
+    for (unsigned int d = 0; d < 100; d++)
+    {
+        errors += order[3 * d + 2] < order[3 * d] || order[3 * d + 2] < order[3 * d + 1];
+        if (d > 0)
+        {
+            errors += order[3 * d] < order[3 * d - 1] || order[3 * d + 1] < order[3 * d - 1];
+        }
+    }
+
+    // Main thread jobs, released by a worker
+    std::thread::id mainThread = std::this_thread::get_id();
+    std::thread::id ranOn;
+    bool loaded = false;
+    Job *load = jobs.createJob([&loaded]() { loaded = true; });
+    Job *upload = jobs.createMainThreadJob([&ranOn, &loaded, &errors]() {
+        ranOn = std::this_thread::get_id();
+        errors += !loaded;
+    });
+    jobs.addDependency(upload, load);
+    jobs.run(upload);
+    jobs.run(load);
+    jobs.wait(upload);
+    errors += ranOn != mainThread;
+
+    // parallelFor, with grains that do and do not divide the range
+    const unsigned int grains[4] = {0, 1, 7, 1000};
+    std::vector<std::atomic<unsigned int> > visits(10000);
+    for (int g = 0; g < 4; g++)
+    {
+        for (unsigned int i = 0; i < visits.size(); i++)
+        {
+            visits[i] = 0;
+        }
+        jobs.parallelFor(3, visits.size(), grains[g], [&visits](unsigned int first, unsigned int last) {
+            for (unsigned int i = first; i < last; i++)
+            {
+                visits[i].fetch_add(1);
+            }
+        });
+        for (unsigned int i = 0; i < visits.size(); i++)
+        {
+            errors += visits[i] != (i >= 3 ? 1u : 0u);
+        }
+    }
+
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int jobCount = argc > 1 ? atoi(argv[1]) : 1000000;
+    unsigned int instances = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    std::vector<unsigned int> workerCounts;
+    unsigned int maxWorkers = JobSystem::defaultWorkerCount() > 3 ? JobSystem::defaultWorkerCount() : 3;
+    for (unsigned int workers = 0; workers <= maxWorkers; workers = workers * 2 + 1)
+    {
+        workerCounts.push_back(workers);
+    }
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+    int errors = 0;
+    std::vector<glm::mat4> reference(instances), matrices(instances);
+    buildInstanceMatrices(instances, 0, instances, &matrices[0]); // first touch of the pages
+    double start = clockTime();
+    buildInstanceMatrices(instances, 0, instances, &reference[0]);
+    double serialTime = clockTime() - start;
+
+    printf("%7s %14s %14s %14s %10s %10s\n", "workers", "flat ns/job", "nested ns/job", "grain", "ms", "speedup");
+    for (unsigned int w = 0; w < workerCounts.size(); w++)
+    {
+        JobSystem jobs;
+        jobs.create(workerCounts[w]);
+        errors += checkJobSystem(jobs);
+
+        // Empty jobs, all children of one root
+        start = clockTime();
+        Job *root = jobs.createJob([]() {});
+        for (unsigned int i = 0; i < jobCount; i++)
+        {
+            jobs.run(jobs.createJob([]() {}, root));
+        }
+        jobs.run(root);
+        jobs.wait(root);
+        double flatTime = clockTime() - start;
+
+        // The same number of jobs, spawned from inside jobs
+        std::atomic<unsigned int> spawned(0);
+        int depth = (int)log2((double)jobCount);
+        start = clockTime();
+        root = jobs.createJob([]() {});
+        jobs.run(jobs.createJob([&jobs, root, depth, &spawned]() { spawnTree(jobs, root, depth - 1, &spawned); },
+                                root));
+        jobs.run(root);
+        jobs.wait(root);
+        double nestedTime = clockTime() - start;
+
+        printf("%7u %14.1f %14.1f\n", workerCounts[w], 1e9 * flatTime / jobCount, 1e9 * nestedTime / spawned);
+
+        // Instance matrices
+        const unsigned int grains[4] = {0, 256, 4096, 65536};
+        for (int g = 0; g < 4; g++)
+        {
+            Timeline timeline = {};
+            JobHooks hooks = {timelineJobStarted, timelineJobFinished, &timeline};
+            jobs.setHooks(hooks);
+            glm::mat4 *output = &matrices[0];
+            start = clockTime();
+            jobs.parallelFor(0, instances, grains[g], [instances, output](unsigned int first, unsigned int last) {
+                buildInstanceMatrices(instances, first, last, output);
+            });
+            double time = clockTime() - start;
+            JobHooks noHooks = {NULL, NULL, NULL};
+            jobs.setHooks(noHooks);
+
+            for (unsigned int i = 0; i < instances; i++)
+            {
+                errors += matrices[i] != reference[i];
+            }
+
+            // What the threads spent in jobs, the main thread first
+            char busy[256] = "";
+            for (unsigned int t = 0; t <= workerCounts[w] && t < 16; t++)
+            {
+                sprintf(busy + strlen(busy), " %.0f%%", 100.0 * timeline.busy[t] / time);
+            }
+            printf("%7s %14s %14s %14u %10.2f %9.2fx   busy :%s\n", "", "", "", grains[g], 1000.0 * time,
+                   serialTime / time, busy);
+        }
+
+        jobs.destroy();
+    }
+    printf("plain loop : %.2f ms for %u instances\n", 1000.0 * serialTime, instances);
+
+    printf("Job system checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,269 @@
+/*
+Multi-draw-indirect benchmark.
+
+Draws 1k, 10k and 100k objects, each one of 8 small meshes with one of 4
+textures, at random places in front of the camera :
+ - "per-object" : every object is a packet of a sorted RenderQueue, so one
+   uniform upload and one glDrawElements per object (the tutorials' loop)
+ - "multi-draw" : the meshes live in a GeometryPool, the objects are put in
+   one IndirectBatch per texture, and each batch is one
+   glMultiDrawElementsIndirect (or one call per command without
+   GL_ARB_multi_draw_indirect)
+and reports draw calls and CPU submit time per frame. The multi-draw time
+includes building the commands and uploading them with the model matrices.
+
+The meshes are tiny and the viewport is 1x1 pixel, so that the GPU side (or
+llvmpipe's rasterizer) stays negligible.
+
+Usage : multidraw_benchmark [frames]
+Run it from tutorial09_vbo_indexing/ so that it finds the StandardShading shaders
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+#include <common/geometrypool.hpp>
+#include <common/glstate.hpp>
+#include <common/mesh.hpp>
+#include <common/renderqueue.hpp>
+#include <common/shader.hpp>
+
+static const int NumTextures = 4;
+static const int NumMeshes = 8;
+
+struct TestObject
+{
+    unsigned int texture;
+    unsigned int mesh;
+    glm::mat4 model;
+};
+
+// A flat polygon with 'sides' vertices around the origin, as a triangle fan
+void buildPolygon(int sides, std::vector<glm::vec3> &vertices, std::vector<glm::vec2> &uvs,
+                  std::vector<glm::vec3> &normals, std::vector<unsigned short> &indices)
+{
+    for (int i = 0; i < sides; i++)
+    {
+        float angle = 6.2831853f * i / sides;
+        vertices.push_back(glm::vec3(cos(angle), sin(angle), 0.0f));
+        uvs.push_back(glm::vec2(0.5f + 0.5f * cos(angle), 0.5f + 0.5f * sin(angle)));
+        normals.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+    for (int i = 1; i + 1 < sides; i++)
+    {
+        indices.push_back(0);
+        indices.push_back(i);
+        indices.push_back(i + 1);
+    }
+}
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 10;
+    int warmupFrames = 3;
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy; should not be needed
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(64, 64, "Multi-draw benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open GLFW window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    glViewport(0, 0, 1, 1);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_CULL_FACE);
+
+    GLuint programID = LoadShaders("StandardShading.vertexshader", "StandardShading.fragmentshader");
+    GLuint instancedProgramID = LoadShaders("StandardShadingInstanced.vertexshader", "StandardShading.fragmentshader");
+    GLuint InstancedVPID = glGetUniformLocation(instancedProgramID, "VP");
+    GLuint InstancedViewMatrixID = glGetUniformLocation(instancedProgramID, "V");
+
+    RenderQueue queue;
+    unsigned int standardProgram = queue.addProgram(programID);
+
+    GLuint textures[NumTextures];
+    glGenTextures(NumTextures, textures);
+    for (int i = 0; i < NumTextures; i++)
+    {
+        unsigned char pixel[3] = {(unsigned char)(64 * i), 128, 0};
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, pixel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        queue.addTexture(textures[i]);
+    }
+
+    // Every mesh twice : with its own buffers, and in the pool
+    Mesh meshes[NumMeshes];
+    GeometryPool pool;
+    pool.create(1024, 1024);
+    PoolMesh poolMeshes[NumMeshes];
+    for (int i = 0; i < NumMeshes; i++)
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec2> uvs;
+        std::vector<glm::vec3> normals;
+        std::vector<unsigned short> indices;
+        buildPolygon(3 + i, vertices, uvs, normals, indices);
+        meshes[i].create(vertices, uvs, normals, indices);
+        queue.addMesh(meshes[i]);
+        pool.addMesh(vertices, uvs, normals, indices, poolMeshes[i]);
+    }
+
+    IndirectBatch batches[NumTextures];
+    for (int i = 0; i < NumTextures; i++)
+    {
+        batches[i].create(3);
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0, 0, 10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    glm::mat4 VP = projection * view;
+
+    printf("%d frames per size, %s\n", frames,
+           GLEW_ARB_multi_draw_indirect ? "glMultiDrawElementsIndirect"
+                                        : "no GL_ARB_multi_draw_indirect, one call per command");
+    printf("%8s %-11s %12s %12s %16s\n", "objects", "path", "draw calls", "commands", "CPU submit ms");
+
+    const int sizes[3] = {1000, 10000, 100000};
+    for (int s = 0; s < 3; s++)
+    {
+        int count = sizes[s];
+
+        srand(1234);
+        std::vector<TestObject> objects(count);
+        for (int i = 0; i < count; i++)
+        {
+            objects[i].texture = rand() % NumTextures;
+            objects[i].mesh = rand() % NumMeshes;
+            glm::vec3 position(randomFloat(-4.0f, 4.0f), randomFloat(-3.0f, 3.0f), randomFloat(-50.0f, 5.0f));
+            objects[i].model = glm::translate(glm::mat4(1.0f), position);
+        }
+
+        for (int path = 0; path < 2; path++)
+        {
+            GLStateCache state;
+            double submitTime = 0.0;
+            unsigned int drawCalls = 0;
+            unsigned int commands = 0;
+
+            for (int frame = 0; frame < warmupFrames + frames; frame++)
+            {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                state.beginFrame();
+
+                double start = glfwGetTime();
+                if (path == 0)
+                {
+                    queue.begin(view, projection);
+                    for (int i = 0; i < count; i++)
+                    {
+                        queue.add(RenderQueue::Opaque, standardProgram, objects[i].texture, objects[i].mesh,
+                                  objects[i].model);
+                    }
+                    queue.sort();
+                    queue.submit(state);
+                    drawCalls = commands = queue.stats().packets;
+                }
+                else
+                {
+                    for (int b = 0; b < NumTextures; b++)
+                    {
+                        batches[b].clear();
+                    }
+                    for (int i = 0; i < count; i++)
+                    {
+                        batches[objects[i].texture].add(poolMeshes[objects[i].mesh], objects[i].model);
+                    }
+
+                    state.useProgram(instancedProgramID);
+                    glUniformMatrix4fv(InstancedVPID, 1, GL_FALSE, &VP[0][0]);
+                    glUniformMatrix4fv(InstancedViewMatrixID, 1, GL_FALSE, &view[0][0]);
+                    drawCalls = commands = 0;
+                    for (int b = 0; b < NumTextures; b++)
+                    {
+                        state.bindTexture(0, GL_TEXTURE_2D, textures[b]);
+                        drawCalls += batches[b].submit(pool, state);
+                        commands += batches[b].commandCount();
+                    }
+                }
+                double end = glfwGetTime();
+
+                // Don't let the queued work of this frame spill into the next one
+                glFinish();
+
+                if (frame >= warmupFrames)
+                {
+                    submitTime += end - start;
+                }
+            }
+
+            printf("%8d %-11s %12u %12u %16.3f\n", count, path == 0 ? "per-object" : "multi-draw", drawCalls,
+                   commands, 1000.0 * submitTime / frames);
+        }
+    }
+
+    // Cleanup
+    for (int i = 0; i < NumTextures; i++)
+    {
+        batches[i].destroy();
+    }
+    for (int i = 0; i < NumMeshes; i++)
+    {
+        meshes[i].destroy();
+    }
+    pool.destroy();
+    glDeleteTextures(NumTextures, textures);
+    glDeleteProgram(programID);
+    glDeleteProgram(instancedProgramID);
+
+    glfwTerminate();
+
+    return 0;
+}
@@ -0,0 +1,307 @@
+/*
+OBJ import benchmark.
+
+Writes a large .obj file for the run : a grid of tori of triangles (1M by
+default), with positions, UVs and normals and an object per torus, the way
+most exporters write them. Then times, best of the runs :
+ - fread of the whole file, what any parser costs at least
+ - the OBJ importer of AssImp without any post-processing step, from the
+   file as DefaultIOSystem maps it
+ - the same from a copy of the file : one that doesn't end with a line end
+   is read whole into memory first, as every file was before the mapping
+ - loadOBJ, the fscanf loader of the tutorials, for reference
+and reports MB and triangles per second.
+
+Checks that :
+ - AssImp gives a mesh per object, every triangle, and a vertex per corner
+   with the position, UV and normal of the file, within 1e-5
+ - the mapped and the copied file give the same scene, bit for bit
+ - loadOBJ gives the same corners, within 1e-5
+
+Usage : obj_benchmark [triangles] [runs]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+using namespace glm;
+
+// Include AssImp
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <common/objloader.hpp>
+
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// What the file holds, as strtof reads the text written : the attributes of each vertex, and the vertex of each
+// corner of each triangle, in the order of the file
+struct ObjContents
+{
+    std::vector<vec3> positions, normals;
+    std::vector<vec2> uvs;
+    std::vector<unsigned int> corners;
+};
+
+float written(std::string &text, const char *format, float value)
+{
+    char number[32];
+    snprintf(number, sizeof(number), format, value);
+    text += number;
+    return strtof(number, NULL);
+}
+
+// 'objects' tori of side x side quads on a grid, each quad as two triangles, and each torus with its own vertices :
+// vertex k of an object has position, UV and normal k
+std::string objText(unsigned int objects, unsigned int side, ObjContents &contents)
+{
+    std::string text;
+    text.reserve((size_t)objects * side * side * 160);
+    char line[256];
+    snprintf(line, sizeof(line), "# obj_benchmark, %u tori of %u triangles\n", objects, 2 * side * side);
+    text += line;
+    unsigned int columns = (unsigned int)ceilf(sqrtf((float)objects));
+    for (unsigned int o = 0; o < objects; o++)
+    {
+        vec3 offset(3.0f * (o % columns), 0.0f, 3.0f * (o / columns));
+        unsigned int first = (unsigned int)contents.positions.size();
+        snprintf(line, sizeof(line), "o Torus%u\n", o);
+        text += line;
+        for (unsigned int j = 0; j <= side; j++)
+        {
+            for (unsigned int i = 0; i <= side; i++)
+            {
+                float u = float(i) / side, v = float(j) / side;
+                float theta = 6.2831853f * u, phi = 6.2831853f * v;
+                vec3 center = vec3(cosf(theta), 0.0f, sinf(theta));
+                vec3 normal = cosf(phi) * center + vec3(0.0f, sinf(phi), 0.0f);
+                vec3 position = offset + center + 0.4f * normal;
+                vec3 p, n;
+                vec2 uv;
+                text += "v";
+                p.x = written(text, " %f", position.x);
+                p.y = written(text, " %f", position.y);
+                p.z = written(text, " %f", position.z);
+                text += "\nvt";
+                uv.x = written(text, " %f", u);
+                uv.y = written(text, " %f", v);
+                text += "\nvn";
+                n.x = written(text, " %f", normal.x);
+                n.y = written(text, " %f", normal.y);
+                n.z = written(text, " %f", normal.z);
+                text += "\n";
+                contents.positions.push_back(p);
+                contents.uvs.push_back(uv);
+                contents.normals.push_back(n);
+            }
+        }
+        for (unsigned int j = 0; j < side; j++)
+        {
+            for (unsigned int i = 0; i < side; i++)
+            {
+                unsigned int a = first + j * (side + 1) + i, b = a + 1, c = b + side + 1, d = a + side + 1;
+                const unsigned int triangles[6] = {a, b, c, a, c, d};
+                for (int t = 0; t < 6; t += 3)
+                {
+                    unsigned int x = triangles[t] + 1, y = triangles[t + 1] + 1, z = triangles[t + 2] + 1;
+                    snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", x, x, x, y, y, y, z, z, z);
+                    text += line;
+                    contents.corners.insert(contents.corners.end(), triangles + t, triangles + t + 3);
+                }
+            }
+        }
+    }
+    return text;
+}
+
+bool writeFile(const char *path, const std::string &text, size_t size)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool written = fwrite(text.data(), 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+size_t readFile(const char *path, std::vector<char> &bytes)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    size_t size = fread(&bytes[0], 1, bytes.size(), file);
+    fclose(file);
+    return size;
+}
+
+bool near(const vec3 &a, const vec3 &b)
+{
+    return all(lessThanEqual(abs(a - b), vec3(1e-5f)));
+}
+
+// A mesh per object, and a vertex per corner with the attributes of its vertex in the file
+int checkScene(const aiScene *scene, unsigned int objects, const ObjContents &contents)
+{
+    if (scene == NULL || scene->mNumMeshes != objects)
+    {
+        return 1;
+    }
+    int errors = 0;
+    size_t corner = 0;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh *mesh = scene->mMeshes[m];
+        if (!mesh->HasNormals() || !mesh->HasTextureCoords(0) || mesh->mNumVertices != 3 * mesh->mNumFaces ||
+            corner + mesh->mNumVertices > contents.corners.size())
+        {
+            return errors + 1;
+        }
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+            const aiFace &face = mesh->mFaces[f];
+            errors += face.mNumIndices != 3 || face.mIndices[0] != 3 * f || face.mIndices[2] != 3 * f + 2;
+        }
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++, corner++)
+        {
+            unsigned int k = contents.corners[corner];
+            const aiVector3D &p = mesh->mVertices[i], &n = mesh->mNormals[i], &t = mesh->mTextureCoords[0][i];
+            errors += !near(vec3(p.x, p.y, p.z), contents.positions[k]) ||
+                      !near(vec3(n.x, n.y, n.z), contents.normals[k]) ||
+                      !near(vec3(t.x, t.y, t.z), vec3(contents.uvs[k], 0.0f));
+        }
+    }
+    return errors + (corner != contents.corners.size());
+}
+
+bool sameScene(const aiScene *a, const aiScene *b)
+{
+    if (a == NULL || b == NULL || a->mNumMeshes != b->mNumMeshes)
+    {
+        return false;
+    }
+    for (unsigned int m = 0; m < a->mNumMeshes; m++)
+    {
+        const aiMesh *x = a->mMeshes[m], *y = b->mMeshes[m];
+        size_t bytes = x->mNumVertices * sizeof(aiVector3D);
+        if (x->mNumVertices != y->mNumVertices || x->mNumFaces != y->mNumFaces ||
+            memcmp(x->mVertices, y->mVertices, bytes) != 0 || memcmp(x->mNormals, y->mNormals, bytes) != 0 ||
+            memcmp(x->mTextureCoords[0], y->mTextureCoords[0], bytes) != 0)
+        {
+            return false;
+        }
+        for (unsigned int f = 0; f < x->mNumFaces; f++)
+        {
+            if (x->mFaces[f].mNumIndices != y->mFaces[f].mNumIndices ||
+                memcmp(x->mFaces[f].mIndices, y->mFaces[f].mIndices, x->mFaces[f].mNumIndices * sizeof(unsigned int)))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int targetTriangles = argc > 1 ? atoi(argv[1]) : 1000000;
+    int runs = argc > 2 ? atoi(argv[2]) : 3;
+    const char *mappedPath = "obj_benchmark.obj";
+    const char *copiedPath = "obj_benchmark_copied.obj";
+
+    // About 8K triangles per object, at least 16 objects
+    unsigned int objects = glm::max(16u, targetTriangles / 8192);
+    unsigned int side = glm::max(2u, (unsigned int)(sqrtf(targetTriangles / 2.0f / objects) + 0.5f));
+    unsigned int triangles = objects * 2 * side * side;
+    ObjContents contents;
+    std::string text = objText(objects, side, contents);
+    if (!writeFile(mappedPath, text, text.size()) || !writeFile(copiedPath, text, text.size() - 1))
+    {
+        fprintf(stderr, "Cannot write %s\n", mappedPath);
+        return 1;
+    }
+    double megabytes = text.size() / 1048576.0;
+    int errors = 0;
+
+    printf("%u objects of %u triangles, %.1f MB of .obj, best of %d runs\n", objects, 2 * side * side, megabytes,
+           runs);
+    printf("%-28s %10s %10s %10s\n", "", "ms", "Mtris/s", "MB/s");
+    enum
+    {
+        Read,
+        Mapped,
+        Copied,
+        LoadOBJ,
+        PassCount
+    };
+    const char *names[PassCount] = {"fread", "AssImp, mapped", "AssImp, copied", "loadOBJ"};
+    double best[PassCount] = {1e30, 1e30, 1e30, 1e30};
+    std::vector<char> bytes(text.size());
+    std::vector<vec3> positions, normals;
+    std::vector<vec2> uvs;
+    Assimp::Importer mappedImporter, copiedImporter;
+    const aiScene *mapped = NULL, *copied = NULL;
+    for (int run = 0; run < runs; run++)
+    {
+        double start = now();
+        errors += readFile(mappedPath, bytes) != text.size();
+        best[Read] = glm::min(best[Read], now() - start);
+
+        start = now();
+        mapped = mappedImporter.ReadFile(mappedPath, 0);
+        best[Mapped] = glm::min(best[Mapped], now() - start);
+
+        start = now();
+        copied = copiedImporter.ReadFile(copiedPath, 0);
+        best[Copied] = glm::min(best[Copied], now() - start);
+
+        positions.clear();
+        uvs.clear();
+        normals.clear();
+        start = now();
+        errors += !loadOBJ(mappedPath, positions, uvs, normals);
+        best[LoadOBJ] = glm::min(best[LoadOBJ], now() - start);
+    }
+    for (int p = 0; p < PassCount; p++)
+    {
+        printf("%-28s %10.1f %10.2f %10.1f\n", names[p], 1000.0 * best[p], 1e-6 * triangles / best[p],
+               megabytes / best[p]);
+    }
+
+    int sceneErrors = checkScene(mapped, objects, contents);
+    errors += sceneErrors;
+    bool same = sameScene(mapped, copied);
+    errors += !same;
+    int loadErrors = positions.size() != contents.corners.size();
+    for (size_t i = 0; loadErrors == 0 && i < positions.size(); i++)
+    {
+        unsigned int k = contents.corners[i];
+        loadErrors += !near(positions[i], contents.positions[k]) || !near(normals[i], contents.normals[k]);
+    }
+    errors += loadErrors;
+
+    remove(mappedPath);
+    remove(copiedPath);
+
+    printf("AssImp mapped against copied : %.2fx faster, %.2fx slower than fread\n", best[Copied] / best[Mapped],
+           best[Mapped] / best[Read]);
+    printf("AssImp : %d corners differ from the file, mapped and copied scenes %s ; loadOBJ : %d corners differ\n",
+           sceneErrors, same ? "equal" : "DIFFER", loadErrors);
+    printf("OBJ import checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    return errors == 0 ? 0 : 1;
+}
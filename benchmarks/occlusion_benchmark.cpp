@@ -0,0 +1,226 @@
+/*
+Software occlusion culling benchmark.
+
+A city of box buildings with 200k small props in its streets, seen from
+street level while walking along an avenue and looking around. Every view :
+ - the buildings in the frustum are rasterized as occluders into an
+   OcclusionBuffer (common/occlusion.cpp), with the scalar reference and
+   with SSE on 1, 2 and 4 threads (the main one and job system workers)
+ - the props in the frustum are tested against it
+and the benchmark reports the setup (transform and binning), rasterization
+and test times, and the ratio of props culled by occlusion.
+
+Checks that every rasterization gives the same depth buffer, and that the
+culled props are really hidden : rays from the eye to their center and
+corners must all hit a building (through a BVH, common/bvh.cpp).
+
+Usage : occlusion_benchmark [props] [views]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+#include <common/clock.hpp>
+#include <common/culling.hpp>
+#include <common/bvh.hpp>
+#include <common/jobsystem.hpp>
+#include <common/occlusion.hpp>
+
+static const int CityBlocks = 24;      // per side
+static const float BlockSpacing = 12.0f; // building footprints are 8 wide, streets 4
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+// A [-1, 1] cube, outward faces counter-clockwise
+void buildCube(std::vector<glm::vec3> &vertices, std::vector<unsigned short> &indices)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        vertices.push_back(glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f));
+    }
+    static const unsigned short faces[36] = {0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4,
+                                             2, 6, 7, 2, 7, 3, 0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6};
+    indices.assign(faces, faces + 36);
+}
+
+bool insideFrustum(const Frustum &frustum, const glm::vec3 &point)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        if (glm::dot(glm::vec3(frustum.planes[p]), point) + frustum.planes[p].w < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int propCount = argc > 1 ? atoi(argv[1]) : 200000;
+    int views = argc > 2 ? atoi(argv[2]) : 16;
+
+    std::vector<glm::vec3> cubeVertices;
+    std::vector<unsigned short> cubeIndices;
+    buildCube(cubeVertices, cubeIndices);
+
+    // Buildings : one per block, centered on the city
+    srand(1234);
+    float cityHalfSize = 0.5f * CityBlocks * BlockSpacing;
+    std::vector<glm::mat4> buildingModels;
+    BoundingBoxes buildings;
+    buildings.resize(CityBlocks * CityBlocks);
+    for (int z = 0; z < CityBlocks; z++)
+    {
+        for (int x = 0; x < CityBlocks; x++)
+        {
+            float height = randomFloat(10.0f, 60.0f);
+            glm::vec3 center(-cityHalfSize + (x + 0.5f) * BlockSpacing, 0.5f * height,
+                             -cityHalfSize + (z + 0.5f) * BlockSpacing);
+            glm::vec3 extent(4.0f, 0.5f * height, 4.0f);
+            buildings.set(buildingModels.size(), center - extent, center + extent);
+            buildingModels.push_back(glm::scale(glm::translate(glm::mat4(1.0f), center), extent));
+        }
+    }
+    BVH buildingTree;
+    buildingTree.build(buildings);
+
+    // Props : anywhere on the ground, some of them end up inside buildings
+    BoundingBoxes props;
+    props.resize(propCount);
+    for (unsigned int i = 0; i < propCount; i++)
+    {
+        glm::vec3 center(randomFloat(-cityHalfSize, cityHalfSize), randomFloat(0.5f, 2.0f),
+                         randomFloat(-cityHalfSize, cityHalfSize));
+        glm::vec3 extent(randomFloat(0.3f, 1.0f), randomFloat(0.3f, 1.0f), randomFloat(0.3f, 1.0f));
+        props.set(i, center - extent, center + extent);
+    }
+
+    OcclusionBuffer buffer;
+    buffer.create(256, 192);
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.5f, 1000.0f);
+
+    // One thread : this one, without a job system
+    const int ThreadCounts[3] = {1, 2, 4};
+    JobSystem jobs[3];
+    for (int t = 1; t < 3; t++)
+    {
+        jobs[t].create(ThreadCounts[t] - 1);
+    }
+    double setupTime = 0.0, scalarTime = 0.0, simdTime[3] = {0.0, 0.0, 0.0}, testTime = 0.0;
+    double occluders = 0.0, triangles = 0.0, inFrustum = 0.0, culled = 0.0, offscreen = 0.0;
+    int mismatches = 0;
+    unsigned int unblocked = 0;
+    std::vector<unsigned int> visibleBuildings, visibleProps;
+    std::vector<float> reference;
+
+    for (int view = 0; view < views; view++)
+    {
+        // Walking down the middle avenue, looking around
+        glm::vec3 eye(0.0f, 1.8f, -cityHalfSize + (view + 0.5f) * 2.0f * cityHalfSize / views);
+        float angle = 6.2831853f * view / views * 3.0f;
+        glm::vec3 direction(sin(angle), 0.05f, cos(angle));
+        glm::mat4 viewProjection = projection * glm::lookAt(eye, eye + direction, glm::vec3(0, 1, 0));
+        Frustum frustum = extractFrustumPlanes(viewProjection);
+
+        double t0 = clockTime();
+        buffer.begin(viewProjection);
+        cullBoxes(frustum, buildings, visibleBuildings);
+        for (unsigned int i = 0; i < visibleBuildings.size(); i++)
+        {
+            buffer.addOccluder(cubeVertices, cubeIndices, buildingModels[visibleBuildings[i]]);
+        }
+        double t1 = clockTime();
+        setupTime += t1 - t0;
+        occluders += buffer.stats().occluders;
+        triangles += buffer.stats().triangles;
+
+        t0 = clockTime();
+        buffer.rasterizeScalar();
+        t1 = clockTime();
+        scalarTime += t1 - t0;
+        reference = buffer.depth();
+        for (int t = 0; t < 3; t++)
+        {
+            t0 = clockTime();
+            buffer.rasterize(t > 0 ? &jobs[t] : NULL);
+            t1 = clockTime();
+            simdTime[t] += t1 - t0;
+            mismatches += buffer.depth() != reference;
+        }
+
+        t0 = clockTime();
+        cullBoxes(frustum, props, visibleProps);
+        std::vector<unsigned int> hidden;
+        for (unsigned int i = 0; i < visibleProps.size(); i++)
+        {
+            unsigned int p = visibleProps[i];
+            if (!buffer.isBoxVisible(glm::vec3(props.minX[p], props.minY[p], props.minZ[p]),
+                                     glm::vec3(props.maxX[p], props.maxY[p], props.maxZ[p]), glm::mat4(1.0f)))
+            {
+                hidden.push_back(p);
+            }
+        }
+        t1 = clockTime();
+        testTime += t1 - t0;
+        inFrustum += buffer.stats().tested;
+        culled += buffer.stats().culled;
+        offscreen += buffer.stats().offscreen;
+
+        // Every point of a hidden prop that is in the frustum must be behind a building
+        for (unsigned int i = 0; i < hidden.size(); i++)
+        {
+            unsigned int p = hidden[i];
+            glm::vec3 min(props.minX[p], props.minY[p], props.minZ[p]);
+            glm::vec3 max(props.maxX[p], props.maxY[p], props.maxZ[p]);
+            for (int point = 0; point < 9; point++)
+            {
+                glm::vec3 target = point == 8 ? 0.5f * (min + max)
+                                              : glm::vec3(point & 1 ? max.x : min.x, point & 2 ? max.y : min.y,
+                                                          point & 4 ? max.z : min.z);
+                unsigned int hit;
+                float distance;
+                if (insideFrustum(frustum, target) && !buildingTree.raycast(eye, target - eye, 1.0f, hit, distance))
+                {
+                    unblocked++;
+                    break;
+                }
+            }
+        }
+    }
+
+    printf("%u props, %d views, %dx%d buffer, %s\n", propCount, views, buffer.width(), buffer.height(),
+           occlusionInstructionSet());
+    printf("%.0f occluders, %.0f triangles per view\n", occluders / views, triangles / views);
+    printf("setup %.3f ms, rasterization : scalar %.3f ms", 1000.0 * setupTime / views, 1000.0 * scalarTime / views);
+    for (int t = 0; t < 3; t++)
+    {
+        printf(", %d thread%s %.3f ms", ThreadCounts[t], ThreadCounts[t] > 1 ? "s" : "", 1000.0 * simdTime[t] / views);
+    }
+    printf("\ntests %.3f ms : %.0f props in the frustum, %.0f culled by occlusion (%.1f%%), %.0f outside of the "
+           "buffer\n",
+           1000.0 * testTime / views, inFrustum / views, culled / views, inFrustum > 0.0 ? 100.0 * culled / inFrustum : 0.0,
+           offscreen / views);
+    printf("depth buffers %s the scalar reference (%d mismatches)\n", mismatches == 0 ? "match" : "DIFFER FROM",
+           mismatches);
+    printf("%u culled props have a point in sight (%.3f%% of the culled ones)\n", unblocked,
+           culled > 0.0 ? 100.0 * unblocked / culled : 0.0);
+
+    for (int t = 1; t < 3; t++)
+    {
+        jobs[t].destroy();
+    }
+
+    return mismatches == 0 && unblocked == 0 ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/*
+Physics benchmark.
+
+Drops suzanne heads (2000 by default) onto the ground plane of tutorial09_AssImp, as rigid bodies with the convex
+hull of the mesh : layers of heads on a grid, each turned at random, as in its --physics mode. Their motion states
+write the Transforms, bounding spheres and model matrices the renderer draws the instances from. Then simulates
+'seconds' (20 by default) in steps of 1/60 s, fed with frames of 1/144 s, and reports for each second the bodies
+still awake and the time per step and per frame.
+
+Checks that :
+ - no head goes through the ground or flies away, and all are asleep at the end
+ - the instance data of each head is the transform of its body, within 1e-5, once they rest
+ - the simulation doesn't depend on the frame times : the same scene, fed frames of 2.5 ms in one run and of
+   random lengths up to a step in another, has every body at the same place after the same steps, bit for bit
+
+Usage : physics_benchmark [heads] [seconds]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+using namespace glm;
+
+#include <common/culling.hpp>
+#include <common/objloader.hpp>
+#include <common/physics.hpp>
+#include <common/transforms.hpp>
+
+// The heads of a pile, from the ground up and ready to fall : 'count' heads in layers of a square grid, 3 units
+// apart, each turned at random, from the seed of rand()
+void buildHeadPile(unsigned int count, unsigned int seed, Transforms &transforms)
+{
+    srand(seed);
+    transforms.resize(count);
+    unsigned int side = (unsigned int)ceilf(sqrtf(count / 4.0f));
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int layer = i / (side * side), cell = i % (side * side);
+        vec3 position(3.0f * (cell % side - (side - 1) / 2.0f), 3.0f * (cell / side - (side - 1) / 2.0f),
+                      2.0f + 3.0f * layer);
+        vec3 axis = normalize(vec3(rand() - RAND_MAX / 2, rand() - RAND_MAX / 2, rand() - RAND_MAX / 2) + 1e-3f);
+        float angle = 6.2831853f * rand() / RAND_MAX;
+        transforms.set(i, position, angleAxis(angle, axis));
+    }
+}
+
+// The heads, and the bodies that move them
+struct PhysicsScene
+{
+    Transforms transforms;
+    BoundingSpheres bounds;
+    std::vector<mat4> modelMatrices;
+    InstanceTargets targets;
+    PhysicsWorld world;
+
+    void create(const std::vector<vec3> &vertices, unsigned int count)
+    {
+        vec3 center;
+        float radius;
+        computeBoundingSphere(vertices, center, radius);
+        buildHeadPile(count, 1, transforms);
+        bounds.resize(count);
+        computeBoundingSpheres(transforms, center, radius, 0, count, bounds);
+        modelMatrices.resize(count);
+        computeModelMatrices(transforms, 0, count, &modelMatrices[0]);
+        targets.transforms = &transforms;
+        targets.bounds = &bounds;
+        targets.modelMatrices = &modelMatrices[0];
+        targets.boundsCenter = center;
+
+        world.create(count);
+        unsigned int hull = world.addConvexHull(vertices);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            world.addBody(hull, 1.0f, &targets, i);
+        }
+    }
+};
+
+bool near(const vec3 &a, const vec3 &b)
+{
+    return all(lessThanEqual(abs(a - b), vec3(1e-5f)));
+}
+
+// Where each head is drawn against where its body is, and whether it stayed on the ground
+int checkInstances(const PhysicsScene &scene, unsigned int &wrongInstances, unsigned int &lostHeads)
+{
+    const Transforms &transforms = scene.transforms;
+    const BoundingSpheres &bounds = scene.bounds;
+    wrongInstances = 0;
+    lostHeads = 0;
+    for (unsigned int i = 0; i < transforms.size(); i++)
+    {
+        vec3 position, drawn(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]);
+        quat rotation, drawnRotation(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i],
+                                     transforms.rotationZ[i]);
+        scene.world.getBodyTransform(i, position, rotation);
+        vec3 center = position + rotation * scene.targets.boundsCenter;
+        bool sameRotation = all(lessThanEqual(abs(vec4(rotation.x, rotation.y, rotation.z, rotation.w) -
+                                                  vec4(drawnRotation.x, drawnRotation.y, drawnRotation.z,
+                                                       drawnRotation.w)),
+                                              vec4(1e-5f))) ||
+                            abs(dot(rotation, drawnRotation)) > 1.0f - 1e-6f;
+        wrongInstances += !near(drawn, position) || !sameRotation ||
+                          !near(vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]), center) ||
+                          !near(vec3(scene.modelMatrices[i][3]), position);
+        // The hull is at least 0.5 from the origin of the mesh in every direction
+        lostHeads += position.z < 0.25f || length(vec2(position)) > 1000.0f;
+    }
+    return wrongInstances + lostHeads;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int heads = argc > 1 ? atoi(argv[1]) : 2000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 20;
+
+    std::vector<vec3> vertices, normals;
+    std::vector<vec2> uvs;
+    if (!loadOBJ("suzanne.obj", vertices, uvs, normals))
+    {
+        fprintf(stderr, "Cannot read suzanne.obj\n");
+        return 1;
+    }
+    int errors = 0;
+
+    PhysicsScene scene;
+    scene.create(vertices, heads);
+    const double frameTime = 1.0 / 144.0;
+    const int framesPerSecond = 144;
+    printf("%u heads, steps of 1/60 s, frames of 1/144 s\n", heads);
+    printf("%-8s %10s %12s %12s %10s\n", "second", "awake", "ms/step", "ms/frame", "steps");
+    for (int second = 1; second <= seconds; second++)
+    {
+        scene.world.resetStats();
+        for (int frame = 0; frame < framesPerSecond; frame++)
+        {
+            scene.world.update(frameTime);
+        }
+        const PhysicsStats &stats = scene.world.stats();
+        printf("%-8d %10u %12.3f %12.3f %10u\n", second, scene.world.activeBodies(),
+               1000.0 * stats.stepTime / glm::max(1u, stats.steps), 1000.0 * stats.stepTime / stats.updates,
+               stats.steps);
+    }
+    unsigned int awake = scene.world.activeBodies();
+    errors += awake != 0;
+    unsigned int wrongInstances, lostHeads;
+    errors += checkInstances(scene, wrongInstances, lostHeads);
+
+    // The same scene twice, smaller, with other frame times : the steps must come out the same
+    const unsigned int testHeads = glm::min(heads, 200u);
+    const unsigned long long testSteps = 120;
+    PhysicsScene regular, irregular;
+    regular.create(vertices, testHeads);
+    irregular.create(vertices, testHeads);
+    while (regular.world.stats().totalSteps < testSteps)
+    {
+        regular.world.update(0.0025);
+    }
+    srand(2);
+    while (irregular.world.stats().totalSteps < testSteps)
+    {
+        irregular.world.update((1.0 / 60.0) * rand() / RAND_MAX);
+    }
+    unsigned int differing = 0;
+    for (unsigned int i = 0; i < testHeads; i++)
+    {
+        vec3 a, b;
+        quat p, q;
+        regular.world.getBodyTransform(i, a, p);
+        irregular.world.getBodyTransform(i, b, q);
+        differing += a != b || p != q;
+    }
+    errors += differing;
+    errors += regular.world.stats().totalSteps != testSteps || irregular.world.stats().totalSteps != testSteps;
+
+    printf("%u heads awake at the end, %u lost through the ground, %u drawn away from their body\n", awake,
+           lostHeads, wrongInstances);
+    printf("%u of %u heads differ after %llu steps fed with other frame times\n", differing, testHeads, testSteps);
+    printf("Physics checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    return errors == 0 ? 0 : 1;
+}
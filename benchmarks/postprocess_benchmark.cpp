@@ -0,0 +1,245 @@
+/*
+Post-processing scaling benchmark.
+
+Writes a .obj file for the run with many small objects and one large one : a
+grid of tori of triangles with positions and UVs but no normals (256 of 2K
+triangles and one of 256K by default). Then, for 1, 2, 4... threads up to
+twice the hardware threads (AI_CONFIG_PP_NUM_THREADS), reads it without any
+step and times, best of the runs, the steps that run on several threads :
+JoinIdenticalVertices, GenSmoothNormals and CalcTangentSpace, through
+ApplyPostProcessing(). Once with the default smoothing angle, where the
+smooth normals of a mesh are computed on one thread, and once with a limit of
+80 degrees, where the large mesh is split between the threads. Reports
+milliseconds and the speedup over one thread.
+
+Checks that :
+ - the scene is the same, bit for bit, for every number of threads
+ - each torus is joined into its grid of vertices, with a unit normal and
+   tangent per vertex, the normal within 0.01 of the one of the torus
+
+Usage : postprocess_benchmark [small triangles] [large triangles] [runs]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+using namespace glm;
+
+// Include AssImp
+#include <assimp/Importer.hpp>
+#include <assimp/config.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A torus of side x side quads centered on 'offset', each quad as two triangles facing outwards
+void torusText(std::string &text, unsigned int &vertexCount, const char *name, vec3 offset, unsigned int side)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "o %s\n", name);
+    text += line;
+    for (unsigned int j = 0; j <= side; j++)
+    {
+        for (unsigned int i = 0; i <= side; i++)
+        {
+            float u = float(i) / side, v = float(j) / side;
+            float theta = 6.2831853f * u, phi = 6.2831853f * v;
+            vec3 center = vec3(cosf(theta), 0.0f, sinf(theta));
+            vec3 position = offset + center + 0.4f * (cosf(phi) * center + vec3(0.0f, sinf(phi), 0.0f));
+            snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\n", position.x, position.y, position.z, u, v);
+            text += line;
+        }
+    }
+    unsigned int first = vertexCount + 1;
+    for (unsigned int j = 0; j < side; j++)
+    {
+        for (unsigned int i = 0; i < side; i++)
+        {
+            unsigned int a = first + j * (side + 1) + i, b = a + 1, c = b + side + 1, d = a + side + 1;
+            snprintf(line, sizeof(line), "f %u/%u %u/%u %u/%u\nf %u/%u %u/%u %u/%u\n", a, a, c, c, b, b, a, a, d, d, c,
+                     c);
+            text += line;
+        }
+    }
+    vertexCount += (side + 1) * (side + 1);
+}
+
+bool writeFile(const char *path, const std::string &text)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && written;
+}
+
+// FNV-1a of every array of every mesh
+unsigned long long hashBytes(unsigned long long hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+unsigned long long hashScene(const aiScene *scene)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh *mesh = scene->mMeshes[m];
+        size_t bytes = mesh->mNumVertices * sizeof(aiVector3D);
+        hash = hashBytes(hash, &mesh->mNumVertices, sizeof(mesh->mNumVertices));
+        const aiVector3D *arrays[5] = {mesh->mVertices, mesh->mNormals, mesh->mTangents, mesh->mBitangents,
+                                       mesh->mTextureCoords[0]};
+        for (int a = 0; a < 5; a++)
+        {
+            hash = arrays[a] != NULL ? hashBytes(hash, arrays[a], bytes) : hashBytes(hash, "-", 1);
+        }
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+            const aiFace &face = mesh->mFaces[f];
+            hash = hashBytes(hash, face.mIndices, face.mNumIndices * sizeof(unsigned int));
+        }
+    }
+    return hash;
+}
+
+bool unit(const aiVector3D &v)
+{
+    return fabsf(v.Length() - 1.0f) < 1e-3f;
+}
+
+// Each torus as its grid of vertices : the seams keep two vertices per position, one per UV
+int checkScene(const aiScene *scene, const std::vector<unsigned int> &sides, const std::vector<vec3> &offsets)
+{
+    if (scene == NULL || scene->mNumMeshes != sides.size())
+    {
+        return 1;
+    }
+    int errors = 0;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh *mesh = scene->mMeshes[m];
+        unsigned int side = sides[m];
+        if (mesh->mNumVertices != (side + 1) * (side + 1) || mesh->mNumFaces != 2 * side * side ||
+            !mesh->HasNormals() || !mesh->HasTangentsAndBitangents())
+        {
+            errors++;
+            continue;
+        }
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            const aiVector3D &p = mesh->mVertices[i], &n = mesh->mNormals[i];
+            vec3 local = vec3(p.x, p.y, p.z) - offsets[m];
+            vec3 normal = normalize(local - normalize(vec3(local.x, 0.0f, local.z)));
+            errors += !unit(n) || !unit(mesh->mTangents[i]) || distance(vec3(n.x, n.y, n.z), normal) > 0.01f;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int smallTriangles = argc > 1 ? atoi(argv[1]) : 2048;
+    unsigned int largeTriangles = argc > 2 ? atoi(argv[2]) : 262144;
+    int runs = argc > 3 ? atoi(argv[3]) : 3;
+    const char *path = "postprocess_benchmark.obj";
+    const unsigned int smallCount = 256;
+
+    // The small tori on a grid, the large one apart
+    std::string text = "# postprocess_benchmark\n";
+    std::vector<unsigned int> sides;
+    std::vector<vec3> offsets;
+    unsigned int vertexCount = 0;
+    unsigned int smallSide = glm::max(2u, (unsigned int)(sqrtf(smallTriangles / 2.0f) + 0.5f));
+    unsigned int largeSide = glm::max(2u, (unsigned int)(sqrtf(largeTriangles / 2.0f) + 0.5f));
+    char name[32];
+    for (unsigned int o = 0; o <= smallCount; o++)
+    {
+        sides.push_back(o < smallCount ? smallSide : largeSide);
+        offsets.push_back(o < smallCount ? vec3(3.0f * (o % 16), 0.0f, 3.0f * (o / 16)) : vec3(-10.0f, 0.0f, 0.0f));
+        snprintf(name, sizeof(name), "Torus%u", o);
+        torusText(text, vertexCount, name, offsets.back(), sides.back());
+    }
+    if (!writeFile(path, text))
+    {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return 1;
+    }
+
+    unsigned int hardwareThreads = glm::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int t = 1; t <= 2 * hardwareThreads; t *= 2)
+    {
+        threadCounts.push_back(t);
+    }
+    const unsigned int steps =
+        aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace;
+    const float angles[2] = {175.0f, 80.0f};
+    int errors = 0, sceneErrors = 0, differing = 0;
+
+    printf("%u tori of %u triangles and 1 of %u, %u hardware threads, best of %d runs\n", smallCount,
+           2 * smallSide * smallSide, 2 * largeSide * largeSide, hardwareThreads, runs);
+    printf("%-10s %-10s %10s %10s\n", "angle", "threads", "ms", "speedup");
+    for (int a = 0; a < 2; a++)
+    {
+        double single = 0.0;
+        unsigned long long reference = 0;
+        for (size_t t = 0; t < threadCounts.size(); t++)
+        {
+            Assimp::Importer importer;
+            importer.SetPropertyInteger(AI_CONFIG_PP_NUM_THREADS, threadCounts[t]);
+            importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, angles[a]);
+            double best = 1e30;
+            const aiScene *scene = NULL;
+            for (int run = 0; run < runs; run++)
+            {
+                errors += importer.ReadFile(path, 0) == NULL;
+                double start = now();
+                scene = importer.ApplyPostProcessing(steps);
+                best = glm::min(best, now() - start);
+            }
+            if (scene == NULL)
+            {
+                errors++;
+                continue;
+            }
+            unsigned long long hash = hashScene(scene);
+            if (t == 0)
+            {
+                single = best;
+                reference = hash;
+                sceneErrors += checkScene(scene, sides, offsets);
+            }
+            differing += hash != reference;
+            printf("%-10.0f %-10u %10.1f %10.2f\n", angles[a], threadCounts[t], 1000.0 * best, single / best);
+        }
+    }
+    errors += sceneErrors + differing;
+
+    remove(path);
+
+    printf("%d scenes differ from the one of a single thread, %d vertices or meshes differ from the tori\n", differing,
+           sceneErrors);
+    printf("Post-processing checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+/*
+Profiler benchmark.
+
+Measures what common/profiler.cpp costs :
+ - a CPU scope, with the profiler off (the scopes left in the code) and on
+ - a GPU scope, two timestamp queries and the CPU scope around them
+ - a job, recorded from the instrumentation hooks of the job system
+
+and checks that :
+ - every scope is recorded once, inside its parent, at the right depth
+ - every job run by the job system is recorded, on the thread that ran it
+ - the GPU scopes come back after GpuFrameLatency frames, inside their
+   parent too, and on the same clock as the CPU scopes
+ - the Chrome trace has one event per recorded scope
+
+Usage : profiler_benchmark [scopes] [trace.json]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+#include <common/clock.hpp>
+#include <common/jobsystem.hpp>
+#include <common/profiler.hpp>
+
+bool startsBefore(const ProfileEvent *a, const ProfileEvent *b)
+{
+    return a->start < b->start || (a->start == b->start && a->depth < b->depth);
+}
+
+// Every event must be inside the last event of lower depth on its track that started before it
+int checkNesting(const std::vector<ProfileEvent> &events, const std::vector<unsigned int> &tracks, unsigned int track)
+{
+    int errors = 0;
+    std::vector<const ProfileEvent *> sorted;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        if (tracks[i] == track)
+        {
+            sorted.push_back(&events[i]);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), startsBefore);
+    std::vector<const ProfileEvent *> open(Profiler::MaxDepth, (const ProfileEvent *)NULL);
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        const ProfileEvent *event = sorted[i];
+        errors += event->end < event->start;
+        if (event->depth > 0)
+        {
+            const ProfileEvent *parent = open[event->depth - 1];
+            errors += parent == NULL || event->start < parent->start || event->end > parent->end;
+        }
+        open[event->depth] = event;
+    }
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int scopes = argc > 1 ? atoi(argv[1]) : 1000000;
+    const char *tracePath = argc > 2 ? argv[2] : "profiler_benchmark.json";
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(64, 64, "Profiler benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open GLFW window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    int errors = 0;
+    std::vector<ProfileEvent> events;
+    std::vector<unsigned int> tracks;
+
+    // The profiler is off : what the scopes cost when they stay in the code
+    Profiler profiler;
+    double start = clockTime();
+    for (unsigned int i = 0; i < scopes; i++)
+    {
+        ProfileScope scope(profiler, "off");
+    }
+    double offTime = clockTime() - start;
+
+    // CPU scopes, three deep, fewer than a ring holds
+    profiler.create();
+    const unsigned int frames = Profiler::EventsPerThread / 4;
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        ProfileScope frameScope(profiler, "frame");
+        {
+            ProfileScope a(profiler, "a");
+            ProfileScope b(profiler, "b");
+        }
+        ProfileScope c(profiler, "c");
+    }
+    profiler.collectEvents(events, tracks);
+    errors += events.size() != 4 * frames;
+    errors += checkNesting(events, tracks, 0);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        unsigned int depth = strcmp(events[i].name, "frame") == 0 ? 0 : strcmp(events[i].name, "b") == 0 ? 2 : 1;
+        errors += events[i].depth != depth;
+    }
+
+    start = clockTime();
+    for (unsigned int i = 0; i < scopes; i++)
+    {
+        ProfileScope scope(profiler, "on");
+    }
+    double onTime = clockTime() - start;
+
+    // Jobs, through the hooks, on a few threads even with one core
+    JobSystem jobs;
+    jobs.create(JobSystem::defaultWorkerCount() > 3 ? JobSystem::defaultWorkerCount() : 3);
+    JobHooks hooks = {Profiler::jobStarted, Profiler::jobFinished, &profiler};
+    jobs.setHooks(hooks);
+    jobs.resetStats();
+    events.clear();
+    tracks.clear();
+    profiler.destroy();
+    profiler.create();
+    unsigned int jobCount = 20000;
+    start = clockTime();
+    Job *root = jobs.createJob([]() {});
+    root->name = "root";
+    for (unsigned int i = 0; i < jobCount; i++)
+    {
+        Job *job = jobs.createJob([]() {}, root);
+        job->name = "empty";
+        jobs.run(job);
+    }
+    jobs.run(root);
+    jobs.wait(root);
+    double jobTime = clockTime() - start;
+    profiler.collectEvents(events, tracks);
+    errors += events.size() != jobs.stats().executed;
+    for (unsigned int t = 0; t < profiler.threadCount(); t++)
+    {
+        errors += checkNesting(events, tracks, t);
+    }
+    jobs.setHooks(JobHooks());
+    start = clockTime();
+    root = jobs.createJob([]() {});
+    for (unsigned int i = 0; i < jobCount; i++)
+    {
+        jobs.run(jobs.createJob([]() {}, root));
+    }
+    jobs.run(root);
+    jobs.wait(root);
+    double plainJobTime = clockTime() - start;
+    jobs.destroy();
+
+    // GPU scopes : a frame of clears, with the first half in a scope of its own
+    events.clear();
+    tracks.clear();
+    profiler.destroy();
+    profiler.create();
+    const unsigned int gpuFrames = 100;
+    const unsigned int clearsPerFrame = 8;
+    double gpuStart = clockTime();
+    for (unsigned int frame = 0; frame < gpuFrames; frame++)
+    {
+        profiler.beginFrame();
+        ProfileScope frameScope(profiler, "gpu frame", true);
+        for (unsigned int i = 0; i < clearsPerFrame; i++)
+        {
+            if (i == 0)
+            {
+                profiler.beginGpu("first half");
+            }
+            glClear(GL_COLOR_BUFFER_BIT);
+            if (i == clearsPerFrame / 2 - 1)
+            {
+                profiler.endGpu();
+            }
+        }
+        glFlush();
+    }
+    double gpuEnd = clockTime();
+    double gpuTime = gpuEnd - gpuStart;
+    profiler.collectEvents(events, tracks);
+    unsigned int gpuTrack = profiler.threadCount();
+    unsigned int gpuEvents = 0;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        if (tracks[i] == gpuTrack)
+        {
+            gpuEvents++;
+            // The two clocks agree, within a millisecond
+            errors += events[i].start < gpuStart - 0.001 || events[i].end > gpuEnd + 0.001;
+        }
+    }
+    errors += gpuEvents != 2 * (gpuFrames - profiler.droppedGpuFrames());
+    errors += checkNesting(events, tracks, gpuTrack);
+
+    printf("%-34s %10.1f ns\n", "CPU scope, profiler off", 1e9 * offTime / scopes);
+    printf("%-34s %10.1f ns\n", "CPU scope, profiler on", 1e9 * onTime / scopes);
+    printf("%-34s %10.1f ns (%.1f ns without hooks)\n", "job, with hooks", 1e9 * jobTime / jobCount,
+           1e9 * plainJobTime / jobCount);
+    printf("%-34s %10.1f us, %u of %u frames dropped\n", "GPU frame, 2 GPU scopes", 1e6 * gpuTime / gpuFrames,
+           profiler.droppedGpuFrames(), gpuFrames);
+
+    // What the tutorials print at exit, and the trace
+    profiler.writeStatistics(stdout);
+    if (!profiler.writeChromeTrace(tracePath))
+    {
+        fprintf(stderr, "Failed to write %s\n", tracePath);
+        errors++;
+    }
+    else
+    {
+        FILE *trace = fopen(tracePath, "r");
+        unsigned int traceEvents = 0;
+        char line[1024];
+        while (fgets(line, sizeof(line), trace) != NULL)
+        {
+            traceEvents += strstr(line, "\"ph\":\"X\"") != NULL;
+        }
+        fclose(trace);
+        errors += traceEvents != events.size();
+        printf("%u events written to %s\n", traceEvents, tracePath);
+    }
+    profiler.destroy();
+
+    printf("Profiler checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    glfwTerminate();
+
+    return errors == 0 ? 0 : 1;
+}
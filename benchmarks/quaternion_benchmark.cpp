@@ -0,0 +1,241 @@
+/*
+Quaternion batch benchmark.
+
+Orients a crowd of agents (100k by default) with RotationBetweenVectors,
+LookAt and RotateTowards :
+ - one agent at a time, with the functions of common/quaternion_utils.cpp
+ - with the batch versions of common/quaternionbatch.cpp, scalar, then SIMD
+   (SSE, or AVX when compiled with USE_AVX) on this thread, then on every
+   thread of the job system
+
+Some agents are degenerate cases on purpose : opposite vectors, directions
+too short to look at, already facing their target, facing away from it, or
+close enough to get there in one step.
+
+Checks that :
+ - QuaternionUtilsTests(), the tests of quaternion_utils.cpp, pass
+ - the polynomials for acos and sin stay within their documented error
+ - the SIMD kernels give exactly the quaternions of the scalar batch ones,
+   with any number of threads
+ - the batch functions give the quaternions of quaternion_utils.cpp within
+   1e-6 per component, q and -q being the same rotation
+
+Usage : quaternion_benchmark [agents] [runs]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+using namespace glm;
+
+#include <common/clock.hpp>
+#include <common/jobsystem.hpp>
+#include <common/quaternion_utils.hpp>
+#include <common/quaternionbatch.hpp>
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+glm::vec3 randomVector()
+{
+    return glm::vec3(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+}
+
+glm::quat randomRotation()
+{
+    return glm::angleAxis(randomFloat(0.0f, 6.2831853f), glm::normalize(randomVector() + glm::vec3(0.001f)));
+}
+
+// The largest difference of a component, q and -q being the same rotation
+float rotationDifference(const glm::quat &a, const glm::quat &b)
+{
+    float same = glm::max(glm::max(fabsf(a.x - b.x), fabsf(a.y - b.y)), glm::max(fabsf(a.z - b.z), fabsf(a.w - b.w)));
+    float opposite =
+        glm::max(glm::max(fabsf(a.x + b.x), fabsf(a.y + b.y)), glm::max(fabsf(a.z + b.z), fabsf(a.w + b.w)));
+    return glm::min(same, opposite);
+}
+
+bool sameQuaternions(const Quaternions &a, const Quaternions &b)
+{
+    unsigned int bytes = a.size() * sizeof(float);
+    return memcmp(&a.x[0], &b.x[0], bytes) == 0 && memcmp(&a.y[0], &b.y[0], bytes) == 0 &&
+           memcmp(&a.z[0], &b.z[0], bytes) == 0 && memcmp(&a.w[0], &b.w[0], bytes) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int count = argc > 1 ? atoi(argv[1]) : 100000;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    int errors = QuaternionUtilsTests();
+
+    // The polynomials, against the double precision functions, all over their ranges
+    double acosError = 0.0, sinError = 0.0;
+    for (int i = 0; i <= 1000000; i++)
+    {
+        float x = -1.0f + 2.0f * i / 1000000.0f;
+        acosError = glm::max(acosError, fabs(acosApproximation(x) - acos((double)x)));
+        float angle = x * 1.57079632f;
+        sinError = glm::max(sinError, fabs(sinApproximation(angle) - sin((double)angle)));
+    }
+    errors += acosError > 5e-7 || sinError > 3e-7;
+
+    // Where each agent is, where it looks, and where it should look
+    srand(1234);
+    const glm::vec3 up(0.0f, 1.0f, 0.0f);
+    const float maxAngle = glm::radians(5.0f);
+    Vectors start, dest, directions;
+    Quaternions from, to;
+    start.resize(count);
+    dest.resize(count);
+    directions.resize(count);
+    from.resize(count);
+    to.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm::vec3 a = randomVector(), b = randomVector();
+        glm::quat q1 = randomRotation(), q2 = randomRotation();
+        switch (i % 16)
+        {
+        case 0:
+            b = -a * 2.0f; // opposite
+            break;
+        case 1:
+            a = glm::vec3(0.0f, 0.0f, 1.0f); // opposite, along the axis guessed first
+            b = glm::vec3(0.0f, 0.0f, -3.0f);
+            break;
+        case 2:
+            a *= 0.001f; // too short to look at
+            break;
+        case 3:
+            q2 = q1; // already there
+            break;
+        case 4:
+            q2 = q1 * -1.0f; // already there, the long way around
+            break;
+        case 5:
+            q2 = q1 * glm::angleAxis(glm::radians(4.0f), glm::vec3(0.0f, 1.0f, 0.0f)); // there in one step
+            break;
+        case 6:
+            q2 = q1 * glm::angleAxis(glm::radians(20.0f), glm::vec3(1.0f, 0.0f, 0.0f)); // a few steps away
+            break;
+        }
+        start.set(i, a);
+        dest.set(i, b);
+        directions.set(i, a);
+        from.set(i, q1);
+        to.set(i, q2);
+    }
+
+    JobSystem jobs;
+    jobs.create(JobSystem::defaultWorkerCount());
+    const unsigned int grain = 8192;
+
+    const char *functions[] = {"RotationBetweenVectors", "LookAt", "RotateTowards"};
+    const char *passes[] = {"one at a time", "batch, scalar", "batch, SIMD", "batch, SIMD, all threads"};
+    double best[3][4];
+    float largestDifference[3] = {0.0f, 0.0f, 0.0f};
+    Quaternions reference, batchScalar, batch;
+    reference.resize(count);
+    batchScalar.resize(count);
+    batch.resize(count);
+    for (int f = 0; f < 3; f++)
+    {
+        for (int p = 0; p < 4; p++)
+        {
+            best[f][p] = 1e30;
+        }
+    }
+
+    for (int run = 0; run < runs; run++)
+    {
+        for (int f = 0; f < 3; f++)
+        {
+            double durations[4];
+            double startTime = clockTime();
+            for (unsigned int i = 0; i < count; i++)
+            {
+                glm::quat q = f == 0   ? RotationBetweenVectors(start.get(i), dest.get(i))
+                              : f == 1 ? LookAt(directions.get(i), up)
+                                       : RotateTowards(from.get(i), to.get(i), maxAngle);
+                reference.set(i, q);
+            }
+            durations[0] = clockTime() - startTime;
+
+            for (int p = 1; p < 4; p++)
+            {
+                Quaternions &out = p == 1 ? batchScalar : batch;
+                out.resize(0);
+                out.resize(count);
+                startTime = clockTime();
+                jobs.parallelFor(0, count, p == 3 ? grain : count, [&](unsigned int first, unsigned int last) {
+                    if (f == 0)
+                    {
+                        p == 1 ? batchRotationBetweenVectorsScalar(start, dest, first, last, out)
+                               : batchRotationBetweenVectors(start, dest, first, last, out);
+                    }
+                    else if (f == 1)
+                    {
+                        p == 1 ? batchLookAtScalar(directions, up, first, last, out)
+                               : batchLookAt(directions, up, first, last, out);
+                    }
+                    else
+                    {
+                        p == 1 ? batchRotateTowardsScalar(from, to, maxAngle, first, last, out)
+                               : batchRotateTowards(from, to, maxAngle, first, last, out);
+                    }
+                });
+                durations[p] = clockTime() - startTime;
+                if (p > 1)
+                {
+                    errors += !sameQuaternions(batch, batchScalar);
+                }
+            }
+
+            for (unsigned int i = 0; i < count; i++)
+            {
+                largestDifference[f] =
+                    glm::max(largestDifference[f], rotationDifference(batchScalar.get(i), reference.get(i)));
+            }
+            for (int p = 0; p < 4; p++)
+            {
+                best[f][p] = glm::min(best[f][p], durations[p]);
+            }
+        }
+    }
+
+    // In place, as a crowd would turn each frame
+    Quaternions turned = from;
+    batchRotateTowards(turned, to, maxAngle, 0, count, turned);
+    batchRotateTowards(from, to, maxAngle, 0, count, batch);
+    errors += !sameQuaternions(turned, batch);
+
+    printf("%u agents, best of %d runs, SIMD kernels : %s, %u worker threads\n", count, runs,
+           quaternionBatchInstructionSet(), jobs.workerCount());
+    printf("%-24s %-26s %10s %12s %9s\n", "function", "pass", "ms", "ns/agent", "speedup");
+    for (int f = 0; f < 3; f++)
+    {
+        for (int p = 0; p < 4; p++)
+        {
+            printf("%-24s %-26s %10.3f %12.2f %8.2fx\n", p == 0 ? functions[f] : "", passes[p],
+                   1000.0 * best[f][p], 1e9 * best[f][p] / count, best[f][0] / best[f][p]);
+        }
+        printf("%-24s largest difference with quaternion_utils.cpp : %g\n", "", largestDifference[f]);
+        errors += largestDifference[f] > 1e-6f;
+    }
+    printf("Largest error of the polynomials : acos %g, sin %g\n", acosError, sinError);
+    printf("Quaternion checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    jobs.destroy();
+
+    return errors == 0 ? 0 : 1;
+}
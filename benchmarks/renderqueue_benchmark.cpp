@@ -0,0 +1,259 @@
+/*
+Render queue benchmark.
+
+Fills a RenderQueue with 1k, 10k and 100k packets that use random programs,
+textures and meshes at random places in front of the camera, and submits them
+ - in insertion order, as a hard-coded draw loop would
+ - after sorting the keys
+and reports, per frame, the number of state switches, the time spent sorting
+the keys (the radix sort, and std::sort on the same keys for reference) and
+the time spent submitting.
+
+The meshes are tiny and the viewport is 1x1 pixel, so that the GPU side (or
+llvmpipe's rasterizer) stays negligible.
+
+Usage : renderqueue_benchmark [frames]
+Run it from tutorial09_vbo_indexing/ so that it finds StandardShading.*
+*/
+
+// Include standard headers
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+#include <common/glstate.hpp>
+#include <common/mesh.hpp>
+#include <common/renderqueue.hpp>
+#include <common/shader.hpp>
+
+static const int NumPrograms = 4;
+static const int NumTextures = 16;
+static const int NumMeshes = 8;
+
+struct TestPacket
+{
+    unsigned int program;
+    unsigned int texture;
+    unsigned int mesh;
+    glm::mat4 model;
+};
+
+// A flat polygon with 'sides' vertices around the origin, as a triangle fan
+void buildPolygon(int sides, std::vector<glm::vec3> &vertices, std::vector<glm::vec2> &uvs,
+                  std::vector<glm::vec3> &normals, std::vector<unsigned short> &indices)
+{
+    for (int i = 0; i < sides; i++)
+    {
+        float angle = 6.2831853f * i / sides;
+        vertices.push_back(glm::vec3(cos(angle), sin(angle), 0.0f));
+        uvs.push_back(glm::vec2(0.5f + 0.5f * cos(angle), 0.5f + 0.5f * sin(angle)));
+        normals.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+    for (int i = 1; i + 1 < sides; i++)
+    {
+        indices.push_back(0);
+        indices.push_back(i);
+        indices.push_back(i + 1);
+    }
+}
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 20;
+    int warmupFrames = 3;
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy; should not be needed
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(64, 64, "Render queue benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open GLFW window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    glViewport(0, 0, 1, 1);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    RenderQueue queue;
+
+    // The same shaders several times : different programs as far as GL is concerned
+    GLuint programs[NumPrograms];
+    for (int i = 0; i < NumPrograms; i++)
+    {
+        programs[i] = LoadShaders("StandardShading.vertexshader", "StandardShading.fragmentshader");
+        queue.addProgram(programs[i]);
+    }
+
+    GLuint textures[NumTextures];
+    glGenTextures(NumTextures, textures);
+    for (int i = 0; i < NumTextures; i++)
+    {
+        unsigned char pixel[3] = {(unsigned char)(16 * i), 128, 0};
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, pixel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        queue.addTexture(textures[i]);
+    }
+
+    Mesh meshes[NumMeshes];
+    for (int i = 0; i < NumMeshes; i++)
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec2> uvs;
+        std::vector<glm::vec3> normals;
+        std::vector<unsigned short> indices;
+        buildPolygon(3 + i, vertices, uvs, normals, indices);
+        meshes[i].create(vertices, uvs, normals, indices);
+        queue.addMesh(meshes[i]);
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0, 0, 10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+
+    printf("%d frames per size, times in ms/frame\n", frames);
+    printf("%8s %-9s %10s %10s %10s %10s %10s\n", "packets", "order", "switches", "GL calls", "radix", "std::sort",
+           "submit");
+
+    const int sizes[3] = {1000, 10000, 100000};
+    for (int s = 0; s < 3; s++)
+    {
+        int count = sizes[s];
+
+        srand(1234);
+        std::vector<TestPacket> testPackets(count);
+        for (int i = 0; i < count; i++)
+        {
+            testPackets[i].program = rand() % NumPrograms;
+            testPackets[i].texture = rand() % NumTextures;
+            testPackets[i].mesh = rand() % NumMeshes;
+            glm::vec3 position(randomFloat(-4.0f, 4.0f), randomFloat(-3.0f, 3.0f), randomFloat(-50.0f, 5.0f));
+            testPackets[i].model = glm::translate(glm::mat4(1.0f), position);
+        }
+
+        for (int sorted = 0; sorted < 2; sorted++)
+        {
+            GLStateCache state;
+            double radixTime = 0.0;
+            double stdSortTime = 0.0;
+            double submitTime = 0.0;
+            unsigned int glCalls = 0;
+
+            for (int frame = 0; frame < warmupFrames + frames; frame++)
+            {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                state.beginFrame();
+
+                queue.begin(view, projection);
+                for (int i = 0; i < count; i++)
+                {
+                    const TestPacket &p = testPackets[i];
+                    queue.add(RenderQueue::Opaque, p.program, p.texture, p.mesh, p.model);
+                }
+
+                double start = glfwGetTime();
+                if (sorted)
+                {
+                    queue.sort();
+                }
+                double sortEnd = glfwGetTime();
+
+                queue.submit(state);
+                double submitEnd = glfwGetTime();
+
+                // Don't let the queued work of this frame spill into the next one
+                glFinish();
+
+                // The same keys through std::sort, for reference
+                double stdSortStart = 0.0, stdSortEnd = 0.0;
+                if (sorted)
+                {
+                    std::vector<GLuint64> keys(count);
+                    glm::mat4 viewProjection = projection * view;
+                    for (int i = 0; i < count; i++)
+                    {
+                        const TestPacket &p = testPackets[i];
+                        glm::vec4 clip = viewProjection * p.model[3];
+                        float depth = clip.w > 0.0f ? glm::clamp(0.5f * clip.z / clip.w + 0.5f, 0.0f, 1.0f) : 0.0f;
+                        keys[i] = RenderQueue::makeKey(RenderQueue::Opaque, p.program, p.texture, p.mesh, depth);
+                    }
+                    stdSortStart = glfwGetTime();
+                    std::sort(keys.begin(), keys.end());
+                    stdSortEnd = glfwGetTime();
+                }
+
+                if (frame >= warmupFrames)
+                {
+                    radixTime += sortEnd - start;
+                    stdSortTime += stdSortEnd - stdSortStart;
+                    submitTime += submitEnd - sortEnd;
+                    glCalls += state.frameCounters().issued;
+                }
+            }
+
+            printf("%8d %-9s %10u %10u %10.3f %10.3f %10.3f\n", count, sorted ? "sorted" : "insertion",
+                   queue.stats().stateSwitches(), glCalls / frames, sorted ? 1000.0 * radixTime / frames : 0.0,
+                   sorted ? 1000.0 * stdSortTime / frames : 0.0, 1000.0 * submitTime / frames);
+        }
+    }
+    printf("With %d programs, %d textures and %d meshes, the fewest possible switches is at most %d\n", NumPrograms,
+           NumTextures, NumMeshes, NumPrograms * (1 + NumTextures * (1 + NumMeshes)));
+
+    // Cleanup
+    for (int i = 0; i < NumMeshes; i++)
+    {
+        meshes[i].destroy();
+    }
+    for (int i = 0; i < NumPrograms; i++)
+    {
+        glDeleteProgram(programs[i]);
+    }
+    glDeleteTextures(NumTextures, textures);
+
+    glfwTerminate();
+
+    return 0;
+}
@@ -0,0 +1,390 @@
+/*
+Scene import benchmark.
+
+Writes a large multi-object scene as a .obj file and its .mtl for the run : a
+grid of tori of quads (1M triangles by default), 8 materials, and a line per
+object that the renderer has no use for. Then times :
+ - importScene without any post-processing step, then with Triangulate alone,
+   then with Triangulate and each other step in turn, then with all of them :
+   what each step costs is its time minus that of Triangulate alone
+ - writeSceneCache, the binary cache of the scene with all the steps
+ - loadScene from that cache, which only maps it, then the same plus reading
+   every byte of the scene, which is what uploading it would take
+and reports triangles per second and MB per second of the file read.
+
+Checks that :
+ - every object and material is imported, every quad as two triangles, and
+   only triangles : the lines and, without Triangulate, the quads are left out
+ - JoinIdenticalVertices leaves the vertices of the grids of the tori
+ - ImproveCacheLocality lowers the average cache miss ratio of the triangles
+   (the vertices transformed per triangle, with a 32 entry FIFO cache), from
+   JoinIdenticalVertices alone to all the steps : before joining, no vertex
+   is shared
+ - the cache gives back exactly what importScene returned, is used again
+   while the .obj and the steps don't change, and is imported again
+   otherwise, and a truncated cache is rejected
+
+Usage : scene_benchmark [triangles] [runs]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <common/sceneimport.hpp>
+
+const unsigned int MaterialCount = 8;
+const unsigned int FifoSize = 32;
+
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+long fileSize(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// 'objects' tori of side x side quads on a grid, each with its own vertices and a material in turn. Vertex k of an
+// object has position, UV and normal k, so that joining identical vertices leaves the (side + 1)^2 of its grid.
+bool writeScene(const char *objPath, const char *mtlPath, unsigned int objects, unsigned int side)
+{
+    FILE *mtl = fopen(mtlPath, "w");
+    if (mtl == NULL)
+    {
+        return false;
+    }
+    for (unsigned int m = 0; m < MaterialCount; m++)
+    {
+        fprintf(mtl, "newmtl Material%u\nKd %f %f %f\n", m, (m & 1) * 0.8f + 0.1f, (m >> 1 & 1) * 0.8f + 0.1f,
+                (m >> 2 & 1) * 0.8f + 0.1f);
+        if (m % 2 == 0)
+        {
+            fprintf(mtl, "map_Kd texture%u.dds\n", m);
+        }
+    }
+    fclose(mtl);
+
+    FILE *file = fopen(objPath, "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+    const char *mtlName = strrchr(mtlPath, '/') ? strrchr(mtlPath, '/') + 1 : mtlPath;
+    fprintf(file, "# scene_benchmark, %u tori of %u triangles\nmtllib %s\n", objects, 2 * side * side, mtlName);
+    unsigned int columns = (unsigned int)ceilf(sqrtf((float)objects));
+    unsigned int gridVertices = (side + 1) * (side + 1);
+    for (unsigned int o = 0; o < objects; o++)
+    {
+        glm::vec3 offset(3.0f * (o % columns), 0.0f, 3.0f * (o / columns));
+        fprintf(file, "o Torus%u\nusemtl Material%u\n", o, o % MaterialCount);
+        for (int attribute = 0; attribute < 3; attribute++)
+        {
+            for (unsigned int j = 0; j <= side; j++)
+            {
+                for (unsigned int i = 0; i <= side; i++)
+                {
+                    float u = float(i) / side, v = float(j) / side;
+                    float theta = 6.2831853f * u, phi = 6.2831853f * v;
+                    glm::vec3 center = glm::vec3(cosf(theta), 0.0f, sinf(theta));
+                    glm::vec3 normal = cosf(phi) * center + glm::vec3(0.0f, sinf(phi), 0.0f);
+                    glm::vec3 position = offset + center + 0.4f * normal;
+                    if (attribute == 0)
+                    {
+                        fprintf(file, "v %f %f %f\n", position.x, position.y, position.z);
+                    }
+                    else if (attribute == 1)
+                    {
+                        fprintf(file, "vt %f %f\n", u, v);
+                    }
+                    else
+                    {
+                        fprintf(file, "vn %f %f %f\n", normal.x, normal.y, normal.z);
+                    }
+                }
+            }
+        }
+        unsigned int first = o * gridVertices + 1;
+        for (unsigned int j = 0; j < side; j++)
+        {
+            for (unsigned int i = 0; i < side; i++)
+            {
+                unsigned int a = first + j * (side + 1) + i, b = a + 1, c = b + side + 1, d = a + side + 1;
+                fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c, d, d, d);
+            }
+        }
+        fprintf(file, "l %u %u\n", first, first + side);
+    }
+    return fclose(file) == 0;
+}
+
+unsigned int triangleCount(const SceneData &scene)
+{
+    return scene.indexCount / 3;
+}
+
+// The vertices a FIFO cache of FifoSize entries transforms per triangle, over every mesh
+float averageCacheMissRatio(const SceneData &scene)
+{
+    unsigned int misses = 0;
+    std::vector<unsigned int> stamps(scene.vertexCount, 0);
+    unsigned int clock = 0; // a vertex is in the cache while its stamp is one of the last FifoSize misses
+    for (unsigned int m = 0; m < scene.meshCount; m++)
+    {
+        const SceneMesh &mesh = scene.meshes[m];
+        clock += FifoSize + 1; // a new draw starts with an empty cache
+        for (unsigned int i = 0; i < mesh.indexCount; i++)
+        {
+            unsigned int &stamp = stamps[mesh.baseVertex + scene.indices[mesh.firstIndex + i]];
+            if (stamp == 0 || clock - stamp >= FifoSize)
+            {
+                stamp = ++clock;
+                misses++;
+            }
+        }
+    }
+    return triangleCount(scene) ? float(misses) / triangleCount(scene) : 0.0f;
+}
+
+// The errors in a scene imported from writeScene()
+int checkScene(const SceneData &scene, unsigned int objects, unsigned int side, unsigned int steps)
+{
+    int errors = 0;
+    unsigned int expected = steps & SceneTriangulate ? objects * 2 * side * side : 0;
+    errors += triangleCount(scene) != expected;
+    if (expected && steps & SceneJoinIdenticalVertices)
+    {
+        errors += scene.vertexCount != objects * (side + 1) * (side + 1);
+    }
+    unsigned int meshes = expected == 0 ? 0 : steps & SceneOptimizeMeshes ? MaterialCount : objects;
+    errors += steps & SceneOptimizeMeshes ? scene.meshCount < meshes || scene.meshCount > objects
+                                          : scene.meshCount != meshes;
+    for (unsigned int m = 0; m < scene.meshCount; m++)
+    {
+        const SceneMesh &mesh = scene.meshes[m];
+        for (unsigned int i = 0; i < mesh.indexCount; i++)
+        {
+            errors += scene.indices[mesh.firstIndex + i] >= mesh.vertexCount;
+        }
+    }
+
+    // Every material of the .mtl, once, and the textures of the even ones
+    unsigned int found = 0;
+    for (unsigned int m = 0; m < scene.materialCount; m++)
+    {
+        unsigned int index;
+        char texture[32];
+        if (sscanf(scene.strings + scene.materials[m].name, "Material%u", &index) == 1 && index < MaterialCount)
+        {
+            found |= 1 << index;
+            sprintf(texture, index % 2 == 0 ? "texture%u.dds" : "", index);
+            errors += strcmp(scene.strings + scene.materials[m].diffuseTexture, texture) != 0;
+        }
+    }
+    errors += found != (1u << MaterialCount) - 1;
+    errors += scene.instanceCount < scene.meshCount;
+    return errors;
+}
+
+bool sameScene(const SceneData &a, const SceneData &b)
+{
+    return a.vertexCount == b.vertexCount && a.indexCount == b.indexCount && a.meshCount == b.meshCount &&
+           a.materialCount == b.materialCount && a.instanceCount == b.instanceCount &&
+           a.stringsSize == b.stringsSize &&
+           memcmp(a.positions, b.positions, a.vertexCount * sizeof(glm::vec3)) == 0 &&
+           memcmp(a.uvs, b.uvs, a.vertexCount * sizeof(glm::vec2)) == 0 &&
+           memcmp(a.normals, b.normals, a.vertexCount * sizeof(glm::vec3)) == 0 &&
+           memcmp(a.indices, b.indices, a.indexCount * sizeof(unsigned int)) == 0 &&
+           memcmp(a.meshes, b.meshes, a.meshCount * sizeof(SceneMesh)) == 0 &&
+           memcmp(a.materials, b.materials, a.materialCount * sizeof(SceneMaterial)) == 0 &&
+           memcmp(a.instances, b.instances, a.instanceCount * sizeof(SceneInstance)) == 0 &&
+           memcmp(a.strings, b.strings, a.stringsSize) == 0;
+}
+
+// Reads every byte of the arrays, as an upload would
+unsigned int touchScene(const SceneData &scene)
+{
+    const void *arrays[] = {scene.positions, scene.uvs, scene.normals, scene.indices};
+    size_t sizes[] = {scene.vertexCount * sizeof(glm::vec3), scene.vertexCount * sizeof(glm::vec2),
+                      scene.vertexCount * sizeof(glm::vec3), scene.indexCount * sizeof(unsigned int)};
+    unsigned int sum = 0;
+    for (int a = 0; a < 4; a++)
+    {
+        const unsigned int *words = (const unsigned int *)arrays[a];
+        for (size_t i = 0; i < sizes[a] / 4; i++)
+        {
+            sum += words[i];
+        }
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int targetTriangles = argc > 1 ? atoi(argv[1]) : 1000000;
+    int runs = argc > 2 ? atoi(argv[2]) : 3;
+    const char *objPath = "scene_benchmark.obj";
+    const char *mtlPath = "scene_benchmark.mtl";
+    const char *cachePath = "scene_benchmark.scenecache";
+
+    // About 4K triangles per object, at least 16 objects
+    unsigned int objects = glm::max(16u, targetTriangles / 4096);
+    unsigned int side = glm::max(2u, (unsigned int)(sqrtf(targetTriangles / 2.0f / objects) + 0.5f));
+    unsigned int triangles = objects * 2 * side * side;
+    if (!writeScene(objPath, mtlPath, objects, side))
+    {
+        fprintf(stderr, "Cannot write %s\n", objPath);
+        return 1;
+    }
+    double megabytes = fileSize(objPath) / 1048576.0;
+    int errors = 0;
+
+    struct Pass
+    {
+        const char *name;
+        unsigned int steps;
+    };
+    const Pass passes[] = {
+        {"no steps", 0},
+        {"Triangulate", SceneTriangulate},
+        {"+ JoinIdenticalVertices", SceneTriangulate | SceneJoinIdenticalVertices},
+        {"+ SortByPType", SceneTriangulate | SceneSortByPType},
+        {"+ OptimizeMeshes", SceneTriangulate | SceneOptimizeMeshes},
+        {"+ ImproveCacheLocality", SceneTriangulate | SceneImproveCacheLocality},
+        {"all steps", SceneAllSteps},
+    };
+    const int passCount = sizeof(passes) / sizeof(passes[0]);
+
+    printf("%u objects of %u triangles, %.1f MB of .obj, best of %d runs\n", objects, 2 * side * side, megabytes,
+           runs);
+    printf("%-28s %10s %12s %10s %10s %10s %8s\n", "pass", "ms", "step ms", "Mtris/s", "MB/s", "vertices", "meshes");
+    // The runs go through every pass in turn, so that a slower moment of the machine doesn't fall on one of them
+    ImportedScene scene;
+    std::vector<double> best(passCount, 1e30);
+    std::vector<unsigned int> vertices(passCount), meshes(passCount);
+    std::vector<int> passErrors(passCount, 0);
+    float cacheMissRatio[2] = {0.0f, 0.0f};
+    for (int run = 0; run < runs; run++)
+    {
+        for (int p = 0; p < passCount; p++)
+        {
+            double start = now();
+            errors += !importScene(objPath, passes[p].steps, scene);
+            best[p] = glm::min(best[p], now() - start);
+            if (run > 0)
+            {
+                continue;
+            }
+            SceneData data = scene.data();
+            passErrors[p] = checkScene(data, objects, side, passes[p].steps);
+            errors += passErrors[p];
+            vertices[p] = data.vertexCount;
+            meshes[p] = data.meshCount;
+            if (p == 2 || p == passCount - 1)
+            {
+                cacheMissRatio[p == 2 ? 0 : 1] = averageCacheMissRatio(data);
+            }
+        }
+    }
+    for (int p = 0; p < passCount; p++)
+    {
+        char stepTime[16] = "";
+        if (p >= 2 && p < passCount - 1)
+        {
+            sprintf(stepTime, "%.1f", 1000.0 * (best[p] - best[1]));
+        }
+        printf("%-28s %10.1f %12s %10.2f %10.1f %10u %8u%s\n", passes[p].name, 1000.0 * best[p], stepTime,
+               1e-6 * triangles / best[p], megabytes / best[p], vertices[p], meshes[p], passErrors[p] ? "  FAIL" : "");
+    }
+    double importTime = best[passCount - 1];
+    errors += !(cacheMissRatio[1] < cacheMissRatio[0]);
+
+    // The cache of the last pass, all the steps
+    double start = now();
+    errors += !writeSceneCache(cachePath, scene.data(), SceneAllSteps, 0, 0);
+    double writeTime = now() - start;
+    double cacheMegabytes = fileSize(cachePath) / 1048576.0;
+    remove(cachePath);
+
+    // loadScene : imports and writes the cache, then maps it while nothing changes
+    SceneCache cache;
+    bool imported = false;
+    errors += !loadScene(objPath, cachePath, SceneAllSteps, cache, &imported) || !imported;
+    errors += !sameScene(cache.data(), scene.data());
+    double mapTime = 1e30, touchTime = 1e30;
+    unsigned int sum = 0;
+    for (int run = 0; run < glm::max(runs, 5); run++)
+    {
+        start = now();
+        errors += !loadScene(objPath, cachePath, SceneAllSteps, cache, &imported) || imported;
+        mapTime = glm::min(mapTime, now() - start);
+        sum += touchScene(cache.data());
+        touchTime = glm::min(touchTime, now() - start);
+    }
+    errors += !sameScene(cache.data(), scene.data());
+    printf("%-28s %10.1f %12s %10.2f %10.1f %10s %8s\n", "writeSceneCache", 1000.0 * writeTime, "",
+           1e-6 * triangles / writeTime, cacheMegabytes / writeTime, "", "");
+    printf("%-28s %10.3f %12s %10.2f %10.1f\n", "loadScene, cached", 1000.0 * mapTime, "", 1e-6 * triangles / mapTime,
+           cacheMegabytes / mapTime);
+    printf("%-28s %10.3f %12s %10.2f %10.1f\n", "loadScene, cached + read", 1000.0 * touchTime, "",
+           1e-6 * triangles / touchTime, cacheMegabytes / touchTime);
+
+    // Other steps, or another .obj, import again
+    errors += !loadScene(objPath, cachePath, SceneTriangulate, cache, &imported) || !imported;
+    errors += checkScene(cache.data(), objects, side, SceneTriangulate);
+    FILE *file = fopen(objPath, "a");
+    if (file != NULL)
+    {
+        fputs("# changed\n", file);
+        fclose(file);
+    }
+    errors += !loadScene(objPath, cachePath, SceneTriangulate, cache, &imported) || !imported;
+    errors += !loadScene(objPath, cachePath, SceneTriangulate, cache, &imported) || imported;
+    cache.close();
+
+    // Half a cache
+    long size = fileSize(cachePath);
+    std::vector<char> bytes(size);
+    file = fopen(cachePath, "rb");
+    errors += file == NULL || fread(&bytes[0], 1, size, file) != (size_t)size;
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    file = fopen(cachePath, "wb");
+    if (file != NULL)
+    {
+        fwrite(&bytes[0], 1, size / 2, file);
+        fclose(file);
+    }
+    errors += cache.open(cachePath);
+
+    remove(objPath);
+    remove(mtlPath);
+    remove(cachePath);
+
+    printf("Cached against imported with all steps : %.0fx faster, %.0fx with the reads (%.1f MB of cache)\n",
+           importTime / mapTime, importTime / touchTime, cacheMegabytes);
+    printf("Average cache miss ratio : %.3f, %.3f with all the steps (checksum %u)\n", cacheMissRatio[0],
+           cacheMissRatio[1], sum);
+    printf("Scene import checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+/*
+Scene graph benchmark.
+
+Builds a tree of roots, children and grandchildren (about 1M nodes by
+default) with random translations, rotations and scales, then times :
+ - rebuilding every world matrix from scratch with glm, parents first, the
+   way the tutorials rebuild their transforms every frame
+ - SceneGraph::update() after moving every node
+ - SceneGraph::update() when nothing moved
+ - SceneGraph::update() after moving 1% of the leaves
+ - SceneGraph::update() after moving one root, so its whole subtree
+
+Reports the time and the number of nodes updated per pass, and checks that :
+ - after each pass, the world matrices and bounds are exactly those of a
+   graph built from scratch with the same local transforms, and the world
+   matrices those of glm within rounding
+ - the changed nodes are exactly the ones moved and their descendants,
+   parents before children
+
+Usage : scenegraph_benchmark [children per node] [runs]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+using namespace glm;
+
+#include <common/clock.hpp>
+#include <common/scenegraph.hpp>
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+struct LocalTransform
+{
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+LocalTransform randomTransform()
+{
+    LocalTransform transform;
+    transform.position = glm::vec3(randomFloat(-10.0f, 10.0f), randomFloat(-10.0f, 10.0f), randomFloat(-10.0f, 10.0f));
+    glm::vec3 axis(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+    transform.rotation = glm::angleAxis(randomFloat(0.0f, 6.2831853f), glm::normalize(axis + glm::vec3(0.001f)));
+    transform.scale = glm::vec3(randomFloat(0.5f, 2.0f));
+    return transform;
+}
+
+// The world matrices from scratch, with a mat4 per local transform. Parents are added before their children.
+void glmWorldMatrices(const std::vector<unsigned int> &parents, const std::vector<LocalTransform> &locals,
+                      std::vector<glm::mat4> &world)
+{
+    world.resize(parents.size());
+    for (unsigned int node = 0; node < parents.size(); node++)
+    {
+        const LocalTransform &local = locals[node];
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), local.position) * glm::mat4_cast(local.rotation) *
+                          glm::scale(glm::mat4(1.0f), local.scale);
+        world[node] = parents[node] == SceneGraph::None ? model : world[parents[node]] * model;
+    }
+}
+
+// The errors between the incremental graph and one built from scratch
+int compareWithFreshGraph(const SceneGraph &graph, const std::vector<unsigned int> &parents,
+                          const std::vector<LocalTransform> &locals, const glm::vec3 &center, float radius)
+{
+    SceneGraph fresh;
+    for (unsigned int node = 0; node < parents.size(); node++)
+    {
+        fresh.addNode(parents[node], locals[node].position, locals[node].rotation, locals[node].scale);
+        fresh.setBounds(node, center, radius);
+    }
+    fresh.update();
+
+    int errors = fresh.stats().updated != parents.size();
+    for (unsigned int node = 0; node < parents.size(); node++)
+    {
+        glm::vec3 centerA, centerB;
+        float radiusA, radiusB;
+        graph.getWorldBounds(node, centerA, radiusA);
+        fresh.getWorldBounds(node, centerB, radiusB);
+        errors += memcmp(&graph.worldMatrix(node), &fresh.worldMatrix(node), sizeof(glm::mat4)) != 0;
+        errors += centerA != centerB || radiusA != radiusB;
+    }
+    return errors;
+}
+
+// The errors in the changed set : 'moved' and their descendants, each once, parents first
+int checkChangedNodes(const SceneGraph &graph, const std::vector<unsigned int> &parents,
+                      const std::vector<unsigned char> &moved)
+{
+    std::vector<unsigned char> expected(parents.size(), 0), seen(parents.size(), 0);
+    unsigned int expectedCount = 0;
+    for (unsigned int node = 0; node < parents.size(); node++)
+    {
+        expected[node] = moved[node] || (parents[node] != SceneGraph::None && expected[parents[node]]);
+        expectedCount += expected[node];
+    }
+
+    const std::vector<unsigned int> &changed = graph.changedNodes();
+    int errors = changed.size() != expectedCount || graph.stats().updated != expectedCount;
+    for (unsigned int i = 0; i < changed.size(); i++)
+    {
+        unsigned int node = changed[i];
+        errors += !expected[node] || seen[node];
+        errors += parents[node] != SceneGraph::None && expected[parents[node]] && !seen[parents[node]];
+        seen[node] = 1;
+    }
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int branching = argc > 1 ? atoi(argv[1]) : 100;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    // Roots, then the children of each, then theirs : the nodes are not added in depth order
+    srand(1234);
+    std::vector<unsigned int> parents, leaves, roots;
+    std::vector<LocalTransform> locals;
+    for (unsigned int root = 0; root < branching; root++)
+    {
+        unsigned int rootNode = parents.size();
+        roots.push_back(rootNode);
+        parents.push_back(SceneGraph::None);
+        locals.push_back(randomTransform());
+        for (unsigned int child = 0; child < branching; child++)
+        {
+            unsigned int childNode = parents.size();
+            parents.push_back(rootNode);
+            locals.push_back(randomTransform());
+            for (unsigned int grandchild = 0; grandchild < branching; grandchild++)
+            {
+                leaves.push_back(parents.size());
+                parents.push_back(childNode);
+                locals.push_back(randomTransform());
+            }
+        }
+    }
+    unsigned int count = parents.size();
+    glm::vec3 center(0.1f, 0.2f, 0.3f);
+    float radius = 1.5f;
+
+    SceneGraph graph;
+    for (unsigned int node = 0; node < count; node++)
+    {
+        graph.addNode(parents[node], locals[node].position, locals[node].rotation, locals[node].scale);
+        graph.setBounds(node, center, radius);
+    }
+    double start = clockTime();
+    graph.update();
+    double firstUpdate = clockTime() - start;
+
+    const char *names[] = {"glm, from scratch", "every node moved", "nothing moved", "1% of the leaves moved",
+                           "one root moved"};
+    const int passes = sizeof(names) / sizeof(names[0]);
+    std::vector<double> best(passes, 1e30);
+    std::vector<unsigned int> updated(passes, count);
+    std::vector<glm::mat4> glmWorld;
+    std::vector<unsigned char> moved(count);
+    int errors = checkChangedNodes(graph, parents, std::vector<unsigned char>(count, 1));
+    float glmDifference = 0.0f;
+
+    for (int run = 0; run < runs; run++)
+    {
+        double durations[passes];
+        start = clockTime();
+        glmWorldMatrices(parents, locals, glmWorld);
+        durations[0] = clockTime() - start;
+
+        for (int pass = 1; pass < passes; pass++)
+        {
+            // What moves this pass, with new local transforms
+            std::fill(moved.begin(), moved.end(), 0);
+            if (pass == 1)
+            {
+                std::fill(moved.begin(), moved.end(), 1);
+            }
+            else if (pass == 3)
+            {
+                for (unsigned int i = 0; i < leaves.size() / 100; i++)
+                {
+                    moved[leaves[rand() % leaves.size()]] = 1;
+                }
+            }
+            else if (pass == 4)
+            {
+                moved[roots[rand() % roots.size()]] = 1;
+            }
+            for (unsigned int node = 0; node < count; node++)
+            {
+                if (moved[node])
+                {
+                    locals[node] = randomTransform();
+                }
+            }
+
+            start = clockTime();
+            for (unsigned int node = 0; node < count; node++)
+            {
+                if (moved[node])
+                {
+                    graph.setLocalTransform(node, locals[node].position, locals[node].rotation, locals[node].scale);
+                }
+            }
+            graph.update();
+            durations[pass] = clockTime() - start;
+            updated[pass] = graph.stats().updated;
+            errors += checkChangedNodes(graph, parents, moved);
+        }
+
+        // Against everything from scratch, with the final local transforms
+        errors += compareWithFreshGraph(graph, parents, locals, center, radius);
+        glmWorldMatrices(parents, locals, glmWorld);
+        for (unsigned int node = 0; node < count; node++)
+        {
+            const float *a = &graph.worldMatrix(node)[0][0];
+            const float *b = &glmWorld[node][0][0];
+            float largest = 1.0f, difference = 0.0f;
+            for (int i = 0; i < 16; i++)
+            {
+                largest = glm::max(largest, fabsf(b[i]));
+                difference = glm::max(difference, fabsf(a[i] - b[i]));
+            }
+            glmDifference = glm::max(glmDifference, difference / largest);
+        }
+
+        for (int p = 0; p < passes; p++)
+        {
+            best[p] = glm::min(best[p], durations[p]);
+        }
+    }
+    errors += glmDifference > 1e-5f;
+
+    printf("%u nodes in %u levels, best of %d runs, first update (with the sort) %.3f ms\n", count,
+           graph.stats().depth, runs, 1000.0 * firstUpdate);
+    printf("%-24s %10s %14s %9s\n", "pass", "ms", "nodes updated", "speedup");
+    for (int p = 0; p < passes; p++)
+    {
+        printf("%-24s %10.3f %14u %8.2fx\n", names[p], 1000.0 * best[p], updated[p], best[0] / best[p]);
+    }
+    printf("Largest difference with glm : %g of the largest value of the matrix\n", glmDifference);
+    printf("Scene graph checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    return errors == 0 ? 0 : 1;
+}
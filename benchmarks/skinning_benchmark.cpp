@@ -0,0 +1,695 @@
+/*
+Skinning benchmark.
+
+Animates a crowd of procedural characters (1000 by default) : a tube of
+3185 vertices around a chain of 8 bones, at most 4 bones per vertex, that
+sways, bobs and bulges in a 2 second loop. Every character plays the loop
+at its own time. Times :
+ - samplePalettes, the palettes of the whole crowd, on every thread
+ - skinVertices for the whole crowd, scalar, then SIMD (SSE) on this
+   thread, then on every thread of the job system
+ - the GPU path : the bind pose and the bone weights uploaded once, the
+   palettes every frame, and StandardShadingSkinned.vertexshader blending
+   them for every character of one instanced draw, up to glFinish, in a
+   1x1 viewport so that the vertices are most of the work
+and reports the skinned vertices per second of each.
+
+Checks that :
+ - the SIMD kernel gives exactly the vertices of the scalar one, with any
+   number of threads, and those of glm within 1e-5
+ - built with AssImp (USE_ASSIMP), loadAssImp reads back the character
+   written as a DirectX .x file for the run : same bones and animation,
+   hence the same skinned vertices within 1e-4, mirrored along Z since
+   AssImp converts .x files to a right-handed space
+ - the GPU path draws the image of the vertices skinned on the CPU, for 64
+   characters, within 0.1% of the pixels
+
+Usage : skinning_benchmark [characters] [runs]
+Run it from tutorial09_vbo_indexing/ so that it finds the shaders
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+using namespace glm;
+
+#include <common/gpuskinning.hpp>
+#include <common/jobsystem.hpp>
+#include <common/mesh.hpp>
+#include <common/objloader.hpp>
+#include <common/shader.hpp>
+#include <common/skinning.hpp>
+
+const int Segments = 48;
+const int Rings = 64;
+const int Bones = 8;
+const float Height = 2.0f;
+const float Radius = 0.3f;
+const float BoneLength = Height / Bones;
+const float Duration = 2.0f;
+const int KeysPerSecond = 10;
+const int TicksPerSecond = 4800; // of the .x file
+
+struct Character
+{
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<unsigned short> indices;
+    std::vector<BoneWeights> weights;
+    Skeleton skeleton;
+    SkeletalAnimation animation;
+};
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+// Keeps the 4 largest weights, in decreasing order
+void addWeight(BoneWeights &vertex, unsigned short bone, float weight)
+{
+    int slot = 4;
+    while (slot > 0 && vertex.weights[slot - 1] < weight)
+    {
+        slot--;
+    }
+    for (int i = 3; i > slot; i--)
+    {
+        vertex.bones[i] = vertex.bones[i - 1];
+        vertex.weights[i] = vertex.weights[i - 1];
+    }
+    if (slot < 4)
+    {
+        vertex.bones[slot] = bone;
+        vertex.weights[slot] = weight;
+    }
+}
+
+void buildCharacter(Character &character)
+{
+    // A root that holds the mesh, then a chain of bones up the tube
+    Skeleton &skeleton = character.skeleton;
+    unsigned int parent = skeleton.addBone("Root", Skeleton::None, glm::mat4(1.0f));
+    for (int b = 0; b < Bones; b++)
+    {
+        char name[16];
+        sprintf(name, "Spine%d", b);
+        glm::vec3 offset(0.0f, b == 0 ? 0.0f : BoneLength, 0.0f);
+        parent = skeleton.addBone(name, parent, glm::translate(glm::mat4(1.0f), offset),
+                                  glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -b * BoneLength, 0.0f)));
+    }
+
+    // The tube, with a seam for the UVs. Each vertex follows the bones whose middle is near.
+    for (int r = 0; r <= Rings; r++)
+    {
+        for (int s = 0; s <= Segments; s++)
+        {
+            float angle = 6.2831853f * s / Segments;
+            float y = Height * r / Rings;
+            glm::vec3 normal(cosf(angle), 0.0f, sinf(angle));
+            character.positions.push_back(normal * Radius + glm::vec3(0.0f, y, 0.0f));
+            character.normals.push_back(normal);
+            character.uvs.push_back(glm::vec2((float)s / Segments, (float)r / Rings));
+
+            BoneWeights weights = {{0, 0, 0, 0}, {0.0f, 0.0f, 0.0f, 0.0f}};
+            for (int b = 0; b < Bones; b++)
+            {
+                float weight = 1.0f - fabsf(y - (b + 0.5f) * BoneLength) / (1.2f * BoneLength);
+                if (weight > 0.0f)
+                {
+                    addWeight(weights, (unsigned short)(b + 1), weight);
+                }
+            }
+            float total = weights.weights[0] + weights.weights[1] + weights.weights[2] + weights.weights[3];
+            for (int slot = 0; slot < 4; slot++)
+            {
+                weights.weights[slot] /= total;
+            }
+            character.weights.push_back(weights);
+        }
+    }
+    for (int r = 0; r < Rings; r++)
+    {
+        for (int s = 0; s < Segments; s++)
+        {
+            unsigned short a = r * (Segments + 1) + s, b = a + 1, c = a + Segments + 1, d = c + 1;
+            unsigned short triangles[6] = {a, c, b, b, c, d}; // counter-clockwise, seen from outside
+            character.indices.insert(character.indices.end(), triangles, triangles + 6);
+        }
+    }
+
+    // Every bone sways, the first one bobs and the middle one bulges : position, rotation and scale keys, with the
+    // rest of the positions coming from the bind pose
+    SkeletalAnimation &animation = character.animation;
+    animation.name = "Sway";
+    animation.duration = Duration;
+    for (int b = 0; b < Bones; b++)
+    {
+        BoneChannel channel;
+        channel.bone = b + 1;
+        for (int key = 0; key <= Duration * KeysPerSecond; key++)
+        {
+            float time = (float)key / KeysPerSecond;
+            float phase = 6.2831853f * time / Duration + 0.6f * b;
+            channel.rotationTimes.push_back(time);
+            channel.rotations.push_back(
+                glm::angleAxis(glm::radians(12.0f) * sinf(phase), glm::vec3(0.0f, 0.0f, 1.0f)) *
+                glm::angleAxis(glm::radians(6.0f) * cosf(phase), glm::vec3(1.0f, 0.0f, 0.0f)));
+            if (b == 0)
+            {
+                channel.positionTimes.push_back(time);
+                channel.positions.push_back(glm::vec3(0.0f, 0.1f * sinf(6.2831853f * time), 0.0f));
+            }
+            if (b == Bones / 2)
+            {
+                channel.scaleTimes.push_back(time);
+                channel.scales.push_back(glm::vec3(1.0f + 0.1f * sinf(6.2831853f * time)));
+            }
+        }
+        animation.channels.push_back(channel);
+    }
+}
+
+void writeMatrix(FILE *file, const glm::mat4 &m)
+{
+    // Column after column : AssImp reads each row of the file as a column. A space after each comma, or AssImp
+    // takes it for a decimal comma.
+    const float *f = &m[0][0];
+    for (int i = 0; i < 16; i++)
+    {
+        fprintf(file, "%.9g%s", f[i], i < 15 ? ", " : ";;\n");
+    }
+}
+
+void writeFrame(FILE *file, const Character &character, unsigned int bone)
+{
+    const Skeleton &skeleton = character.skeleton;
+    fprintf(file, "Frame %s {\nFrameTransformMatrix {\n", skeleton.names[bone].c_str());
+    writeMatrix(file, skeleton.localBindPose[bone]);
+    fprintf(file, "}\n");
+
+    if (bone == 0)
+    {
+        unsigned int vertices = character.positions.size(), faces = character.indices.size() / 3;
+        fprintf(file, "Mesh Tube {\n%u;\n", vertices);
+        for (unsigned int i = 0; i < vertices; i++)
+        {
+            const glm::vec3 &p = character.positions[i];
+            fprintf(file, "%.9g;%.9g;%.9g;%s\n", p.x, p.y, p.z, i + 1 < vertices ? "," : ";");
+        }
+        for (int normals = 0; normals < 2; normals++)
+        {
+            if (normals)
+            {
+                fprintf(file, "MeshNormals {\n%u;\n", vertices);
+                for (unsigned int i = 0; i < vertices; i++)
+                {
+                    const glm::vec3 &n = character.normals[i];
+                    fprintf(file, "%.9g;%.9g;%.9g;%s\n", n.x, n.y, n.z, i + 1 < vertices ? "," : ";");
+                }
+            }
+            fprintf(file, "%u;\n", faces);
+            for (unsigned int i = 0; i < faces; i++)
+            {
+                const unsigned short *f = &character.indices[3 * i];
+                fprintf(file, "3;%u,%u,%u;%s\n", f[0], f[1], f[2], i + 1 < faces ? "," : ";");
+            }
+        }
+        fprintf(file, "}\nMeshTextureCoords {\n%u;\n", vertices);
+        for (unsigned int i = 0; i < vertices; i++)
+        {
+            // AssImp flips v back
+            const glm::vec2 &uv = character.uvs[i];
+            fprintf(file, "%.9g;%.9g;%s\n", uv.x, 1.0f - uv.y, i + 1 < vertices ? "," : ";");
+        }
+        fprintf(file, "}\nXSkinMeshHeader {\n4;\n12;\n%d;\n}\n", Bones);
+        for (int b = 1; b <= Bones; b++)
+        {
+            std::vector<unsigned int> moved;
+            std::vector<float> weights;
+            for (unsigned int i = 0; i < vertices; i++)
+            {
+                for (int slot = 0; slot < 4; slot++)
+                {
+                    if (character.weights[i].bones[slot] == b && character.weights[i].weights[slot] > 0.0f)
+                    {
+                        moved.push_back(i);
+                        weights.push_back(character.weights[i].weights[slot]);
+                    }
+                }
+            }
+            fprintf(file, "SkinWeights {\n\"%s\";\n%u;\n", skeleton.names[b].c_str(), (unsigned int)moved.size());
+            for (unsigned int i = 0; i < moved.size(); i++)
+            {
+                fprintf(file, "%u%s", moved[i], i + 1 < moved.size() ? "," : ";\n");
+            }
+            for (unsigned int i = 0; i < weights.size(); i++)
+            {
+                fprintf(file, "%.9g%s", weights[i], i + 1 < weights.size() ? ", " : ";\n");
+            }
+            writeMatrix(file, skeleton.inverseBindPose[b]);
+            fprintf(file, "}\n");
+        }
+        fprintf(file, "}\n");
+    }
+
+    for (unsigned int child = bone + 1; child < skeleton.size(); child++)
+    {
+        if (skeleton.parents[child] == bone)
+        {
+            writeFrame(file, character, child);
+        }
+    }
+    fprintf(file, "}\n");
+}
+
+// The character as a DirectX .x file, the way exporters write them : D3D quaternions are conjugated, so that AssImp
+// ends up with the rotations of the animation, mirrored like everything else
+bool writeXFile(const char *path, const Character &character)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    fprintf(file, "xof 0303txt 0032\nAnimTicksPerSecond {\n%d;\n}\n", TicksPerSecond);
+    writeFrame(file, character, 0);
+
+    const SkeletalAnimation &animation = character.animation;
+    fprintf(file, "AnimationSet %s {\n", animation.name.c_str());
+    for (unsigned int c = 0; c < animation.channels.size(); c++)
+    {
+        const BoneChannel &channel = animation.channels[c];
+        fprintf(file, "Animation {\n{ %s }\n", character.skeleton.names[channel.bone].c_str());
+        unsigned int keys = channel.rotationTimes.size();
+        fprintf(file, "AnimationKey {\n0;\n%u;\n", keys);
+        for (unsigned int k = 0; k < keys; k++)
+        {
+            const glm::quat &q = channel.rotations[k];
+            fprintf(file, "%d;4;%.9g, %.9g, %.9g, %.9g;;%s\n", (int)(channel.rotationTimes[k] * TicksPerSecond + 0.5f),
+                    q.w, -q.x, -q.y, -q.z, k + 1 < keys ? "," : ";");
+        }
+        fprintf(file, "}\n");
+        for (int type = 1; type <= 2; type++)
+        {
+            const std::vector<float> &times = type == 1 ? channel.scaleTimes : channel.positionTimes;
+            const std::vector<glm::vec3> &values = type == 1 ? channel.scales : channel.positions;
+            if (times.empty())
+            {
+                continue;
+            }
+            fprintf(file, "AnimationKey {\n%d;\n%u;\n", type, (unsigned int)times.size());
+            for (unsigned int k = 0; k < times.size(); k++)
+            {
+                fprintf(file, "%d;3;%.9g, %.9g, %.9g;;%s\n", (int)(times[k] * TicksPerSecond + 0.5f), values[k].x,
+                        values[k].y, values[k].z, k + 1 < times.size() ? "," : ";");
+            }
+            fprintf(file, "}\n");
+        }
+        fprintf(file, "}\n");
+    }
+    fprintf(file, "}\n");
+    return fclose(file) == 0;
+}
+
+// The errors between the character and the one loadAssImp reads back from 'path', and the largest difference of
+// their skinned vertices
+int checkImport(const char *path, const Character &character, float &largestDifference)
+{
+    Character imported;
+    std::vector<SkeletalAnimation> animations;
+    if (!loadAssImp(path, imported.indices, imported.positions, imported.uvs, imported.normals, imported.weights,
+                    imported.skeleton, animations))
+    {
+        return 1;
+    }
+    int errors = imported.skeleton.names != character.skeleton.names;
+    errors += imported.skeleton.parents != character.skeleton.parents;
+    errors += animations.size() != 1;
+    if (errors)
+    {
+        return errors;
+    }
+    errors += animations[0].name != character.animation.name || animations[0].duration != Duration;
+
+    // AssImp makes a vertex per corner of each triangle : find where each one comes from, by its position. Its
+    // parser can be an ulp away from the numbers written.
+    const glm::vec3 mirror(1.0f, 1.0f, -1.0f);
+    std::vector<unsigned int> sources(imported.positions.size());
+    for (unsigned int i = 0; i < imported.positions.size(); i++)
+    {
+        float nearest = 1e30f;
+        for (unsigned int j = 0; j < character.positions.size(); j++)
+        {
+            float distance = glm::length(imported.positions[i] * mirror - character.positions[j]);
+            if (distance < nearest)
+            {
+                nearest = distance;
+                sources[i] = j;
+            }
+        }
+        if (nearest > 1e-6f)
+        {
+            return errors + 1;
+        }
+    }
+    errors += imported.positions.size() != character.indices.size();
+
+    // The same skinned vertices, mirrored, all along the loop
+    unsigned int count = imported.positions.size(), bones = character.skeleton.size();
+    std::vector<glm::mat4> palette(bones), importedPalette(bones);
+    std::vector<glm::vec3> positions(character.positions.size()), normals(positions.size());
+    std::vector<glm::vec3> importedPositions(count), importedNormals(count);
+    largestDifference = 0.0f;
+    for (int step = 0; step < 16; step++)
+    {
+        float time = step * Duration / 15.0f + 0.01f;
+        samplePalettes(character.skeleton, character.animation, &time, NULL, 0, 1, &palette[0]);
+        samplePalettes(imported.skeleton, animations[0], &time, NULL, 0, 1, &importedPalette[0]);
+        skinVertices(&character.positions[0], &character.normals[0], &character.weights[0], &palette[0], 0,
+                     positions.size(), &positions[0], &normals[0]);
+        skinVertices(&imported.positions[0], &imported.normals[0], &imported.weights[0], &importedPalette[0], 0,
+                     count, &importedPositions[0], &importedNormals[0]);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            glm::vec3 position = importedPositions[i] * mirror - positions[sources[i]];
+            glm::vec3 normal = importedNormals[i] * mirror - normals[sources[i]];
+            largestDifference = glm::max(largestDifference, glm::max(glm::length(position), glm::length(normal)));
+        }
+    }
+    return errors + (largestDifference > 1e-4f);
+}
+
+// The pixels of two RGB images that differ by more than 'tolerance' in a channel
+unsigned int differentPixels(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b, int tolerance)
+{
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < a.size(); i += 3)
+    {
+        count += abs(a[i] - b[i]) > tolerance || abs(a[i + 1] - b[i + 1]) > tolerance ||
+                 abs(a[i + 2] - b[i + 2]) > tolerance;
+    }
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int count = argc > 1 ? atoi(argv[1]) : 1000;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    const int imageSize = 256;
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(imageSize, imageSize, "Skinning benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open a GL 3.3 window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    Character character;
+    buildCharacter(character);
+    unsigned int vertices = character.positions.size(), bones = character.skeleton.size();
+    int errors = 0;
+
+    // Read back through AssImp
+    float importDifference = 0.0f;
+#ifdef USE_ASSIMP
+    const char *path = "skinning_benchmark.x";
+    errors += !writeXFile(path, character) || checkImport(path, character, importDifference);
+    remove(path);
+#endif
+
+    // A crowd on a grid, each facing its own way, each at its own time of the loop
+    srand(1234);
+    unsigned int columns = (unsigned int)ceilf(sqrtf((float)count));
+    std::vector<float> times(count);
+    std::vector<glm::mat4> roots(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        times[i] = randomFloat(0.0f, Duration);
+        glm::vec3 position(1.0f * (i % columns) - 0.5f * columns, 0.0f, 1.0f * (i / columns) - 0.5f * columns);
+        roots[i] = glm::rotate(glm::translate(glm::mat4(1.0f), position), randomFloat(0.0f, 6.2831853f),
+                               glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    JobSystem jobs;
+    jobs.create(JobSystem::defaultWorkerCount());
+    const unsigned int grain = 16; // characters
+
+    std::vector<glm::mat4> palettes(count * bones);
+    std::vector<glm::vec3> reference(count * vertices), referenceNormals(count * vertices);
+    std::vector<glm::vec3> positions(count * vertices), normals(count * vertices);
+    const char *names[] = {"palettes, all threads", "skinning, scalar", "skinning, SIMD", "skinning, SIMD, all threads",
+                           "GPU skinning"};
+    const int passes = sizeof(names) / sizeof(names[0]);
+    std::vector<double> best(passes, 1e30);
+
+    // The GPU path : the mesh in its bind pose, its weights in the same VAO, the palettes in a texture buffer
+    GLuint skinnedProgramID = LoadShaders("StandardShadingSkinned.vertexshader", "StandardShading.fragmentshader");
+    GLuint standardProgramID = LoadShaders("StandardShading.vertexshader", "StandardShading.fragmentshader");
+    Mesh mesh;
+    mesh.create(character.positions, character.uvs, character.normals, character.indices);
+    mesh.bind();
+    BoneWeightBuffer weightBuffer;
+    createBoneWeightBuffer(weightBuffer, 3, character.weights);
+    glBindVertexArray(0);
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    unsigned int charactersPerDraw = glm::min(count, (unsigned int)maxTexels / (4 * bones));
+    PaletteBuffer paletteBuffer;
+    createPaletteBuffer(paletteBuffer, charactersPerDraw * bones);
+
+    // One orange pixel as the texture, lit from above the crowd
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    unsigned char pixel[3] = {230, 140, 40};
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, pixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glm::vec3 light(0.0f, 4.0f, 3.0f);
+    GLuint programs[2] = {skinnedProgramID, standardProgramID};
+    for (int p = 0; p < 2; p++)
+    {
+        glUseProgram(programs[p]);
+        glUniform1i(glGetUniformLocation(programs[p], "myTextureSampler"), 0);
+        glUniform1i(glGetUniformLocation(programs[p], "lightOn"), 1);
+        glUniform3f(glGetUniformLocation(programs[p], "LightPosition_worldspace"), light.x, light.y, light.z);
+    }
+    glUseProgram(skinnedProgramID);
+    glUniform1i(glGetUniformLocation(skinnedProgramID, "BonePalettes"), 1);
+    glUniform1i(glGetUniformLocation(skinnedProgramID, "BoneCount"), bones);
+    GLuint skinnedVPID = glGetUniformLocation(skinnedProgramID, "VP");
+    GLuint skinnedViewID = glGetUniformLocation(skinnedProgramID, "V");
+    bindPalettes(paletteBuffer, 1);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_CULL_FACE);
+    glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 6.0f, 8.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0, 1, 0));
+    glm::mat4 viewProjection = projection * view;
+
+    // Draws the first 'characters' of the crowd, skinned on the GPU with the palettes of the last pass
+    auto drawOnGpu = [&](unsigned int characters) {
+        glUseProgram(skinnedProgramID);
+        glUniformMatrix4fv(skinnedVPID, 1, GL_FALSE, &viewProjection[0][0]);
+        glUniformMatrix4fv(skinnedViewID, 1, GL_FALSE, &view[0][0]);
+        mesh.bind();
+        for (unsigned int first = 0; first < characters; first += charactersPerDraw)
+        {
+            unsigned int batch = glm::min(charactersPerDraw, characters - first);
+            uploadPalettes(paletteBuffer, &palettes[first * bones], batch * bones);
+            mesh.drawInstanced(batch);
+        }
+        glBindVertexArray(0);
+    };
+
+    for (int run = 0; run < runs; run++)
+    {
+        double durations[passes];
+        double start = glfwGetTime();
+        jobs.parallelFor(0, count, grain, [&](unsigned int first, unsigned int last) {
+            samplePalettes(character.skeleton, character.animation, &times[0], &roots[0], first, last,
+                           &palettes[first * bones]);
+        });
+        durations[0] = glfwGetTime() - start;
+
+        start = glfwGetTime();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            skinVerticesScalar(&character.positions[0], &character.normals[0], &character.weights[0],
+                               &palettes[i * bones], 0, vertices, &reference[i * vertices],
+                               &referenceNormals[i * vertices]);
+        }
+        durations[1] = glfwGetTime() - start;
+
+        for (int p = 2; p <= 3; p++)
+        {
+            std::fill(positions.begin(), positions.end(), glm::vec3(0.0f));
+            start = glfwGetTime();
+            jobs.parallelFor(0, count, p == 3 ? grain : count, [&](unsigned int first, unsigned int last) {
+                for (unsigned int i = first; i < last; i++)
+                {
+                    skinVertices(&character.positions[0], &character.normals[0], &character.weights[0],
+                                 &palettes[i * bones], 0, vertices, &positions[i * vertices],
+                                 &normals[i * vertices]);
+                }
+            });
+            durations[p] = glfwGetTime() - start;
+            errors += memcmp(&positions[0], &reference[0], positions.size() * sizeof(glm::vec3)) != 0;
+            errors += memcmp(&normals[0], &referenceNormals[0], normals.size() * sizeof(glm::vec3)) != 0;
+        }
+
+        glViewport(0, 0, 1, 1);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glFinish();
+        start = glfwGetTime();
+        drawOnGpu(count);
+        glFinish();
+        durations[4] = glfwGetTime() - start;
+
+        for (int p = 0; p < passes; p++)
+        {
+            best[p] = glm::min(best[p], durations[p]);
+        }
+    }
+
+    // Against glm, one matrix product per bone, for a few characters
+    float glmDifference = 0.0f;
+    for (unsigned int i = 0; i < glm::min(count, 16u); i++)
+    {
+        for (unsigned int v = 0; v < vertices; v++)
+        {
+            const BoneWeights &w = character.weights[v];
+            glm::vec4 position(0.0f);
+            for (int slot = 0; slot < 4; slot++)
+            {
+                const glm::mat4 &m = palettes[i * bones + w.bones[slot]];
+                position += w.weights[slot] * (m * glm::vec4(character.positions[v], 1.0f));
+            }
+            glmDifference = glm::max(glmDifference, glm::length(glm::vec3(position) - positions[i * vertices + v]) /
+                                                        glm::max(1.0f, glm::length(glm::vec3(position))));
+        }
+    }
+    errors += glmDifference > 1e-5f;
+
+    // The image of the GPU path, then that of the vertices skinned on the CPU, for the first 64 characters. The
+    // camera looks at the middle of the grid : the crowd is recentered on it.
+    unsigned int drawn = glm::min(count, 64u);
+    unsigned int drawnColumns = (unsigned int)ceilf(sqrtf((float)drawn));
+    for (unsigned int i = 0; i < drawn; i++)
+    {
+        glm::vec3 position(1.0f * (i % drawnColumns) - 0.5f * drawnColumns, 0.0f,
+                           1.0f * (i / drawnColumns) - 0.5f * drawnColumns);
+        roots[i][3] = glm::vec4(position, 1.0f);
+    }
+    samplePalettes(character.skeleton, character.animation, &times[0], &roots[0], 0, drawn, &palettes[0]);
+    std::vector<unsigned char> gpuImage(imageSize * imageSize * 3), cpuImage(gpuImage.size());
+    glViewport(0, 0, imageSize, imageSize);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawOnGpu(drawn);
+    glReadPixels(0, 0, imageSize, imageSize, GL_RGB, GL_UNSIGNED_BYTE, &gpuImage[0]);
+
+    std::vector<unsigned int> crowdIndices;
+    std::vector<glm::vec2> crowdUVs;
+    for (unsigned int i = 0; i < drawn; i++)
+    {
+        skinVertices(&character.positions[0], &character.normals[0], &character.weights[0], &palettes[i * bones], 0,
+                     vertices, &positions[i * vertices], &normals[i * vertices]);
+        for (unsigned int j = 0; j < character.indices.size(); j++)
+        {
+            crowdIndices.push_back(i * vertices + character.indices[j]);
+        }
+        crowdUVs.insert(crowdUVs.end(), character.uvs.begin(), character.uvs.end());
+    }
+    Mesh crowd;
+    crowd.create(&positions[0], &crowdUVs[0], &normals[0], drawn * vertices, &crowdIndices[0], crowdIndices.size());
+    glm::mat4 identity(1.0f);
+    glm::mat3 identityNormal(1.0f);
+    glUseProgram(standardProgramID);
+    glUniformMatrix4fv(glGetUniformLocation(standardProgramID, "MVP"), 1, GL_FALSE, &viewProjection[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(standardProgramID, "V"), 1, GL_FALSE, &view[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(standardProgramID, "M"), 1, GL_FALSE, &identity[0][0]);
+    glUniformMatrix3fv(glGetUniformLocation(standardProgramID, "N"), 1, GL_FALSE, &identityNormal[0][0]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    crowd.bind();
+    crowd.draw();
+    glReadPixels(0, 0, imageSize, imageSize, GL_RGB, GL_UNSIGNED_BYTE, &cpuImage[0]);
+    unsigned int background = 0;
+    for (unsigned int i = 0; i < cpuImage.size(); i += 3)
+    {
+        background += cpuImage[i] == 0 && cpuImage[i + 1] == 0 && cpuImage[i + 2] == 102;
+    }
+    unsigned int differences = differentPixels(gpuImage, cpuImage, 2);
+    errors += differences > imageSize * imageSize / 1000 || background == imageSize * imageSize;
+
+    printf("%u characters of %u vertices and %u bones, best of %d runs, SIMD kernel : %s, %u worker threads\n", count,
+           vertices, bones, runs, skinningInstructionSet(), jobs.workerCount());
+    printf("%-28s %10s %18s\n", "pass", "ms", "Mvertices/s");
+    for (int p = 0; p < passes; p++)
+    {
+        printf("%-28s %10.3f %18.2f\n", names[p], 1000.0 * best[p], 1e-6 * count * vertices / best[p]);
+    }
+    printf("Largest difference with glm : %g\n", glmDifference);
+#ifdef USE_ASSIMP
+    printf("Largest difference of the character read back by loadAssImp : %g\n", importDifference);
+#else
+    printf("Built without AssImp : loadAssImp not checked\n");
+#endif
+    printf("GPU and CPU skinning : %u of %d pixels differ\n", differences, imageSize * imageSize);
+    printf("Skinning checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    crowd.destroy();
+    mesh.destroy();
+    deleteBoneWeightBuffer(weightBuffer);
+    deletePaletteBuffer(paletteBuffer);
+    glDeleteTextures(1, &texture);
+    glDeleteProgram(skinnedProgramID);
+    glDeleteProgram(standardProgramID);
+    jobs.destroy();
+    glfwTerminate();
+
+    return errors == 0 ? 0 : 1;
+}
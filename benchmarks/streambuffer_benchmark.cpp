@@ -0,0 +1,275 @@
+/*
+Streaming upload benchmark.
+
+Uploads per-frame data in two patterns :
+ - "text" : 200 small uploads of 1.5 KB per frame, one per string, like
+   printText2D (common/text2D.cpp)
+ - "instances" : one upload of 100k model matrices (6.4 MB) per frame, like
+   the heads of tutorial09_AssImp
+and compares three ways of doing it :
+ - "BufferData" : glBufferData(GL_STATIC_DRAW) for every upload, which
+   reallocates the storage each time
+ - "orphan+SubData" : glBufferData(NULL) to orphan, then glBufferSubData,
+   like uploadInstanceMatrices (common/instancing.cpp)
+ - "StreamBuffer" : common/streambuffer.cpp, a persistently mapped ring of
+   three regions guarded by fences
+Every upload is consumed by a draw that reads all of it, with rasterization
+off. Reports the time per frame, the bandwidth, and the stalls of the ring.
+
+Checks, outside of the timings, that every draw read exactly the data that
+was written for it : the vertex shader copies what it reads to a transform
+feedback buffer, for 8 frames in a row without waiting, so the ring wraps
+around while earlier draws may still be pending.
+
+Usage : streambuffer_benchmark [frames]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+// Include GLM
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <common/streambuffer.hpp>
+
+enum UploadMethod
+{
+    BufferData,
+    OrphanSubData,
+    Stream,
+    MethodCount
+};
+const char *methodNames[MethodCount] = {"BufferData", "orphan+SubData", "StreamBuffer"};
+
+struct Scenario
+{
+    const char *name;
+    unsigned int uploads;  // per frame
+    unsigned int vertices; // vec4 per upload
+};
+
+// Passes every vec4 through, for the transform feedback check
+static const char *vertexShaderSource = "#version 330 core\n"
+                                        "layout(location = 0) in vec4 value;\n"
+                                        "out vec4 captured;\n"
+                                        "void main(){\n"
+                                        "    captured = value;\n"
+                                        "    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);\n"
+                                        "}\n";
+
+GLuint createCaptureProgram()
+{
+    GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(shader, 1, &vertexShaderSource, NULL);
+    glCompileShader(shader);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    const char *varying = "captured";
+    glTransformFeedbackVaryings(program, 1, &varying, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked ? program : 0;
+}
+
+// Different for every value of every upload of every frame
+void fillUpload(glm::vec4 *values, unsigned int count, unsigned int frame, unsigned int upload)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        values[i] = glm::vec4((float)frame, (float)upload, (float)i, 1.0f);
+    }
+}
+
+// Runs 'frames' frames of the scenario. With a transform feedback buffer, the draws write what they read to it,
+// one after the other.
+void runFrames(UploadMethod method, const Scenario &scenario, unsigned int frames, GLuint plainBuffer,
+               StreamBuffer &stream, std::vector<glm::vec4> &staging, GLuint captureBuffer)
+{
+    unsigned int bytes = scenario.vertices * sizeof(glm::vec4);
+    unsigned int draw = 0;
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        for (unsigned int upload = 0; upload < scenario.uploads; upload++)
+        {
+            GLintptr offset = 0;
+            if (method == Stream)
+            {
+                StreamAllocation allocation = stream.allocate(bytes);
+                fillUpload(static_cast<glm::vec4 *>(allocation.data), scenario.vertices, frame, upload);
+                stream.flush();
+                glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+                offset = allocation.offset;
+            }
+            else
+            {
+                fillUpload(&staging[0], scenario.vertices, frame, upload);
+                glBindBuffer(GL_ARRAY_BUFFER, plainBuffer);
+                if (method == BufferData)
+                {
+                    glBufferData(GL_ARRAY_BUFFER, bytes, &staging[0], GL_STATIC_DRAW);
+                }
+                else
+                {
+                    glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+                    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &staging[0]);
+                }
+            }
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void *)offset);
+
+            if (captureBuffer != 0)
+            {
+                glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, captureBuffer, (GLintptr)draw * bytes, bytes);
+                glBeginTransformFeedback(GL_POINTS);
+            }
+            glDrawArrays(GL_POINTS, 0, scenario.vertices);
+            if (captureBuffer != 0)
+            {
+                glEndTransformFeedback();
+            }
+            draw++;
+        }
+        if (method == Stream)
+        {
+            stream.nextFrame();
+        }
+        // What a buffer swap would do
+        glFlush();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int frames = argc > 1 ? atoi(argv[1]) : 60;
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(64, 64, "Streaming upload benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open GLFW window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    GLuint programID = createCaptureProgram();
+    if (programID == 0)
+    {
+        fprintf(stderr, "Failed to build the capture program\n");
+        glfwTerminate();
+        return -1;
+    }
+    glUseProgram(programID);
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    GLuint VertexArrayID;
+    glGenVertexArrays(1, &VertexArrayID);
+    glBindVertexArray(VertexArrayID);
+    glEnableVertexAttribArray(0);
+
+    GLuint plainBuffer, captureBuffer;
+    glGenBuffers(1, &plainBuffer);
+    glGenBuffers(1, &captureBuffer);
+
+    printf("StreamBuffer : %s\n", StreamBuffer::isPersistentSupported() ? "persistent mapping"
+                                                                         : "no GL_ARB_buffer_storage, copies");
+
+    const Scenario scenarios[2] = {{"text", 200, 96}, {"instances", 1, 400000}};
+    const unsigned int checkFrames = 8;
+    int mismatches = 0;
+
+    printf("%10s %15s %12s %12s %8s\n", "scenario", "method", "ms/frame", "MB/s", "stalls");
+    for (int s = 0; s < 2; s++)
+    {
+        const Scenario &scenario = scenarios[s];
+        unsigned int bytes = scenario.vertices * sizeof(glm::vec4);
+        std::vector<glm::vec4> staging(scenario.vertices);
+
+        for (int m = 0; m < MethodCount; m++)
+        {
+            UploadMethod method = (UploadMethod)m;
+            StreamBuffer stream;
+            stream.create(scenario.uploads * bytes);
+
+            // Warm up, then measure
+            runFrames(method, scenario, 2, plainBuffer, stream, staging, 0);
+            glFinish();
+            stream.resetStats();
+            double start = glfwGetTime();
+            runFrames(method, scenario, frames, plainBuffer, stream, staging, 0);
+            glFinish();
+            double time = glfwGetTime() - start;
+
+            double frameBytes = (double)scenario.uploads * bytes;
+            printf("%10s %15s %12.3f %12.1f %8u\n", scenario.name, methodNames[m], 1000.0 * time / frames,
+                   frameBytes * frames / (1048576.0 * time), stream.stats().stalls);
+
+            // Every draw must have read its own data, even with the ring wrapping around
+            unsigned int draws = checkFrames * scenario.uploads;
+            glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, captureBuffer);
+            glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, (GLsizeiptr)draws * bytes, NULL, GL_STREAM_READ);
+            runFrames(method, scenario, checkFrames, plainBuffer, stream, staging, captureBuffer);
+            std::vector<glm::vec4> captured((size_t)draws * scenario.vertices);
+            glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, captureBuffer);
+            glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, (GLsizeiptr)draws * bytes, &captured[0]);
+            for (unsigned int frame = 0; frame < checkFrames; frame++)
+            {
+                for (unsigned int upload = 0; upload < scenario.uploads; upload++)
+                {
+                    fillUpload(&staging[0], scenario.vertices, frame, upload);
+                    const glm::vec4 *read = &captured[(size_t)(frame * scenario.uploads + upload) * scenario.vertices];
+                    mismatches += memcmp(read, &staging[0], bytes) != 0;
+                }
+            }
+
+            stream.destroy();
+        }
+    }
+
+    printf("Every draw %s the data uploaded for it (%d mismatches)\n", mismatches == 0 ? "read" : "did NOT read",
+           mismatches);
+
+    // Cleanup
+    glDeleteBuffers(1, &plainBuffer);
+    glDeleteBuffers(1, &captureBuffer);
+    glDeleteVertexArrays(1, &VertexArrayID);
+    glDeleteProgram(programID);
+
+    glfwTerminate();
+
+    return mismatches == 0 ? 0 : 1;
+}
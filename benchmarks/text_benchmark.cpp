@@ -0,0 +1,297 @@
+/*
+Text rendering benchmark.
+
+Prints 10k glyphs per frame, 200 strings of 50 characters covering an
+800x600 window, in two ways :
+ - "per string" : what printText2D used to do, two new vertex and UV arrays
+   for every string, uploaded with glBufferData, and one draw per string
+ - "batched" : common/text2D.cpp, the quads of every string written into
+   one streaming buffer and drawn in one call by flushText2D()
+with strings that are the same every frame ("static", kept on the GPU by
+text2D after their second frame) and strings that change every frame
+("dynamic", built into the streaming buffer every frame).
+
+Reports the whole frame, and the time spent in the print calls and the
+draws ("submit"), which is what the batching changes. With a small glyph
+size, filling the pixels no longer hides it. The fence flushText2D() puts
+behind the text, and its wait for the GPU to release a region of the
+streaming buffer, are reported apart ("fence") and left out of the submit
+time : they are the GPU being behind, and with a software rasterizer
+(llvmpipe) the fence is where the whole frame is drawn, which the per-string
+way pays in glfwSwapBuffers instead. Both show in the whole frame.
+
+Checks that both ways draw exactly the same pixels. The font is uvmap.DDS :
+only the pixels matter here, not the letters.
+
+Usage : text_benchmark [frames] [glyph size]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Include GLFW
+#include <GLFW/glfw3.h>
+GLFWwindow *window;
+
+// Include GLM
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <common/glstate.hpp>
+#include <common/shader.hpp>
+#include <common/text2D.hpp>
+#include <common/texture.hpp>
+
+const int stringCount = 200;
+const int stringLength = 50;
+int glyphSize = 8;
+
+// The previous printText2D
+struct PerStringText
+{
+    GLuint vertexArrayID;
+    GLuint textureID;
+    GLuint vertexBufferID;
+    GLuint uvBufferID;
+    GLuint programID;
+    GLuint samplerID;
+};
+
+void printPerString(const PerStringText &state, const char *text, int x, int y, int size)
+{
+    unsigned int length = strlen(text);
+
+    std::vector<glm::vec2> vertices;
+    std::vector<glm::vec2> UVs;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        glm::vec2 vertex_up_left = glm::vec2(x + i * size, y + size);
+        glm::vec2 vertex_up_right = glm::vec2(x + i * size + size, y + size);
+        glm::vec2 vertex_down_right = glm::vec2(x + i * size + size, y);
+        glm::vec2 vertex_down_left = glm::vec2(x + i * size, y);
+
+        vertices.push_back(vertex_up_left);
+        vertices.push_back(vertex_down_left);
+        vertices.push_back(vertex_up_right);
+
+        vertices.push_back(vertex_down_right);
+        vertices.push_back(vertex_up_right);
+        vertices.push_back(vertex_down_left);
+
+        char character = text[i];
+        float uv_x = (character % 16) / 16.0f;
+        float uv_y = (character / 16) / 16.0f;
+
+        glm::vec2 uv_up_left = glm::vec2(uv_x, uv_y);
+        glm::vec2 uv_up_right = glm::vec2(uv_x + 1.0f / 16.0f, uv_y);
+        glm::vec2 uv_down_right = glm::vec2(uv_x + 1.0f / 16.0f, (uv_y + 1.0f / 16.0f));
+        glm::vec2 uv_down_left = glm::vec2(uv_x, (uv_y + 1.0f / 16.0f));
+        UVs.push_back(uv_up_left);
+        UVs.push_back(uv_down_left);
+        UVs.push_back(uv_up_right);
+
+        UVs.push_back(uv_down_right);
+        UVs.push_back(uv_up_right);
+        UVs.push_back(uv_down_left);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, state.vertexBufferID);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, state.uvBufferID);
+    glBufferData(GL_ARRAY_BUFFER, UVs.size() * sizeof(glm::vec2), &UVs[0], GL_STATIC_DRAW);
+
+    glUseProgram(state.programID);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, state.textureID);
+    glUniform1i(state.samplerID, 0);
+
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, state.vertexBufferID);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, state.uvBufferID);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+
+    glDisable(GL_BLEND);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+}
+
+// The text of a frame : the same for every frame, or with the frame number in every string
+void buildStrings(bool dynamic, unsigned int frame, std::vector<std::string> &strings)
+{
+    strings.resize(stringCount);
+    for (int s = 0; s < stringCount; s++)
+    {
+        char text[stringLength + 1];
+        for (int i = 0; i < stringLength; i++)
+        {
+            text[i] = (char)(32 + (s * 7 + i) % 95);
+        }
+        text[stringLength] = '\0';
+        if (dynamic)
+        {
+            char counter[32];
+            int written = sprintf(counter, "frame %u line %d", frame, s);
+            memcpy(text, counter, written);
+        }
+        strings[s] = text;
+    }
+}
+
+// Two columns of 100 overlapping lines
+void printStrings(const PerStringText *perString, const std::vector<std::string> &strings, GLStateCache &state)
+{
+    if (perString != NULL)
+    {
+        state.bindVertexArray(perString->vertexArrayID);
+    }
+    for (int s = 0; s < stringCount; s++)
+    {
+        int x = (s % 2) * 400;
+        int y = (s / 2) * 6;
+        if (perString != NULL)
+        {
+            printPerString(*perString, strings[s].c_str(), x, y, glyphSize);
+        }
+        else
+        {
+            printText2D(strings[s].c_str(), x, y, glyphSize, state);
+        }
+    }
+    if (perString == NULL)
+    {
+        flushText2D(state);
+    }
+    else
+    {
+        // printPerString() changes the state directly
+        state.invalidate();
+    }
+}
+
+void readFrame(std::vector<unsigned char> &pixels)
+{
+    pixels.resize(800 * 600 * 4);
+    glReadPixels(0, 0, 800, 600, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int frames = argc > 1 ? atoi(argv[1]) : 100;
+    glyphSize = argc > 2 ? atoi(argv[2]) : 8;
+
+    // Initialise GLFW
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(800, 600, "Text rendering benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open GLFW window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    // Initialize GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    PerStringText perString;
+    glGenVertexArrays(1, &perString.vertexArrayID);
+    perString.textureID = loadDDS("uvmap.DDS");
+    glGenBuffers(1, &perString.vertexBufferID);
+    glGenBuffers(1, &perString.uvBufferID);
+    perString.programID = LoadShaders("TextVertexShader.vertexshader", "TextVertexShader.fragmentshader");
+    perString.samplerID = glGetUniformLocation(perString.programID, "myTextureSampler");
+
+    initText2D("uvmap.DDS");
+    GLStateCache state;
+
+    printf("%u frames of %d glyphs of %d pixels\n", frames, stringCount * stringLength, glyphSize);
+    printf("%8s %11s %12s %12s %16s %15s\n", "text", "method", "draws", "ms/frame", "submit ms/frame",
+           "fence ms/frame");
+    int mismatches = 0;
+    std::vector<std::string> strings;
+    for (int dynamic = 0; dynamic < 2; dynamic++)
+    {
+        std::vector<unsigned char> reference, pixels;
+        for (int batched = 0; batched < 2; batched++)
+        {
+            const PerStringText *method = batched ? NULL : &perString;
+
+            // Warm up, then measure
+            buildStrings(dynamic != 0, 0, strings);
+            printStrings(method, strings, state);
+            glFinish();
+            double start = glfwGetTime();
+            double submitTime = 0.0;
+            double fenceStart = text2DFenceTime();
+            for (unsigned int frame = 1; frame <= frames; frame++)
+            {
+                glClear(GL_COLOR_BUFFER_BIT);
+                buildStrings(dynamic != 0, frame, strings);
+                double submitStart = glfwGetTime();
+                printStrings(method, strings, state);
+                submitTime += glfwGetTime() - submitStart;
+                glfwSwapBuffers(window);
+            }
+            glFinish();
+            double time = glfwGetTime() - start;
+            double fenceTime = text2DFenceTime() - fenceStart;
+            printf("%8s %11s %12d %12.3f %16.3f %15.3f\n", dynamic ? "dynamic" : "static",
+                   batched ? "batched" : "per string", batched ? 1 : stringCount, 1000.0 * time / frames,
+                   1000.0 * (submitTime - fenceTime) / frames, 1000.0 * fenceTime / frames);
+
+            // The same picture both ways
+            glClear(GL_COLOR_BUFFER_BIT);
+            buildStrings(dynamic != 0, frames, strings);
+            printStrings(method, strings, state);
+            readFrame(batched ? pixels : reference);
+        }
+        mismatches += pixels != reference;
+    }
+    printf("Batched text %s per-string text\n", mismatches == 0 ? "matches" : "does NOT match");
+
+    // Cleanup
+    cleanupText2D();
+    glDeleteBuffers(1, &perString.vertexBufferID);
+    glDeleteBuffers(1, &perString.uvBufferID);
+    glDeleteTextures(1, &perString.textureID);
+    glDeleteProgram(perString.programID);
+    glDeleteVertexArrays(1, &perString.vertexArrayID);
+
+    glfwTerminate();
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+/*
+Transform benchmark.
+
+Builds the model, MVP and normal matrices of 1M instances, from random
+translations, rotations and scales :
+ - with glm, one instance at a time, as tutorial09_AssImp did : a translate
+   and a rotation per model matrix, projection * view * model as two mat4
+   multiplies, the normal matrix from an inverse
+ - with the scalar reference of common/transforms.cpp
+ - with its SIMD kernels (SSE, or AVX when compiled with USE_AVX), on this
+   thread, then on every thread of the job system
+ - for the instances of an index list only, half of them, as after culling
+ - the model matrices only
+ - the compact and quantized instances, 32 and 24 bytes instead of 176
+
+Reports the time per pass and per instance, and checks that :
+ - the SIMD kernels give exactly the matrices of the scalar reference, with
+   any number of threads, and the matrices of glm within rounding
+ - decoding the compact instances the way the vertex shader does gives the
+   model and normal matrices of the reference for the instances scaled the
+   same along each axis, within rounding, and within 1e-4 of the scale once
+   the rotations are quantized
+
+Usage : transform_benchmark [instances] [runs]
+*/
+
+// Include standard headers
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+using namespace glm;
+
+#include <common/clock.hpp>
+#include <common/jobsystem.hpp>
+#include <common/transforms.hpp>
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+// The matrices of one instance, the way the tutorial built them
+void glmInstanceTransform(const Transforms &transforms, unsigned int i, const glm::mat4 &projection,
+                          const glm::mat4 &view, InstanceTransform &out)
+{
+    glm::quat rotation(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i],
+                       transforms.rotationZ[i]);
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(transforms.positionX[i], transforms.positionY[i],
+                                                                transforms.positionZ[i]));
+    model = glm::rotate(model, glm::angle(rotation), glm::axis(rotation));
+    model = glm::scale(model, glm::vec3(transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i]));
+    out.model = model;
+    out.mvp = projection * view * model;
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+    for (int c = 0; c < 3; c++)
+    {
+        out.normal[c] = glm::vec4(normal[c], 0.0f);
+    }
+}
+
+// The largest difference between two sets of matrices, relative to the largest value of each matrix
+float largestDifference(const InstanceTransform &a, const InstanceTransform &b)
+{
+    const float *x = &a.model[0][0];
+    const float *y = &b.model[0][0];
+    int count = sizeof(InstanceTransform) / sizeof(float);
+    float largest = 0.0f, difference = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        largest = glm::max(largest, fabsf(x[i]));
+        difference = glm::max(difference, fabsf(x[i] - y[i]));
+    }
+    return difference / glm::max(largest, 1.0f);
+}
+
+// The largest difference between a decoded instance and the reference matrices of an instance scaled by 'scale' along
+// each axis, relative to that scale. The reference normal matrix is the rotation divided by the scale, the decoded one
+// the rotation alone. The translation must be exact.
+float decodedDifference(const glm::mat4 &model, const glm::mat3 &normal, const InstanceTransform &reference,
+                        float scale)
+{
+    float difference = model[3] == reference.model[3] ? 0.0f : 1.0f;
+    for (int c = 0; c < 3; c++)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            difference = glm::max(difference, fabsf(model[c][r] - reference.model[c][r]) / scale);
+            difference = glm::max(difference, fabsf(normal[c][r] - reference.normal[c][r] * scale));
+        }
+    }
+    return difference;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    srand(1234);
+    Transforms transforms;
+    transforms.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm::vec3 position(randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f), randomFloat(-500.0f, 500.0f));
+        glm::vec3 axis(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+        glm::quat rotation = glm::angleAxis(randomFloat(0.0f, 6.2831853f), glm::normalize(axis + glm::vec3(0.001f)));
+        // A quarter of the instances are not scaled the same along every axis
+        float scale = randomFloat(0.5f, 2.0f);
+        glm::vec3 scales = i % 4 == 0 ? glm::vec3(scale, randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f))
+                                      : glm::vec3(scale);
+        transforms.set(i, position, rotation, scales);
+    }
+
+    // Every other instance, as if culling kept half of them
+    std::vector<unsigned int> indices;
+    for (unsigned int i = 0; i < count; i += 2)
+    {
+        indices.push_back(i);
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(10.0f, 20.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0, 1, 0));
+    glm::mat4 viewProjection = projection * view;
+
+    JobSystem jobs;
+    jobs.create(JobSystem::defaultWorkerCount());
+    const unsigned int grain = 16384;
+
+    std::vector<InstanceTransform> reference(count), result(count), indexed(indices.size()), fromGlm(count);
+    std::vector<glm::mat4> models(count), referenceModels(count);
+    std::vector<CompactInstance> compact(count);
+    std::vector<QuantizedInstance> quantized(count);
+    const char *names[] = {"glm, one at a time", "scalar",           "SIMD",           "SIMD, all threads",
+                           "SIMD, half, indexed", "model only, scalar", "model only, SIMD", "compact, 32 bytes",
+                           "quantized, 24 bytes"};
+    const int passes = sizeof(names) / sizeof(names[0]);
+    std::vector<double> best(passes, 1e30);
+    int errors = 0;
+    float glmDifference = 0.0f;
+
+    for (int run = 0; run < runs; run++)
+    {
+        double durations[passes];
+        double start = clockTime();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            glmInstanceTransform(transforms, i, projection, view, fromGlm[i]);
+        }
+        durations[0] = clockTime() - start;
+
+        start = clockTime();
+        computeInstanceTransformsScalar(transforms, viewProjection, 0, count, &reference[0]);
+        durations[1] = clockTime() - start;
+
+        std::fill(result.begin(), result.end(), InstanceTransform());
+        start = clockTime();
+        computeInstanceTransforms(transforms, viewProjection, 0, count, &result[0]);
+        durations[2] = clockTime() - start;
+        errors += memcmp(&result[0], &reference[0], count * sizeof(InstanceTransform)) != 0;
+
+        std::fill(result.begin(), result.end(), InstanceTransform());
+        start = clockTime();
+        jobs.parallelFor(0, count, grain, [&](unsigned int first, unsigned int last) {
+            computeInstanceTransforms(transforms, viewProjection, first, last, &result[first]);
+        });
+        durations[3] = clockTime() - start;
+        errors += memcmp(&result[0], &reference[0], count * sizeof(InstanceTransform)) != 0;
+
+        start = clockTime();
+        computeIndexedInstanceTransforms(transforms, viewProjection, &indices[0], indices.size(), &indexed[0]);
+        durations[4] = clockTime() - start;
+        for (unsigned int i = 0; i < indices.size(); i++)
+        {
+            errors += memcmp(&indexed[i], &reference[indices[i]], sizeof(InstanceTransform)) != 0;
+        }
+
+        start = clockTime();
+        computeModelMatricesScalar(transforms, 0, count, &referenceModels[0]);
+        durations[5] = clockTime() - start;
+        start = clockTime();
+        computeModelMatrices(transforms, 0, count, &models[0]);
+        durations[6] = clockTime() - start;
+        errors += memcmp(&models[0], &referenceModels[0], count * sizeof(glm::mat4)) != 0;
+
+        start = clockTime();
+        computeCompactInstances(transforms, 0, count, &compact[0]);
+        durations[7] = clockTime() - start;
+        start = clockTime();
+        computeQuantizedInstances(transforms, 0, count, &quantized[0]);
+        durations[8] = clockTime() - start;
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            errors += memcmp(&models[i], &reference[i].model, sizeof(glm::mat4)) != 0;
+            glmDifference = glm::max(glmDifference, largestDifference(reference[i], fromGlm[i]));
+        }
+        for (int p = 0; p < passes; p++)
+        {
+            best[p] = glm::min(best[p], durations[p]);
+        }
+    }
+    errors += glmDifference > 1e-5f;
+
+    // The CPU reference of the compact vertex shader, for the instances it can draw
+    std::vector<CompactInstance> indexedCompact(indices.size());
+    std::vector<QuantizedInstance> indexedQuantized(indices.size());
+    computeIndexedCompactInstances(transforms, &indices[0], indices.size(), &indexedCompact[0]);
+    computeIndexedQuantizedInstances(transforms, &indices[0], indices.size(), &indexedQuantized[0]);
+    float compactDifference = 0.0f, quantizedDifference = 0.0f;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (transforms.scaleY[i] != transforms.scaleX[i] || transforms.scaleZ[i] != transforms.scaleX[i])
+        {
+            continue;
+        }
+        glm::mat4 model;
+        glm::mat3 normal;
+        decodeCompactInstance(compact[i], model, normal);
+        compactDifference =
+            glm::max(compactDifference, decodedDifference(model, normal, reference[i], compact[i].scale));
+        decodeQuantizedInstance(quantized[i], model, normal);
+        quantizedDifference =
+            glm::max(quantizedDifference, decodedDifference(model, normal, reference[i], quantized[i].scale));
+    }
+    for (unsigned int i = 0; i < indices.size(); i++)
+    {
+        errors += memcmp(&indexedCompact[i], &compact[indices[i]], sizeof(CompactInstance)) != 0;
+        errors += memcmp(&indexedQuantized[i], &quantized[indices[i]], sizeof(QuantizedInstance)) != 0;
+    }
+    errors += compactDifference > 1e-5f || quantizedDifference > 1e-4f;
+
+    printf("%u instances, best of %d runs, SIMD kernels : %s, %u worker threads\n", count, runs,
+           transformsInstructionSet(), jobs.workerCount());
+    printf("%-22s %10s %12s %9s\n", "pass", "ms", "ns/instance", "speedup");
+    for (int p = 0; p < passes; p++)
+    {
+        unsigned int instances = p == 4 ? indices.size() : count;
+        printf("%-22s %10.3f %12.2f %8.2fx\n", names[p], 1000.0 * best[p], 1e9 * best[p] / instances,
+               best[0] / best[p] * instances / count);
+    }
+    printf("Largest difference with glm : %g of the largest value of the matrix\n", glmDifference);
+    printf("Largest difference of the decoded instances : compact %g, quantized %g of the scale\n", compactDifference,
+           quantizedDifference);
+    printf("Transform checks %s (%d errors)\n", errors == 0 ? "pass" : "FAIL", errors);
+
+    jobs.destroy();
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,594 @@
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+#include "bvh.hpp"
+
+static const int NumBins = 16;
+static const unsigned int AllPlanes = 0x3F;
+
+static inline float surfaceArea(const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static inline float surfaceArea(const BVHNode &a, const BVHNode &b)
+{
+    return surfaceArea(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+// Tests the box against the planes of 'mask'. Returns false when it is
+// outside of one of them, otherwise removes from 'mask' the planes it is
+// completely inside of.
+static inline bool classifyBox(const Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max, unsigned int &mask)
+{
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    for (int p = 0; p < 6; p++)
+    {
+        if (!(mask & (1 << p)))
+        {
+            continue;
+        }
+        const glm::vec4 &plane = frustum.planes[p];
+        // Same arithmetic as the brute-force kernels, so that both agree exactly
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float reach = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+        if (distance + reach < 0.0f)
+        {
+            return false;
+        }
+        if (distance - reach >= 0.0f)
+        {
+            mask &= ~(1u << p);
+        }
+    }
+    return true;
+}
+
+static inline bool sphereOverlapsBox(const glm::vec3 &center, float radius, const glm::vec3 &min,
+                                     const glm::vec3 &max)
+{
+    glm::vec3 d = center - glm::clamp(center, min, max);
+    return glm::dot(d, d) <= radius * radius;
+}
+
+static inline bool boxesOverlap(const glm::vec3 &minA, const glm::vec3 &maxA, const glm::vec3 &minB,
+                                const glm::vec3 &maxB)
+{
+    return minA.x <= maxB.x && minB.x <= maxA.x && minA.y <= maxB.y && minB.y <= maxA.y && minA.z <= maxB.z &&
+           minB.z <= maxA.z;
+}
+
+// Slab test. Returns the entry distance, clamped to 0 when the origin is
+// inside, or a negative number when the ray misses or enters beyond 'maxDistance'.
+static inline float intersectRay(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance,
+                                 const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 t0 = (min - origin) * inverseDirection;
+    glm::vec3 t1 = (max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return enter <= exit ? enter : -1.0f;
+}
+
+BVH::BVH() : boxes(NULL), maxLeafSize(4)
+{
+}
+
+void BVH::computeBounds(unsigned int nodeIndex)
+{
+    BVHNode &node = nodes[nodeIndex];
+    glm::vec3 min(INFINITY), max(-INFINITY);
+    for (unsigned int i = 0; i < node.count; i++)
+    {
+        unsigned int p = primitives[node.leftOrFirst + i];
+        min = glm::min(min, glm::vec3(boxes->minX[p], boxes->minY[p], boxes->minZ[p]));
+        max = glm::max(max, glm::vec3(boxes->maxX[p], boxes->maxY[p], boxes->maxZ[p]));
+    }
+    node.min = min;
+    node.max = max;
+}
+
+// The build partitions copies of the boxes rather than indices, so that every
+// pass over a node's primitives reads contiguous memory
+struct BuildPrimitive
+{
+    glm::vec3 min, max, centroid;
+    unsigned int index;
+};
+
+static void buildBounds(BVHNode &node, const std::vector<BuildPrimitive> &work)
+{
+    glm::vec3 min(INFINITY), max(-INFINITY);
+    for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+    {
+        min = glm::min(min, work[i].min);
+        max = glm::max(max, work[i].max);
+    }
+    node.min = min;
+    node.max = max;
+}
+
+static void subdivide(std::vector<BVHNode> &nodes, std::vector<BuildPrimitive> &work, unsigned int nodeIndex,
+                      unsigned int depth, unsigned int maxLeafSize)
+{
+    BVHNode &node = nodes[nodeIndex];
+    unsigned int first = node.leftOrFirst;
+    unsigned int count = node.count;
+    if (count <= 1 || depth + 1 >= BVH::MaxDepth)
+    {
+        return;
+    }
+
+    glm::vec3 centroidMin(INFINITY), centroidMax(-INFINITY);
+    for (unsigned int i = first; i < first + count; i++)
+    {
+        centroidMin = glm::min(centroidMin, work[i].centroid);
+        centroidMax = glm::max(centroidMax, work[i].centroid);
+    }
+
+    // Binned SAH : sort the centroids in NumBins slices along each axis, all
+    // three in the same pass, and evaluate the NumBins - 1 planes between them
+    glm::vec3 scale;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        scale[axis] = extent > 0.0f ? NumBins / extent : 0.0f;
+    }
+    glm::vec3 binMin[3][NumBins], binMax[3][NumBins];
+    unsigned int binCount[3][NumBins];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int b = 0; b < NumBins; b++)
+        {
+            binMin[axis][b] = glm::vec3(INFINITY);
+            binMax[axis][b] = glm::vec3(-INFINITY);
+            binCount[axis][b] = 0;
+        }
+    }
+    for (unsigned int i = first; i < first + count; i++)
+    {
+        const BuildPrimitive &primitive = work[i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int b = std::min(NumBins - 1, (int)((primitive.centroid[axis] - centroidMin[axis]) * scale[axis]));
+            binMin[axis][b] = glm::min(binMin[axis][b], primitive.min);
+            binMax[axis][b] = glm::max(binMax[axis][b], primitive.max);
+            binCount[axis][b]++;
+        }
+    }
+
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = INFINITY;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (scale[axis] == 0.0f)
+        {
+            continue;
+        }
+
+        // Sweep from the left, then from the right
+        float leftArea[NumBins - 1];
+        unsigned int leftCount[NumBins - 1];
+        glm::vec3 min(INFINITY), max(-INFINITY);
+        unsigned int sum = 0;
+        for (int b = 0; b < NumBins - 1; b++)
+        {
+            min = glm::min(min, binMin[axis][b]);
+            max = glm::max(max, binMax[axis][b]);
+            sum += binCount[axis][b];
+            leftCount[b] = sum;
+            leftArea[b] = sum > 0 ? surfaceArea(min, max) : 0.0f;
+        }
+        min = glm::vec3(INFINITY);
+        max = glm::vec3(-INFINITY);
+        sum = 0;
+        for (int b = NumBins - 1; b > 0; b--)
+        {
+            min = glm::min(min, binMin[axis][b]);
+            max = glm::max(max, binMax[axis][b]);
+            sum += binCount[axis][b];
+            if (sum == 0 || leftCount[b - 1] == 0)
+            {
+                continue;
+            }
+            float cost = leftArea[b - 1] * leftCount[b - 1] + surfaceArea(min, max) * sum;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    // All the centroids are at the same place : nothing to split
+    if (bestAxis < 0)
+    {
+        return;
+    }
+    // Small enough, and splitting would not pay for the extra node
+    float leafCost = surfaceArea(node.min, node.max) * (count - 1);
+    if (count <= maxLeafSize && bestCost >= leafCost)
+    {
+        return;
+    }
+
+    float axisMin = centroidMin[bestAxis], axisScale = scale[bestAxis];
+    BuildPrimitive *begin = &work[first];
+    BuildPrimitive *middle = std::partition(begin, begin + count, [&](const BuildPrimitive &primitive) {
+        return std::min(NumBins - 1, (int)((primitive.centroid[bestAxis] - axisMin) * axisScale)) < bestSplit;
+    });
+    unsigned int leftCount = middle - begin;
+
+    unsigned int leftIndex = nodes.size();
+    BVHNode child;
+    child.leftOrFirst = first;
+    child.count = leftCount;
+    nodes.push_back(child);
+    child.leftOrFirst = first + leftCount;
+    child.count = count - leftCount;
+    nodes.push_back(child);
+    node.leftOrFirst = leftIndex;
+    node.count = 0;
+
+    buildBounds(nodes[leftIndex], work);
+    buildBounds(nodes[leftIndex + 1], work);
+    subdivide(nodes, work, leftIndex, depth + 1, maxLeafSize);
+    subdivide(nodes, work, leftIndex + 1, depth + 1, maxLeafSize);
+}
+
+void BVH::build(const BoundingBoxes &boundingBoxes, unsigned int leafSize)
+{
+    boxes = &boundingBoxes;
+    maxLeafSize = std::max(leafSize, 1u);
+    unsigned int count = boundingBoxes.size();
+
+    nodes.clear();
+    primitives.resize(count);
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::vector<BuildPrimitive> work(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        work[i].min = glm::vec3(boundingBoxes.minX[i], boundingBoxes.minY[i], boundingBoxes.minZ[i]);
+        work[i].max = glm::vec3(boundingBoxes.maxX[i], boundingBoxes.maxY[i], boundingBoxes.maxZ[i]);
+        work[i].centroid = 0.5f * (work[i].min + work[i].max);
+        work[i].index = i;
+    }
+
+    // At most 2n - 1 nodes : reserving them keeps the references in subdivide() valid
+    nodes.reserve(2 * count - 1);
+    BVHNode root;
+    root.leftOrFirst = 0;
+    root.count = count;
+    nodes.push_back(root);
+    buildBounds(nodes[0], work);
+    subdivide(nodes, work, 0, 0, maxLeafSize);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        primitives[i] = work[i].index;
+    }
+}
+
+void BVH::refitNode(unsigned int nodeIndex)
+{
+    BVHNode &node = nodes[nodeIndex];
+    if (node.count > 0)
+    {
+        computeBounds(nodeIndex);
+        return;
+    }
+    refitNode(node.leftOrFirst);
+    refitNode(node.leftOrFirst + 1);
+    const BVHNode &left = nodes[node.leftOrFirst];
+    const BVHNode &right = nodes[node.leftOrFirst + 1];
+    node.min = glm::min(left.min, right.min);
+    node.max = glm::max(left.max, right.max);
+}
+
+void BVH::refit()
+{
+    if (!nodes.empty())
+    {
+        refitNode(0);
+    }
+}
+
+// Kopta et al., "Fast, Effective BVH Updates for Animated Scenes" : swap a
+// child with one of its nephews when that makes the sibling smaller. Done
+// bottom-up, and never deeper than MaxDepth. Returns the height of the subtree.
+unsigned int BVH::rotateNode(unsigned int nodeIndex, unsigned int depth, std::vector<unsigned char> &heights,
+                             unsigned int &rotations)
+{
+    if (nodes[nodeIndex].count > 0)
+    {
+        heights[nodeIndex] = 0;
+        return 0;
+    }
+    unsigned int children[2] = {nodes[nodeIndex].leftOrFirst, nodes[nodeIndex].leftOrFirst + 1};
+    rotateNode(children[0], depth + 1, heights, rotations);
+    rotateNode(children[1], depth + 1, heights, rotations);
+
+    // Candidate : child 'c' goes down in place of nephew 'n', under 'sibling'
+    float bestGain = 0.0f;
+    unsigned int bestChild = 0, bestNephew = 0;
+    for (int c = 0; c < 2; c++)
+    {
+        unsigned int child = children[c];
+        unsigned int sibling = children[1 - c];
+        if (nodes[sibling].count > 0 || depth + 2 + heights[child] >= MaxDepth)
+        {
+            continue;
+        }
+        float siblingArea = surfaceArea(nodes[sibling].min, nodes[sibling].max);
+        for (int n = 0; n < 2; n++)
+        {
+            unsigned int nephew = nodes[sibling].leftOrFirst + n;
+            unsigned int otherNephew = nodes[sibling].leftOrFirst + 1 - n;
+            float gain = siblingArea - surfaceArea(nodes[child], nodes[otherNephew]);
+            if (gain > bestGain)
+            {
+                bestGain = gain;
+                bestChild = child;
+                bestNephew = nephew;
+            }
+        }
+    }
+
+    if (bestGain > 0.0f)
+    {
+        // Swapping the records moves whole subtrees, their children stay where they are
+        std::swap(nodes[bestChild], nodes[bestNephew]);
+        std::swap(heights[bestChild], heights[bestNephew]);
+        unsigned int sibling = bestChild == children[0] ? children[1] : children[0];
+        BVHNode &parent = nodes[sibling];
+        const BVHNode &left = nodes[parent.leftOrFirst];
+        const BVHNode &right = nodes[parent.leftOrFirst + 1];
+        parent.min = glm::min(left.min, right.min);
+        parent.max = glm::max(left.max, right.max);
+        heights[sibling] = 1 + std::max(heights[parent.leftOrFirst], heights[parent.leftOrFirst + 1]);
+        rotations++;
+    }
+
+    heights[nodeIndex] = 1 + std::max(heights[children[0]], heights[children[1]]);
+    return heights[nodeIndex];
+}
+
+unsigned int BVH::rotate()
+{
+    unsigned int rotations = 0;
+    if (!nodes.empty())
+    {
+        std::vector<unsigned char> heights(nodes.size());
+        rotateNode(0, 0, heights, rotations);
+    }
+    return rotations;
+}
+
+void BVH::cullFrustum(const Frustum &frustum, std::vector<unsigned int> &visible) const
+{
+    visible.clear();
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    // Node index and the planes that still have to be tested
+    struct Entry
+    {
+        unsigned int node, mask;
+    };
+    Entry stack[MaxDepth + 1];
+    int top = 0;
+    stack[top].node = 0;
+    stack[top++].mask = AllPlanes;
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+        const BVHNode &node = nodes[entry.node];
+        if (entry.mask != 0 && !classifyBox(frustum, node.min, node.max, entry.mask))
+        {
+            continue;
+        }
+        if (node.count == 0)
+        {
+            stack[top].node = node.leftOrFirst + 1;
+            stack[top++].mask = entry.mask;
+            stack[top].node = node.leftOrFirst;
+            stack[top++].mask = entry.mask;
+            continue;
+        }
+        for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+        {
+            unsigned int p = primitives[i];
+            unsigned int mask = entry.mask;
+            if (mask == 0 || classifyBox(frustum, glm::vec3(boxes->minX[p], boxes->minY[p], boxes->minZ[p]),
+                                         glm::vec3(boxes->maxX[p], boxes->maxY[p], boxes->maxZ[p]), mask))
+            {
+                visible.push_back(p);
+            }
+        }
+    }
+}
+
+void BVH::querySphere(const glm::vec3 &center, float radius, std::vector<unsigned int> &result) const
+{
+    result.clear();
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    unsigned int stack[MaxDepth + 1];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVHNode &node = nodes[stack[--top]];
+        if (!sphereOverlapsBox(center, radius, node.min, node.max))
+        {
+            continue;
+        }
+        if (node.count == 0)
+        {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+            continue;
+        }
+        for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+        {
+            unsigned int p = primitives[i];
+            if (sphereOverlapsBox(center, radius, glm::vec3(boxes->minX[p], boxes->minY[p], boxes->minZ[p]),
+                                  glm::vec3(boxes->maxX[p], boxes->maxY[p], boxes->maxZ[p])))
+            {
+                result.push_back(p);
+            }
+        }
+    }
+}
+
+void BVH::queryBox(const glm::vec3 &min, const glm::vec3 &max, std::vector<unsigned int> &result) const
+{
+    result.clear();
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    unsigned int stack[MaxDepth + 1];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVHNode &node = nodes[stack[--top]];
+        if (!boxesOverlap(min, max, node.min, node.max))
+        {
+            continue;
+        }
+        if (node.count == 0)
+        {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+            continue;
+        }
+        for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+        {
+            unsigned int p = primitives[i];
+            if (boxesOverlap(min, max, glm::vec3(boxes->minX[p], boxes->minY[p], boxes->minZ[p]),
+                             glm::vec3(boxes->maxX[p], boxes->maxY[p], boxes->maxZ[p])))
+            {
+                result.push_back(p);
+            }
+        }
+    }
+}
+
+bool BVH::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, unsigned int &hit,
+                  float &distance) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    // 1 / 0 = inf makes the slab test work for axis-aligned rays
+    glm::vec3 inverseDirection = 1.0f / direction;
+    float closest = maxDistance;
+    bool found = false;
+
+    unsigned int stack[MaxDepth + 1];
+    int top = 0;
+    if (intersectRay(origin, inverseDirection, closest, nodes[0].min, nodes[0].max) < 0.0f)
+    {
+        return false;
+    }
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVHNode &node = nodes[stack[--top]];
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+            {
+                unsigned int p = primitives[i];
+                float t = intersectRay(origin, inverseDirection, closest,
+                                       glm::vec3(boxes->minX[p], boxes->minY[p], boxes->minZ[p]),
+                                       glm::vec3(boxes->maxX[p], boxes->maxY[p], boxes->maxZ[p]));
+                if (t >= 0.0f && (!found || t < closest || (t == closest && p < hit)))
+                {
+                    closest = t;
+                    hit = p;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // Visit the closest child first, so that it shortens the ray for the other one
+        unsigned int first = node.leftOrFirst, second = node.leftOrFirst + 1;
+        float tFirst = intersectRay(origin, inverseDirection, closest, nodes[first].min, nodes[first].max);
+        float tSecond = intersectRay(origin, inverseDirection, closest, nodes[second].min, nodes[second].max);
+        if (tSecond >= 0.0f && (tFirst < 0.0f || tSecond < tFirst))
+        {
+            std::swap(first, second);
+            std::swap(tFirst, tSecond);
+        }
+        if (tSecond >= 0.0f)
+        {
+            stack[top++] = second;
+        }
+        if (tFirst >= 0.0f)
+        {
+            stack[top++] = first;
+        }
+    }
+
+    if (found)
+    {
+        distance = closest;
+    }
+    return found;
+}
+
+float BVH::sahCost() const
+{
+    if (nodes.empty())
+    {
+        return 0.0f;
+    }
+    // Probability of visiting a node ~ its area relative to the root's
+    float cost = 0.0f;
+    for (unsigned int i = 0; i < nodes.size(); i++)
+    {
+        float area = surfaceArea(nodes[i].min, nodes[i].max);
+        cost += area * (nodes[i].count > 0 ? nodes[i].count : 1);
+    }
+    return cost / surfaceArea(nodes[0].min, nodes[0].max);
+}
+
+unsigned int BVH::nodeDepth(unsigned int nodeIndex) const
+{
+    const BVHNode &node = nodes[nodeIndex];
+    if (node.count > 0)
+    {
+        return 1;
+    }
+    return 1 + std::max(nodeDepth(node.leftOrFirst), nodeDepth(node.leftOrFirst + 1));
+}
+
+unsigned int BVH::depth() const
+{
+    return nodes.empty() ? 0 : nodeDepth(0);
+}
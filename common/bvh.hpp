@@ -0,0 +1,76 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+// A node of the flattened tree, 32 bytes. The two children of an internal
+// node are next to each other in the array, so one index is enough.
+struct BVHNode
+{
+    glm::vec3 min;
+    unsigned int leftOrFirst; // internal node : index of the left child, the right one follows it
+                              // leaf : first entry of its primitives in the primitive index array
+    glm::vec3 max;
+    unsigned int count; // 0 for internal nodes, number of primitives for leaves
+};
+
+// Bounding volume hierarchy over the boxes of a BoundingBoxes (see
+// culling.hpp), stored as a flat array of nodes.
+//
+// build() uses the surface area heuristic with binning, for static content.
+// When instances move, update their boxes and call refit(), which keeps the
+// topology and only grows or shrinks the nodes, then rotate(), which swaps
+// subtrees wherever it makes the nodes smaller, so that the tree does not
+// degrade too much before the next full build.
+//
+// The BVH keeps a pointer to the boxes : they must outlive it, and must not
+// be resized without building again.
+class BVH
+{
+  public:
+    static const unsigned int MaxDepth = 64;
+
+    BVH();
+
+    void build(const BoundingBoxes &boxes, unsigned int maxLeafSize = 4);
+    void refit();
+    // Returns how many rotations were done
+    unsigned int rotate();
+
+    // Same result as cullBoxes (culling.hpp) but in tree order, skipping the
+    // planes that a node is already completely inside of, and every test
+    // below a node that is completely inside the frustum.
+    void cullFrustum(const Frustum &frustum, std::vector<unsigned int> &visible) const;
+
+    // Boxes that overlap the sphere / the box
+    void querySphere(const glm::vec3 &center, float radius, std::vector<unsigned int> &result) const;
+    void queryBox(const glm::vec3 &min, const glm::vec3 &max, std::vector<unsigned int> &result) const;
+
+    // Closest box hit by the ray (direction need not be normalized ; distances
+    // are in multiples of it), closer than maxDistance. A ray that starts inside
+    // a box hits it at distance 0.
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, unsigned int &hit,
+                 float &distance) const;
+
+    // Expected cost of a ray traversal relative to a single box test, the
+    // quantity that the SAH build minimizes. Lower is better.
+    float sahCost() const;
+
+    unsigned int nodeCount() const
+    {
+        return nodes.size();
+    }
+    unsigned int depth() const;
+
+  private:
+    void computeBounds(unsigned int nodeIndex);
+    void refitNode(unsigned int nodeIndex);
+    unsigned int rotateNode(unsigned int nodeIndex, unsigned int depth, std::vector<unsigned char> &heights,
+                            unsigned int &rotations);
+    unsigned int nodeDepth(unsigned int nodeIndex) const;
+
+    const BoundingBoxes *boxes;
+    unsigned int maxLeafSize;
+    std::vector<BVHNode> nodes;
+    std::vector<unsigned int> primitives; // indices in 'boxes', in leaf order
+};
+
+#endif
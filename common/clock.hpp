@@ -0,0 +1,13 @@
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <chrono>
+
+// Seconds on std::chrono::steady_clock, from an arbitrary origin. The clock of every time measured in common/ : it
+// needs no glfwInit(), so it runs in the headless benchmarks too, and it can be read from any thread.
+inline double clockTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
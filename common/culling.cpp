@@ -0,0 +1,429 @@
+#include <math.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX__)
+#define CULLING_AVX
+#include <immintrin.h>
+#endif
+
+#include "culling.hpp"
+
+Frustum extractFrustumPlanes(const glm::mat4 &viewProjection)
+{
+    // glm is column-major : row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+    {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // left
+    frustum.planes[1] = rows[3] - rows[0]; // right
+    frustum.planes[2] = rows[3] + rows[1]; // bottom
+    frustum.planes[3] = rows[3] - rows[1]; // top
+    frustum.planes[4] = rows[3] + rows[2]; // near
+    frustum.planes[5] = rows[3] - rows[2]; // far
+
+    // Normalize, so that the distances can be compared to a radius
+    for (int i = 0; i < 6; i++)
+    {
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+    }
+    return frustum;
+}
+
+void BoundingSpheres::resize(unsigned int count)
+{
+    centerX.resize(count);
+    centerY.resize(count);
+    centerZ.resize(count);
+    radius.resize(count);
+}
+
+void BoundingSpheres::set(unsigned int i, const glm::vec3 &center, float r)
+{
+    centerX[i] = center.x;
+    centerY[i] = center.y;
+    centerZ[i] = center.z;
+    radius[i] = r;
+}
+
+void BoundingBoxes::resize(unsigned int count)
+{
+    minX.resize(count);
+    minY.resize(count);
+    minZ.resize(count);
+    maxX.resize(count);
+    maxY.resize(count);
+    maxZ.resize(count);
+}
+
+void BoundingBoxes::set(unsigned int i, const glm::vec3 &min, const glm::vec3 &max)
+{
+    minX[i] = min.x;
+    minY[i] = min.y;
+    minZ[i] = min.z;
+    maxX[i] = max.x;
+    maxY[i] = max.y;
+    maxZ[i] = max.z;
+}
+
+void computeBoundingBox(const std::vector<glm::vec3> &vertices, glm::vec3 &min, glm::vec3 &max)
+{
+    min = max = vertices.empty() ? glm::vec3(0.0f) : vertices[0];
+    for (unsigned int i = 1; i < vertices.size(); i++)
+    {
+        min = glm::min(min, vertices[i]);
+        max = glm::max(max, vertices[i]);
+    }
+}
+
+void computeBoundingSphere(const std::vector<glm::vec3> &vertices, glm::vec3 &center, float &radius)
+{
+    // Centered on the bounding box : not the smallest sphere, but close enough for culling
+    glm::vec3 min, max;
+    computeBoundingBox(vertices, min, max);
+    center = 0.5f * (min + max);
+    radius = 0.0f;
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        radius = glm::max(radius, glm::length(vertices[i] - center));
+    }
+}
+
+// The scalar tests. The SIMD kernels do exactly the same operations in the
+// same order, so that they give exactly the same answers.
+
+static inline bool sphereVisible(const Frustum &frustum, float x, float y, float z, float r)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        float distance = plane.x * x + plane.y * y + plane.z * z + plane.w;
+        if (distance + r < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline bool boxVisible(const Frustum &frustum, float minX, float minY, float minZ, float maxX, float maxY,
+                              float maxZ)
+{
+    float x = (minX + maxX) * 0.5f;
+    float y = (minY + maxY) * 0.5f;
+    float z = (minZ + maxZ) * 0.5f;
+    float extentX = (maxX - minX) * 0.5f;
+    float extentY = (maxY - minY) * 0.5f;
+    float extentZ = (maxZ - minZ) * 0.5f;
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        float distance = plane.x * x + plane.y * y + plane.z * z + plane.w;
+        // Projection of the half-diagonal that goes the furthest along the normal
+        float reach = fabsf(plane.x) * extentX + fabsf(plane.y) * extentY + fabsf(plane.z) * extentZ;
+        if (distance + reach < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned int cullSpheresScalar(const Frustum &frustum, const BoundingSpheres &spheres,
+                               std::vector<unsigned int> &visible)
+{
+    unsigned int count = 0;
+    unsigned int n = spheres.size();
+    visible.resize(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (sphereVisible(frustum, spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i], spheres.radius[i]))
+        {
+            visible[count++] = i;
+        }
+    }
+    visible.resize(count);
+    return count;
+}
+
+unsigned int cullBoxesScalar(const Frustum &frustum, const BoundingBoxes &boxes, std::vector<unsigned int> &visible)
+{
+    unsigned int count = 0;
+    unsigned int n = boxes.size();
+    visible.resize(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (boxVisible(frustum, boxes.minX[i], boxes.minY[i], boxes.minZ[i], boxes.maxX[i], boxes.maxY[i],
+                       boxes.maxZ[i]))
+        {
+            visible[count++] = i;
+        }
+    }
+    visible.resize(count);
+    return count;
+}
+
+// Writes the index of every lane, but only advances past the visible ones :
+// no branch to mispredict. 'out' must have room for all the lanes.
+static inline unsigned int compact(unsigned int *out, unsigned int count, unsigned int first, int mask, int lanes)
+{
+    for (int lane = 0; lane < lanes; lane++)
+    {
+        out[count] = first + lane;
+        count += (mask >> lane) & 1;
+    }
+    return count;
+}
+
+#ifdef CULLING_SSE
+
+struct SSEPlanes
+{
+    __m128 x[6], y[6], z[6], w[6];
+    __m128 absX[6], absY[6], absZ[6];
+};
+
+static void broadcastPlanes(const Frustum &frustum, SSEPlanes &planes)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        planes.x[p] = _mm_set1_ps(plane.x);
+        planes.y[p] = _mm_set1_ps(plane.y);
+        planes.z[p] = _mm_set1_ps(plane.z);
+        planes.w[p] = _mm_set1_ps(plane.w);
+        planes.absX[p] = _mm_set1_ps(fabsf(plane.x));
+        planes.absY[p] = _mm_set1_ps(fabsf(plane.y));
+        planes.absZ[p] = _mm_set1_ps(fabsf(plane.z));
+    }
+}
+
+// Bit i is set when instance i of the 4 is visible
+static inline int spheresVisible4(const SSEPlanes &planes, __m128 x, __m128 y, __m128 z, __m128 r)
+{
+    __m128 zero = _mm_setzero_ps();
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++)
+    {
+        __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[p], x), _mm_mul_ps(planes.y[p], y)), _mm_mul_ps(planes.z[p], z)),
+            planes.w[p]);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+    }
+    return _mm_movemask_ps(inside);
+}
+
+static inline int boxesVisible4(const SSEPlanes &planes, __m128 minX, __m128 minY, __m128 minZ, __m128 maxX,
+                                __m128 maxY, __m128 maxZ)
+{
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 x = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+    __m128 y = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+    __m128 z = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+    __m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+    __m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+    __m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++)
+    {
+        __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[p], x), _mm_mul_ps(planes.y[p], y)), _mm_mul_ps(planes.z[p], z)),
+            planes.w[p]);
+        __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.absX[p], extentX), _mm_mul_ps(planes.absY[p], extentY)),
+                                  _mm_mul_ps(planes.absZ[p], extentZ));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+    }
+    return _mm_movemask_ps(inside);
+}
+
+#endif
+
+#ifdef CULLING_AVX
+
+struct AVXPlanes
+{
+    __m256 x[6], y[6], z[6], w[6];
+    __m256 absX[6], absY[6], absZ[6];
+};
+
+static void broadcastPlanes(const Frustum &frustum, AVXPlanes &planes)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        planes.x[p] = _mm256_set1_ps(plane.x);
+        planes.y[p] = _mm256_set1_ps(plane.y);
+        planes.z[p] = _mm256_set1_ps(plane.z);
+        planes.w[p] = _mm256_set1_ps(plane.w);
+        planes.absX[p] = _mm256_set1_ps(fabsf(plane.x));
+        planes.absY[p] = _mm256_set1_ps(fabsf(plane.y));
+        planes.absZ[p] = _mm256_set1_ps(fabsf(plane.z));
+    }
+}
+
+static inline int spheresVisible8(const AVXPlanes &planes, __m256 x, __m256 y, __m256 z, __m256 r)
+{
+    __m256 zero = _mm256_setzero_ps();
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+    for (int p = 0; p < 6; p++)
+    {
+        __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes.x[p], x),
+                                                                    _mm256_mul_ps(planes.y[p], y)),
+                                                      _mm256_mul_ps(planes.z[p], z)),
+                                        planes.w[p]);
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_GE_OQ));
+    }
+    return _mm256_movemask_ps(inside);
+}
+
+static inline int boxesVisible8(const AVXPlanes &planes, __m256 minX, __m256 minY, __m256 minZ, __m256 maxX,
+                                __m256 maxY, __m256 maxZ)
+{
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256 x = _mm256_mul_ps(_mm256_add_ps(minX, maxX), half);
+    __m256 y = _mm256_mul_ps(_mm256_add_ps(minY, maxY), half);
+    __m256 z = _mm256_mul_ps(_mm256_add_ps(minZ, maxZ), half);
+    __m256 extentX = _mm256_mul_ps(_mm256_sub_ps(maxX, minX), half);
+    __m256 extentY = _mm256_mul_ps(_mm256_sub_ps(maxY, minY), half);
+    __m256 extentZ = _mm256_mul_ps(_mm256_sub_ps(maxZ, minZ), half);
+
+    __m256 zero = _mm256_setzero_ps();
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+    for (int p = 0; p < 6; p++)
+    {
+        __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes.x[p], x),
+                                                                    _mm256_mul_ps(planes.y[p], y)),
+                                                      _mm256_mul_ps(planes.z[p], z)),
+                                        planes.w[p]);
+        __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes.absX[p], extentX),
+                                                   _mm256_mul_ps(planes.absY[p], extentY)),
+                                     _mm256_mul_ps(planes.absZ[p], extentZ));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+    }
+    return _mm256_movemask_ps(inside);
+}
+
+#endif
+
+unsigned int cullSpheres(const Frustum &frustum, const BoundingSpheres &spheres, std::vector<unsigned int> &visible)
+{
+    unsigned int n = spheres.size();
+    visible.resize(n);
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    const float *cx = &spheres.centerX[0];
+    const float *cy = &spheres.centerY[0];
+    const float *cz = &spheres.centerZ[0];
+    const float *r = &spheres.radius[0];
+    unsigned int *out = &visible[0];
+    unsigned int count = 0;
+    unsigned int i = 0;
+
+#ifdef CULLING_AVX
+    AVXPlanes planes8;
+    broadcastPlanes(frustum, planes8);
+    for (; i + 8 <= n; i += 8)
+    {
+        int mask = spheresVisible8(planes8, _mm256_loadu_ps(cx + i), _mm256_loadu_ps(cy + i), _mm256_loadu_ps(cz + i),
+                                   _mm256_loadu_ps(r + i));
+        count = compact(out, count, i, mask, 8);
+    }
+#endif
+#ifdef CULLING_SSE
+    SSEPlanes planes4;
+    broadcastPlanes(frustum, planes4);
+    for (; i + 4 <= n; i += 4)
+    {
+        int mask = spheresVisible4(planes4, _mm_loadu_ps(cx + i), _mm_loadu_ps(cy + i), _mm_loadu_ps(cz + i),
+                                   _mm_loadu_ps(r + i));
+        count = compact(out, count, i, mask, 4);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if (sphereVisible(frustum, cx[i], cy[i], cz[i], r[i]))
+        {
+            out[count++] = i;
+        }
+    }
+
+    visible.resize(count);
+    return count;
+}
+
+unsigned int cullBoxes(const Frustum &frustum, const BoundingBoxes &boxes, std::vector<unsigned int> &visible)
+{
+    unsigned int n = boxes.size();
+    visible.resize(n);
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    const float *minX = &boxes.minX[0];
+    const float *minY = &boxes.minY[0];
+    const float *minZ = &boxes.minZ[0];
+    const float *maxX = &boxes.maxX[0];
+    const float *maxY = &boxes.maxY[0];
+    const float *maxZ = &boxes.maxZ[0];
+    unsigned int *out = &visible[0];
+    unsigned int count = 0;
+    unsigned int i = 0;
+
+#ifdef CULLING_AVX
+    AVXPlanes planes8;
+    broadcastPlanes(frustum, planes8);
+    for (; i + 8 <= n; i += 8)
+    {
+        int mask = boxesVisible8(planes8, _mm256_loadu_ps(minX + i), _mm256_loadu_ps(minY + i),
+                                 _mm256_loadu_ps(minZ + i), _mm256_loadu_ps(maxX + i), _mm256_loadu_ps(maxY + i),
+                                 _mm256_loadu_ps(maxZ + i));
+        count = compact(out, count, i, mask, 8);
+    }
+#endif
+#ifdef CULLING_SSE
+    SSEPlanes planes4;
+    broadcastPlanes(frustum, planes4);
+    for (; i + 4 <= n; i += 4)
+    {
+        int mask = boxesVisible4(planes4, _mm_loadu_ps(minX + i), _mm_loadu_ps(minY + i), _mm_loadu_ps(minZ + i),
+                                 _mm_loadu_ps(maxX + i), _mm_loadu_ps(maxY + i), _mm_loadu_ps(maxZ + i));
+        count = compact(out, count, i, mask, 4);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if (boxVisible(frustum, minX[i], minY[i], minZ[i], maxX[i], maxY[i], maxZ[i]))
+        {
+            out[count++] = i;
+        }
+    }
+
+    visible.resize(count);
+    return count;
+}
+
+const char *cullingInstructionSet()
+{
+#if defined(CULLING_AVX)
+    return "AVX";
+#elif defined(CULLING_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
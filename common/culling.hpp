@@ -0,0 +1,64 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+// The 6 planes of a view frustum, as (normal, distance) with the normals
+// pointing inside : a point p is inside when dot(normal, p) + distance >= 0
+// for all of them. Order : left, right, bottom, top, near, far.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Planes of the frustum of a projection * view matrix (Gribb & Hartmann), in
+// world space. With a projection * view * model matrix, they are in model space.
+Frustum extractFrustumPlanes(const glm::mat4 &viewProjection);
+
+// Bounding volumes stored as structures of arrays, so that the kernels can
+// load the same coordinate of 4 (SSE) or 8 (AVX) instances at once.
+struct BoundingSpheres
+{
+    std::vector<float> centerX, centerY, centerZ, radius;
+
+    void resize(unsigned int count);
+    void set(unsigned int i, const glm::vec3 &center, float r);
+    unsigned int size() const
+    {
+        return radius.size();
+    }
+};
+
+struct BoundingBoxes
+{
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    void resize(unsigned int count);
+    void set(unsigned int i, const glm::vec3 &min, const glm::vec3 &max);
+    unsigned int size() const
+    {
+        return minX.size();
+    }
+};
+
+// Bounds of a mesh in model space
+void computeBoundingSphere(const std::vector<glm::vec3> &vertices, glm::vec3 &center, float &radius);
+void computeBoundingBox(const std::vector<glm::vec3> &vertices, glm::vec3 &min, glm::vec3 &max);
+
+// Fill 'visible' with the indices, in increasing order, of the spheres /
+// boxes that are at least partly inside the frustum, and return how many there
+// are. The tests are conservative : a volume that straddles a corner of the
+// frustum while being outside of it may be kept.
+//
+// With SSE (any x86-64 compiler), 4 instances are tested per iteration, and 8
+// with AVX (-mavx or /arch:AVX, see USE_AVX in CMakeLists.txt). Other CPUs use
+// the scalar versions, which are also the reference the SIMD ones must match.
+unsigned int cullSpheres(const Frustum &frustum, const BoundingSpheres &spheres, std::vector<unsigned int> &visible);
+unsigned int cullBoxes(const Frustum &frustum, const BoundingBoxes &boxes, std::vector<unsigned int> &visible);
+
+unsigned int cullSpheresScalar(const Frustum &frustum, const BoundingSpheres &spheres,
+                               std::vector<unsigned int> &visible);
+unsigned int cullBoxesScalar(const Frustum &frustum, const BoundingBoxes &boxes, std::vector<unsigned int> &visible);
+
+// "AVX", "SSE" or "scalar"
+const char *cullingInstructionSet();
+
+#endif
@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "clock.hpp"
+#include "framecapture.hpp"
+
+namespace
+{
+void appendBytes(std::vector<unsigned char> &out, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+void appendLittleEndian(std::vector<unsigned char> &out, unsigned int value, unsigned int size)
+{
+    for (unsigned int i = 0; i < size; i++)
+    {
+        out.push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+void appendBigEndian(std::vector<unsigned char> &out, unsigned int value)
+{
+    for (int i = 3; i >= 0; i--)
+    {
+        out.push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+struct Crc32Table
+{
+    unsigned int entries[256];
+
+    Crc32Table()
+    {
+        for (unsigned int n = 0; n < 256; n++)
+        {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++)
+            {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+};
+
+unsigned int crc32(const unsigned char *data, size_t size)
+{
+    static const Crc32Table table; // built once, by whichever thread comes first
+    unsigned int crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void appendPngChunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, size_t size)
+{
+    appendBigEndian(out, (unsigned int)size);
+    size_t start = out.size();
+    appendBytes(out, type, 4);
+    appendBytes(out, data, size);
+    appendBigEndian(out, crc32(&out[start], out.size() - start));
+}
+
+// 24 bits, rows padded to 4 bytes, bottom row first like the pixels
+void encodeBMP(const unsigned char *pixels, int width, int height, std::vector<unsigned char> &out)
+{
+    unsigned int rowSize = (3 * width + 3) & ~3u;
+    unsigned int imageSize = rowSize * height;
+    out.clear();
+    out.reserve(54 + imageSize);
+    out.push_back('B');
+    out.push_back('M');
+    appendLittleEndian(out, 54 + imageSize, 4);
+    appendLittleEndian(out, 0, 4);
+    appendLittleEndian(out, 54, 4); // where the pixels start
+    appendLittleEndian(out, 40, 4); // BITMAPINFOHEADER
+    appendLittleEndian(out, width, 4);
+    appendLittleEndian(out, height, 4);
+    appendLittleEndian(out, 1, 2);  // planes
+    appendLittleEndian(out, 24, 2); // bits per pixel
+    appendLittleEndian(out, 0, 4);  // not compressed
+    appendLittleEndian(out, imageSize, 4);
+    appendLittleEndian(out, 2835, 4); // 72 dpi
+    appendLittleEndian(out, 2835, 4);
+    appendLittleEndian(out, 0, 4);
+    appendLittleEndian(out, 0, 4);
+    size_t start = out.size();
+    out.resize(start + imageSize, 0);
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *in = pixels + 4 * (size_t)width * y;
+        unsigned char *row = &out[start + (size_t)rowSize * y];
+        for (int x = 0; x < width; x++)
+        {
+            row[3 * x + 0] = in[4 * x + 2];
+            row[3 * x + 1] = in[4 * x + 1];
+            row[3 * x + 2] = in[4 * x + 0];
+        }
+    }
+}
+
+// 24 bits, top row first, every row with filter 0, in a zlib stream of stored deflate blocks : encoding is a copy
+void encodePNG(const unsigned char *pixels, int width, int height, std::vector<unsigned char> &out,
+               std::vector<unsigned char> &scratch)
+{
+    size_t rowSize = 1 + 3 * (size_t)width;
+    scratch.resize(rowSize * height);
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *in = pixels + 4 * (size_t)width * (height - 1 - y);
+        unsigned char *row = &scratch[rowSize * y];
+        row[0] = 0;
+        for (int x = 0; x < width; x++)
+        {
+            row[1 + 3 * x + 0] = in[4 * x + 0];
+            row[1 + 3 * x + 1] = in[4 * x + 1];
+            row[1 + 3 * x + 2] = in[4 * x + 2];
+        }
+    }
+
+    std::vector<unsigned char> zlib;
+    const size_t MaxBlock = 65535;
+    zlib.reserve(scratch.size() + 5 * (scratch.size() / MaxBlock + 1) + 6);
+    zlib.push_back(0x78); // deflate, 32K window
+    zlib.push_back(0x01); // no preset dictionary, fastest : (0x78 << 8 | 0x01) % 31 == 0
+    unsigned int a = 1, b = 0;
+    size_t done = 0;
+    do
+    {
+        size_t size = scratch.size() - done < MaxBlock ? scratch.size() - done : MaxBlock;
+        zlib.push_back(done + size == scratch.size() ? 1 : 0); // last block or not, stored
+        appendLittleEndian(zlib, (unsigned int)size, 2);
+        appendLittleEndian(zlib, (unsigned int)~size & 0xFFFF, 2);
+        appendBytes(zlib, &scratch[done], size);
+        for (size_t i = done; i < done + size; i++)
+        {
+            a += scratch[i];
+            b += a;
+            // Reduced at least every 4096 bytes, fewer than the 5552 after which the sums could overflow
+            if ((i & 4095) == 4095)
+            {
+                a %= 65521;
+                b %= 65521;
+            }
+        }
+        a %= 65521;
+        b %= 65521;
+        done += size;
+    } while (done < scratch.size());
+    appendBigEndian(zlib, b << 16 | a);
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    unsigned char header[13] = {0};
+    for (int i = 0; i < 4; i++)
+    {
+        header[i] = (width >> (24 - 8 * i)) & 0xFF;
+        header[4 + i] = (height >> (24 - 8 * i)) & 0xFF;
+    }
+    header[8] = 8; // bits per channel
+    header[9] = 2; // RGB
+    out.clear();
+    out.reserve(zlib.size() + 64);
+    appendBytes(out, signature, sizeof(signature));
+    appendPngChunk(out, "IHDR", header, sizeof(header));
+    appendPngChunk(out, "IDAT", &zlib[0], zlib.size());
+    appendPngChunk(out, "IEND", NULL, 0);
+}
+
+// A "FRAME" of 4:2:0 BT.601 video range YCbCr, top row first, chroma averaged over 2x2 pixels
+void encodeY4M(const unsigned char *pixels, int width, int height, std::vector<unsigned char> &out)
+{
+    int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    size_t lumaSize = (size_t)width * height, chromaSize = (size_t)chromaWidth * chromaHeight;
+    out.resize(6 + lumaSize + 2 * chromaSize);
+    memcpy(&out[0], "FRAME\n", 6);
+    unsigned char *luma = &out[6];
+    unsigned char *cb = luma + lumaSize;
+    unsigned char *cr = cb + chromaSize;
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *in = pixels + 4 * (size_t)width * (height - 1 - y);
+        unsigned char *row = luma + (size_t)width * y;
+        for (int x = 0; x < width; x++)
+        {
+            int r = in[4 * x], g = in[4 * x + 1], b = in[4 * x + 2];
+            row[x] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+    for (int cy = 0; cy < chromaHeight; cy++)
+    {
+        for (int cx = 0; cx < chromaWidth; cx++)
+        {
+            int r = 0, g = 0, b = 0, count = 0;
+            for (int y = 2 * cy; y < 2 * cy + 2 && y < height; y++)
+            {
+                const unsigned char *in = pixels + 4 * (size_t)width * (height - 1 - y);
+                for (int x = 2 * cx; x < 2 * cx + 2 && x < width; x++)
+                {
+                    r += in[4 * x];
+                    g += in[4 * x + 1];
+                    b += in[4 * x + 2];
+                    count++;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+            cb[(size_t)chromaWidth * cy + cx] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            cr[(size_t)chromaWidth * cy + cx] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+} // namespace
+
+FrameCapture::FrameCapture()
+    : enabled(false), width(0), height(0), format(CaptureBMP), stream(NULL), frame(0), stopping(false)
+{
+    memset(buffers, 0, sizeof(buffers));
+    memset(fences, 0, sizeof(fences));
+    memset(slotFrames, 0, sizeof(slotFrames));
+    memset(&counters, 0, sizeof(counters));
+}
+
+bool FrameCapture::create(int frameWidth, int frameHeight, const char *pathPattern, FrameCaptureFormat fileFormat,
+                          unsigned int framesPerSecond)
+{
+    width = frameWidth;
+    height = frameHeight;
+    format = fileFormat;
+    path.assign(pathPattern, pathPattern + strlen(pathPattern) + 1);
+    if (format == CaptureY4M)
+    {
+        stream = fopen(pathPattern, "wb");
+        if (stream == NULL)
+        {
+            return false;
+        }
+        // C420jpeg : the chroma is centered between the 4 pixels it covers, which is what averaging them gives
+        fprintf(stream, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", width, height, framesPerSecond);
+    }
+
+    glGenBuffers(Latency, buffers);
+    for (unsigned int slot = 0; slot < Latency; slot++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 4 * (GLsizeiptr)width * height, NULL, GL_STREAM_READ);
+        fences[slot] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    frame = 0;
+    stopping = false;
+    memset(&counters, 0, sizeof(counters));
+    enabled = true;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+    return true;
+}
+
+void FrameCapture::destroy()
+{
+    if (!enabled)
+    {
+        return;
+    }
+    // The frames still in the ring, oldest first, none dropped
+    for (unsigned int i = 0; i < Latency; i++)
+    {
+        unsigned int slot = (frame + i) % Latency;
+        if (fences[slot] != 0)
+        {
+            readBack(slot, false);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    writer.join();
+
+    glDeleteBuffers(Latency, buffers);
+    if (stream != NULL)
+    {
+        fclose(stream);
+        stream = NULL;
+    }
+    freePixels.clear();
+    enabled = false;
+}
+
+void FrameCapture::capture()
+{
+    if (!enabled)
+    {
+        return;
+    }
+    double start = clockTime();
+
+    // The buffer of Latency frames ago : read it back before reusing it
+    unsigned int slot = frame % Latency;
+    if (fences[slot] != 0)
+    {
+        readBack(slot, true);
+    }
+
+    // RGBA rows are always 4 byte aligned, whatever GL_PACK_ALIGNMENT is
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slotFrames[slot] = frame;
+    frame++;
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    counters.frames++;
+    counters.captureTime += clockTime() - start;
+}
+
+void FrameCapture::readBack(unsigned int slot, bool mayDrop)
+{
+    double stallTime = 0.0;
+    GLenum status = glClientWaitSync(fences[slot], 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        double start = clockTime();
+        do
+        {
+            status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        } while (status == GL_TIMEOUT_EXPIRED);
+        stallTime = clockTime() - start;
+    }
+    glDeleteSync(fences[slot]);
+    fences[slot] = 0;
+
+    std::vector<unsigned char> pixels;
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (stallTime > 0.0)
+        {
+            counters.stalls++;
+            counters.stallTime += stallTime;
+        }
+        if (queue.size() >= MaxQueuedFrames)
+        {
+            if (mayDrop)
+            {
+                counters.dropped++;
+                return;
+            }
+            queueChanged.wait(lock, [this]() { return queue.size() < MaxQueuedFrames; });
+        }
+        if (!freePixels.empty())
+        {
+            pixels.swap(freePixels.back());
+            freePixels.pop_back();
+        }
+    }
+
+    size_t size = 4 * (size_t)width * height;
+    pixels.resize(size);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+    const void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data != NULL)
+    {
+        memcpy(&pixels[0], data, size);
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(QueuedFrame());
+        queue.back().number = slotFrames[slot];
+        queue.back().pixels.swap(pixels);
+    }
+    queueChanged.notify_all();
+}
+
+void FrameCapture::writerLoop()
+{
+    QueuedFrame current;
+    std::vector<unsigned char> encoded;
+    std::unique_lock<std::mutex> lock(queueMutex);
+    for (;;)
+    {
+        queueChanged.wait(lock, [this]() { return stopping || !queue.empty(); });
+        if (queue.empty())
+        {
+            return; // stopping, and everything written
+        }
+        current.number = queue.front().number;
+        current.pixels.swap(queue.front().pixels);
+        queue.pop_front();
+        lock.unlock();
+        queueChanged.notify_all(); // room for readBack(), when it waits
+
+        double start = clockTime();
+        writeFrame(current, encoded);
+        double writeTime = clockTime() - start;
+
+        lock.lock();
+        counters.written++;
+        counters.writeTime += writeTime;
+        counters.bytes += encoded.size();
+        freePixels.push_back(std::vector<unsigned char>());
+        freePixels.back().swap(current.pixels);
+    }
+}
+
+void FrameCapture::writeFrame(const QueuedFrame &frame, std::vector<unsigned char> &encoded)
+{
+    static thread_local std::vector<unsigned char> scratch; // the PNG rows, kept between frames
+    const unsigned char *pixels = &frame.pixels[0];
+    if (format == CaptureY4M)
+    {
+        encodeY4M(pixels, width, height, encoded);
+        fwrite(&encoded[0], 1, encoded.size(), stream);
+        return;
+    }
+
+    if (format == CapturePNG)
+    {
+        encodePNG(pixels, width, height, encoded, scratch);
+    }
+    else
+    {
+        encodeBMP(pixels, width, height, encoded);
+    }
+    char name[1024];
+    snprintf(name, sizeof(name), &path[0], frame.number);
+    FILE *file = fopen(name, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to write %s\n", name);
+        encoded.clear();
+        return;
+    }
+    fwrite(&encoded[0], 1, encoded.size(), file);
+    fclose(file);
+}
+
+FrameCaptureStats FrameCapture::stats()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return counters;
+}
@@ -0,0 +1,105 @@
+#ifndef FRAMECAPTURE_HPP
+#define FRAMECAPTURE_HPP
+
+#include <stdio.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum FrameCaptureFormat
+{
+    CaptureBMP, // one file per frame, 24 bits
+    CapturePNG, // one file per frame, 24 bits, not compressed : a PNG any viewer reads, written at BMP speed
+    CaptureY4M  // every frame in one YUV4MPEG2 file, 4:2:0, for ffmpeg and video players
+};
+
+struct FrameCaptureStats
+{
+    unsigned int frames;       // calls to capture()
+    unsigned int written;      // frames the writer thread wrote
+    unsigned int dropped;      // frames not written because the writer was too far behind
+    unsigned int stalls;       // times capture() found the readback of Latency frames ago not done yet
+    double captureTime;        // in seconds, spent in capture() on the GL thread, stalls included
+    double stallTime;          // in seconds, waiting for those readbacks
+    double writeTime;          // in seconds, spent encoding and writing on the writer thread
+    unsigned long long bytes;  // written to the files
+};
+
+// Captures the frames of the default framebuffer, without stalling the GL thread for them.
+//
+// capture() starts a glReadPixels into a pixel pack buffer : one of a ring of Latency buffers, each with a fence.
+// The pixels come back Latency frames later, when the buffer comes around again : by then the GPU is done with
+// them, and mapping the buffer costs a copy, not a wait. The copy goes to a queue, and a thread encodes and writes
+// the frames in order, off the GL thread. When MaxQueuedFrames are already waiting in the queue, the frame is
+// dropped rather than slowing the rendering down : its number is skipped in the file names.
+//
+// Any framebuffer size works. 'pathPattern' is a printf() pattern with the number of the frame for BMP and PNG
+// ("capture/frame%05u.png"), the name of the file for Y4M.
+//
+// Typical use :
+//     capture.create(1024, 768, "frame%05u.bmp", CaptureBMP);
+//     do {
+//         ... draw ...
+//         capture.capture();
+//         glfwSwapBuffers(window);
+//     } while (...);
+//     capture.destroy(); // reads the last frames back, and waits for the writer
+class FrameCapture
+{
+  public:
+    static const unsigned int Latency = 3;
+    static const unsigned int MaxQueuedFrames = 8;
+
+    FrameCapture();
+
+    // Needs GL 3.2 for the fences. Returns false when the Y4M file cannot be opened.
+    bool create(int frameWidth, int frameHeight, const char *pathPattern, FrameCaptureFormat fileFormat,
+                unsigned int framesPerSecond = 30);
+    void destroy();
+
+    // Call when the frame is drawn, before swapping the buffers. Binds 0 to GL_PIXEL_PACK_BUFFER.
+    void capture();
+
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+    // Takes the writer lock : cheap, but not free
+    FrameCaptureStats stats();
+
+  private:
+    struct QueuedFrame
+    {
+        unsigned int number;
+        std::vector<unsigned char> pixels; // RGBA, bottom row first
+    };
+
+    // Queues the frame in the buffer, or drops it when the queue is full and 'mayDrop'
+    void readBack(unsigned int slot, bool mayDrop);
+    void writerLoop();
+    void writeFrame(const QueuedFrame &frame, std::vector<unsigned char> &encoded);
+
+    bool enabled;
+    int width, height;
+    FrameCaptureFormat format;
+    std::vector<char> path;
+    FILE *stream; // Y4M
+
+    GLuint buffers[Latency];
+    GLsync fences[Latency];
+    unsigned int slotFrames[Latency]; // the frame read into each buffer
+    unsigned int frame;
+
+    std::thread writer;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<QueuedFrame> queue;
+    std::vector<std::vector<unsigned char> > freePixels; // reused, so that a frame costs no allocation
+    bool stopping;
+    FrameCaptureStats counters;
+};
+
+#endif
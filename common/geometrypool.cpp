@@ -0,0 +1,307 @@
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "geometrypool.hpp"
+#include "glstate.hpp"
+#include "instancing.hpp"
+
+void OffsetAllocator::reset(unsigned int size)
+{
+    freeRanges.clear();
+    if (size > 0)
+    {
+        Range all = {0, size};
+        freeRanges.push_back(all);
+    }
+}
+
+unsigned int OffsetAllocator::allocate(unsigned int size)
+{
+    for (unsigned int i = 0; i < freeRanges.size(); i++)
+    {
+        Range &range = freeRanges[i];
+        if (range.size < size)
+        {
+            continue;
+        }
+        unsigned int offset = range.offset;
+        range.offset += size;
+        range.size -= size;
+        if (range.size == 0)
+        {
+            freeRanges.erase(freeRanges.begin() + i);
+        }
+        return offset;
+    }
+    return Invalid;
+}
+
+void OffsetAllocator::release(unsigned int offset, unsigned int size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    // First free range after the released one
+    unsigned int next = 0;
+    while (next < freeRanges.size() && freeRanges[next].offset < offset)
+    {
+        next++;
+    }
+
+    bool mergeBefore = next > 0 && freeRanges[next - 1].offset + freeRanges[next - 1].size == offset;
+    bool mergeAfter = next < freeRanges.size() && offset + size == freeRanges[next].offset;
+
+    if (mergeBefore && mergeAfter)
+    {
+        freeRanges[next - 1].size += size + freeRanges[next].size;
+        freeRanges.erase(freeRanges.begin() + next);
+    }
+    else if (mergeBefore)
+    {
+        freeRanges[next - 1].size += size;
+    }
+    else if (mergeAfter)
+    {
+        freeRanges[next].offset = offset;
+        freeRanges[next].size += size;
+    }
+    else
+    {
+        Range range = {offset, size};
+        freeRanges.insert(freeRanges.begin() + next, range);
+    }
+}
+
+unsigned int OffsetAllocator::freeSpace() const
+{
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < freeRanges.size(); i++)
+    {
+        total += freeRanges[i].size;
+    }
+    return total;
+}
+
+unsigned int OffsetAllocator::largestFreeRange() const
+{
+    unsigned int largest = 0;
+    for (unsigned int i = 0; i < freeRanges.size(); i++)
+    {
+        if (freeRanges[i].size > largest)
+        {
+            largest = freeRanges[i].size;
+        }
+    }
+    return largest;
+}
+
+GeometryPool::GeometryPool() : vertexArrayID(0), vertexbuffer(0), uvbuffer(0), normalbuffer(0), elementbuffer(0)
+{
+}
+
+void GeometryPool::create(unsigned int maxVertices, unsigned int maxIndices)
+{
+    vertexSpace.reset(maxVertices);
+    indexSpace.reset(maxIndices);
+
+    glGenVertexArrays(1, &vertexArrayID);
+    glBindVertexArray(vertexArrayID);
+
+    // Storage only : the meshes are copied in by addMesh
+    glGenBuffers(1, &vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    glGenBuffers(1, &uvbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+    glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(glm::vec2), NULL, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    glGenBuffers(1, &normalbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+    glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    glGenBuffers(1, &elementbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, maxIndices * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+}
+
+bool GeometryPool::addMesh(const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs,
+                           const std::vector<glm::vec3> &normals, const std::vector<unsigned short> &indices,
+                           PoolMesh &mesh)
+{
+    std::vector<unsigned int> wideIndices(indices.begin(), indices.end());
+    return addMesh(&vertices[0], &uvs[0], &normals[0], vertices.size(), &wideIndices[0], wideIndices.size(), mesh);
+}
+
+bool GeometryPool::addMesh(const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals,
+                           unsigned int vertexCount, const unsigned int *indices, unsigned int indexCount,
+                           PoolMesh &mesh)
+{
+    unsigned int baseVertex = vertexSpace.allocate(vertexCount);
+    if (baseVertex == OffsetAllocator::Invalid)
+    {
+        return false;
+    }
+    unsigned int firstIndex = indexSpace.allocate(indexCount);
+    if (firstIndex == OffsetAllocator::Invalid)
+    {
+        vertexSpace.release(baseVertex, vertexCount);
+        return false;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, baseVertex * sizeof(glm::vec3), vertexCount * sizeof(glm::vec3), vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, baseVertex * sizeof(glm::vec2), vertexCount * sizeof(glm::vec2), uvs);
+    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, baseVertex * sizeof(glm::vec3), vertexCount * sizeof(glm::vec3), normals);
+
+    // GL_ELEMENT_ARRAY_BUFFER would change the binding of whatever VAO is bound
+    glBindBuffer(GL_COPY_WRITE_BUFFER, elementbuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int),
+                    indices);
+
+    mesh.firstIndex = firstIndex;
+    mesh.indexCount = indexCount;
+    mesh.baseVertex = baseVertex;
+    mesh.vertexCount = vertexCount;
+    return true;
+}
+
+void GeometryPool::removeMesh(const PoolMesh &mesh)
+{
+    vertexSpace.release(mesh.baseVertex, mesh.vertexCount);
+    indexSpace.release(mesh.firstIndex, mesh.indexCount);
+}
+
+void GeometryPool::destroy()
+{
+    glDeleteBuffers(1, &vertexbuffer);
+    glDeleteBuffers(1, &uvbuffer);
+    glDeleteBuffers(1, &normalbuffer);
+    glDeleteBuffers(1, &elementbuffer);
+    glDeleteVertexArrays(1, &vertexArrayID);
+    vertexArrayID = vertexbuffer = uvbuffer = normalbuffer = elementbuffer = 0;
+    vertexSpace.reset(0);
+    indexSpace.reset(0);
+}
+
+IndirectBatch::IndirectBatch() : indirectBuffer(0), indirectCapacity(0)
+{
+}
+
+void IndirectBatch::create(GLuint instanceLocation)
+{
+    createInstanceBuffer(instances, instanceLocation, 64);
+
+    indirectCapacity = 64;
+    glGenBuffers(1, &indirectBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indirectBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, indirectCapacity * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+}
+
+void IndirectBatch::clear()
+{
+    commands.clear();
+    modelMatrices.clear();
+}
+
+void IndirectBatch::add(const PoolMesh &mesh, const glm::mat4 &model)
+{
+    unsigned int instance = modelMatrices.size();
+    modelMatrices.push_back(model);
+
+    if (!commands.empty())
+    {
+        DrawElementsIndirectCommand &last = commands.back();
+        if (last.firstIndex == mesh.firstIndex && last.baseVertex == (GLint)mesh.baseVertex &&
+            last.baseInstance + last.instanceCount == instance)
+        {
+            last.instanceCount++;
+            return;
+        }
+    }
+
+    DrawElementsIndirectCommand command;
+    command.count = mesh.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = mesh.firstIndex;
+    command.baseVertex = mesh.baseVertex;
+    command.baseInstance = instance;
+    commands.push_back(command);
+}
+
+unsigned int IndirectBatch::submit(const GeometryPool &pool, GLStateCache &state)
+{
+    if (commands.empty())
+    {
+        return 0;
+    }
+
+    // Leaves the instance buffer bound through the cache, which enableInstanceAttributes binds again directly
+    uploadInstanceMatrices(instances, modelMatrices, state);
+
+    state.bindVertexArray(pool.vertexArray());
+    enableInstanceAttributes(instances);
+
+    if (GLEW_ARB_multi_draw_indirect)
+    {
+        state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        if (commands.size() > indirectCapacity)
+        {
+            indirectCapacity = commands.size();
+        }
+        // Orphan, like the instance buffer
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCapacity * sizeof(DrawElementsIndirectCommand), NULL,
+                     GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand),
+                        &commands[0]);
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, commands.size(), 0);
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < commands.size(); i++)
+    {
+        const DrawElementsIndirectCommand &command = commands[i];
+        void *firstIndex = (void *)(command.firstIndex * sizeof(unsigned int));
+        if (GLEW_ARB_base_instance)
+        {
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, GL_UNSIGNED_INT, firstIndex,
+                                                          command.instanceCount, command.baseVertex,
+                                                          command.baseInstance);
+        }
+        else
+        {
+            if (i > 0)
+            {
+                enableInstanceAttributes(instances, command.baseInstance);
+            }
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT, firstIndex,
+                                              command.instanceCount, command.baseVertex);
+        }
+    }
+    return commands.size();
+}
+
+void IndirectBatch::destroy()
+{
+    deleteInstanceBuffer(instances);
+    glDeleteBuffers(1, &indirectBuffer);
+    indirectBuffer = 0;
+    indirectCapacity = 0;
+    clear();
+}
@@ -0,0 +1,130 @@
+#ifndef GEOMETRYPOOL_HPP
+#define GEOMETRYPOOL_HPP
+
+#include "instancing.hpp"
+
+class GLStateCache;
+
+// Hands out ranges [offset, offset + size) of a space of a given size.
+// First fit; freed ranges are merged with their free neighbours.
+class OffsetAllocator
+{
+  public:
+    static const unsigned int Invalid = ~0u;
+
+    void reset(unsigned int size);
+    // Returns Invalid if no free range is large enough
+    unsigned int allocate(unsigned int size);
+    void release(unsigned int offset, unsigned int size);
+
+    unsigned int freeSpace() const;
+    unsigned int largestFreeRange() const;
+
+  private:
+    struct Range
+    {
+        unsigned int offset;
+        unsigned int size;
+    };
+    std::vector<Range> freeRanges; // sorted by offset
+};
+
+// Where a mesh lives in a GeometryPool
+struct PoolMesh
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    unsigned int baseVertex;
+    unsigned int vertexCount;
+};
+
+// Layout fixed by GL for glDrawElementsIndirect / glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// A few large buffers shared by many meshes, with one VAO for all of them :
+//  - location 0 : vertex position (vec3)
+//  - location 1 : UV (vec2)
+//  - location 2 : normal (vec3)
+// and 32-bit indices, relative to the first vertex of their mesh.
+// Any mesh of the pool can then be drawn without binding anything else, which
+// is what lets a whole list of them go out in a single multi-draw.
+class GeometryPool
+{
+  public:
+    GeometryPool();
+
+    void create(unsigned int maxVertices, unsigned int maxIndices);
+
+    // Both return false, and leave 'mesh' alone, when the pool is full
+    bool addMesh(const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs,
+                 const std::vector<glm::vec3> &normals, const std::vector<unsigned short> &indices, PoolMesh &mesh);
+    bool addMesh(const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals, unsigned int vertexCount,
+                 const unsigned int *indices, unsigned int indexCount, PoolMesh &mesh);
+    // The space can be reused right away : don't remove a mesh that queued draws still use
+    void removeMesh(const PoolMesh &mesh);
+
+    void destroy();
+
+    GLuint vertexArray() const
+    {
+        return vertexArrayID;
+    }
+
+  private:
+    GLuint vertexArrayID;
+    GLuint vertexbuffer;
+    GLuint uvbuffer;
+    GLuint normalbuffer;
+    GLuint elementbuffer;
+    OffsetAllocator vertexSpace;
+    OffsetAllocator indexSpace;
+};
+
+// The draws of one state bucket (same program, textures and render state),
+// as an array of DrawElementsIndirectCommand plus one model matrix per
+// instance. Consecutive draws of the same mesh are merged into one command.
+//
+// With GL_ARB_multi_draw_indirect (GL 4.3) the whole batch is a single
+// glMultiDrawElementsIndirect. Otherwise every command is a draw call of its
+// own : glDrawElementsInstancedBaseVertexBaseInstance with GL 4.2, or, with
+// only GL 3.3, glDrawElementsInstancedBaseVertex after moving the instance
+// attributes to the first matrix of the command.
+class IndirectBatch
+{
+  public:
+    IndirectBatch();
+
+    // The model matrix and its normal matrix are read by the shader as
+    // InstanceMatrices (instancing.hpp) from instanceLocation on
+    void create(GLuint instanceLocation);
+
+    void clear();
+    void add(const PoolMesh &mesh, const glm::mat4 &model);
+
+    // Uploads the commands and matrices, and draws. Returns the number of
+    // draw calls that it took.
+    unsigned int submit(const GeometryPool &pool, GLStateCache &state);
+
+    void destroy();
+
+    unsigned int commandCount() const
+    {
+        return commands.size();
+    }
+
+  private:
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<glm::mat4> modelMatrices;
+    InstanceBuffer instances;
+    GLuint indirectBuffer;
+    unsigned int indirectCapacity; // in commands
+};
+
+#endif
@@ -0,0 +1,380 @@
+#include <GL/glew.h>
+
+#include "glstate.hpp"
+
+// Value of any shadowed name or enum we know nothing about
+static const GLuint Unknown = ~0u;
+
+// Wrappers around the real entry points. GLEW's function pointers are only
+// valid after glewInit(), and don't have the same calling convention on Win32.
+static void realUseProgram(GLuint program)
+{
+    glUseProgram(program);
+}
+static void realActiveTexture(GLenum unit)
+{
+    glActiveTexture(unit);
+}
+static void realBindTexture(GLenum target, GLuint texture)
+{
+    glBindTexture(target, texture);
+}
+static void realBindBuffer(GLenum target, GLuint buffer)
+{
+    glBindBuffer(target, buffer);
+}
+static void realBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    glBindBufferBase(target, index, buffer);
+}
+static void realBindVertexArray(GLuint vertexArray)
+{
+    glBindVertexArray(vertexArray);
+}
+static void realEnable(GLenum capability)
+{
+    glEnable(capability);
+}
+static void realDisable(GLenum capability)
+{
+    glDisable(capability);
+}
+static void realBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    glBlendFunc(sfactor, dfactor);
+}
+static void realDepthFunc(GLenum func)
+{
+    glDepthFunc(func);
+}
+static void realDepthMask(GLboolean flag)
+{
+    glDepthMask(flag);
+}
+static void realCullFace(GLenum mode)
+{
+    glCullFace(mode);
+}
+static void realViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    glViewport(x, y, width, height);
+}
+
+GLStateFunctions getDefaultGLStateFunctions()
+{
+    GLStateFunctions functions;
+    functions.useProgram = realUseProgram;
+    functions.activeTexture = realActiveTexture;
+    functions.bindTexture = realBindTexture;
+    functions.bindBuffer = realBindBuffer;
+    functions.bindBufferBase = realBindBufferBase;
+    functions.bindVertexArray = realBindVertexArray;
+    functions.enable = realEnable;
+    functions.disable = realDisable;
+    functions.blendFunc = realBlendFunc;
+    functions.depthFunc = realDepthFunc;
+    functions.depthMask = realDepthMask;
+    functions.cullFace = realCullFace;
+    functions.viewport = realViewport;
+    return functions;
+}
+
+GLStateCache::GLStateCache() : gl(getDefaultGLStateFunctions())
+{
+    invalidate();
+    beginFrame();
+}
+
+GLStateCache::GLStateCache(const GLStateFunctions &functions) : gl(functions)
+{
+    invalidate();
+    beginFrame();
+}
+
+void GLStateCache::invalidate()
+{
+    program = Unknown;
+    activeUnit = Unknown;
+    for (unsigned int unit = 0; unit < MaxTextureUnits; unit++)
+    {
+        for (int target = 0; target < TextureTargetCount; target++)
+        {
+            textures[unit][target] = Unknown;
+        }
+    }
+    for (int target = 0; target < BufferTargetCount; target++)
+    {
+        buffers[target] = Unknown;
+    }
+    vertexArray = Unknown;
+    for (int capability = 0; capability < CapabilityCount; capability++)
+    {
+        capabilities[capability] = -1;
+    }
+    blendSource = blendDestination = Unknown;
+    depthFunction = Unknown;
+    depthWrite = -1;
+    cullFaceMode = Unknown;
+    viewportKnown = false;
+}
+
+void GLStateCache::beginFrame()
+{
+    lastFrame = currentFrame;
+    currentFrame.issued = 0;
+    currentFrame.elided = 0;
+}
+
+int GLStateCache::textureTargetSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+        return Texture2D;
+    case GL_TEXTURE_3D:
+        return Texture3D;
+    case GL_TEXTURE_CUBE_MAP:
+        return TextureCubeMap;
+    case GL_TEXTURE_2D_ARRAY:
+        return Texture2DArray;
+    case GL_TEXTURE_BUFFER:
+        return TextureBuffer;
+    default:
+        return -1;
+    }
+}
+
+int GLStateCache::bufferTargetSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:
+        return ArrayBuffer;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return ElementArrayBuffer;
+    case GL_UNIFORM_BUFFER:
+        return UniformBuffer;
+    case GL_SHADER_STORAGE_BUFFER:
+        return ShaderStorageBuffer;
+    case GL_DRAW_INDIRECT_BUFFER:
+        return DrawIndirectBuffer;
+    case GL_DISPATCH_INDIRECT_BUFFER:
+        return DispatchIndirectBuffer;
+    case GL_PIXEL_PACK_BUFFER:
+        return PixelPackBuffer;
+    case GL_PIXEL_UNPACK_BUFFER:
+        return PixelUnpackBuffer;
+    case GL_COPY_READ_BUFFER:
+        return CopyReadBuffer;
+    case GL_COPY_WRITE_BUFFER:
+        return CopyWriteBuffer;
+    default:
+        return -1;
+    }
+}
+
+int GLStateCache::capabilitySlot(GLenum capability)
+{
+    switch (capability)
+    {
+    case GL_BLEND:
+        return Blend;
+    case GL_CULL_FACE:
+        return CullFace;
+    case GL_DEPTH_TEST:
+        return DepthTest;
+    case GL_SCISSOR_TEST:
+        return ScissorTest;
+    case GL_STENCIL_TEST:
+        return StencilTest;
+    case GL_POLYGON_OFFSET_FILL:
+        return PolygonOffsetFill;
+    case GL_MULTISAMPLE:
+        return Multisample;
+    default:
+        return -1;
+    }
+}
+
+void GLStateCache::useProgram(GLuint newProgram)
+{
+    if (program == newProgram)
+    {
+        elided();
+        return;
+    }
+    gl.useProgram(newProgram);
+    program = newProgram;
+    issued();
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int slot = textureTargetSlot(target);
+    if (slot < 0 || unit >= MaxTextureUnits)
+    {
+        // Not shadowed : always forward, and don't trust the active unit anymore
+        gl.activeTexture(GL_TEXTURE0 + unit);
+        gl.bindTexture(target, texture);
+        activeUnit = unit;
+        issued();
+        issued();
+        return;
+    }
+
+    if (textures[unit][slot] == texture)
+    {
+        elided();
+        return;
+    }
+    if (activeUnit != unit)
+    {
+        gl.activeTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        issued();
+    }
+    gl.bindTexture(target, texture);
+    textures[unit][slot] = texture;
+    issued();
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = bufferTargetSlot(target);
+    if (slot >= 0 && buffers[slot] == buffer)
+    {
+        elided();
+        return;
+    }
+    gl.bindBuffer(target, buffer);
+    if (slot >= 0)
+    {
+        buffers[slot] = buffer;
+    }
+    issued();
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    gl.bindBufferBase(target, index, buffer);
+    int slot = bufferTargetSlot(target);
+    if (slot >= 0)
+    {
+        buffers[slot] = buffer;
+    }
+    issued();
+}
+
+void GLStateCache::bindVertexArray(GLuint newVertexArray)
+{
+    if (vertexArray == newVertexArray)
+    {
+        elided();
+        return;
+    }
+    gl.bindVertexArray(newVertexArray);
+    vertexArray = newVertexArray;
+    // The element array binding is part of the VAO state
+    buffers[ElementArrayBuffer] = Unknown;
+    issued();
+}
+
+void GLStateCache::setCapability(GLenum capability, bool enabled)
+{
+    int slot = capabilitySlot(capability);
+    if (slot >= 0 && capabilities[slot] == (enabled ? 1 : 0))
+    {
+        elided();
+        return;
+    }
+    if (enabled)
+    {
+        gl.enable(capability);
+    }
+    else
+    {
+        gl.disable(capability);
+    }
+    if (slot >= 0)
+    {
+        capabilities[slot] = enabled ? 1 : 0;
+    }
+    issued();
+}
+
+void GLStateCache::enable(GLenum capability)
+{
+    setCapability(capability, true);
+}
+
+void GLStateCache::disable(GLenum capability)
+{
+    setCapability(capability, false);
+}
+
+void GLStateCache::blendFunc(GLenum sfactor, GLenum dfactor)
+{
+    if (blendSource == sfactor && blendDestination == dfactor)
+    {
+        elided();
+        return;
+    }
+    gl.blendFunc(sfactor, dfactor);
+    blendSource = sfactor;
+    blendDestination = dfactor;
+    issued();
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+    if (depthFunction == func)
+    {
+        elided();
+        return;
+    }
+    gl.depthFunc(func);
+    depthFunction = func;
+    issued();
+}
+
+void GLStateCache::depthMask(GLboolean flag)
+{
+    int write = flag ? 1 : 0;
+    if (depthWrite == write)
+    {
+        elided();
+        return;
+    }
+    gl.depthMask(flag);
+    depthWrite = write;
+    issued();
+}
+
+void GLStateCache::cullFace(GLenum mode)
+{
+    if (cullFaceMode == mode)
+    {
+        elided();
+        return;
+    }
+    gl.cullFace(mode);
+    cullFaceMode = mode;
+    issued();
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (viewportKnown && viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width &&
+        viewportRect[3] == height)
+    {
+        elided();
+        return;
+    }
+    gl.viewport(x, y, width, height);
+    viewportRect[0] = x;
+    viewportRect[1] = y;
+    viewportRect[2] = width;
+    viewportRect[3] = height;
+    viewportKnown = true;
+    issued();
+}
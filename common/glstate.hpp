@@ -0,0 +1,147 @@
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+// The GL entry points used by GLStateCache. getDefaultGLStateFunctions() returns
+// the real ones; anything else with the same signatures (a mock that records
+// the calls, for instance) can be used instead, in which case no GL context
+// is needed at all.
+struct GLStateFunctions
+{
+    void (*useProgram)(GLuint program);
+    void (*activeTexture)(GLenum unit);
+    void (*bindTexture)(GLenum target, GLuint texture);
+    void (*bindBuffer)(GLenum target, GLuint buffer);
+    void (*bindBufferBase)(GLenum target, GLuint index, GLuint buffer);
+    void (*bindVertexArray)(GLuint vertexArray);
+    void (*enable)(GLenum capability);
+    void (*disable)(GLenum capability);
+    void (*blendFunc)(GLenum sfactor, GLenum dfactor);
+    void (*depthFunc)(GLenum func);
+    void (*depthMask)(GLboolean flag);
+    void (*cullFace)(GLenum mode);
+    void (*viewport)(GLint x, GLint y, GLsizei width, GLsizei height);
+};
+
+GLStateFunctions getDefaultGLStateFunctions();
+
+struct GLStateCounters
+{
+    unsigned int issued; // calls forwarded to GL
+    unsigned int elided; // calls skipped because they would not have changed anything
+};
+
+// Shadows the bound program, textures, buffers, VAO, and the blend / cull /
+// depth state and viewport, and only forwards the calls that change them.
+//
+// Everything starts as "unknown", so the first call for a given piece of state
+// is always issued. Code that changes the same state directly with gl* calls
+// must call invalidate() afterwards, or the cache will skip calls it should not.
+class GLStateCache
+{
+  public:
+    GLStateCache();
+    explicit GLStateCache(const GLStateFunctions &functions);
+
+    void useProgram(GLuint program);
+    // Makes 'unit' (0, 1, ..., not GL_TEXTURE0 + n) active if needed, then binds
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindBuffer(GLenum target, GLuint buffer);
+    // Indexed bindings are not shadowed, so this is always issued. It binds
+    // the generic target as well, and the shadow of that one is kept up to date.
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void bindVertexArray(GLuint vertexArray);
+
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void blendFunc(GLenum sfactor, GLenum dfactor);
+    void depthFunc(GLenum func);
+    void depthMask(GLboolean flag);
+    void cullFace(GLenum mode);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    // Forget everything that is shadowed
+    void invalidate();
+
+    // Starts counting for a new frame. The counters of the frame that just
+    // ended stay available through lastFrameCounters().
+    void beginFrame();
+    const GLStateCounters &frameCounters() const
+    {
+        return currentFrame;
+    }
+    const GLStateCounters &lastFrameCounters() const
+    {
+        return lastFrame;
+    }
+
+    static const unsigned int MaxTextureUnits = 16;
+
+  private:
+    enum TextureTargetSlot
+    {
+        Texture2D,
+        Texture3D,
+        TextureCubeMap,
+        Texture2DArray,
+        TextureBuffer,
+        TextureTargetCount
+    };
+    enum BufferTargetSlot
+    {
+        ArrayBuffer,
+        ElementArrayBuffer,
+        UniformBuffer,
+        ShaderStorageBuffer,
+        DrawIndirectBuffer,
+        DispatchIndirectBuffer,
+        PixelPackBuffer,
+        PixelUnpackBuffer,
+        CopyReadBuffer,
+        CopyWriteBuffer,
+        BufferTargetCount
+    };
+    enum CapabilitySlot
+    {
+        Blend,
+        CullFace,
+        DepthTest,
+        ScissorTest,
+        StencilTest,
+        PolygonOffsetFill,
+        Multisample,
+        CapabilityCount
+    };
+    static int textureTargetSlot(GLenum target);
+    static int bufferTargetSlot(GLenum target);
+    static int capabilitySlot(GLenum capability);
+
+    void setCapability(GLenum capability, bool enabled);
+    void issued()
+    {
+        currentFrame.issued++;
+    }
+    void elided()
+    {
+        currentFrame.elided++;
+    }
+
+    GLStateFunctions gl;
+
+    GLuint program;
+    GLuint activeUnit;
+    GLuint textures[MaxTextureUnits][TextureTargetCount];
+    GLuint buffers[BufferTargetCount];
+    GLuint vertexArray;
+    int capabilities[CapabilityCount]; // -1 unknown, 0 disabled, 1 enabled
+    GLenum blendSource, blendDestination;
+    GLenum depthFunction;
+    int depthWrite; // -1 unknown
+    GLenum cullFaceMode;
+    GLint viewportRect[4];
+    bool viewportKnown;
+
+    GLStateCounters currentFrame;
+    GLStateCounters lastFrame;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+#include "glstate.hpp"
+#include "gpuculling.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+
+// Must match local_size_x in the compute shader
+static const unsigned int GroupSize = 64;
+
+// Binding points of the shader storage blocks
+enum
+{
+    BoundsBinding,
+    ModelsBinding,
+    VisibleModelsBinding,
+    VisibleIndicesBinding,
+    DrawCommandBinding
+};
+
+// Same layout as the DrawElementsIndirectCommand of geometrypool.hpp
+struct IndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+GpuCuller::GpuCuller()
+    : programID(0), totalInstancesID(0), frustumPlanesID(0), boundsBuffer(0), modelBuffer(0), indexBuffer(0),
+      indirectBuffer(0), instanceCount(0)
+{
+    visible.buffer = 0;
+    visible.capacity = 0;
+    visible.count = 0;
+}
+
+bool GpuCuller::isSupported()
+{
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object);
+}
+
+bool GpuCuller::create(const char *computeShaderPath, GLuint instanceLocation, unsigned int capacity)
+{
+    programID = LoadComputeShader(computeShaderPath);
+    if (programID == 0)
+    {
+        return false;
+    }
+    totalInstancesID = glGetUniformLocation(programID, "totalInstances");
+    frustumPlanesID = glGetUniformLocation(programID, "frustumPlanes");
+
+    glGenBuffers(1, &boundsBuffer);
+    glGenBuffers(1, &modelBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glGenBuffers(1, &indirectBuffer);
+    capacity = capacity > 0 ? capacity : 1;
+    createInstanceBuffer(visible, instanceLocation, capacity);
+    allocate(capacity);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectCommand), NULL, GL_DYNAMIC_DRAW);
+    return true;
+}
+
+void GpuCuller::allocate(unsigned int capacity)
+{
+    visible.capacity = capacity;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, modelBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    // Only the compute shader writes to these two, so they are allocated once per size
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visible.buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(InstanceMatrices), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+}
+
+void GpuCuller::upload(const BoundingSpheres &bounds, const std::vector<glm::mat4> &modelMatrices,
+                       GLStateCache &state)
+{
+    instanceCount = modelMatrices.size();
+    if (instanceCount == 0)
+    {
+        return;
+    }
+    if (instanceCount > visible.capacity)
+    {
+        allocate(instanceCount);
+        state.invalidate(); // allocate() binds buffers behind the cache's back
+    }
+
+    packedBounds.resize(instanceCount);
+    for (unsigned int i = 0; i < instanceCount; i++)
+    {
+        packedBounds[i] = glm::vec4(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.radius[i]);
+    }
+
+    // Orphan the storage of the last frame, like uploadInstanceMatrices
+    state.bindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, visible.capacity * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instanceCount * sizeof(glm::vec4), &packedBounds[0]);
+    state.bindBuffer(GL_SHADER_STORAGE_BUFFER, modelBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, visible.capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instanceCount * sizeof(glm::mat4), &modelMatrices[0]);
+}
+
+void GpuCuller::cull(const Frustum &frustum, const Mesh &mesh, GLStateCache &state)
+{
+    // Draw the whole mesh, 0 instances so far. This is the only thing the CPU writes.
+    IndirectCommand command = {mesh.indexCount(), 0, 0, 0, 0};
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+    if (instanceCount == 0)
+    {
+        return;
+    }
+
+    state.useProgram(programID);
+    glUniform1ui(totalInstancesID, instanceCount);
+    glUniform4fv(frustumPlanesID, 6, &frustum.planes[0][0]);
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, BoundsBinding, boundsBuffer);
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, ModelsBinding, modelBuffer);
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, VisibleModelsBinding, visible.buffer);
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, VisibleIndicesBinding, indexBuffer);
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawCommandBinding, indirectBuffer);
+    glDispatchCompute((instanceCount + GroupSize - 1) / GroupSize, 1, 1);
+
+    // The writes must land before the draw reads the command and the matrices
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::draw(const Mesh &mesh, GLStateCache &state)
+{
+    state.bindVertexArray(mesh.vertexArray());
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glDrawElementsIndirect(GL_TRIANGLES, mesh.indexType(), 0);
+}
+
+unsigned int GpuCuller::readVisibleCount(GLStateCache &state)
+{
+    IndirectCommand command;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+    return command.instanceCount;
+}
+
+void GpuCuller::readVisibleIndices(std::vector<unsigned int> &indices, GLStateCache &state)
+{
+    indices.resize(readVisibleCount(state));
+    if (!indices.empty())
+    {
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, indices.size() * sizeof(GLuint), &indices[0]);
+    }
+}
+
+void GpuCuller::destroy()
+{
+    glDeleteProgram(programID);
+    glDeleteBuffers(1, &boundsBuffer);
+    glDeleteBuffers(1, &modelBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &indirectBuffer);
+    deleteInstanceBuffer(visible);
+    programID = boundsBuffer = modelBuffer = indexBuffer = indirectBuffer = 0;
+    instanceCount = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef GPUCULLING_HPP
+#define GPUCULLING_HPP
+
+#include "instancing.hpp"
+
+struct BoundingSpheres;
+struct Frustum;
+class GLStateCache;
+class Mesh;
+
+// Frustum culling of the instances of one mesh by a compute shader, which
+// packs the visible model matrices, with their normal matrices, into an
+// instance buffer and counts them in the instanceCount of an indirect draw
+// command. The draw then reads the count from GPU memory : nothing comes back
+// to the CPU.
+//
+// Needs GL 4.3 (or GL_ARB_compute_shader and GL_ARB_shader_storage_buffer_object).
+class GpuCuller
+{
+  public:
+    GpuCuller();
+
+    static bool isSupported();
+
+    // The visible matrices are read by the vertex shader as InstanceMatrices
+    // (instancing.hpp) from instanceLocation on. Returns false if the compute
+    // shader did not build.
+    bool create(const char *computeShaderPath, GLuint instanceLocation, unsigned int capacity);
+
+    // World space bounding spheres and model matrices of all the instances
+    void upload(const BoundingSpheres &bounds, const std::vector<glm::mat4> &modelMatrices, GLStateCache &state);
+
+    void cull(const Frustum &frustum, const Mesh &mesh, GLStateCache &state);
+
+    // The VAO of the mesh must have had enableInstanceAttributes(visibleInstances())
+    // recorded in it, and the instanced program must be in use
+    void draw(const Mesh &mesh, GLStateCache &state);
+
+    // For tests only, as they wait for the GPU : the number and the indices
+    // (in an unspecified order) of the instances found visible by the last cull()
+    unsigned int readVisibleCount(GLStateCache &state);
+    void readVisibleIndices(std::vector<unsigned int> &indices, GLStateCache &state);
+
+    const InstanceBuffer &visibleInstances() const
+    {
+        return visible;
+    }
+
+    void destroy();
+
+  private:
+    void allocate(unsigned int capacity);
+
+    GLuint programID;
+    GLuint totalInstancesID;
+    GLuint frustumPlanesID;
+    GLuint boundsBuffer;
+    GLuint modelBuffer;
+    GLuint indexBuffer;
+    GLuint indirectBuffer;
+    InstanceBuffer visible;
+    unsigned int instanceCount; // uploaded by the last call to upload()
+    std::vector<glm::vec4> packedBounds;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include <stddef.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "gpuskinning.hpp"
+#include "skinning.hpp"
+
+void createBoneWeightBuffer(BoneWeightBuffer &weights, GLuint firstLocation, const std::vector<BoneWeights> &vertices)
+{
+    weights.firstLocation = firstLocation;
+    glGenBuffers(1, &weights.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, weights.buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(BoneWeights), vertices.empty() ? NULL : &vertices[0],
+                 GL_STATIC_DRAW);
+
+    // Integers for the indices : glVertexAttribIPointer, not glVertexAttribPointer, which would turn them into floats
+    glEnableVertexAttribArray(firstLocation);
+    glVertexAttribIPointer(firstLocation, 4, GL_UNSIGNED_SHORT, sizeof(BoneWeights),
+                           (void *)offsetof(BoneWeights, bones));
+    glEnableVertexAttribArray(firstLocation + 1);
+    glVertexAttribPointer(firstLocation + 1, 4, GL_FLOAT, GL_FALSE, sizeof(BoneWeights),
+                          (void *)offsetof(BoneWeights, weights));
+}
+
+void deleteBoneWeightBuffer(BoneWeightBuffer &weights)
+{
+    glDeleteBuffers(1, &weights.buffer);
+    weights.buffer = 0;
+}
+
+void createPaletteBuffer(PaletteBuffer &palettes, unsigned int capacity)
+{
+    palettes.capacity = capacity > 0 ? capacity : 1;
+    glGenBuffers(1, &palettes.buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, palettes.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, palettes.capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+
+    glGenTextures(1, &palettes.texture);
+    glBindTexture(GL_TEXTURE_BUFFER, palettes.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palettes.buffer);
+}
+
+void uploadPalettes(PaletteBuffer &palettes, const glm::mat4 *matrices, unsigned int count)
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, palettes.buffer);
+    if (count > palettes.capacity)
+    {
+        palettes.capacity = count;
+    }
+
+    // Orphaned like the instance buffers, so that the draws of the last frame can still read the old palettes
+    glBufferData(GL_TEXTURE_BUFFER, palettes.capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    if (count > 0)
+    {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, count * sizeof(glm::mat4), matrices);
+    }
+}
+
+void bindPalettes(const PaletteBuffer &palettes, GLuint unit)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, palettes.texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void deletePaletteBuffer(PaletteBuffer &palettes)
+{
+    glDeleteTextures(1, &palettes.texture);
+    glDeleteBuffers(1, &palettes.buffer);
+    palettes.texture = 0;
+    palettes.buffer = 0;
+}
@@ -0,0 +1,39 @@
+#ifndef GPUSKINNING_HPP
+#define GPUSKINNING_HPP
+
+struct BoneWeights;
+
+// The bones and weights of every vertex of a mesh (skinning.hpp), stored in a GL_ARRAY_BUFFER and read by the vertex
+// shader as "in uvec4 BoneIndices" at firstLocation and "in vec4 BoneWeights" at firstLocation+1. Like the instance
+// attributes, they are recorded in the VAO bound when the buffer is created.
+struct BoneWeightBuffer
+{
+    GLuint buffer;
+    GLuint firstLocation;
+};
+
+void createBoneWeightBuffer(BoneWeightBuffer &weights, GLuint firstLocation, const std::vector<BoneWeights> &vertices);
+void deleteBoneWeightBuffer(BoneWeightBuffer &weights);
+
+// The palettes of a crowd, one after the other as samplePalettes() writes them, in a texture buffer that
+// StandardShadingSkinned.vertexshader reads as "uniform samplerBuffer BonePalettes" : one RGBA32F texel per column,
+// from 4 * gl_InstanceID * BoneCount. GL 3.3 only promises 65536 texels, 16384 matrices : larger crowds are drawn in
+// several instanced draws.
+struct PaletteBuffer
+{
+    GLuint buffer;
+    GLuint texture;
+    unsigned int capacity; // in matrices
+};
+
+void createPaletteBuffer(PaletteBuffer &palettes, unsigned int capacity);
+
+// Replaces the content of the buffer. Grows the storage if needed.
+void uploadPalettes(PaletteBuffer &palettes, const glm::mat4 *matrices, unsigned int count);
+
+// Binds the texture buffer to 'unit', for the sampler of the program
+void bindPalettes(const PaletteBuffer &palettes, GLuint unit);
+
+void deletePaletteBuffer(PaletteBuffer &palettes);
+
+#endif
@@ -0,0 +1,152 @@
+#include <stddef.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "glstate.hpp"
+#include "instancing.hpp"
+#include "transforms.hpp"
+
+void createInstanceBuffer(InstanceBuffer &instances, GLuint firstLocation, unsigned int capacity)
+{
+    instances.firstLocation = firstLocation;
+    instances.capacity = capacity;
+    instances.count = 0;
+
+    glGenBuffers(1, &instances.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceMatrices), NULL, GL_STREAM_DRAW);
+}
+
+void uploadInstanceMatrices(InstanceBuffer &instances, const std::vector<glm::mat4> &modelMatrices,
+                            GLStateCache &state)
+{
+    instances.count = (unsigned int)modelMatrices.size();
+    if (instances.count == 0)
+    {
+        return;
+    }
+
+    // The normal matrices here, once per instance, and not in the vertex shader
+    instances.staging.resize(instances.count);
+    for (unsigned int i = 0; i < instances.count; i++)
+    {
+        InstanceMatrices &matrices = instances.staging[i];
+        matrices.model = modelMatrices[i];
+        glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(modelMatrices[i])));
+        for (int column = 0; column < 3; column++)
+        {
+            matrices.normal[column] = glm::vec4(normal[column], 0.0f);
+        }
+    }
+
+    state.bindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    if (instances.count > instances.capacity)
+    {
+        instances.capacity = instances.count;
+    }
+
+    // Orphan the previous storage so the driver does not have to wait for the
+    // draws of the last frame to finish before we overwrite it.
+    glBufferData(GL_ARRAY_BUFFER, instances.capacity * sizeof(InstanceMatrices), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.count * sizeof(InstanceMatrices), &instances.staging[0]);
+}
+
+void enableInstanceAttributes(const InstanceBuffer &instances, unsigned int firstInstance)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    for (GLuint column = 0; column < 7; column++)
+    {
+        GLuint location = instances.firstLocation + column;
+        glEnableVertexAttribArray(location);
+        // The columns of the normal matrix are vec4 in the buffer, vec3 in the shader
+        glVertexAttribPointer(location, column < 4 ? 4 : 3, GL_FLOAT, GL_FALSE, sizeof(InstanceMatrices),
+                              (void *)(firstInstance * sizeof(InstanceMatrices) + column * sizeof(glm::vec4)));
+        // Advance once per instance instead of once per vertex
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+void disableInstanceAttributes(const InstanceBuffer &instances)
+{
+    for (GLuint column = 0; column < 7; column++)
+    {
+        GLuint location = instances.firstLocation + column;
+        glVertexAttribDivisor(location, 0);
+        glDisableVertexAttribArray(location);
+    }
+}
+
+void enableInstanceTransformAttributes(const InstanceBuffer &instances, unsigned int firstInstance)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    for (GLuint column = 0; column < 11; column++)
+    {
+        GLuint location = instances.firstLocation + column;
+        glEnableVertexAttribArray(location);
+        // The columns of the normal matrix are vec4 in the buffer, vec3 in the shader
+        glVertexAttribPointer(location, column < 8 ? 4 : 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                              (void *)(firstInstance * sizeof(InstanceTransform) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+void disableInstanceTransformAttributes(const InstanceBuffer &instances)
+{
+    for (GLuint column = 0; column < 11; column++)
+    {
+        GLuint location = instances.firstLocation + column;
+        glVertexAttribDivisor(location, 0);
+        glDisableVertexAttribArray(location);
+    }
+}
+
+void enableCompactInstanceAttributes(const InstanceBuffer &instances, unsigned int firstInstance)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    GLuint location = instances.firstLocation;
+    size_t offset = firstInstance * sizeof(CompactInstance);
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(CompactInstance),
+                          (void *)(offset + offsetof(CompactInstance, rotation)));
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location + 1);
+    glVertexAttribPointer(location + 1, 4, GL_FLOAT, GL_FALSE, sizeof(CompactInstance),
+                          (void *)(offset + offsetof(CompactInstance, position)));
+    glVertexAttribDivisor(location + 1, 1);
+}
+
+void enableQuantizedInstanceAttributes(const InstanceBuffer &instances, unsigned int firstInstance)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    GLuint location = instances.firstLocation;
+    size_t offset = firstInstance * sizeof(QuantizedInstance);
+    glEnableVertexAttribArray(location);
+    // Normalized : the shader reads the shorts divided by 32767
+    glVertexAttribPointer(location, 4, GL_SHORT, GL_TRUE, sizeof(QuantizedInstance),
+                          (void *)(offset + offsetof(QuantizedInstance, rotation)));
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location + 1);
+    glVertexAttribPointer(location + 1, 4, GL_FLOAT, GL_FALSE, sizeof(QuantizedInstance),
+                          (void *)(offset + offsetof(QuantizedInstance, position)));
+    glVertexAttribDivisor(location + 1, 1);
+}
+
+void disableCompactInstanceAttributes(const InstanceBuffer &instances)
+{
+    for (GLuint location = instances.firstLocation; location < instances.firstLocation + 2; location++)
+    {
+        glVertexAttribDivisor(location, 0);
+        glDisableVertexAttribArray(location);
+    }
+}
+
+void deleteInstanceBuffer(InstanceBuffer &instances)
+{
+    glDeleteBuffers(1, &instances.buffer);
+    instances.buffer = 0;
+    instances.capacity = 0;
+    instances.count = 0;
+}
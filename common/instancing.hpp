@@ -0,0 +1,59 @@
+#ifndef INSTANCING_HPP
+#define INSTANCING_HPP
+
+class GLStateCache;
+
+// What the instance buffer holds per instance : the model matrix, and its
+// normal matrix (the inverse transpose of its 3x3), computed once per instance
+// rather than once per vertex. The columns of the normal matrix are vec4, w
+// unused, so that the compute shader of gpuculling.cpp can write it as well.
+struct InstanceMatrices
+{
+    glm::mat4 model;
+    glm::vec4 normal[3];
+};
+
+// One InstanceMatrices per instance, stored in a GL_ARRAY_BUFFER and read by
+// the vertex shader through seven consecutive attributes with a divisor of 1,
+// for "layout(location = N) in mat4 M; layout(location = N+4) in mat3 N;".
+struct InstanceBuffer
+{
+    GLuint buffer;
+    GLuint firstLocation;
+    unsigned int capacity;                 // in instances
+    unsigned int count;                    // instances uploaded by the last call to uploadInstanceMatrices
+    std::vector<InstanceMatrices> staging; // what uploadInstanceMatrices sends to the buffer
+};
+
+void createInstanceBuffer(InstanceBuffer &instances, GLuint firstLocation, unsigned int capacity);
+
+// Replaces the content of the buffer with the model matrices and their normal
+// matrices. Grows the storage if needed. The buffer is bound to
+// GL_ARRAY_BUFFER through 'state', and stays bound.
+void uploadInstanceMatrices(InstanceBuffer &instances, const std::vector<glm::mat4> &modelMatrices,
+                            GLStateCache &state);
+
+// Points the matrix columns at the buffer and sets their divisor.
+// Must be called with the VAO used for drawing bound. Instance 0 of the next
+// draw call reads the matrix at index firstInstance.
+// These bind the buffer to GL_ARRAY_BUFFER directly : in a frame that goes
+// through a GLStateCache, bind it through the cache first, so that it keeps
+// the right binding.
+void enableInstanceAttributes(const InstanceBuffer &instances, unsigned int firstInstance = 0);
+void disableInstanceAttributes(const InstanceBuffer &instances);
+
+// The same, for a buffer of InstanceTransform (transforms.hpp) : the model matrix, the MVP and the normal matrix of
+// every instance, at locations firstLocation to firstLocation+3, +4 to +7 and +8 to +10, for
+// "in mat4 M; in mat4 MVP; in mat3 N;" in the shader.
+void enableInstanceTransformAttributes(const InstanceBuffer &instances, unsigned int firstInstance = 0);
+void disableInstanceTransformAttributes(const InstanceBuffer &instances);
+
+// The same, for a buffer of CompactInstance or QuantizedInstance (transforms.hpp) : the rotation at firstLocation and
+// the position and scale at firstLocation+1, for "in vec4 InstanceRotation; in vec4 InstancePositionScale;"
+void enableCompactInstanceAttributes(const InstanceBuffer &instances, unsigned int firstInstance = 0);
+void enableQuantizedInstanceAttributes(const InstanceBuffer &instances, unsigned int firstInstance = 0);
+void disableCompactInstanceAttributes(const InstanceBuffer &instances);
+
+void deleteInstanceBuffer(InstanceBuffer &instances);
+
+#endif
@@ -0,0 +1,471 @@
+#include <algorithm>
+#include <thread>
+
+#include "jobsystem.hpp"
+
+// Idle threads try this many times to find a job, yielding in between, before they go to sleep
+static const int SpinCount = 64;
+
+// Chase-Lev work-stealing deque, with the memory orderings of Le, Pop, Cohen and Zappa Nardelli, "Correct and
+// Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013). Its capacity is fixed : push() fails when it is full.
+class JobDeque
+{
+  public:
+    static const long long Capacity = 8192;
+
+    JobDeque() : top(0), bottom(0)
+    {
+    }
+
+    // Owner only
+    bool push(Job *job)
+    {
+        long long b = bottom.load(std::memory_order_relaxed);
+        long long t = top.load(std::memory_order_acquire);
+        if (b - t >= Capacity)
+        {
+            return false;
+        }
+        entries[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+        // A release store rather than the paper's release fence and relaxed store : the same on x86, and visible
+        // to ThreadSanitizer, which ignores fences
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only, last in first out
+    Job *pop()
+    {
+        long long b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long long t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            // Empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return NULL;
+        }
+        Job *job = entries[b & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // Last one : race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                job = NULL;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Any thread, first in first out. Can fail when another thread takes the same job.
+    Job *steal()
+    {
+        long long t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long long b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+        {
+            return NULL;
+        }
+        Job *job = entries[t & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return NULL;
+        }
+        return job;
+    }
+
+  private:
+    std::atomic<long long> top;
+    std::atomic<long long> bottom;
+    std::atomic<Job *> entries[Capacity];
+};
+
+struct JobWorker
+{
+    JobSystem *system;
+    unsigned int index;
+    JobDeque deque;
+    Job *jobs; // ring of MaxJobsPerThread jobs
+    unsigned int allocated;
+    unsigned int victim; // where the next steal attempt starts
+    std::thread thread;
+
+    std::atomic<unsigned int> executed;
+    std::atomic<unsigned int> stolen;
+    std::atomic<unsigned int> inlined;
+};
+
+// The worker of the calling thread, NULL on threads that are not part of a JobSystem
+static thread_local JobWorker *threadWorker = NULL;
+
+JobSystem::JobSystem() : mainThreadJobCount(0), pendingJobs(0), sleepingWorkers(0), stopping(false)
+{
+    hooks.jobStarted = NULL;
+    hooks.jobFinished = NULL;
+    hooks.user = NULL;
+}
+
+unsigned int JobSystem::defaultWorkerCount()
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 0;
+}
+
+void JobSystem::create(unsigned int workerThreads)
+{
+    stopping = false;
+    pendingJobs = 0;
+    sleepingWorkers = 0;
+    for (unsigned int i = 0; i <= workerThreads; i++)
+    {
+        JobWorker *worker = new JobWorker;
+        worker->system = this;
+        worker->index = i;
+        worker->jobs = new Job[MaxJobsPerThread];
+        for (unsigned int j = 0; j < MaxJobsPerThread; j++)
+        {
+            worker->jobs[j].unfinished = 0;
+        }
+        worker->allocated = 0;
+        worker->victim = i + 1;
+        worker->executed = 0;
+        worker->stolen = 0;
+        worker->inlined = 0;
+        workers.push_back(worker);
+    }
+    threadWorker = workers[0];
+    for (unsigned int i = 1; i <= workerThreads; i++)
+    {
+        workers[i]->thread = std::thread(&JobSystem::workerLoop, this, workers[i]);
+    }
+}
+
+void JobSystem::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    // All of them first : a thread that is still running may be stealing from any deque
+    for (unsigned int i = 0; i < workers.size(); i++)
+    {
+        if (workers[i]->thread.joinable())
+        {
+            workers[i]->thread.join();
+        }
+    }
+    for (unsigned int i = 0; i < workers.size(); i++)
+    {
+        delete[] workers[i]->jobs;
+        delete workers[i];
+    }
+    workers.clear();
+    mainThreadJobs.clear();
+    mainThreadJobCount = 0;
+    threadWorker = NULL;
+}
+
+JobWorker &JobSystem::currentWorker()
+{
+    // Threads foreign to this system are taken for the main thread
+    JobWorker *worker = threadWorker;
+    return worker != NULL && worker->system == this ? *worker : *workers[0];
+}
+
+Job *JobSystem::allocateJob(void (*function)(Job *), Job *parent)
+{
+    JobWorker &worker = currentWorker();
+
+    // Skip the jobs that are still going (a parent waiting for its children, typically), running a job for every
+    // one skipped : when the ring is full of queued jobs, that is what frees it
+    Job *job = &worker.jobs[worker.allocated++ & (MaxJobsPerThread - 1)];
+    while (job->unfinished.load(std::memory_order_acquire) > 0)
+    {
+        Job *other = findJob(worker);
+        if (other != NULL)
+        {
+            execute(other, worker);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+        job = &worker.jobs[worker.allocated++ & (MaxJobsPerThread - 1)];
+    }
+
+    job->function = function;
+    job->parent = parent;
+    job->name = NULL;
+    job->blockers.store(1, std::memory_order_relaxed);
+    job->continuationCount = 0;
+    job->mainThread = false;
+    job->unfinished.store(1, std::memory_order_release);
+    if (parent != NULL)
+    {
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+bool JobSystem::addDependency(Job *job, Job *dependency)
+{
+    if (dependency->continuationCount == (int)Job::MaxContinuations)
+    {
+        return false;
+    }
+    dependency->continuations[dependency->continuationCount++] = job;
+    job->blockers.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void JobSystem::run(Job *job)
+{
+    if (job->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        schedule(job, currentWorker());
+    }
+}
+
+void JobSystem::schedule(Job *job, JobWorker &worker)
+{
+    if (job->mainThread)
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        mainThreadJobs.push_back(job);
+        mainThreadJobCount.fetch_add(1);
+        return;
+    }
+    if (!worker.deque.push(job))
+    {
+        worker.inlined.fetch_add(1, std::memory_order_relaxed);
+        execute(job, worker);
+        return;
+    }
+    pendingJobs.fetch_add(1);
+    if (sleepingWorkers.load() > 0)
+    {
+        // Taking the lock guarantees that a worker going to sleep either sees the new job or gets the notification
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeUp.notify_one();
+    }
+}
+
+Job *JobSystem::findJob(JobWorker &worker)
+{
+    if (worker.index == 0 && mainThreadJobCount.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        if (!mainThreadJobs.empty())
+        {
+            Job *job = mainThreadJobs.front();
+            mainThreadJobs.pop_front();
+            mainThreadJobCount.fetch_sub(1);
+            return job;
+        }
+    }
+
+    Job *job = worker.deque.pop();
+    if (job != NULL)
+    {
+        pendingJobs.fetch_sub(1);
+        return job;
+    }
+
+    // Go around the other threads, starting after the last one we took something from
+    unsigned int count = workers.size();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int victim = (worker.victim + i) % count;
+        if (victim == worker.index)
+        {
+            continue;
+        }
+        job = workers[victim]->deque.steal();
+        if (job != NULL)
+        {
+            worker.victim = victim;
+            worker.stolen.fetch_add(1, std::memory_order_relaxed);
+            pendingJobs.fetch_sub(1);
+            return job;
+        }
+    }
+    return NULL;
+}
+
+void JobSystem::execute(Job *job, JobWorker &worker)
+{
+    if (hooks.jobStarted != NULL)
+    {
+        hooks.jobStarted(job, worker.index, hooks.user);
+    }
+    job->function(job);
+    if (hooks.jobFinished != NULL)
+    {
+        hooks.jobFinished(job, worker.index, hooks.user);
+    }
+    worker.executed.fetch_add(1, std::memory_order_relaxed);
+    finish(job);
+}
+
+void JobSystem::finish(Job *job)
+{
+    // Nothing of the job can change once it runs, but it can be recycled as soon as 'unfinished' reaches 0 :
+    // read what is needed first
+    Job *parent = job->parent;
+    int continuationCount = job->continuationCount;
+    Job *continuations[Job::MaxContinuations];
+    std::copy(job->continuations, job->continuations + continuationCount, continuations);
+
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    JobWorker &worker = currentWorker();
+    for (int i = 0; i < continuationCount; i++)
+    {
+        if (continuations[i]->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            schedule(continuations[i], worker);
+        }
+    }
+    if (parent != NULL)
+    {
+        finish(parent);
+    }
+}
+
+void JobSystem::wait(Job *job)
+{
+    JobWorker &worker = currentWorker();
+    while (job->unfinished.load(std::memory_order_acquire) > 0)
+    {
+        Job *other = findJob(worker);
+        if (other != NULL)
+        {
+            execute(other, worker);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::runMainThreadJobs()
+{
+    for (;;)
+    {
+        Job *job;
+        {
+            std::lock_guard<std::mutex> lock(mainThreadMutex);
+            if (mainThreadJobs.empty())
+            {
+                return;
+            }
+            job = mainThreadJobs.front();
+            mainThreadJobs.pop_front();
+            mainThreadJobCount.fetch_sub(1);
+        }
+        execute(job, *workers[0]);
+    }
+}
+
+void JobSystem::workerLoop(JobWorker *worker)
+{
+    threadWorker = worker;
+    int spins = 0;
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        Job *job = findJob(*worker);
+        if (job != NULL)
+        {
+            execute(job, *worker);
+            spins = 0;
+            continue;
+        }
+        if (++spins < SpinCount)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        wakeUp.wait(lock, [this]() { return pendingJobs.load() > 0 || stopping.load(); });
+        sleepingWorkers.fetch_sub(1);
+        spins = 0;
+    }
+}
+
+void JobSystem::parallelForRange(unsigned int begin, unsigned int end, unsigned int grain, RangeFunction function,
+                                 const void *body)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+    if (grain == 0)
+    {
+        grain = std::max((end - begin) / (4 * (unsigned int)workers.size()), 1u);
+    }
+    if (end - begin <= grain)
+    {
+        function(body, begin, end);
+        return;
+    }
+
+    // Every piece is a child of the root, which finishes with the last one
+    Job *root = createJob([]() {});
+    Job *first = createJob([=]() { splitRange(root, begin, end, grain, function, body); }, root);
+    root->name = "parallelFor";
+    first->name = "parallelFor";
+    run(first);
+    run(root);
+    wait(root);
+}
+
+void JobSystem::splitRange(Job *root, unsigned int begin, unsigned int end, unsigned int grain,
+                           RangeFunction function, const void *body)
+{
+    // Give away the upper halves, which is what the other threads steal, and keep going down the lower ones
+    while (end - begin > grain)
+    {
+        unsigned int middle = begin + (end - begin) / 2;
+        Job *half = createJob([=]() { splitRange(root, middle, end, grain, function, body); }, root);
+        half->name = "parallelFor";
+        run(half);
+        end = middle;
+    }
+    function(body, begin, end);
+}
+
+void JobSystem::setHooks(const JobHooks &newHooks)
+{
+    hooks = newHooks;
+}
+
+JobSystemStats JobSystem::stats() const
+{
+    JobSystemStats total = {0, 0, 0};
+    for (unsigned int i = 0; i < workers.size(); i++)
+    {
+        total.executed += workers[i]->executed.load(std::memory_order_relaxed);
+        total.stolen += workers[i]->stolen.load(std::memory_order_relaxed);
+        total.inlined += workers[i]->inlined.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void JobSystem::resetStats()
+{
+    for (unsigned int i = 0; i < workers.size(); i++)
+    {
+        workers[i]->executed = 0;
+        workers[i]->stolen = 0;
+        workers[i]->inlined = 0;
+    }
+}
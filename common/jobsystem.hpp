@@ -0,0 +1,172 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <vector>
+
+class JobSystem;
+struct JobWorker;
+
+// A unit of work, made by JobSystem::createJob. The fields are managed by the JobSystem, except for 'name'.
+//
+// Jobs live in a ring per creating thread and are recycled once they have finished : a Job pointer stays valid
+// until the job has finished and its creator has created JobSystem::MaxJobsPerThread more jobs.
+struct Job
+{
+    static const unsigned int MaxContinuations = 4;
+    static const unsigned int PayloadSize = 48;
+
+    void (*function)(Job *job);
+    Job *parent;                          // does not finish before this job does
+    const char *name;                     // for the instrumentation hooks, can be NULL
+    std::atomic<int> unfinished;          // this job and its unfinished children
+    std::atomic<int> blockers;            // unfinished dependencies, plus one until the job is run
+    int continuationCount;
+    bool mainThread;                      // only runs on the thread that created the JobSystem
+    Job *continuations[MaxContinuations]; // jobs waiting for this one
+    void *payload[PayloadSize / sizeof(void *)];
+};
+
+// Called on the thread that runs the job, just before and just after it. 'worker' is 0 for the main thread and
+// 1...workerCount() for the worker threads.
+struct JobHooks
+{
+    void (*jobStarted)(const Job *job, unsigned int worker, void *user);
+    void (*jobFinished)(const Job *job, unsigned int worker, void *user);
+    void *user;
+};
+
+struct JobSystemStats
+{
+    unsigned int executed; // jobs run, by any thread
+    unsigned int stolen;   // jobs taken from the deque of another thread
+    unsigned int inlined;  // jobs run directly because the deque was full
+};
+
+// A work-stealing scheduler. Every thread (the main thread included) has its own Chase-Lev deque : it pushes and
+// pops jobs at the bottom, and idle threads steal from the top of the others. Threads that find nothing to do
+// sleep until more jobs are pushed.
+//
+// The thread that calls create() is the main thread. Jobs can be created, run and waited for from the main thread
+// and from inside jobs only. Jobs marked with createMainThreadJob() (GL calls, for instance) go to a separate queue
+// that only the main thread runs, from wait() and runMainThreadJobs().
+//
+// Typical use :
+//     Job *load = jobs.createJob([&]() { loadOBJ(path, vertices, uvs, normals); });
+//     Job *upload = jobs.createMainThreadJob([&]() { mesh.create(vertices, uvs, normals, indices); });
+//     jobs.addDependency(upload, load);
+//     jobs.run(upload);
+//     jobs.run(load);
+//     jobs.wait(upload);
+class JobSystem
+{
+  public:
+    static const unsigned int MaxJobsPerThread = 4096;
+
+    JobSystem();
+
+    // The worker threads that hardware_concurrency leaves next to the main thread
+    static unsigned int defaultWorkerCount();
+
+    // Starts 'workerThreads' threads besides the calling one. With 0 threads, the main thread runs everything,
+    // from wait().
+    void create(unsigned int workerThreads = defaultWorkerCount());
+    // Stops the threads. Every job must have finished.
+    void destroy();
+
+    unsigned int workerCount() const
+    {
+        return workers.size() - 1;
+    }
+
+    // 'function' is any callable taking no argument, copied into the job : it may capture up to
+    // Job::PayloadSize bytes. If 'parent' is given, the parent does not finish before this job does.
+    // Every job that is created must be run.
+    template <typename F> Job *createJob(const F &function, Job *parent = NULL)
+    {
+        static_assert(sizeof(F) <= Job::PayloadSize, "the job captures too much : capture a pointer to a struct");
+        static_assert(alignof(F) <= alignof(void *), "the job captures an over-aligned type");
+        Job *job = allocateJob(&callPayload<F>, parent);
+        new (job->payload) F(function);
+        return job;
+    }
+    template <typename F> Job *createMainThreadJob(const F &function, Job *parent = NULL)
+    {
+        Job *job = createJob(function, parent);
+        job->mainThread = true;
+        return job;
+    }
+
+    // 'job' does not start before 'dependency' and its children have finished. Neither may have been run yet.
+    // Returns false if 'dependency' has Job::MaxContinuations dependent jobs already.
+    bool addDependency(Job *job, Job *dependency);
+
+    // Queues the job, or leaves it for its last dependency to queue
+    void run(Job *job);
+
+    // Runs other jobs until 'job' and its children have finished
+    void wait(Job *job);
+
+    // Runs the main thread jobs that are ready. Call it from the main thread, once per frame for instance.
+    void runMainThreadJobs();
+
+    // Calls body(first, last) on subranges of [begin, end) of at most 'grain' elements, in parallel, and returns
+    // when they have all been processed. With a grain of 0, the range is split in about 4 pieces per thread.
+    template <typename F> void parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const F &body)
+    {
+        parallelForRange(begin, end, grain, &callRange<F>, &body);
+    }
+
+    // Set when no job is running. Hooks with NULL functions are not called.
+    void setHooks(const JobHooks &hooks);
+
+    JobSystemStats stats() const;
+    void resetStats();
+
+  private:
+    typedef void (*RangeFunction)(const void *body, unsigned int first, unsigned int last);
+
+    template <typename F> static void callPayload(Job *job)
+    {
+        F *function = reinterpret_cast<F *>(job->payload);
+        (*function)();
+        function->~F();
+    }
+    template <typename F> static void callRange(const void *body, unsigned int first, unsigned int last)
+    {
+        (*static_cast<const F *>(body))(first, last);
+    }
+
+    Job *allocateJob(void (*function)(Job *), Job *parent);
+    void parallelForRange(unsigned int begin, unsigned int end, unsigned int grain, RangeFunction function,
+                          const void *body);
+    void splitRange(Job *root, unsigned int begin, unsigned int end, unsigned int grain, RangeFunction function,
+                    const void *body);
+
+    JobWorker &currentWorker();
+    void schedule(Job *job, JobWorker &worker);
+    Job *findJob(JobWorker &worker);
+    void execute(Job *job, JobWorker &worker);
+    void finish(Job *job);
+    void workerLoop(JobWorker *worker);
+
+    std::vector<JobWorker *> workers; // workers[0] is the main thread
+    JobHooks hooks;
+
+    std::mutex mainThreadMutex;
+    std::deque<Job *> mainThreadJobs;
+    std::atomic<int> mainThreadJobCount; // so that the main thread does not take the lock to find nothing
+
+    // Sleeping and waking up the worker threads
+    std::atomic<int> pendingJobs; // jobs pushed to a deque and not taken yet
+    std::atomic<int> sleepingWorkers;
+    std::atomic<bool> stopping;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+};
+
+#endif
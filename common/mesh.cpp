@@ -0,0 +1,106 @@
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+
+Mesh::Mesh()
+    : vertexArrayID(0), vertexbuffer(0), uvbuffer(0), normalbuffer(0), elementbuffer(0), numIndices(0),
+      elementType(GL_UNSIGNED_SHORT)
+{
+}
+
+void Mesh::create(const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs,
+                  const std::vector<glm::vec3> &normals, const std::vector<unsigned short> &indices)
+{
+    createBuffers(&vertices[0], &uvs[0], &normals[0], vertices.size(), &indices[0], indices.size(),
+                  GL_UNSIGNED_SHORT);
+}
+
+void Mesh::create(const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs,
+                  const std::vector<glm::vec3> &normals, const std::vector<unsigned int> &indices)
+{
+    createBuffers(&vertices[0], &uvs[0], &normals[0], vertices.size(), &indices[0], indices.size(), GL_UNSIGNED_INT);
+}
+
+void Mesh::create(const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals, unsigned int vertexCount,
+                  const unsigned short *indices, unsigned int indexCount)
+{
+    createBuffers(vertices, uvs, normals, vertexCount, indices, indexCount, GL_UNSIGNED_SHORT);
+}
+
+void Mesh::create(const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals, unsigned int vertexCount,
+                  const unsigned int *indices, unsigned int indexCount)
+{
+    createBuffers(vertices, uvs, normals, vertexCount, indices, indexCount, GL_UNSIGNED_INT);
+}
+
+void Mesh::createBuffers(const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals,
+                         unsigned int vertexCount, const void *indices, unsigned int indexCount, GLenum indexType)
+{
+    numIndices = indexCount;
+    elementType = indexType;
+
+    // The VAO records every glVertexAttribPointer / glEnableVertexAttribArray
+    // below, and the element buffer binding.
+    glGenVertexArrays(1, &vertexArrayID);
+    glBindVertexArray(vertexArrayID);
+
+    // 1rst attribute buffer : vertices
+    glGenBuffers(1, &vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    // 2nd attribute buffer : UVs
+    glGenBuffers(1, &uvbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec2), uvs, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    // 3rd attribute buffer : normals
+    glGenBuffers(1, &normalbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3), normals, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+    // Index buffer
+    unsigned int indexSize = (indexType == GL_UNSIGNED_INT) ? sizeof(unsigned int) : sizeof(unsigned short);
+    glGenBuffers(1, &elementbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, indices, GL_STATIC_DRAW);
+
+    // Unbind the VAO first, so that it keeps its element buffer
+    glBindVertexArray(0);
+}
+
+void Mesh::bind() const
+{
+    glBindVertexArray(vertexArrayID);
+}
+
+void Mesh::draw() const
+{
+    glDrawElements(GL_TRIANGLES, numIndices, elementType, (void *)0);
+}
+
+void Mesh::drawInstanced(unsigned int instanceCount) const
+{
+    glDrawElementsInstanced(GL_TRIANGLES, numIndices, elementType, (void *)0, instanceCount);
+}
+
+void Mesh::destroy()
+{
+    glDeleteBuffers(1, &vertexbuffer);
+    glDeleteBuffers(1, &uvbuffer);
+    glDeleteBuffers(1, &normalbuffer);
+    glDeleteBuffers(1, &elementbuffer);
+    glDeleteVertexArrays(1, &vertexArrayID);
+    vertexArrayID = vertexbuffer = uvbuffer = normalbuffer = elementbuffer = 0;
+    numIndices = 0;
+}
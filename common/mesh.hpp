@@ -0,0 +1,66 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+// An indexed triangle mesh that owns its vertex, UV, normal and index buffers,
+// plus a vertex array object in which the attribute layout is recorded once,
+// at creation :
+//  - location 0 : vertex position (vec3)
+//  - location 1 : UV (vec2)
+//  - location 2 : normal (vec3)
+// Drawing is then just glBindVertexArray + glDrawElements, instead of
+// re-specifying every attribute pointer before each draw call.
+class Mesh
+{
+  public:
+    Mesh();
+
+    void create(const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs,
+                const std::vector<glm::vec3> &normals, const std::vector<unsigned short> &indices);
+    void create(const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs,
+                const std::vector<glm::vec3> &normals, const std::vector<unsigned int> &indices);
+    void create(const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals, unsigned int vertexCount,
+                const unsigned short *indices, unsigned int indexCount);
+    void create(const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals, unsigned int vertexCount,
+                const unsigned int *indices, unsigned int indexCount);
+
+    // Binds the VAO. Any other attribute set up while it is bound (per-instance
+    // data for instance) is remembered by the VAO too.
+    void bind() const;
+
+    // Both expect the mesh to be bound
+    void draw() const;
+    void drawInstanced(unsigned int instanceCount) const;
+
+    void destroy();
+
+    GLuint vertexArray() const
+    {
+        return vertexArrayID;
+    }
+    GLuint elementBuffer() const
+    {
+        return elementbuffer;
+    }
+    unsigned int indexCount() const
+    {
+        return numIndices;
+    }
+    GLenum indexType() const
+    {
+        return elementType;
+    }
+
+  private:
+    void createBuffers(const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals,
+                       unsigned int vertexCount, const void *indices, unsigned int indexCount, GLenum indexType);
+
+    GLuint vertexArrayID;
+    GLuint vertexbuffer;
+    GLuint uvbuffer;
+    GLuint normalbuffer;
+    GLuint elementbuffer;
+    unsigned int numIndices;
+    GLenum elementType;
+};
+
+#endif
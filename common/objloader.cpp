@@ -118,24 +118,17 @@ bool loadOBJ(
 #include <assimp/scene.h>           // Output data structure
 #include <assimp/postprocess.h>     // Post processing flags
 
-bool loadAssImp(
-	const char * path, 
+
+#include "skinning.hpp"
+
+// Copies the positions, UV0, normals and triangles of a mesh
+static void copyMesh(
+	const aiMesh* mesh,
 	std::vector<unsigned short> & indices,
 	std::vector<glm::vec3> & vertices,
 	std::vector<glm::vec2> & uvs,
 	std::vector<glm::vec3> & normals
 ){
-
-	Assimp::Importer importer;
-
-	const aiScene* scene = importer.ReadFile(path, 0/*aiProcess_JoinIdenticalVertices | aiProcess_SortByPType*/);
-	if( !scene) {
-		fprintf( stderr, importer.GetErrorString());
-		getchar();
-		return false;
-	}
-	const aiMesh* mesh = scene->mMeshes[0]; // In this simple example code we always use the 1rst mesh (in OBJ files there is often only one anyway)
-
 	// Fill vertices positions
 	vertices.reserve(mesh->mNumVertices);
 	for(unsigned int i=0; i<mesh->mNumVertices; i++){
@@ -166,9 +159,168 @@ bool loadAssImp(
 		indices.push_back(mesh->mFaces[i].mIndices[1]);
 		indices.push_back(mesh->mFaces[i].mIndices[2]);
 	}
+}
+
+bool loadAssImp(
+	const char * path, 
+	std::vector<unsigned short> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals
+){
+
+	Assimp::Importer importer;
+
+	const aiScene* scene = importer.ReadFile(path, 0/*aiProcess_JoinIdenticalVertices | aiProcess_SortByPType*/);
+	if( !scene) {
+		fprintf( stderr, importer.GetErrorString());
+		getchar();
+		return false;
+	}
+	const aiMesh* mesh = scene->mMeshes[0]; // In this simple example code we always use the 1rst mesh (in OBJ files there is often only one anyway)
+
+	copyMesh(mesh, indices, vertices, uvs, normals);
 	
 	// The "scene" pointer will be deleted automatically by "importer"
 	return true;
 }
 
+// AssImp matrices are row-major, GLM ones column-major
+static glm::mat4 toGlm(const aiMatrix4x4 & m){
+	return glm::mat4(
+		m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4
+	);
+}
+
+// Every node becomes a bone, parents first, so that the animations can move any of them
+static void addBones(const aiNode* node, unsigned int parent, Skeleton & skeleton){
+	unsigned int bone = skeleton.addBone(node->mName.C_Str(), parent, toGlm(node->mTransformation));
+	for(unsigned int i=0; i<node->mNumChildren; i++){
+		addBones(node->mChildren[i], bone, skeleton);
+	}
+}
+
+// The node that holds the first mesh
+static const aiNode* findMeshNode(const aiNode* node){
+	for(unsigned int i=0; i<node->mNumMeshes; i++){
+		if (node->mMeshes[i] == 0)
+			return node;
+	}
+	for(unsigned int i=0; i<node->mNumChildren; i++){
+		const aiNode* found = findMeshNode(node->mChildren[i]);
+		if (found)
+			return found;
+	}
+	return NULL;
+}
+
+// Keeps the 4 largest weights of a vertex, in decreasing order
+static void addWeight(BoneWeights & vertex, unsigned short bone, float weight){
+	int slot = 4;
+	while (slot > 0 && vertex.weights[slot-1] < weight)
+		slot--;
+	if (slot == 4)
+		return;
+	for (int i=3; i>slot; i--){
+		vertex.bones[i] = vertex.bones[i-1];
+		vertex.weights[i] = vertex.weights[i-1];
+	}
+	vertex.bones[slot] = bone;
+	vertex.weights[slot] = weight;
+}
+
+bool loadAssImp(
+	const char * path, 
+	std::vector<unsigned short> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<BoneWeights> & weights,
+	Skeleton & skeleton,
+	std::vector<SkeletalAnimation> & animations
+){
+
+	Assimp::Importer importer;
+
+	const aiScene* scene = importer.ReadFile(path, 0);
+	if( !scene) {
+		fprintf( stderr, "%s\n", importer.GetErrorString());
+		return false;
+	}
+	const aiMesh* mesh = scene->mMeshes[0];
+	copyMesh(mesh, indices, vertices, uvs, normals);
+
+	// The whole node hierarchy
+	addBones(scene->mRootNode, Skeleton::None, skeleton);
+
+	// The bones of the mesh, and the vertices each one moves
+	BoneWeights unused = {{0, 0, 0, 0}, {0.0f, 0.0f, 0.0f, 0.0f}};
+	weights.assign(mesh->mNumVertices, unused);
+	for(unsigned int i=0; i<mesh->mNumBones; i++){
+		const aiBone* bone = mesh->mBones[i];
+		unsigned int index = skeleton.find(bone->mName.C_Str());
+		if (index == Skeleton::None){
+			fprintf(stderr, "%s : no node for the bone %s\n", path, bone->mName.C_Str());
+			continue;
+		}
+		skeleton.inverseBindPose[index] = toGlm(bone->mOffsetMatrix);
+		for(unsigned int j=0; j<bone->mNumWeights; j++){
+			addWeight(weights[bone->mWeights[j].mVertexId], (unsigned short)index, bone->mWeights[j].mWeight);
+		}
+	}
+
+	// The weights must add up to 1. Vertices that no bone moves follow the node of the mesh.
+	const aiNode* meshNode = findMeshNode(scene->mRootNode);
+	unsigned short meshBone = (unsigned short)skeleton.find(meshNode ? meshNode->mName.C_Str() : "");
+	for(unsigned int i=0; i<weights.size(); i++){
+		float total = weights[i].weights[0] + weights[i].weights[1] + weights[i].weights[2] + weights[i].weights[3];
+		if (total <= 0.0f){
+			weights[i].bones[0] = meshNode ? meshBone : 0;
+			weights[i].weights[0] = 1.0f;
+			continue;
+		}
+		for (int slot=0; slot<4; slot++)
+			weights[i].weights[slot] /= total;
+	}
+
+	// The keys of each node, in seconds
+	for(unsigned int i=0; i<scene->mNumAnimations; i++){
+		const aiAnimation* source = scene->mAnimations[i];
+		double ticksPerSecond = source->mTicksPerSecond != 0.0 ? source->mTicksPerSecond : 25.0; // AssImp's default
+		SkeletalAnimation animation;
+		animation.name = source->mName.C_Str();
+		animation.duration = (float)(source->mDuration / ticksPerSecond);
+		for(unsigned int j=0; j<source->mNumChannels; j++){
+			const aiNodeAnim* keys = source->mChannels[j];
+			BoneChannel channel;
+			channel.bone = skeleton.find(keys->mNodeName.C_Str());
+			if (channel.bone == Skeleton::None)
+				continue;
+			for(unsigned int k=0; k<keys->mNumPositionKeys; k++){
+				const aiVectorKey & key = keys->mPositionKeys[k];
+				channel.positionTimes.push_back((float)(key.mTime / ticksPerSecond));
+				channel.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			for(unsigned int k=0; k<keys->mNumRotationKeys; k++){
+				const aiQuatKey & key = keys->mRotationKeys[k];
+				channel.rotationTimes.push_back((float)(key.mTime / ticksPerSecond));
+				channel.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			for(unsigned int k=0; k<keys->mNumScalingKeys; k++){
+				const aiVectorKey & key = keys->mScalingKeys[k];
+				channel.scaleTimes.push_back((float)(key.mTime / ticksPerSecond));
+				channel.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			animation.channels.push_back(channel);
+		}
+		animations.push_back(animation);
+	}
+
+	// The "scene" pointer will be deleted automatically by "importer"
+	return true;
+}
+
 #endif
\ No newline at end of file
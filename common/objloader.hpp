@@ -18,4 +18,22 @@ bool loadAssImp(
 	std::vector<glm::vec3> & normals
 );
 
+struct BoneWeights;
+struct Skeleton;
+struct SkeletalAnimation;
+
+// The same, plus what animates the first mesh (see skinning.hpp) : the bones
+// and weights of each vertex, every node of the file as a bone, and the
+// animations of the scene. Bones without a node are ignored.
+bool loadAssImp(
+	const char * path, 
+	std::vector<unsigned short> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<BoneWeights> & weights,
+	Skeleton & skeleton,
+	std::vector<SkeletalAnimation> & animations
+);
+
 #endif
\ No newline at end of file
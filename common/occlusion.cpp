@@ -0,0 +1,364 @@
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "jobsystem.hpp"
+#include "occlusion.hpp"
+
+OcclusionBuffer::OcclusionBuffer() : bufferWidth(0), bufferHeight(0), tilesX(0), tilesY(0)
+{
+    frameStats = OcclusionStats();
+}
+
+void OcclusionBuffer::create(int width, int height)
+{
+    tilesX = (std::max(width, 1) + TileWidth - 1) / TileWidth;
+    tilesY = (std::max(height, 1) + TileHeight - 1) / TileHeight;
+    bufferWidth = tilesX * TileWidth;
+    bufferHeight = tilesY * TileHeight;
+    depthBuffer.assign(bufferWidth * bufferHeight, 1.0f);
+    blockDepth.assign((bufferWidth / BlockSize) * (bufferHeight / BlockSize), 1.0f);
+    tileTriangles.resize(tilesX * tilesY);
+}
+
+void OcclusionBuffer::begin(const glm::mat4 &matrix)
+{
+    viewProjection = matrix;
+    triangles.clear();
+    for (unsigned int i = 0; i < tileTriangles.size(); i++)
+    {
+        tileTriangles[i].clear();
+    }
+    frameStats = OcclusionStats();
+}
+
+void OcclusionBuffer::addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c, bool doubleSided)
+{
+    // Clipping would only make the occluders smaller : drop what crosses the near plane
+    if (a.w <= 0.0f || b.w <= 0.0f || c.w <= 0.0f || a.z < -a.w || b.z < -b.w || c.z < -c.w)
+    {
+        return;
+    }
+
+    // Window coordinates, in pixels, and depth in [0, 1]
+    glm::vec3 v[3];
+    const glm::vec4 *clip[3] = {&a, &b, &c};
+    for (int i = 0; i < 3; i++)
+    {
+        glm::vec3 ndc = glm::vec3(*clip[i]) / clip[i]->w;
+        v[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * bufferWidth, (ndc.y * 0.5f + 0.5f) * bufferHeight,
+                         ndc.z * 0.5f + 0.5f);
+    }
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+    if (area < 0.0f && doubleSided)
+    {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+    // Back facing, degenerate or NaN
+    if (!(area > 0.0f))
+    {
+        return;
+    }
+
+    // Pixels whose center may be inside
+    float minX = std::max(0.0f, ceilf(std::min(v[0].x, std::min(v[1].x, v[2].x)) - 0.5f));
+    float maxX = std::min(bufferWidth - 1.0f, floorf(std::max(v[0].x, std::max(v[1].x, v[2].x)) - 0.5f));
+    float minY = std::max(0.0f, ceilf(std::min(v[0].y, std::min(v[1].y, v[2].y)) - 0.5f));
+    float maxY = std::min(bufferHeight - 1.0f, floorf(std::max(v[0].y, std::max(v[1].y, v[2].y)) - 0.5f));
+    if (minX > maxX || minY > maxY)
+    {
+        return;
+    }
+
+    Triangle triangle;
+    triangle.minX = (int)minX;
+    triangle.maxX = (int)maxX;
+    triangle.minY = (int)minY;
+    triangle.maxY = (int)maxY;
+
+    // Edge functions, evaluated at the pixel centers from integer pixel coordinates. Each edge is pulled in by half
+    // a pixel : its smallest value over the pixel rather than the one at the center, so that only the pixels the
+    // triangle covers completely are inside. A partly covered pixel could show something behind the occluder.
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec3 &p = v[i];
+        const glm::vec3 &q = v[(i + 1) % 3];
+        float edgeA = p.y - q.y;
+        float edgeB = q.x - p.x;
+        float edgeC = p.x * q.y - p.y * q.x;
+        triangle.edgeA[i] = edgeA;
+        triangle.edgeB[i] = edgeB;
+        triangle.edgeC[i] = edgeC + 0.5f * (edgeA + edgeB) - 0.5f * (fabsf(edgeA) + fabsf(edgeB));
+    }
+
+    // Depth is linear in screen space. Store its farthest value over each
+    // pixel rather than the one at the center, but no farther than the triangle.
+    float depthDx = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+    float depthDy = ((v[1].x - v[0].x) * (v[2].z - v[0].z) - (v[2].x - v[0].x) * (v[1].z - v[0].z)) / area;
+    triangle.depthA = depthDx;
+    triangle.depthB = depthDy;
+    triangle.depthC = v[0].z - depthDx * v[0].x - depthDy * v[0].y + 0.5f * (depthDx + depthDy) +
+                      0.5f * (fabsf(depthDx) + fabsf(depthDy));
+    triangle.depthMax = std::max(v[0].z, std::max(v[1].z, v[2].z));
+
+    unsigned int index = triangles.size();
+    triangles.push_back(triangle);
+    frameStats.triangles++;
+
+    for (int tileY = triangle.minY / TileHeight; tileY <= triangle.maxY / TileHeight; tileY++)
+    {
+        for (int tileX = triangle.minX / TileWidth; tileX <= triangle.maxX / TileWidth; tileX++)
+        {
+            tileTriangles[tileY * tilesX + tileX].push_back(index);
+            frameStats.binned++;
+        }
+    }
+}
+
+void OcclusionBuffer::addOccluder(const std::vector<glm::vec3> &vertices, const std::vector<unsigned short> &indices,
+                                  const glm::mat4 &model, bool doubleSided)
+{
+    frameStats.occluders++;
+    clipVertices.resize(vertices.size());
+    glm::mat4 mvp = viewProjection * model;
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        clipVertices[i] = mvp * glm::vec4(vertices[i], 1.0f);
+    }
+    for (unsigned int i = 0; i + 2 < indices.size(); i += 3)
+    {
+        addTriangle(clipVertices[indices[i]], clipVertices[indices[i + 1]], clipVertices[indices[i + 2]],
+                    doubleSided);
+    }
+}
+
+void OcclusionBuffer::addOccluder(const glm::vec3 *vertices, unsigned int vertexCount, const unsigned int *indices,
+                                  unsigned int indexCount, const glm::mat4 &model, bool doubleSided)
+{
+    frameStats.occluders++;
+    clipVertices.resize(vertexCount);
+    glm::mat4 mvp = viewProjection * model;
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        clipVertices[i] = mvp * glm::vec4(vertices[i], 1.0f);
+    }
+    for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+    {
+        addTriangle(clipVertices[indices[i]], clipVertices[indices[i + 1]], clipVertices[indices[i + 2]],
+                    doubleSided);
+    }
+}
+
+void OcclusionBuffer::rasterizeTile(unsigned int tile, bool simd)
+{
+    int tileX = (tile % tilesX) * TileWidth;
+    int tileY = (tile / tilesX) * TileHeight;
+
+    for (int y = tileY; y < tileY + TileHeight; y++)
+    {
+        std::fill(&depthBuffer[y * bufferWidth + tileX], &depthBuffer[y * bufferWidth + tileX] + TileWidth, 1.0f);
+    }
+
+    const std::vector<unsigned int> &list = tileTriangles[tile];
+    for (unsigned int i = 0; i < list.size(); i++)
+    {
+        const Triangle &t = triangles[list[i]];
+        // Groups of 4 pixels, aligned : they never leave the tile
+        int startX = std::max(t.minX, tileX) & ~3;
+        int endX = std::min(t.maxX, tileX + TileWidth - 1);
+        int startY = std::max(t.minY, tileY);
+        int endY = std::min(t.maxY, tileY + TileHeight - 1);
+
+        for (int y = startY; y <= endY; y++)
+        {
+            float *row = &depthBuffer[y * bufferWidth];
+            // The per-row terms, then A * x + row term : the same operations in both paths
+            float row0 = t.edgeB[0] * y + t.edgeC[0];
+            float row1 = t.edgeB[1] * y + t.edgeC[1];
+            float row2 = t.edgeB[2] * y + t.edgeC[2];
+            float rowDepth = t.depthB * y + t.depthC;
+#ifdef OCCLUSION_SSE
+            if (simd)
+            {
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+                __m128 a0 = _mm_set1_ps(t.edgeA[0]), a1 = _mm_set1_ps(t.edgeA[1]), a2 = _mm_set1_ps(t.edgeA[2]);
+                __m128 r0 = _mm_set1_ps(row0), r1 = _mm_set1_ps(row1), r2 = _mm_set1_ps(row2);
+                __m128 depthA = _mm_set1_ps(t.depthA), depthRow = _mm_set1_ps(rowDepth);
+                __m128 depthMax = _mm_set1_ps(t.depthMax);
+                for (int x = startX; x <= endX; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+                    __m128 inside = _mm_and_ps(_mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a0, px), r0), zero),
+                                               _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a1, px), r1), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a2, px), r2), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                    {
+                        continue;
+                    }
+                    __m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthA, px), depthRow), depthMax);
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 result = _mm_min_ps(old, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, result), _mm_andnot_ps(inside, old)));
+                }
+                continue;
+            }
+#endif
+            for (int x = startX; x <= endX; x++)
+            {
+                float px = (float)x;
+                if (t.edgeA[0] * px + row0 > 0.0f && t.edgeA[1] * px + row1 > 0.0f && t.edgeA[2] * px + row2 > 0.0f)
+                {
+                    float depth = std::min(t.depthA * px + rowDepth, t.depthMax);
+                    row[x] = std::min(row[x], depth);
+                }
+            }
+        }
+    }
+
+    // Farthest depth of every block of the tile
+    int blocksX = bufferWidth / BlockSize;
+    for (int by = tileY; by < tileY + TileHeight; by += BlockSize)
+    {
+        for (int bx = tileX; bx < tileX + TileWidth; bx += BlockSize)
+        {
+            float farthest = 0.0f;
+            for (int y = by; y < by + BlockSize; y++)
+            {
+                const float *row = &depthBuffer[y * bufferWidth + bx];
+                for (int x = 0; x < BlockSize; x++)
+                {
+                    farthest = std::max(farthest, row[x]);
+                }
+            }
+            blockDepth[(by / BlockSize) * blocksX + bx / BlockSize] = farthest;
+        }
+    }
+}
+
+void OcclusionBuffer::rasterizeTiles(JobSystem *jobs, bool simd)
+{
+    unsigned int tileCount = tilesX * tilesY;
+    if (jobs == NULL)
+    {
+        for (unsigned int tile = 0; tile < tileCount; tile++)
+        {
+            rasterizeTile(tile, simd);
+        }
+        return;
+    }
+    // Tiles don't share pixels : any thread can take any of them
+    jobs->parallelFor(0, tileCount, 1, [&](unsigned int first, unsigned int last) {
+        for (unsigned int tile = first; tile < last; tile++)
+        {
+            rasterizeTile(tile, simd);
+        }
+    });
+}
+
+void OcclusionBuffer::rasterize(JobSystem *jobs)
+{
+    rasterizeTiles(jobs, true);
+}
+
+void OcclusionBuffer::rasterizeScalar(JobSystem *jobs)
+{
+    rasterizeTiles(jobs, false);
+}
+
+bool OcclusionBuffer::isBoxVisible(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &model)
+{
+    frameStats.tested++;
+
+    // Screen rectangle and nearest depth of the 8 corners
+    // Corners from one transformed corner and the transformed edges
+    glm::mat4 mvp = viewProjection * model;
+    glm::vec4 base = mvp * glm::vec4(min, 1.0f);
+    glm::vec4 edgeX = mvp[0] * (max.x - min.x);
+    glm::vec4 edgeY = mvp[1] * (max.y - min.y);
+    glm::vec4 edgeZ = mvp[2] * (max.z - min.z);
+    glm::vec2 screenMin(INFINITY), screenMax(-INFINITY);
+    float nearest = INFINITY;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 clip = base;
+        if (corner & 1)
+        {
+            clip += edgeX;
+        }
+        if (corner & 2)
+        {
+            clip += edgeY;
+        }
+        if (corner & 4)
+        {
+            clip += edgeZ;
+        }
+        if (clip.w <= 0.0f || clip.z < -clip.w)
+        {
+            return true; // crosses the near plane
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 screen((ndc.x * 0.5f + 0.5f) * bufferWidth, (ndc.y * 0.5f + 0.5f) * bufferHeight);
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+
+    // Every pixel the rectangle touches
+    float minX = std::max(0.0f, floorf(screenMin.x));
+    float maxX = std::min(bufferWidth - 1.0f, floorf(screenMax.x));
+    float minY = std::max(0.0f, floorf(screenMin.y));
+    float maxY = std::min(bufferHeight - 1.0f, floorf(screenMax.y));
+    if (minX > maxX || minY > maxY)
+    {
+        frameStats.offscreen++;
+        return false;
+    }
+    int x0 = (int)minX, x1 = (int)maxX, y0 = (int)minY, y1 = (int)maxY;
+    int blocksX = bufferWidth / BlockSize;
+    for (int by = y0 / BlockSize; by <= y1 / BlockSize; by++)
+    {
+        for (int bx = x0 / BlockSize; bx <= x1 / BlockSize; bx++)
+        {
+            if (blockDepth[by * blocksX + bx] < nearest)
+            {
+                continue; // the whole block is in front of the box
+            }
+            // Look at the pixels of the block that the rectangle covers
+            int startX = std::max(x0, bx * BlockSize), endX = std::min(x1, bx * BlockSize + BlockSize - 1);
+            int startY = std::max(y0, by * BlockSize), endY = std::min(y1, by * BlockSize + BlockSize - 1);
+            for (int y = startY; y <= endY; y++)
+            {
+                for (int x = startX; x <= endX; x++)
+                {
+                    if (depthBuffer[y * bufferWidth + x] >= nearest)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Behind the occluders wherever it could be seen
+    frameStats.culled++;
+    return false;
+}
+
+const char *occlusionInstructionSet()
+{
+#ifdef OCCLUSION_SSE
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
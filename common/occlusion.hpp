@@ -0,0 +1,105 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+class JobSystem;
+
+struct OcclusionStats
+{
+    unsigned int occluders;
+    unsigned int triangles; // that survived setup (near plane, back faces, size)
+    unsigned int binned;    // triangle / tile pairs that were rasterized
+    unsigned int tested;
+    unsigned int culled;    // hidden by the occluders
+    unsigned int offscreen; // outside of the buffer, not counted in culled
+
+    float culledRatio() const
+    {
+        return tested > 0 ? (float)culled / tested : 0.0f;
+    }
+};
+
+// Software depth buffer for occlusion culling, entirely on the CPU.
+//
+// Each frame : begin() with the view projection matrix, addOccluder() for the
+// big objects, rasterize(), then isBoxVisible() for the things to draw.
+//
+// The buffer is small (a few hundred pixels wide) and split in tiles, which
+// the jobs of a JobSystem rasterize independently, 4 pixels at a time with
+// SSE. It stores
+// the farthest depth of the occluders over each pixel, and the farthest over
+// each 8x8 block, so that most boxes are rejected or accepted with a few
+// block tests. Occluders only cover the pixels they cover completely, their
+// triangles that cross the near plane are dropped, and a box that crosses it
+// is always visible : the answer is never "hidden" for something that is
+// visible.
+class OcclusionBuffer
+{
+  public:
+    static const int TileWidth = 64;
+    static const int TileHeight = 32;
+    static const int BlockSize = 8;
+
+    OcclusionBuffer();
+
+    // Rounded up to whole tiles
+    void create(int width, int height);
+
+    void begin(const glm::mat4 &viewProjection);
+    // Back faces are skipped unless doubleSided : the mesh must be closed
+    void addOccluder(const std::vector<glm::vec3> &vertices, const std::vector<unsigned short> &indices,
+                     const glm::mat4 &model, bool doubleSided = false);
+    void addOccluder(const glm::vec3 *vertices, unsigned int vertexCount, const unsigned int *indices,
+                     unsigned int indexCount, const glm::mat4 &model, bool doubleSided = false);
+    // One job per tile, or everything on this thread without 'jobs'
+    void rasterize(JobSystem *jobs = NULL);
+    // Same result without SIMD, for reference
+    void rasterizeScalar(JobSystem *jobs = NULL);
+
+    // Box in model space. A box outside of the buffer is not visible either.
+    bool isBoxVisible(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &model);
+
+    const OcclusionStats &stats() const
+    {
+        return frameStats;
+    }
+    int width() const
+    {
+        return bufferWidth;
+    }
+    int height() const
+    {
+        return bufferHeight;
+    }
+    // 0 (near) to 1 (far), rows from the bottom like OpenGL
+    const std::vector<float> &depth() const
+    {
+        return depthBuffer;
+    }
+
+  private:
+    struct Triangle
+    {
+        float edgeA[3], edgeB[3], edgeC[3]; // edge i is positive inside : A * x + B * y + C
+        float depthA, depthB, depthC, depthMax;
+        int minX, minY, maxX, maxY;
+    };
+
+    void addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c, bool doubleSided);
+    void rasterizeTiles(JobSystem *jobs, bool simd);
+    void rasterizeTile(unsigned int tile, bool simd);
+
+    int bufferWidth, bufferHeight;
+    int tilesX, tilesY;
+    glm::mat4 viewProjection;
+    std::vector<float> depthBuffer;
+    std::vector<float> blockDepth; // farthest depth of every 8x8 block
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<unsigned int> > tileTriangles;
+    std::vector<glm::vec4> clipVertices;
+    OcclusionStats frameStats;
+};
+
+// "SSE" or "scalar"
+const char *occlusionInstructionSet();
+
+#endif
@@ -0,0 +1,201 @@
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionShapes/btShapeHull.h>
+
+#include "clock.hpp"
+#include "culling.hpp"
+#include "physics.hpp"
+#include "transforms.hpp"
+
+void InstanceMotionState::getWorldTransform(btTransform &worldTransform) const
+{
+    const Transforms &transforms = *targets->transforms;
+    worldTransform.setOrigin(
+        btVector3(transforms.positionX[index], transforms.positionY[index], transforms.positionZ[index]));
+    worldTransform.setRotation(btQuaternion(transforms.rotationX[index], transforms.rotationY[index],
+                                            transforms.rotationZ[index], transforms.rotationW[index]));
+}
+
+void InstanceMotionState::setWorldTransform(const btTransform &worldTransform)
+{
+    Transforms &transforms = *targets->transforms;
+    const btVector3 &origin = worldTransform.getOrigin();
+    btQuaternion rotation = worldTransform.getRotation();
+    transforms.positionX[index] = origin.x();
+    transforms.positionY[index] = origin.y();
+    transforms.positionZ[index] = origin.z();
+    transforms.rotationX[index] = rotation.x();
+    transforms.rotationY[index] = rotation.y();
+    transforms.rotationZ[index] = rotation.z();
+    transforms.rotationW[index] = rotation.w();
+    if (targets->bounds != NULL)
+    {
+        const glm::vec3 &c = targets->boundsCenter;
+        btVector3 center = worldTransform * btVector3(c.x, c.y, c.z);
+        targets->bounds->centerX[index] = center.x();
+        targets->bounds->centerY[index] = center.y();
+        targets->bounds->centerZ[index] = center.z();
+    }
+    if (targets->modelMatrices != NULL)
+    {
+        // Column-major like glm
+        worldTransform.getOpenGLMatrix(&targets->modelMatrices[index][0][0]);
+    }
+}
+
+PhysicsWorld::PhysicsWorld()
+    : collisionConfiguration(NULL), dispatcher(NULL), broadphase(NULL), solver(NULL), world(NULL), groundShape(NULL),
+      ground(NULL), fixedTimeStep(1.0f / 60.0f), maxSubSteps(4), active(0)
+{
+    resetStats();
+    statistics.totalSteps = 0;
+}
+
+PhysicsWorld::~PhysicsWorld()
+{
+    destroy();
+}
+
+void PhysicsWorld::create(unsigned int maxBodies, float groundHeight, float fixedTimeStep, int maxSubSteps)
+{
+    destroy();
+    collisionConfiguration = new btDefaultCollisionConfiguration();
+    dispatcher = new btCollisionDispatcher(collisionConfiguration);
+    broadphase = new btDbvtBroadphase();
+    solver = new btSequentialImpulseConstraintSolver();
+    world = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
+    world->setGravity(btVector3(0.0f, 0.0f, -9.81f));
+
+    // Static : a mass of 0, and no motion state
+    groundShape = new btStaticPlaneShape(btVector3(0.0f, 0.0f, 1.0f), groundHeight);
+    ground = new btRigidBody(btRigidBody::btRigidBodyConstructionInfo(0.0f, NULL, groundShape));
+    world->addRigidBody(ground);
+
+    bodies.reserve(maxBodies);
+    motionStates.reserve(maxBodies);
+    awake.reserve(maxBodies);
+    active = 0;
+    this->fixedTimeStep = fixedTimeStep;
+    this->maxSubSteps = maxSubSteps;
+    resetStats();
+    statistics.totalSteps = 0;
+}
+
+void PhysicsWorld::destroy()
+{
+    if (world == NULL)
+    {
+        return;
+    }
+    for (unsigned int i = 0; i < bodies.size(); i++)
+    {
+        world->removeRigidBody(bodies[i]);
+        delete bodies[i];
+    }
+    world->removeRigidBody(ground);
+    delete ground;
+    delete groundShape;
+    for (unsigned int i = 0; i < shapes.size(); i++)
+    {
+        delete shapes[i];
+    }
+    delete world;
+    delete solver;
+    delete broadphase;
+    delete dispatcher;
+    delete collisionConfiguration;
+    bodies.clear();
+    motionStates.clear();
+    awake.clear();
+    active = 0;
+    shapes.clear();
+    world = NULL;
+    ground = NULL;
+    groundShape = NULL;
+    solver = NULL;
+    broadphase = NULL;
+    dispatcher = NULL;
+    collisionConfiguration = NULL;
+}
+
+unsigned int PhysicsWorld::addConvexHull(const std::vector<glm::vec3> &vertices)
+{
+    // The hull of every vertex first, then one with the vertices btShapeHull keeps of it
+    btConvexHullShape full(&vertices[0].x, vertices.size(), sizeof(glm::vec3));
+    btShapeHull simplified(&full);
+    simplified.buildHull(full.getMargin());
+    btConvexHullShape *hull = new btConvexHullShape(&simplified.getVertexPointer()->getX(),
+                                                    simplified.numVertices(), sizeof(btVector3));
+    shapes.push_back(hull);
+    return shapes.size() - 1;
+}
+
+bool PhysicsWorld::addBody(unsigned int shape, float mass, const InstanceTargets *targets, unsigned int index)
+{
+    // Growing the array would move the motion states the bodies point to
+    if (motionStates.size() == motionStates.capacity())
+    {
+        return false;
+    }
+    motionStates.push_back(InstanceMotionState(targets, index));
+    btVector3 inertia(0.0f, 0.0f, 0.0f);
+    shapes[shape]->calculateLocalInertia(mass, inertia);
+    btRigidBody::btRigidBodyConstructionInfo info(mass, &motionStates.back(), shapes[shape], inertia);
+    // Without damping, the bodies of a pile keep rocking each other long after they have landed, and the pile never
+    // sleeps
+    info.m_linearDamping = 0.1f;
+    info.m_angularDamping = 0.5f;
+    btRigidBody *body = new btRigidBody(info);
+    world->addRigidBody(body);
+    bodies.push_back(body);
+    awake.push_back(1);
+    active++;
+    return true;
+}
+
+int PhysicsWorld::update(double elapsed)
+{
+    double start = clockTime();
+    // Bullet returns the steps the time was worth, even those beyond 'maxSubSteps' that it drops
+    int steps = btMin(world->stepSimulation((btScalar)elapsed, maxSubSteps, fixedTimeStep), maxSubSteps);
+    if (steps > 0)
+    {
+        // Bullet no longer writes the motion states of the bodies that fell asleep, whose last transform was
+        // extrapolated from their last step : give them the one of the step, where they stay
+        active = 0;
+        for (unsigned int i = 0; i < bodies.size(); i++)
+        {
+            bool isActive = bodies[i]->isActive();
+            if (awake[i] && !isActive)
+            {
+                motionStates[i].setWorldTransform(bodies[i]->getWorldTransform());
+            }
+            awake[i] = isActive;
+            active += isActive;
+        }
+    }
+    statistics.stepTime += clockTime() - start;
+    statistics.updates++;
+    statistics.steps += steps;
+    statistics.totalSteps += steps;
+    return steps;
+}
+
+void PhysicsWorld::getBodyTransform(unsigned int body, glm::vec3 &position, glm::quat &rotation) const
+{
+    const btTransform &transform = bodies[body]->getWorldTransform();
+    btQuaternion q = transform.getRotation();
+    position = glm::vec3(transform.getOrigin().x(), transform.getOrigin().y(), transform.getOrigin().z());
+    rotation = glm::quat(q.w(), q.x(), q.y(), q.z());
+}
+
+void PhysicsWorld::resetStats()
+{
+    statistics.updates = 0;
+    statistics.steps = 0;
+    statistics.stepTime = 0.0;
+}
@@ -0,0 +1,134 @@
+#ifndef PHYSICS_HPP
+#define PHYSICS_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <LinearMath/btMotionState.h>
+
+class btBroadphaseInterface;
+class btCollisionDispatcher;
+class btCollisionShape;
+class btDefaultCollisionConfiguration;
+class btDiscreteDynamicsWorld;
+class btRigidBody;
+class btSequentialImpulseConstraintSolver;
+
+struct BoundingSpheres;
+struct Transforms;
+
+// The arrays a renderer draws instances from, which the bodies of a PhysicsWorld move. Only the position and the
+// rotation of Transforms are written : the scale must be 1, the shapes being the size of the meshes. 'bounds' and
+// 'modelMatrices' are optional, the center of the spheres is 'boundsCenter' in model space and their radius is left
+// as it is.
+struct InstanceTargets
+{
+    Transforms *transforms;
+    BoundingSpheres *bounds;  // NULL : not written
+    glm::mat4 *modelMatrices; // NULL : not written
+    glm::vec3 boundsCenter;
+};
+
+// The motion state of the body of instance 'index' : Bullet reads the starting transform from the Transforms of the
+// targets, then writes the transform of every frame straight back there, for the bodies that moved, instead of each
+// body keeping its own that the renderer would copy.
+class InstanceMotionState : public btMotionState
+{
+  public:
+    InstanceMotionState(const InstanceTargets *targets, unsigned int index) : targets(targets), index(index)
+    {
+    }
+
+    void getWorldTransform(btTransform &worldTransform) const;
+    void setWorldTransform(const btTransform &worldTransform);
+
+  private:
+    const InstanceTargets *targets;
+    unsigned int index;
+};
+
+struct PhysicsStats
+{
+    unsigned int updates;          // calls to update()
+    unsigned int steps;            // fixed steps those took
+    double stepTime;               // in seconds, in stepSimulation : the steps and the writes of the motion states
+    unsigned long long totalSteps; // since create(), not reset
+};
+
+// Rigid bodies on a static ground plane, with the gravity along -Z like the scenes of the tutorials (z is up).
+//
+// update() takes the time the frame took and simulates it in steps of a fixed length, whatever the frame rate :
+// what is left of a step waits for the next frames, and the motion states get transforms interpolated between the
+// last two steps, so that the bodies move smoothly when the frames are shorter than a step. A frame too long for
+// 'maxSubSteps' steps loses the rest of its time : the simulation slows down instead of falling further behind. As
+// long as each step takes the same input, the bodies are where they would be with any other frame times after the
+// same number of steps.
+class PhysicsWorld
+{
+  public:
+    PhysicsWorld();
+    ~PhysicsWorld();
+
+    // Room for 'maxBodies' bodies : the motion states are in one array, which never moves
+    void create(unsigned int maxBodies, float groundHeight = 0.0f, float fixedTimeStep = 1.0f / 60.0f,
+                int maxSubSteps = 4);
+    void destroy();
+
+    // The convex hull of 'vertices', simplified by btShapeHull to at most 42 points, for as many bodies as need it.
+    // Returns its index.
+    unsigned int addConvexHull(const std::vector<glm::vec3> &vertices);
+
+    // A dynamic body of 'shape' for instance 'index' of 'targets', where its Transforms put it. 'targets' must
+    // outlive the world. Returns false when there is no room left.
+    bool addBody(unsigned int shape, float mass, const InstanceTargets *targets, unsigned int index);
+
+    // Simulates 'elapsed' seconds of frame time, see above. Returns the number of steps taken.
+    int update(double elapsed);
+
+    // The length of a step, in seconds : update(timeStep()) takes exactly one step
+    float timeStep() const
+    {
+        return fixedTimeStep;
+    }
+    // The bodies that were not asleep after the last step, that is those that update() moves
+    unsigned int activeBodies() const
+    {
+        return active;
+    }
+    unsigned int bodyCount() const
+    {
+        return bodies.size();
+    }
+    // The transform of body 'body' after the last step, not interpolated
+    void getBodyTransform(unsigned int body, glm::vec3 &position, glm::quat &rotation) const;
+
+    const PhysicsStats &stats() const
+    {
+        return statistics;
+    }
+    void resetStats();
+
+  private:
+    PhysicsWorld(const PhysicsWorld &);
+    PhysicsWorld &operator=(const PhysicsWorld &);
+
+    btDefaultCollisionConfiguration *collisionConfiguration;
+    btCollisionDispatcher *dispatcher;
+    btBroadphaseInterface *broadphase;
+    btSequentialImpulseConstraintSolver *solver;
+    btDiscreteDynamicsWorld *world;
+    btCollisionShape *groundShape;
+    btRigidBody *ground;
+    std::vector<btCollisionShape *> shapes;
+    std::vector<btRigidBody *> bodies;
+    std::vector<InstanceMotionState> motionStates;
+    std::vector<unsigned char> awake; // after the last step
+    float fixedTimeStep;
+    int maxSubSteps;
+    unsigned int active;
+    PhysicsStats statistics;
+};
+
+#endif
@@ -0,0 +1,415 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "clock.hpp"
+#include "jobsystem.hpp"
+#include "profiler.hpp"
+
+// What a thread records, written by that thread only
+struct ProfilerThread
+{
+    char name[32];
+    std::vector<ProfileEvent> events; // a ring of EventsPerThread
+    std::atomic<unsigned long long> written;
+    const char *openNames[Profiler::MaxDepth];
+    double openStarts[Profiler::MaxDepth];
+    unsigned int depth; // open scopes, MaxDepth and more are not recorded
+};
+
+namespace
+{
+const unsigned int NoGpuScope = ~0u;
+
+std::atomic<unsigned int> profilerGenerations(0);
+
+// The state of the calling thread, for the create() of generation 'threadGeneration'
+thread_local ProfilerThread *threadProfile = NULL;
+thread_local unsigned int threadGeneration = 0;
+
+void writeJsonString(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (const char *c = text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// The value below which 'percent' % of the sorted values are
+double percentile(const std::vector<double> &sorted, double percent)
+{
+    size_t index = (size_t)(percent / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+} // namespace
+
+Profiler::Profiler()
+    : enabled(false), generation(0), gpuEnabled(false), gpuClockOffset(0.0), gpuFrame(0), gpuDepth(0), gpuWritten(0),
+      dropped(0)
+{
+    memset(gpuScopeCount, 0, sizeof(gpuScopeCount));
+}
+
+void Profiler::create(bool gpuTimers)
+{
+    generation = ++profilerGenerations;
+    enabled = true;
+    setThreadName("main");
+
+    gpuEnabled = gpuTimers;
+    gpuFrame = 0;
+    gpuDepth = 0;
+    gpuWritten = 0;
+    dropped = 0;
+    memset(gpuScopeCount, 0, sizeof(gpuScopeCount));
+    if (gpuEnabled)
+    {
+        glGenQueries(GpuFrameLatency * 2 * MaxGpuScopesPerFrame, &gpuQueries[0][0]);
+        gpuEvents.resize(EventsPerThread);
+
+        // Both clocks at the same time, to put the GPU scopes on the CPU timeline
+        GLint64 gpuTime = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+        gpuClockOffset = clockTime() - gpuTime * 1e-9;
+    }
+}
+
+void Profiler::destroy()
+{
+    if (!enabled)
+    {
+        return;
+    }
+    enabled = false;
+    generation = 0;
+    for (unsigned int i = 0; i < threads.size(); i++)
+    {
+        delete threads[i];
+    }
+    threads.clear();
+    if (gpuEnabled)
+    {
+        glDeleteQueries(GpuFrameLatency * 2 * MaxGpuScopesPerFrame, &gpuQueries[0][0]);
+        gpuEvents.clear();
+    }
+}
+
+ProfilerThread *Profiler::threadState()
+{
+    if (threadGeneration != generation)
+    {
+        ProfilerThread *thread = new ProfilerThread();
+        thread->events.resize(EventsPerThread);
+        thread->written = 0;
+        thread->depth = 0;
+
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        sprintf(thread->name, "thread %u", (unsigned int)threads.size());
+        threads.push_back(thread);
+        threadProfile = thread;
+        threadGeneration = generation;
+    }
+    return threadProfile;
+}
+
+void Profiler::setThreadName(const char *name)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    ProfilerThread *thread = threadState();
+    strncpy(thread->name, name, sizeof(thread->name) - 1);
+    thread->name[sizeof(thread->name) - 1] = '\0';
+}
+
+void Profiler::beginCpu(const char *name)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    ProfilerThread *thread = threadState();
+    if (thread->depth < MaxDepth)
+    {
+        thread->openNames[thread->depth] = name;
+        thread->openStarts[thread->depth] = clockTime();
+    }
+    thread->depth++;
+}
+
+void Profiler::endCpu()
+{
+    if (!enabled)
+    {
+        return;
+    }
+    ProfilerThread *thread = threadState();
+    if (thread->depth == 0)
+    {
+        return;
+    }
+    thread->depth--;
+    if (thread->depth < MaxDepth)
+    {
+        unsigned long long written = thread->written.load(std::memory_order_relaxed);
+        ProfileEvent &event = thread->events[written % EventsPerThread];
+        event.name = thread->openNames[thread->depth];
+        event.start = thread->openStarts[thread->depth];
+        event.end = clockTime();
+        event.depth = thread->depth;
+        thread->written.store(written + 1, std::memory_order_release);
+    }
+}
+
+void Profiler::beginGpu(const char *name)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    beginCpu(name);
+    if (!gpuEnabled)
+    {
+        return;
+    }
+    unsigned int scope = gpuScopeCount[gpuFrame];
+    if (scope < MaxGpuScopesPerFrame && gpuDepth < MaxDepth)
+    {
+        gpuNames[gpuFrame][scope] = name;
+        gpuDepths[gpuFrame][scope] = gpuDepth;
+        glQueryCounter(gpuQueries[gpuFrame][2 * scope], GL_TIMESTAMP);
+        gpuLastQuery[gpuFrame] = gpuQueries[gpuFrame][2 * scope];
+        gpuScopeCount[gpuFrame]++;
+    }
+    else
+    {
+        scope = NoGpuScope;
+    }
+    if (gpuDepth < MaxDepth)
+    {
+        gpuStack[gpuDepth] = scope;
+    }
+    gpuDepth++;
+}
+
+void Profiler::endGpu()
+{
+    if (!enabled)
+    {
+        return;
+    }
+    if (gpuEnabled && gpuDepth > 0)
+    {
+        gpuDepth--;
+        unsigned int scope = gpuDepth < MaxDepth ? gpuStack[gpuDepth] : NoGpuScope;
+        if (scope != NoGpuScope)
+        {
+            glQueryCounter(gpuQueries[gpuFrame][2 * scope + 1], GL_TIMESTAMP);
+            gpuLastQuery[gpuFrame] = gpuQueries[gpuFrame][2 * scope + 1];
+        }
+    }
+    endCpu();
+}
+
+void Profiler::beginFrame()
+{
+    if (!enabled || !gpuEnabled)
+    {
+        return;
+    }
+    // The queries of this slot were issued GpuFrameLatency frames ago
+    gpuFrame = (gpuFrame + 1) % GpuFrameLatency;
+    readGpuFrame(gpuFrame, false);
+    gpuDepth = 0;
+}
+
+void Profiler::readGpuFrame(unsigned int frame, bool wait)
+{
+    unsigned int count = gpuScopeCount[frame];
+    gpuScopeCount[frame] = 0;
+    if (count == 0)
+    {
+        return;
+    }
+    // Queries finish in order : when the last one is available, they all are
+    if (!wait)
+    {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(gpuLastQuery[frame], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            dropped++;
+            return;
+        }
+    }
+    for (unsigned int scope = 0; scope < count; scope++)
+    {
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(gpuQueries[frame][2 * scope], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(gpuQueries[frame][2 * scope + 1], GL_QUERY_RESULT, &end);
+        ProfileEvent event;
+        event.name = gpuNames[frame][scope];
+        event.start = start * 1e-9 + gpuClockOffset;
+        event.end = end * 1e-9 + gpuClockOffset;
+        event.depth = gpuDepths[frame][scope];
+        recordGpuEvent(event);
+    }
+}
+
+void Profiler::recordGpuEvent(const ProfileEvent &event)
+{
+    gpuEvents[gpuWritten % EventsPerThread] = event;
+    gpuWritten++;
+}
+
+void Profiler::jobStarted(const Job *job, unsigned int worker, void *user)
+{
+    Profiler *profiler = static_cast<Profiler *>(user);
+    // A worker thread that has not recorded anything yet
+    if (profiler->enabled && worker > 0 && threadGeneration != profiler->generation)
+    {
+        char name[32];
+        sprintf(name, "worker %u", worker);
+        profiler->setThreadName(name);
+    }
+    profiler->beginCpu(job->name != NULL ? job->name : "job");
+}
+
+void Profiler::jobFinished(const Job *, unsigned int, void *user)
+{
+    static_cast<Profiler *>(user)->endCpu();
+}
+
+void Profiler::collectEvents(std::vector<ProfileEvent> &events, std::vector<unsigned int> &tracks)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    // The GPU scopes that are still pending, oldest frame first
+    if (gpuEnabled)
+    {
+        for (unsigned int i = 1; i <= GpuFrameLatency; i++)
+        {
+            readGpuFrame((gpuFrame + i) % GpuFrameLatency, true);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (unsigned int t = 0; t <= threads.size(); t++)
+    {
+        const ProfileEvent *ring;
+        unsigned long long written;
+        if (t < threads.size())
+        {
+            ring = &threads[t]->events[0];
+            written = threads[t]->written.load(std::memory_order_acquire);
+        }
+        else
+        {
+            if (!gpuEnabled)
+            {
+                break;
+            }
+            ring = &gpuEvents[0];
+            written = gpuWritten;
+        }
+        unsigned long long first = written > EventsPerThread ? written - EventsPerThread : 0;
+        for (unsigned long long i = first; i < written; i++)
+        {
+            events.push_back(ring[i % EventsPerThread]);
+            tracks.push_back(t);
+        }
+    }
+}
+
+void Profiler::writeStatistics(FILE *file)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    std::vector<ProfileEvent> events;
+    std::vector<unsigned int> tracks;
+    collectEvents(events, tracks);
+
+    // Durations in ms per scope, CPU scopes of all threads together
+    std::map<std::pair<bool, std::string>, std::vector<double> > durations;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        bool gpu = tracks[i] == threads.size();
+        durations[std::make_pair(gpu, std::string(events[i].name))].push_back(
+            1000.0 * (events[i].end - events[i].start));
+    }
+
+    fprintf(file, "%-24s %5s %8s %12s %12s %12s %12s\n", "scope", "on", "count", "total ms", "mean ms", "p50 ms",
+            "p99 ms");
+    for (std::map<std::pair<bool, std::string>, std::vector<double> >::iterator it = durations.begin();
+         it != durations.end(); ++it)
+    {
+        std::vector<double> &values = it->second;
+        std::sort(values.begin(), values.end());
+        double total = 0.0;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            total += values[i];
+        }
+        fprintf(file, "%-24s %5s %8u %12.3f %12.4f %12.4f %12.4f\n", it->first.second.c_str(),
+                it->first.first ? "GPU" : "CPU", (unsigned int)values.size(), total, total / values.size(),
+                percentile(values, 50.0), percentile(values, 99.0));
+    }
+    if (dropped > 0)
+    {
+        fprintf(file, "%u frames of GPU scopes dropped, not ready after %u frames\n", dropped, GpuFrameLatency);
+    }
+}
+
+bool Profiler::writeChromeTrace(const char *path)
+{
+    if (!enabled)
+    {
+        return false;
+    }
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+    std::vector<ProfileEvent> events;
+    std::vector<unsigned int> tracks;
+    collectEvents(events, tracks);
+
+    // Complete events ("X"), in microseconds, one track per thread and one for the GPU
+    fprintf(file, "{\"traceEvents\":[\n");
+    unsigned int trackCount = gpuEnabled ? threads.size() + 1 : threads.size();
+    for (unsigned int t = 0; t < trackCount; t++)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                t > 0 ? ",\n" : "", t);
+        writeJsonString(file, t < threads.size() ? threads[t]->name : "GPU");
+        fprintf(file, "}}");
+    }
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        fprintf(file, ",\n{\"name\":");
+        writeJsonString(file, events[i].name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                tracks[i] == threads.size() ? "gpu" : "cpu", tracks[i], 1e6 * events[i].start,
+                1e6 * (events[i].end - events[i].start));
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
@@ -0,0 +1,156 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <stdio.h>
+
+#include <mutex>
+#include <vector>
+
+struct Job;
+struct ProfilerThread;
+
+// A finished scope. Times are in seconds, on the clockTime() clock (common/clock.hpp), GPU scopes included.
+struct ProfileEvent
+{
+    const char *name;
+    double start;
+    double end;
+    unsigned int depth; // 0 for the outermost scopes
+};
+
+// A frame profiler with nested CPU and GPU scopes.
+//
+// CPU scopes cost two clockTime() and a few stores : every thread writes the scopes it closes to its own ring of
+// EventsPerThread events, the oldest overwritten first. GPU scopes are pairs of glQueryCounter(GL_TIMESTAMP), which
+// nest where GL_TIME_ELAPSED queries cannot. Each frame has its own set of queries, and beginFrame() reads those of
+// GpuFrameLatency frames ago : by then they are done, and a frame whose queries are still not is dropped rather
+// than waited for.
+//
+// Scope names are kept as pointers : use string literals. Scopes must close on the thread that opened them, and GPU
+// scopes in the frame that opened them, on the GL thread. Nothing is recorded before create() or after destroy(),
+// so the scopes can stay in the code.
+//
+// Typical use :
+//     profiler.beginFrame();
+//     {
+//         ProfileScope scope(profiler, "culling");
+//         cullSpheres(frustum, bounds, visible);
+//     }
+//     {
+//         ProfileScope scope(profiler, "submission", true); // timed on the GPU too
+//         renderQueue.submit(glState);
+//     }
+//     ...
+//     profiler.writeStatistics(stdout);
+//     profiler.writeChromeTrace("trace.json"); // for chrome://tracing or ui.perfetto.dev
+class Profiler
+{
+  public:
+    static const unsigned int EventsPerThread = 65536;
+    static const unsigned int MaxDepth = 32;
+    static const unsigned int GpuFrameLatency = 4;
+    static const unsigned int MaxGpuScopesPerFrame = 64;
+
+    Profiler();
+
+    // Starts recording. The calling thread is "main". Without 'gpuTimers', GPU scopes are only CPU scopes.
+    void create(bool gpuTimers = true);
+    void destroy();
+
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    // Names the calling thread in the trace. Job system workers are "worker N", other threads "thread N".
+    void setThreadName(const char *name);
+
+    void beginCpu(const char *name);
+    void endCpu();
+    // Also open and close a CPU scope of the same name
+    void beginGpu(const char *name);
+    void endGpu();
+
+    // Call at the start of every frame, on the GL thread
+    void beginFrame();
+
+    // Instrumentation hooks for JobSystem::setHooks : one scope per job, named after Job::name.
+    //     JobHooks hooks = {Profiler::jobStarted, Profiler::jobFinished, &profiler};
+    static void jobStarted(const Job *job, unsigned int worker, void *user);
+    static void jobFinished(const Job *job, unsigned int worker, void *user);
+
+    // Count, mean, median and 99th percentile of every scope, over the events still in the rings. Call when no
+    // other thread is recording, and not between a beginGpu() and its endGpu() : both wait for the GPU.
+    void writeStatistics(FILE *file);
+    bool writeChromeTrace(const char *path);
+    // The events behind both, and the track of each : the index of the thread, or threadCount() for the GPU
+    void collectEvents(std::vector<ProfileEvent> &events, std::vector<unsigned int> &tracks);
+    unsigned int threadCount() const
+    {
+        return threads.size();
+    }
+
+    // Frames whose GPU scopes were not ready in time
+    unsigned int droppedGpuFrames() const
+    {
+        return dropped;
+    }
+
+  private:
+    ProfilerThread *threadState();
+    void readGpuFrame(unsigned int frame, bool wait);
+    void recordGpuEvent(const ProfileEvent &event);
+
+    bool enabled;
+    unsigned int generation; // tells the threads that a new create() happened
+    std::mutex threadsMutex;
+    std::vector<ProfilerThread *> threads;
+
+    bool gpuEnabled;
+    double gpuClockOffset; // clockTime() - GL_TIMESTAMP
+    unsigned int gpuFrame;
+    GLuint gpuQueries[GpuFrameLatency][2 * MaxGpuScopesPerFrame];
+    const char *gpuNames[GpuFrameLatency][MaxGpuScopesPerFrame];
+    unsigned int gpuDepths[GpuFrameLatency][MaxGpuScopesPerFrame];
+    unsigned int gpuScopeCount[GpuFrameLatency];
+    GLuint gpuLastQuery[GpuFrameLatency];
+    unsigned int gpuStack[MaxDepth];
+    unsigned int gpuDepth;
+    std::vector<ProfileEvent> gpuEvents; // a ring, like the ones of the threads
+    unsigned long long gpuWritten;
+    unsigned int dropped;
+};
+
+// Opens a scope for its lifetime
+class ProfileScope
+{
+  public:
+    ProfileScope(Profiler &profiler, const char *name, bool gpu = false) : profiler(profiler), gpu(gpu)
+    {
+        if (gpu)
+        {
+            profiler.beginGpu(name);
+        }
+        else
+        {
+            profiler.beginCpu(name);
+        }
+    }
+    ~ProfileScope()
+    {
+        if (gpu)
+        {
+            profiler.endGpu();
+        }
+        else
+        {
+            profiler.endCpu();
+        }
+    }
+
+  private:
+    Profiler &profiler;
+    bool gpu;
+};
+
+#endif
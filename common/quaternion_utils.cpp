@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/euler_angles.hpp>
@@ -135,7 +136,30 @@ quat RotateTowards(quat q1, quat q2, float maxAngle){
 
 
 
-void tests(){
+// 1 if q is not the expected rotation, after printing both
+static int checkQuaternion(const char * name, quat q, quat expected, float tolerance){
+	// q and -q are the same rotation
+	float difference = min(length(vec4(q.x - expected.x, q.y - expected.y, q.z - expected.z, q.w - expected.w)),
+	                       length(vec4(q.x + expected.x, q.y + expected.y, q.z + expected.z, q.w + expected.w)));
+	if (!(difference <= tolerance)){
+		printf("%s : (%f %f %f %f), expected (%f %f %f %f)\n", name, q.x, q.y, q.z, q.w,
+		       expected.x, expected.y, expected.z, expected.w);
+		return 1;
+	}
+	return 0;
+}
+
+// 1 if v is not the expected vector, after printing both
+static int checkVector(const char * name, vec3 v, vec3 expected, float tolerance){
+	if (!(length(v - expected) <= tolerance)){
+		printf("%s : (%f %f %f), expected (%f %f %f)\n", name, v.x, v.y, v.z, expected.x, expected.y, expected.z);
+		return 1;
+	}
+	return 0;
+}
+
+// The functions above, on the cases where they are easy to get wrong
+int QuaternionUtilsTests(){
 
 	glm::vec3 Xpos(+1.0f,  0.0f,  0.0f);
 	glm::vec3 Ypos( 0.0f, +1.0f,  0.0f);
@@ -143,22 +167,68 @@ void tests(){
 	glm::vec3 Xneg(-1.0f,  0.0f,  0.0f);
 	glm::vec3 Yneg( 0.0f, -1.0f,  0.0f);
 	glm::vec3 Zneg( 0.0f,  0.0f, -1.0f);
+	const float tolerance = 1e-5f;
+	int failures = 0;
 	
 	// Testing standard, easy case
-	// Must be 90 rotation on X : 0.7 0 0 0.7
+	// Must be 90 degrees rotation on X : 0.7 0 0 0.7
 	quat X90rot = RotationBetweenVectors(Ypos, Zpos);
+	failures += checkQuaternion("RotationBetweenVectors(Y, Z)", X90rot, angleAxis(radians(90.0f), Xpos), tolerance);
+	failures += checkVector("RotationBetweenVectors(Y, Z) * Y", X90rot * Ypos, Zpos, tolerance);
 	
 	// Testing with v1 = v2
 	// Must be identity : 0 0 0 1
 	quat id = RotationBetweenVectors(Xpos, Xpos);
+	failures += checkQuaternion("RotationBetweenVectors(X, X)", id, quat(), tolerance);
 	
 	// Testing with v1 = -v2
-	// Must be 180 on +/-Y axis : 0 +/-1 0 0
+	// Must be 180 degrees on +/-Y axis : 0 +/-1 0 0
 	quat Y180rot = RotationBetweenVectors(Xpos, Xneg);
+	failures += checkQuaternion("RotationBetweenVectors(X, -X)", Y180rot, quat(0.0f, 0.0f, 1.0f, 0.0f), tolerance);
+	failures += checkVector("RotationBetweenVectors(X, -X) * X", Y180rot * Xpos, Xneg, tolerance);
 	
 	// Testing with v1 = -v2, but with a "bad first guess"
-	// Must be 180 on +/-Y axis : 0 +/-1 0 0
-	quat X180rot = RotationBetweenVectors(Zpos, Zneg);
-	
-
-}
\ No newline at end of file
+	// Must be 180 degrees on +/-Y axis : 0 +/-1 0 0
+	quat Y180rotBadGuess = RotationBetweenVectors(Zpos, Zneg);
+	failures += checkQuaternion("RotationBetweenVectors(Z, -Z)", Y180rotBadGuess, quat(0.0f, 0.0f, 1.0f, 0.0f),
+	                            tolerance);
+	failures += checkVector("RotationBetweenVectors(Z, -Z) * Z", Y180rotBadGuess * Zpos, Zneg, tolerance);
+	
+	// Not normalized, nor perpendicular
+	vec3 start(1.0f, 2.0f, 3.0f), dest(-4.0f, 0.5f, 2.0f);
+	failures += checkVector("RotationBetweenVectors(start, dest) * start",
+	                        RotationBetweenVectors(start, dest) * normalize(start), normalize(dest), tolerance);
+	
+	// Looking along -X with Z up : the front (+Z) goes to -X, the up (+Y) to +Z
+	quat look = LookAt(Xneg, Zpos);
+	failures += checkVector("LookAt(-X, Z) * Z", look * Zpos, Xneg, tolerance);
+	failures += checkVector("LookAt(-X, Z) * Y", look * Ypos, Zpos, tolerance);
+	
+	// The desired up is made perpendicular to the direction
+	look = LookAt(vec3(1.0f, 1.0f, 0.0f), Ypos);
+	failures += checkVector("LookAt(X+Y, Y) * Z", look * Zpos, normalize(vec3(1.0f, 1.0f, 0.0f)), tolerance);
+	failures += checkVector("LookAt(X+Y, Y) * Y", look * Ypos, normalize(vec3(-1.0f, 1.0f, 0.0f)), tolerance);
+	
+	// Too short a direction : identity
+	failures += checkQuaternion("LookAt(0, Y)", LookAt(vec3(0.0f), Ypos), quat(), tolerance);
+	
+	// maxAngle is the angle between the quaternions, half the one of the rotation : 90 degrees
+	// to go, 30 allowed, gives about 60, within a degree as this is not exactly slerp()
+	quat from = quat(), to = angleAxis(radians(90.0f), Ypos);
+	failures += checkQuaternion("RotateTowards(0, 90, 30)", RotateTowards(from, to, radians(30.0f)),
+	                            angleAxis(radians(60.0f), Ypos), 0.01f);
+	
+	// More allowed than needed, or the same rotation : there already
+	failures += checkQuaternion("RotateTowards(0, 90, 100)", RotateTowards(from, to, radians(100.0f)), to, tolerance);
+	failures += checkQuaternion("RotateTowards(90, 90, 30)", RotateTowards(to, to, radians(30.0f)), to, tolerance);
+	
+	// Nothing allowed : where it was
+	failures += checkQuaternion("RotateTowards(0, 90, 0)", RotateTowards(from, to, 0.0f), from, tolerance);
+	
+	// The short way around : -to is the same rotation as to
+	quat toNegated = to * -1.0f;
+	failures += checkQuaternion("RotateTowards(0, -90, 30)", RotateTowards(from, toNegated, radians(30.0f)),
+	                            angleAxis(radians(60.0f), Ypos), 0.01f);
+
+	return failures;
+}
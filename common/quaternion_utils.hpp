@@ -7,5 +7,8 @@ quat LookAt(vec3 direction, vec3 desiredUp);
 
 quat RotateTowards(quat q1, quat q2, float maxAngle);
 
+// Checks the functions above, prints what fails and returns how many did
+int QuaternionUtilsTests();
+
 
 #endif // QUATERNION_UTILS_H
\ No newline at end of file
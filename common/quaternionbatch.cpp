@@ -0,0 +1,611 @@
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QUATERNIONBATCH_SSE
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX__)
+#define QUATERNIONBATCH_AVX
+#include <immintrin.h>
+#endif
+
+#include "quaternionbatch.hpp"
+
+void Quaternions::resize(unsigned int count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    w.resize(count, 1.0f);
+}
+
+void Quaternions::set(unsigned int i, const glm::quat &q)
+{
+    x[i] = q.x;
+    y[i] = q.y;
+    z[i] = q.z;
+    w[i] = q.w;
+}
+
+void Vectors::resize(unsigned int count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+}
+
+void Vectors::set(unsigned int i, const glm::vec3 &v)
+{
+    x[i] = v.x;
+    y[i] = v.y;
+    z[i] = v.z;
+}
+
+namespace
+{
+// One element, or one element per lane of a SIMD register : the kernels below are written once for all of them.
+// Comparisons give a Mask, and select() picks between two values lane by lane.
+struct Mask1
+{
+    bool v;
+};
+
+struct Float1
+{
+    typedef Mask1 Mask;
+    float v;
+
+    Float1()
+    {
+    }
+    Float1(float f) : v(f)
+    {
+    }
+    static Float1 load(const float *p)
+    {
+        return *p;
+    }
+    void store(float *p) const
+    {
+        *p = v;
+    }
+};
+
+inline Float1 operator+(Float1 a, Float1 b)
+{
+    return a.v + b.v;
+}
+inline Float1 operator-(Float1 a, Float1 b)
+{
+    return a.v - b.v;
+}
+inline Float1 operator*(Float1 a, Float1 b)
+{
+    return a.v * b.v;
+}
+inline Float1 operator/(Float1 a, Float1 b)
+{
+    return a.v / b.v;
+}
+inline Float1 sqrt(Float1 a)
+{
+    return sqrtf(a.v);
+}
+inline Float1 abs(Float1 a)
+{
+    return fabsf(a.v);
+}
+inline Mask1 operator<(Float1 a, Float1 b)
+{
+    Mask1 m = {a.v < b.v};
+    return m;
+}
+inline Mask1 operator>(Float1 a, Float1 b)
+{
+    Mask1 m = {a.v > b.v};
+    return m;
+}
+inline Mask1 operator<=(Float1 a, Float1 b)
+{
+    Mask1 m = {a.v <= b.v};
+    return m;
+}
+inline Mask1 operator|(Mask1 a, Mask1 b)
+{
+    Mask1 m = {a.v || b.v};
+    return m;
+}
+inline Float1 select(Mask1 m, Float1 a, Float1 b)
+{
+    return m.v ? a : b;
+}
+
+#ifdef QUATERNIONBATCH_SSE
+
+struct Mask4
+{
+    __m128 v;
+};
+
+struct Float4
+{
+    typedef Mask4 Mask;
+    __m128 v;
+
+    Float4()
+    {
+    }
+    Float4(float f) : v(_mm_set1_ps(f))
+    {
+    }
+    Float4(__m128 m) : v(m)
+    {
+    }
+    static Float4 load(const float *p)
+    {
+        return _mm_loadu_ps(p);
+    }
+    void store(float *p) const
+    {
+        _mm_storeu_ps(p, v);
+    }
+};
+
+inline Float4 operator+(Float4 a, Float4 b)
+{
+    return _mm_add_ps(a.v, b.v);
+}
+inline Float4 operator-(Float4 a, Float4 b)
+{
+    return _mm_sub_ps(a.v, b.v);
+}
+inline Float4 operator*(Float4 a, Float4 b)
+{
+    return _mm_mul_ps(a.v, b.v);
+}
+inline Float4 operator/(Float4 a, Float4 b)
+{
+    return _mm_div_ps(a.v, b.v);
+}
+inline Float4 sqrt(Float4 a)
+{
+    return _mm_sqrt_ps(a.v);
+}
+inline Float4 abs(Float4 a)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v);
+}
+inline Mask4 operator<(Float4 a, Float4 b)
+{
+    Mask4 m = {_mm_cmplt_ps(a.v, b.v)};
+    return m;
+}
+inline Mask4 operator>(Float4 a, Float4 b)
+{
+    Mask4 m = {_mm_cmpgt_ps(a.v, b.v)};
+    return m;
+}
+inline Mask4 operator<=(Float4 a, Float4 b)
+{
+    Mask4 m = {_mm_cmple_ps(a.v, b.v)};
+    return m;
+}
+inline Mask4 operator|(Mask4 a, Mask4 b)
+{
+    Mask4 m = {_mm_or_ps(a.v, b.v)};
+    return m;
+}
+inline Float4 select(Mask4 m, Float4 a, Float4 b)
+{
+    return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+}
+
+#endif
+
+#ifdef QUATERNIONBATCH_AVX
+
+struct Mask8
+{
+    __m256 v;
+};
+
+struct Float8
+{
+    typedef Mask8 Mask;
+    __m256 v;
+
+    Float8()
+    {
+    }
+    Float8(float f) : v(_mm256_set1_ps(f))
+    {
+    }
+    Float8(__m256 m) : v(m)
+    {
+    }
+    static Float8 load(const float *p)
+    {
+        return _mm256_loadu_ps(p);
+    }
+    void store(float *p) const
+    {
+        _mm256_storeu_ps(p, v);
+    }
+};
+
+inline Float8 operator+(Float8 a, Float8 b)
+{
+    return _mm256_add_ps(a.v, b.v);
+}
+inline Float8 operator-(Float8 a, Float8 b)
+{
+    return _mm256_sub_ps(a.v, b.v);
+}
+inline Float8 operator*(Float8 a, Float8 b)
+{
+    return _mm256_mul_ps(a.v, b.v);
+}
+inline Float8 operator/(Float8 a, Float8 b)
+{
+    return _mm256_div_ps(a.v, b.v);
+}
+inline Float8 sqrt(Float8 a)
+{
+    return _mm256_sqrt_ps(a.v);
+}
+inline Float8 abs(Float8 a)
+{
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v);
+}
+inline Mask8 operator<(Float8 a, Float8 b)
+{
+    Mask8 m = {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)};
+    return m;
+}
+inline Mask8 operator>(Float8 a, Float8 b)
+{
+    Mask8 m = {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)};
+    return m;
+}
+inline Mask8 operator<=(Float8 a, Float8 b)
+{
+    Mask8 m = {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)};
+    return m;
+}
+inline Mask8 operator|(Mask8 a, Mask8 b)
+{
+    Mask8 m = {_mm256_or_ps(a.v, b.v)};
+    return m;
+}
+inline Float8 select(Mask8 m, Float8 a, Float8 b)
+{
+    return _mm256_blendv_ps(b.v, a.v, m.v);
+}
+
+#endif
+
+// Abramowitz and Stegun 4.4.46 on [0, 1], and acos(-x) = pi - acos(x)
+template <typename F> inline F acosLanes(F x)
+{
+    F a = abs(x);
+    F p(-0.0012624911f);
+    p = p * a + F(0.0066700901f);
+    p = p * a + F(-0.0170881256f);
+    p = p * a + F(0.0308918810f);
+    p = p * a + F(-0.0501743046f);
+    p = p * a + F(0.0889789874f);
+    p = p * a + F(-0.2145988016f);
+    p = p * a + F(1.5707963050f);
+    F result = sqrt(F(1.0f) - a) * p;
+    return select(x < F(0.0f), F(3.14159265f) - result, result);
+}
+
+// x - x^3 / 3! + x^5 / 5! - ... - x^11 / 11!, Horner's way
+template <typename F> inline F sinLanes(F x)
+{
+    F x2 = x * x;
+    F p(-1.0f / 39916800.0f);
+    p = p * x2 + F(1.0f / 362880.0f);
+    p = p * x2 + F(-1.0f / 5040.0f);
+    p = p * x2 + F(1.0f / 120.0f);
+    p = p * x2 + F(-1.0f / 6.0f);
+    p = p * x2 + F(1.0f);
+    return x * p;
+}
+
+template <typename F> struct Quat
+{
+    F x, y, z, w;
+};
+
+template <typename F> struct Vec3
+{
+    F x, y, z;
+};
+
+template <typename F> inline Vec3<F> cross(const Vec3<F> &a, const Vec3<F> &b)
+{
+    Vec3<F> c = {a.y * b.z - b.y * a.z, a.z * b.x - b.z * a.x, a.x * b.y - b.x * a.y};
+    return c;
+}
+
+template <typename F> inline F dot(const Vec3<F> &a, const Vec3<F> &b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template <typename F> inline Vec3<F> normalize(const Vec3<F> &v)
+{
+    F inverseLength = F(1.0f) / sqrt(dot(v, v));
+    Vec3<F> n = {v.x * inverseLength, v.y * inverseLength, v.z * inverseLength};
+    return n;
+}
+
+template <typename F> inline Vec3<F> select(typename F::Mask m, const Vec3<F> &a, const Vec3<F> &b)
+{
+    Vec3<F> v = {select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z)};
+    return v;
+}
+
+template <typename F> inline Quat<F> select(typename F::Mask m, const Quat<F> &a, const Quat<F> &b)
+{
+    Quat<F> q = {select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z), select(m, a.w, b.w)};
+    return q;
+}
+
+// p * q, rotating by q then by p
+template <typename F> inline Quat<F> multiply(const Quat<F> &p, const Quat<F> &q)
+{
+    Quat<F> r = {p.w * q.x + p.x * q.w + p.y * q.z - p.z * q.y, p.w * q.y + p.y * q.w + p.z * q.x - p.x * q.z,
+                 p.w * q.z + p.z * q.w + p.x * q.y - p.y * q.x, p.w * q.w - p.x * q.x - p.y * q.y - p.z * q.z};
+    return r;
+}
+
+template <typename F> inline Vec3<F> rotate(const Quat<F> &q, const Vec3<F> &v)
+{
+    Vec3<F> axis = {q.x, q.y, q.z};
+    Vec3<F> uv = cross(axis, v);
+    Vec3<F> uuv = cross(axis, uv);
+    F two(2.0f);
+    Vec3<F> r = {v.x + (uv.x * q.w + uuv.x) * two, v.y + (uv.y * q.w + uuv.y) * two, v.z + (uv.z * q.w + uuv.z) * two};
+    return r;
+}
+
+// RotationBetweenVectors(), both ways, then the one of each lane
+template <typename F> inline Quat<F> rotationBetweenLanes(Vec3<F> start, Vec3<F> dest)
+{
+    start = normalize(start);
+    dest = normalize(dest);
+    F cosTheta = dot(start, dest);
+    F zero(0.0f), one(1.0f);
+
+    // Opposite vectors : half a turn around an axis perpendicular to start, favoring the up axis
+    Vec3<F> zAxis = {zero, zero, one}, xAxis = {one, zero, zero};
+    Vec3<F> aroundUp = cross(zAxis, start);
+    Vec3<F> opposite = normalize(select(dot(aroundUp, aroundUp) < F(0.01f), cross(xAxis, start), aroundUp));
+    F halfTurnSin(sinf(glm::radians(180.0f) * 0.5f));
+    Quat<F> halfTurn = {opposite.x * halfTurnSin, opposite.y * halfTurnSin, opposite.z * halfTurnSin,
+                        F(cosf(glm::radians(180.0f) * 0.5f))};
+
+    // Stan Melax's, from Game Programming Gems 1
+    Vec3<F> axis = cross(start, dest);
+    F s = sqrt((one + cosTheta) * F(2.0f));
+    F invs = one / s;
+    Quat<F> rotation = {axis.x * invs, axis.y * invs, axis.z * invs, s * F(0.5f)};
+
+    return select(cosTheta < F(-1.0f + 0.001f), halfTurn, rotation);
+}
+
+struct RotationBetweenVectorsKernel
+{
+    const Vectors &start;
+    const Vectors &dest;
+    Quaternions &out;
+
+    template <typename F> void run(unsigned int i) const
+    {
+        Vec3<F> a = {F::load(&start.x[i]), F::load(&start.y[i]), F::load(&start.z[i])};
+        Vec3<F> b = {F::load(&dest.x[i]), F::load(&dest.y[i]), F::load(&dest.z[i])};
+        Quat<F> q = rotationBetweenLanes(a, b);
+        q.x.store(&out.x[i]);
+        q.y.store(&out.y[i]);
+        q.z.store(&out.z[i]);
+        q.w.store(&out.w[i]);
+    }
+};
+
+struct LookAtKernel
+{
+    const Vectors &directions;
+    glm::vec3 desiredUp;
+    Quaternions &out;
+
+    template <typename F> void run(unsigned int i) const
+    {
+        Vec3<F> direction = {F::load(&directions.x[i]), F::load(&directions.y[i]), F::load(&directions.z[i])};
+        Vec3<F> up = {F(desiredUp.x), F(desiredUp.y), F(desiredUp.z)};
+        F zero(0.0f), one(1.0f);
+
+        // The up that is perpendicular to the direction
+        Vec3<F> right = cross(direction, up);
+        up = cross(right, direction);
+
+        // From the front of the object, +Z, to the direction, then from its rotated up to the desired one
+        Vec3<F> front = {zero, zero, one}, objectUp = {zero, one, zero};
+        Quat<F> rot1 = rotationBetweenLanes(front, direction);
+        Quat<F> rot2 = rotationBetweenLanes(rotate(rot1, objectUp), up);
+        Quat<F> identity = {zero, zero, zero, one};
+        Quat<F> q = select(dot(direction, direction) < F(0.0001f), identity, multiply(rot2, rot1));
+
+        q.x.store(&out.x[i]);
+        q.y.store(&out.y[i]);
+        q.z.store(&out.z[i]);
+        q.w.store(&out.w[i]);
+    }
+};
+
+struct RotateTowardsKernel
+{
+    const Quaternions &from;
+    const Quaternions &to;
+    float maxAngle;
+    Quaternions &out;
+
+    template <typename F> void run(unsigned int i) const
+    {
+        Quat<F> q1 = {F::load(&from.x[i]), F::load(&from.y[i]), F::load(&from.z[i]), F::load(&from.w[i])};
+        Quat<F> q2 = {F::load(&to.x[i]), F::load(&to.y[i]), F::load(&to.z[i]), F::load(&to.w[i])};
+        F zero(0.0f), one(1.0f), minusOne(-1.0f), angleLimit(maxAngle);
+
+        F cosTheta = (q1.x * q2.x + q1.y * q2.y) + (q1.z * q2.z + q1.w * q2.w);
+        typename F::Mask equal = cosTheta > F(0.9999f);
+
+        // Avoid taking the long path around the sphere
+        typename F::Mask longPath = cosTheta < zero;
+        Quat<F> negated = {q1.x * minusOne, q1.y * minusOne, q1.z * minusOne, q1.w * minusOne};
+        q1 = select(longPath, negated, q1);
+        cosTheta = select(longPath, cosTheta * minusOne, cosTheta);
+
+        // Close enough to get there this time
+        F angle = acosLanes(cosTheta);
+        typename F::Mask arrived = angle < angleLimit;
+
+        // Like slerp(), with a custom t
+        F t = angleLimit / angle;
+        F a = sinLanes((one - t) * angleLimit), b = sinLanes(t * angleLimit), s = sinLanes(angleLimit);
+        Quat<F> q = {(a * q1.x + b * q2.x) / s, (a * q1.y + b * q2.y) / s, (a * q1.z + b * q2.z) / s,
+                     (a * q1.w + b * q2.w) / s};
+        F length = sqrt((q.x * q.x + q.y * q.y) + (q.z * q.z + q.w * q.w));
+        F oneOverLength = one / length;
+        Quat<F> normalized = {q.x * oneOverLength, q.y * oneOverLength, q.z * oneOverLength, q.w * oneOverLength};
+        Quat<F> identity = {zero, zero, zero, one};
+        q = select(length <= zero, identity, normalized);
+
+        q = select(equal | arrived, q2, q);
+        q.x.store(&out.x[i]);
+        q.y.store(&out.y[i]);
+        q.z.store(&out.z[i]);
+        q.w.store(&out.w[i]);
+    }
+};
+
+// 8 elements at a time with AVX, then 4 with SSE, then one at a time
+template <typename Kernel> void runKernel(const Kernel &kernel, unsigned int first, unsigned int last, bool simd)
+{
+    unsigned int i = first;
+    if (simd)
+    {
+#ifdef QUATERNIONBATCH_AVX
+        for (; i + 8 <= last; i += 8)
+        {
+            kernel.template run<Float8>(i);
+        }
+#endif
+#ifdef QUATERNIONBATCH_SSE
+        for (; i + 4 <= last; i += 4)
+        {
+            kernel.template run<Float4>(i);
+        }
+#endif
+    }
+    for (; i < last; i++)
+    {
+        kernel.template run<Float1>(i);
+    }
+}
+
+void rotationBetweenVectors(const Vectors &start, const Vectors &dest, unsigned int first, unsigned int last,
+                            Quaternions &out, bool simd)
+{
+    RotationBetweenVectorsKernel kernel = {start, dest, out};
+    runKernel(kernel, first, last, simd);
+}
+
+void lookAt(const Vectors &directions, const glm::vec3 &desiredUp, unsigned int first, unsigned int last,
+            Quaternions &out, bool simd)
+{
+    LookAtKernel kernel = {directions, desiredUp, out};
+    runKernel(kernel, first, last, simd);
+}
+
+void rotateTowards(const Quaternions &from, const Quaternions &to, float maxAngle, unsigned int first,
+                   unsigned int last, Quaternions &out, bool simd)
+{
+    if (maxAngle < 0.001f)
+    {
+        // No rotation allowed, which also keeps the kernel from dividing by 0
+        if (&out != &from)
+        {
+            std::copy(from.x.begin() + first, from.x.begin() + last, out.x.begin() + first);
+            std::copy(from.y.begin() + first, from.y.begin() + last, out.y.begin() + first);
+            std::copy(from.z.begin() + first, from.z.begin() + last, out.z.begin() + first);
+            std::copy(from.w.begin() + first, from.w.begin() + last, out.w.begin() + first);
+        }
+        return;
+    }
+    RotateTowardsKernel kernel = {from, to, maxAngle, out};
+    runKernel(kernel, first, last, simd);
+}
+} // namespace
+
+void batchRotationBetweenVectors(const Vectors &start, const Vectors &dest, unsigned int first, unsigned int last,
+                                 Quaternions &out)
+{
+    rotationBetweenVectors(start, dest, first, last, out, true);
+}
+
+void batchLookAt(const Vectors &directions, const glm::vec3 &desiredUp, unsigned int first, unsigned int last,
+                 Quaternions &out)
+{
+    lookAt(directions, desiredUp, first, last, out, true);
+}
+
+void batchRotateTowards(const Quaternions &from, const Quaternions &to, float maxAngle, unsigned int first,
+                        unsigned int last, Quaternions &out)
+{
+    rotateTowards(from, to, maxAngle, first, last, out, true);
+}
+
+void batchRotationBetweenVectorsScalar(const Vectors &start, const Vectors &dest, unsigned int first,
+                                       unsigned int last, Quaternions &out)
+{
+    rotationBetweenVectors(start, dest, first, last, out, false);
+}
+
+void batchLookAtScalar(const Vectors &directions, const glm::vec3 &desiredUp, unsigned int first, unsigned int last,
+                       Quaternions &out)
+{
+    lookAt(directions, desiredUp, first, last, out, false);
+}
+
+void batchRotateTowardsScalar(const Quaternions &from, const Quaternions &to, float maxAngle, unsigned int first,
+                              unsigned int last, Quaternions &out)
+{
+    rotateTowards(from, to, maxAngle, first, last, out, false);
+}
+
+float acosApproximation(float x)
+{
+    return acosLanes(Float1(x)).v;
+}
+
+float sinApproximation(float x)
+{
+    return sinLanes(Float1(x)).v;
+}
+
+const char *quaternionBatchInstructionSet()
+{
+#if defined(QUATERNIONBATCH_AVX)
+    return "AVX";
+#elif defined(QUATERNIONBATCH_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,78 @@
+#ifndef QUATERNIONBATCH_HPP
+#define QUATERNIONBATCH_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Quaternions and vectors stored as structures of arrays, like Transforms, so that the kernels below load the same
+// component of 4 (SSE) or 8 (AVX) of them at once
+struct Quaternions
+{
+    std::vector<float> x, y, z, w;
+
+    void resize(unsigned int count);
+    void set(unsigned int i, const glm::quat &q);
+    glm::quat get(unsigned int i) const
+    {
+        return glm::quat(w[i], x[i], y[i], z[i]);
+    }
+    unsigned int size() const
+    {
+        return w.size();
+    }
+};
+
+struct Vectors
+{
+    std::vector<float> x, y, z;
+
+    void resize(unsigned int count);
+    void set(unsigned int i, const glm::vec3 &v);
+    glm::vec3 get(unsigned int i) const
+    {
+        return glm::vec3(x[i], y[i], z[i]);
+    }
+    unsigned int size() const
+    {
+        return x.size();
+    }
+};
+
+// RotationBetweenVectors(), LookAt() and RotateTowards() of quaternion_utils.hpp for the elements [first, last), to
+// orient a whole crowd at once. They handle the same degenerate cases the same way : opposite vectors, a direction
+// too short to look at, no rotation allowed, and already there. 'out' may be one of the inputs.
+//
+// They do the same operations, except for acos and sin, which are the polynomials of acosApproximation() and
+// sinApproximation() : RotateTowards() gives the same rotations within 1e-6 per component. Like the culling
+// kernels, these work on 4 elements at once with SSE and 8 with AVX (USE_AVX in CMakeLists.txt), and on one at a
+// time with the scalar versions, which give exactly the same results. Ranges are independent, so that several
+// threads can share a large batch with JobSystem::parallelFor.
+void batchRotationBetweenVectors(const Vectors &start, const Vectors &dest, unsigned int first, unsigned int last,
+                                 Quaternions &out);
+// The same desired up for every direction, like a crowd on the ground
+void batchLookAt(const Vectors &directions, const glm::vec3 &desiredUp, unsigned int first, unsigned int last,
+                 Quaternions &out);
+// The same largest angle for every element, like a turn rate times the frame time
+void batchRotateTowards(const Quaternions &from, const Quaternions &to, float maxAngle, unsigned int first,
+                        unsigned int last, Quaternions &out);
+
+void batchRotationBetweenVectorsScalar(const Vectors &start, const Vectors &dest, unsigned int first,
+                                       unsigned int last, Quaternions &out);
+void batchLookAtScalar(const Vectors &directions, const glm::vec3 &desiredUp, unsigned int first, unsigned int last,
+                       Quaternions &out);
+void batchRotateTowardsScalar(const Quaternions &from, const Quaternions &to, float maxAngle, unsigned int first,
+                              unsigned int last, Quaternions &out);
+
+// The polynomials of the kernels, one value at a time :
+//  - acos on [-1, 1], sqrt(1 - |x|) times a polynomial of degree 7 (Abramowitz and Stegun 4.4.46) : absolute error
+//    below 2e-8 before rounding, 5e-7 in floats, where an ulp of pi is 2.4e-7
+//  - sin on [-pi/2, pi/2], the Taylor series up to x^11 : absolute error below 6e-8 before rounding, 3e-7 in floats
+float acosApproximation(float x);
+float sinApproximation(float x);
+
+// "AVX", "SSE" or "scalar"
+const char *quaternionBatchInstructionSet();
+
+#endif
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "glstate.hpp"
+#include "mesh.hpp"
+#include "renderqueue.hpp"
+
+static const int DepthBits = 24;
+static const GLuint64 DepthMask = (1 << DepthBits) - 1;
+
+RenderQueue::RenderQueue() : viewMatrix(1.0f), viewProjection(1.0f)
+{
+    memset(&lastStats, 0, sizeof(lastStats));
+}
+
+unsigned int RenderQueue::addProgram(GLuint program)
+{
+    if (programs.size() >= MaxPrograms)
+    {
+        fprintf(stderr, "RenderQueue : too many programs, %u at most\n", MaxPrograms);
+        return 0;
+    }
+    ProgramInfo info;
+    info.program = program;
+    info.mvpLocation = glGetUniformLocation(program, "MVP");
+    info.modelLocation = glGetUniformLocation(program, "M");
+    info.normalLocation = glGetUniformLocation(program, "N");
+    info.viewLocation = glGetUniformLocation(program, "V");
+    info.viewProjectionLocation = glGetUniformLocation(program, "VP");
+    programs.push_back(info);
+    return programs.size() - 1;
+}
+
+unsigned int RenderQueue::addTexture(GLuint texture)
+{
+    if (textures.size() >= MaxTextures)
+    {
+        fprintf(stderr, "RenderQueue : too many textures, %u at most\n", MaxTextures);
+        return 0;
+    }
+    textures.push_back(texture);
+    return textures.size() - 1;
+}
+
+unsigned int RenderQueue::addMesh(const Mesh &mesh, bool doubleSided)
+{
+    if (meshes.size() >= MaxMeshes)
+    {
+        fprintf(stderr, "RenderQueue : too many meshes, %u at most\n", MaxMeshes);
+        return 0;
+    }
+    MeshInfo info;
+    info.mesh = &mesh;
+    info.doubleSided = doubleSided;
+    meshes.push_back(info);
+    return meshes.size() - 1;
+}
+
+GLuint64 RenderQueue::makeKey(Pass pass, unsigned int program, unsigned int texture, unsigned int mesh, float depth)
+{
+    GLuint64 quantizedDepth = (GLuint64)(depth * DepthMask) & DepthMask;
+    GLuint64 key = (GLuint64)pass << 60;
+    if (pass == Opaque)
+    {
+        key |= (GLuint64)(program & (MaxPrograms - 1)) << 52;
+        key |= (GLuint64)(texture & (MaxTextures - 1)) << 40;
+        key |= (GLuint64)(mesh & (MaxMeshes - 1)) << 24;
+        key |= quantizedDepth;
+    }
+    else
+    {
+        // Farthest first, then by state
+        key |= (DepthMask - quantizedDepth) << 36;
+        key |= (GLuint64)(program & (MaxPrograms - 1)) << 28;
+        key |= (GLuint64)(texture & (MaxTextures - 1)) << 16;
+        key |= (GLuint64)(mesh & (MaxMeshes - 1));
+    }
+    return key;
+}
+
+void RenderQueue::begin(const glm::mat4 &view, const glm::mat4 &projection)
+{
+    viewMatrix = view;
+    viewProjection = projection * view;
+    packets.clear();
+    order.clear();
+}
+
+void RenderQueue::add(Pass pass, unsigned int program, unsigned int texture, unsigned int mesh,
+                      const glm::mat4 &model, unsigned int instanceCount)
+{
+    // Same depth as the one the depth buffer will see, in [0,1]
+    glm::vec4 clip = viewProjection * model[3];
+    float depth = 0.0f;
+    if (clip.w > 0.0f)
+    {
+        depth = glm::clamp(0.5f * clip.z / clip.w + 0.5f, 0.0f, 1.0f);
+    }
+
+    Packet packet;
+    packet.model = model;
+    packet.program = program;
+    packet.texture = texture;
+    packet.mesh = mesh;
+    packet.instanceCount = instanceCount;
+    packet.pass = pass;
+
+    SortItem item;
+    item.key = makeKey(pass, program, texture, mesh, depth);
+    item.packet = packets.size();
+
+    packets.push_back(packet);
+    order.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+    unsigned int count = order.size();
+    if (count < 2)
+    {
+        return;
+    }
+    scratch.resize(count);
+
+    // LSD radix sort, one byte at a time. All the histograms are built in a
+    // single read of the keys.
+    unsigned int histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (unsigned int i = 0; i < count; i++)
+    {
+        GLuint64 key = order[i].key;
+        for (int digit = 0; digit < 8; digit++)
+        {
+            histograms[digit][(key >> (8 * digit)) & 0xFF]++;
+        }
+    }
+
+    SortItem *source = &order[0];
+    SortItem *destination = &scratch[0];
+    for (int digit = 0; digit < 8; digit++)
+    {
+        unsigned int *histogram = histograms[digit];
+
+        // Every key has the same byte here (unused bits of the key) : nothing to do
+        if (histogram[(source[0].key >> (8 * digit)) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        unsigned int offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            unsigned int bucketSize = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketSize;
+        }
+        for (unsigned int i = 0; i < count; i++)
+        {
+            destination[histogram[(source[i].key >> (8 * digit)) & 0xFF]++] = source[i];
+        }
+
+        SortItem *swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    if (source != &order[0])
+    {
+        order.swap(scratch);
+    }
+}
+
+void RenderQueue::submit(GLStateCache &state)
+{
+    memset(&lastStats, 0, sizeof(lastStats));
+    lastStats.packets = order.size();
+
+    // V and VP only need to be sent once per program
+    std::vector<bool> programReady(programs.size(), false);
+
+    unsigned int currentProgram = ~0u;
+    unsigned int currentTexture = ~0u;
+    unsigned int currentMesh = ~0u;
+    bool blending = false;
+
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+        const Packet &packet = packets[order[i].packet];
+        const ProgramInfo &program = programs[packet.program];
+        const MeshInfo &mesh = meshes[packet.mesh];
+
+        if (packet.pass == Transparent && !blending)
+        {
+            state.enable(GL_BLEND);
+            state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            state.depthMask(GL_FALSE);
+            blending = true;
+        }
+
+        if (packet.program != currentProgram)
+        {
+            state.useProgram(program.program);
+            if (!programReady[packet.program])
+            {
+                if (program.viewLocation >= 0)
+                {
+                    glUniformMatrix4fv(program.viewLocation, 1, GL_FALSE, &viewMatrix[0][0]);
+                }
+                if (program.viewProjectionLocation >= 0)
+                {
+                    glUniformMatrix4fv(program.viewProjectionLocation, 1, GL_FALSE, &viewProjection[0][0]);
+                }
+                programReady[packet.program] = true;
+            }
+            currentProgram = packet.program;
+            lastStats.programSwitches++;
+        }
+        if (packet.texture != currentTexture)
+        {
+            state.bindTexture(0, GL_TEXTURE_2D, textures[packet.texture]);
+            currentTexture = packet.texture;
+            lastStats.textureSwitches++;
+        }
+        if (packet.mesh != currentMesh)
+        {
+            if (mesh.doubleSided)
+            {
+                state.disable(GL_CULL_FACE);
+            }
+            else
+            {
+                state.enable(GL_CULL_FACE);
+            }
+            state.bindVertexArray(mesh.mesh->vertexArray());
+            currentMesh = packet.mesh;
+            lastStats.meshSwitches++;
+        }
+
+        if (program.mvpLocation >= 0)
+        {
+            glm::mat4 MVP = viewProjection * packet.model;
+            glUniformMatrix4fv(program.mvpLocation, 1, GL_FALSE, &MVP[0][0]);
+        }
+        if (program.modelLocation >= 0)
+        {
+            glUniformMatrix4fv(program.modelLocation, 1, GL_FALSE, &packet.model[0][0]);
+        }
+        if (program.normalLocation >= 0)
+        {
+            glm::mat3 N = glm::transpose(glm::inverse(glm::mat3(packet.model)));
+            glUniformMatrix3fv(program.normalLocation, 1, GL_FALSE, &N[0][0]);
+        }
+
+        if (packet.instanceCount > 0)
+        {
+            mesh.mesh->drawInstanced(packet.instanceCount);
+        }
+        else
+        {
+            mesh.mesh->draw();
+        }
+    }
+
+    if (blending)
+    {
+        state.disable(GL_BLEND);
+        state.depthMask(GL_TRUE);
+    }
+}
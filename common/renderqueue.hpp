@@ -0,0 +1,122 @@
+#ifndef RENDERQUEUE_HPP
+#define RENDERQUEUE_HPP
+
+// What the queue did during the last submit()
+struct RenderQueueStats
+{
+    unsigned int packets;
+    unsigned int programSwitches;
+    unsigned int textureSwitches;
+    unsigned int meshSwitches;
+
+    unsigned int stateSwitches() const
+    {
+        return programSwitches + textureSwitches + meshSwitches;
+    }
+};
+
+// Collects draw packets during a frame, sorts them with a 64-bit key, and
+// submits them in that order.
+//
+// Programs, textures and meshes are registered once and referred to by the
+// small id that add*() returns. For opaque packets the key is
+//   pass (4 bits) | program (8) | texture (12) | mesh (16) | depth (24)
+// so that submission only changes a piece of state when it has to, and
+// draws front to back within a group, which helps early-Z. Transparent
+// packets come after every opaque one, sorted back to front first :
+//   pass (4 bits) | inverted depth (24) | program (8) | texture (12) | mesh (16)
+//
+// Registered programs may use the StandardShading uniforms : MVP, M and its
+// normal matrix N are set for every packet, V and VP once per program and per
+// frame, when they exist in the program.
+class RenderQueue
+{
+  public:
+    enum Pass
+    {
+        Opaque = 0,
+        Transparent = 1
+    };
+
+    static const unsigned int MaxPrograms = 1 << 8;
+    static const unsigned int MaxTextures = 1 << 12;
+    static const unsigned int MaxMeshes = 1 << 16;
+
+    RenderQueue();
+
+    unsigned int addProgram(GLuint program);
+    unsigned int addTexture(GLuint texture);
+    // Face culling is disabled for double-sided meshes, enabled for the others
+    unsigned int addMesh(const Mesh &mesh, bool doubleSided = false);
+
+    // Empties the queue. The camera is used to compute the depth of the packets.
+    void begin(const glm::mat4 &view, const glm::mat4 &projection);
+
+    // The depth of a packet is the one of the origin of its model matrix.
+    // With instanceCount > 0, the mesh is drawn with glDrawElementsInstanced
+    // and the per-instance attributes that its VAO references.
+    void add(Pass pass, unsigned int program, unsigned int texture, unsigned int mesh, const glm::mat4 &model,
+             unsigned int instanceCount = 0);
+
+    // Radix sort of the keys. Without it, submit() draws in insertion order.
+    void sort();
+
+    // Draws every packet, with state changes going through 'state'
+    void submit(GLStateCache &state);
+
+    const RenderQueueStats &stats() const
+    {
+        return lastStats;
+    }
+    unsigned int size() const
+    {
+        return packets.size();
+    }
+
+    static GLuint64 makeKey(Pass pass, unsigned int program, unsigned int texture, unsigned int mesh, float depth);
+
+  private:
+    struct ProgramInfo
+    {
+        GLuint program;
+        GLint mvpLocation;
+        GLint modelLocation;
+        GLint normalLocation;
+        GLint viewLocation;
+        GLint viewProjectionLocation;
+    };
+    struct MeshInfo
+    {
+        const Mesh *mesh;
+        bool doubleSided;
+    };
+    struct Packet
+    {
+        glm::mat4 model;
+        unsigned int program;
+        unsigned int texture;
+        unsigned int mesh;
+        unsigned int instanceCount;
+        Pass pass;
+    };
+    struct SortItem
+    {
+        GLuint64 key;
+        unsigned int packet;
+    };
+
+    std::vector<ProgramInfo> programs;
+    std::vector<GLuint> textures;
+    std::vector<MeshInfo> meshes;
+
+    glm::mat4 viewMatrix;
+    glm::mat4 viewProjection;
+
+    std::vector<Packet> packets;
+    std::vector<SortItem> order;
+    std::vector<SortItem> scratch;
+
+    RenderQueueStats lastStats;
+};
+
+#endif
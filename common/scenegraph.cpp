@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "culling.hpp"
+#include "scenegraph.hpp"
+#include "transforms.hpp"
+
+const unsigned int SceneGraph::None;
+
+SceneGraph::SceneGraph() : sorted(true)
+{
+    graphStats = SceneGraphStats();
+}
+
+unsigned int SceneGraph::addNode(unsigned int parent, const glm::vec3 &position, const glm::quat &rotation,
+                                 const glm::vec3 &scale)
+{
+    unsigned int node = parents.size();
+    parents.push_back(parent);
+    localPositions.push_back(position);
+    localRotations.push_back(rotation);
+    localScales.push_back(scale);
+    localCenters.push_back(glm::vec3(0.0f));
+    localRadii.push_back(0.0f);
+    slots.push_back(None);
+
+    // The new node goes to its level the next update(), which recomputes everything
+    sorted = false;
+    graphStats.nodes = parents.size();
+    return node;
+}
+
+void SceneGraph::setLocalTransform(unsigned int node, const glm::vec3 &position, const glm::quat &rotation,
+                                   const glm::vec3 &scale)
+{
+    localPositions[node] = position;
+    localRotations[node] = rotation;
+    localScales[node] = scale;
+    if (sorted)
+    {
+        markDirty(slots[node]);
+    }
+}
+
+void SceneGraph::setBounds(unsigned int node, const glm::vec3 &center, float radius)
+{
+    localCenters[node] = center;
+    localRadii[node] = radius;
+    if (sorted)
+    {
+        markDirty(slots[node]);
+    }
+}
+
+void SceneGraph::clear()
+{
+    parents.clear();
+    localPositions.clear();
+    localRotations.clear();
+    localScales.clear();
+    localCenters.clear();
+    localRadii.clear();
+    slots.clear();
+    nodes.clear();
+    parentSlots.clear();
+    firstChildren.clear();
+    childCounts.clear();
+    dirty.clear();
+    moved.clear();
+    world.resize(0);
+    worldMatrices.clear();
+    worldBounds.resize(0);
+    dirtySlots.clear();
+    changed.clear();
+    sorted = true;
+    graphStats = SceneGraphStats();
+}
+
+void SceneGraph::markDirty(unsigned int slot)
+{
+    if (!dirty[slot])
+    {
+        dirty[slot] = 1;
+        dirtySlots.push_back(slot);
+    }
+}
+
+void SceneGraph::sortByDepth()
+{
+    // The children of each node, in the order they were added
+    unsigned int count = parents.size();
+    std::vector<unsigned int> childStarts(count + 1, 0), children(count);
+    for (unsigned int node = 0; node < count; node++)
+    {
+        if (parents[node] != None)
+        {
+            childStarts[parents[node] + 1]++;
+        }
+    }
+    for (unsigned int node = 0; node < count; node++)
+    {
+        childStarts[node + 1] += childStarts[node];
+    }
+    std::vector<unsigned int> filled(childStarts.begin(), childStarts.end() - 1);
+    for (unsigned int node = 0; node < count; node++)
+    {
+        if (parents[node] != None)
+        {
+            children[filled[parents[node]]++] = node;
+        }
+    }
+
+    // Breadth first from the roots : the levels follow each other, and so do the children of a node
+    nodes.clear();
+    parentSlots.clear();
+    for (unsigned int node = 0; node < count; node++)
+    {
+        if (parents[node] == None)
+        {
+            nodes.push_back(node);
+            parentSlots.push_back(None);
+        }
+    }
+    unsigned int roots = nodes.size();
+    firstChildren.resize(count);
+    childCounts.resize(count);
+    std::vector<unsigned int> depths(count, 0);
+    unsigned int levels = count > 0 ? 1 : 0;
+    for (unsigned int slot = 0; slot < nodes.size(); slot++)
+    {
+        unsigned int node = nodes[slot];
+        slots[node] = slot;
+        firstChildren[slot] = nodes.size();
+        childCounts[slot] = childStarts[node + 1] - childStarts[node];
+        for (unsigned int i = childStarts[node]; i < childStarts[node + 1]; i++)
+        {
+            depths[nodes.size()] = depths[slot] + 1;
+            levels = std::max(levels, depths[slot] + 2);
+            nodes.push_back(children[i]);
+            parentSlots.push_back(slot);
+        }
+    }
+
+    // Everything is recomputed from the roots
+    world.resize(count);
+    worldMatrices.resize(count);
+    worldBounds.resize(count);
+    dirty.assign(count, 0);
+    moved.assign(count, 0);
+    dirtySlots.clear();
+    for (unsigned int slot = 0; slot < roots; slot++)
+    {
+        markDirty(slot);
+    }
+    sorted = true;
+    graphStats.depth = levels;
+}
+
+void SceneGraph::updateSlot(unsigned int slot)
+{
+    unsigned int node = nodes[slot];
+    unsigned int parentSlot = parentSlots[slot];
+    glm::vec3 position = localPositions[node];
+    glm::quat rotation = localRotations[node];
+    glm::vec3 scale = localScales[node];
+    if (parentSlot != None)
+    {
+        glm::vec3 parentPosition(world.positionX[parentSlot], world.positionY[parentSlot],
+                                 world.positionZ[parentSlot]);
+        glm::quat parentRotation(world.rotationW[parentSlot], world.rotationX[parentSlot],
+                                 world.rotationY[parentSlot], world.rotationZ[parentSlot]);
+        glm::vec3 parentScale(world.scaleX[parentSlot], world.scaleY[parentSlot], world.scaleZ[parentSlot]);
+        position = parentPosition + parentRotation * (parentScale * position);
+        rotation = parentRotation * rotation;
+        scale = parentScale * scale;
+    }
+    world.set(slot, position, rotation, scale);
+    dirty[slot] = 0;
+}
+
+void SceneGraph::update()
+{
+    if (!sorted)
+    {
+        sortByDepth();
+    }
+    changed.clear();
+
+    if (dirtySlots.size() > nodes.size() / 8)
+    {
+        // Most of the graph moved : one pass over all of it is faster than sorting the dirty nodes
+        for (unsigned int slot = 0; slot < nodes.size(); slot++)
+        {
+            unsigned int parentSlot = parentSlots[slot];
+            if (dirty[slot] || (parentSlot != None && moved[parentSlot]))
+            {
+                moved[slot] = 1;
+                updateSlot(slot);
+                changed.push_back(slot);
+            }
+        }
+    }
+    else
+    {
+        // The subtree of each dirty node, breadth first, with 'changed' as the queue. A dirty node in the subtree of
+        // another has a larger slot, and is already done when its turn comes.
+        std::sort(dirtySlots.begin(), dirtySlots.end());
+        for (unsigned int i = 0; i < dirtySlots.size(); i++)
+        {
+            if (moved[dirtySlots[i]])
+            {
+                continue;
+            }
+            unsigned int next = changed.size();
+            changed.push_back(dirtySlots[i]);
+            moved[dirtySlots[i]] = 1;
+            while (next < changed.size())
+            {
+                unsigned int slot = changed[next++];
+                updateSlot(slot);
+                for (unsigned int child = firstChildren[slot]; child < firstChildren[slot] + childCounts[slot];
+                     child++)
+                {
+                    moved[child] = 1;
+                    changed.push_back(child);
+                }
+            }
+        }
+    }
+    dirtySlots.clear();
+
+    // The world matrices of runs of consecutive slots at once, then the bounds like computeBoundingSpheres()
+    for (unsigned int i = 0; i < changed.size();)
+    {
+        unsigned int first = changed[i], last = first + 1;
+        for (i++; i < changed.size() && changed[i] == last; i++)
+        {
+            last++;
+        }
+        computeModelMatrices(world, first, last, &worldMatrices[first]);
+    }
+    for (unsigned int i = 0; i < changed.size(); i++)
+    {
+        unsigned int slot = changed[i];
+        unsigned int node = nodes[slot];
+        glm::vec3 position, scale;
+        glm::quat rotation;
+        getWorldTransform(node, position, rotation, scale);
+        float largestScale = glm::max(glm::abs(scale.x), glm::max(glm::abs(scale.y), glm::abs(scale.z)));
+        worldBounds.set(slot, position + rotation * (scale * localCenters[node]), localRadii[node] * largestScale);
+
+        moved[slot] = 0;
+        changed[i] = node;
+    }
+    graphStats.updated = changed.size();
+}
+
+void SceneGraph::getWorldTransform(unsigned int node, glm::vec3 &position, glm::quat &rotation,
+                                   glm::vec3 &scale) const
+{
+    unsigned int slot = slots[node];
+    position = glm::vec3(world.positionX[slot], world.positionY[slot], world.positionZ[slot]);
+    rotation = glm::quat(world.rotationW[slot], world.rotationX[slot], world.rotationY[slot], world.rotationZ[slot]);
+    scale = glm::vec3(world.scaleX[slot], world.scaleY[slot], world.scaleZ[slot]);
+}
+
+void SceneGraph::getWorldBounds(unsigned int node, glm::vec3 &center, float &radius) const
+{
+    unsigned int slot = slots[node];
+    center = glm::vec3(worldBounds.centerX[slot], worldBounds.centerY[slot], worldBounds.centerZ[slot]);
+    radius = worldBounds.radius[slot];
+}
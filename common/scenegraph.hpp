@@ -0,0 +1,107 @@
+#ifndef SCENEGRAPH_HPP
+#define SCENEGRAPH_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "culling.hpp"
+#include "transforms.hpp"
+
+struct SceneGraphStats
+{
+    unsigned int nodes;
+    unsigned int depth;   // number of levels
+    unsigned int updated; // nodes whose world transform was recomputed by the last update()
+};
+
+// Nodes with a parent, a local translation, rotation and scale, and a bounding sphere, whose world transforms are
+// only recomputed when they or one of their ancestors moved.
+//
+// The nodes are stored in flat arrays sorted by depth : the roots, then their children, and so on, with the children
+// of a node next to each other. update() walks down the subtrees of the dirty nodes only, parents first, with no
+// recursion : its cost is that of what moved, not of the whole graph, until so much moved that a single pass over
+// all the nodes is cheaper. The world transforms are a Transforms, so that the SIMD kernels of transforms.hpp build
+// the world matrices of runs of nodes that moved.
+//
+// World transforms are composed like those of most engines : rotations and scales multiply, and a scale that is not
+// the same along each axis does not skew the children, it only scales their position.
+//
+// Each frame : setLocalTransform() for what moved, update(), then the renderer reads changedNodes() to refresh only
+// those of its instances.
+class SceneGraph
+{
+  public:
+    static const unsigned int None = ~0u;
+
+    SceneGraph();
+
+    // The parent must already be in the graph, or None for a root. Returns the node, handles never change.
+    unsigned int addNode(unsigned int parent, const glm::vec3 &position = glm::vec3(0.0f),
+                         const glm::quat &rotation = glm::quat(), const glm::vec3 &scale = glm::vec3(1.0f));
+    void setLocalTransform(unsigned int node, const glm::vec3 &position, const glm::quat &rotation,
+                           const glm::vec3 &scale = glm::vec3(1.0f));
+    // In model space. Nodes without bounds have a radius of 0 : cull them with their children, not on their own.
+    void setBounds(unsigned int node, const glm::vec3 &center, float radius);
+    void clear();
+
+    // Sorts the new nodes by depth, then propagates the world transforms and bounds of the dirty nodes to their
+    // subtrees. Nothing happens if no node changed.
+    void update();
+
+    // The nodes whose world transform changed in the last update(), parents before children
+    const std::vector<unsigned int> &changedNodes() const
+    {
+        return changed;
+    }
+
+    unsigned int parent(unsigned int node) const
+    {
+        return parents[node];
+    }
+    // Valid after update()
+    const glm::mat4 &worldMatrix(unsigned int node) const
+    {
+        return worldMatrices[slots[node]];
+    }
+    void getWorldTransform(unsigned int node, glm::vec3 &position, glm::quat &rotation, glm::vec3 &scale) const;
+    void getWorldBounds(unsigned int node, glm::vec3 &center, float &radius) const;
+
+    unsigned int size() const
+    {
+        return parents.size();
+    }
+    const SceneGraphStats &stats() const
+    {
+        return graphStats;
+    }
+
+  private:
+    void sortByDepth();
+    void markDirty(unsigned int slot);
+    // The world transform of a slot from its local one and that of its parent
+    void updateSlot(unsigned int slot);
+
+    // Per node, in the order they were added
+    std::vector<unsigned int> parents;
+    std::vector<glm::vec3> localPositions, localScales, localCenters;
+    std::vector<glm::quat> localRotations;
+    std::vector<float> localRadii;
+    std::vector<unsigned int> slots; // where the node is in the arrays below
+
+    // Per slot, sorted by depth
+    std::vector<unsigned int> nodes;
+    std::vector<unsigned int> parentSlots, firstChildren, childCounts;
+    std::vector<unsigned char> dirty, moved;
+    Transforms world;
+    std::vector<glm::mat4> worldMatrices;
+    BoundingSpheres worldBounds;
+
+    std::vector<unsigned int> dirtySlots;
+    std::vector<unsigned int> changed;
+    bool sorted; // false after addNode(), until update()
+    SceneGraphStats graphStats;
+};
+
+#endif
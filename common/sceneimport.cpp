@@ -0,0 +1,479 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#ifdef USE_ASSIMP
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#endif
+
+#include "sceneimport.hpp"
+
+namespace
+{
+const char CacheMagic[8] = {'S', 'C', 'E', 'N', 'E', 'B', 'I', 'N'};
+const unsigned int CacheVersion = 1;
+
+enum CacheArray
+{
+    Positions,
+    UVs,
+    Normals,
+    Indices,
+    Meshes,
+    Materials,
+    Instances,
+    Strings,
+    ArrayCount
+};
+
+struct CacheHeader
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int steps;
+    unsigned long long sourceSize;
+    long long sourceTime;
+    unsigned int counts[ArrayCount]; // elements
+    unsigned long long offsets[ArrayCount];
+    unsigned long long fileSize;
+};
+
+unsigned long long align16(unsigned long long offset)
+{
+    return (offset + 15) & ~15ull;
+}
+
+void arraysOf(const SceneData &scene, const void *arrays[ArrayCount], unsigned int counts[ArrayCount],
+              unsigned int sizes[ArrayCount])
+{
+    arrays[Positions] = scene.positions;
+    arrays[UVs] = scene.uvs;
+    arrays[Normals] = scene.normals;
+    arrays[Indices] = scene.indices;
+    arrays[Meshes] = scene.meshes;
+    arrays[Materials] = scene.materials;
+    arrays[Instances] = scene.instances;
+    arrays[Strings] = scene.strings;
+    counts[Positions] = counts[UVs] = counts[Normals] = scene.vertexCount;
+    counts[Indices] = scene.indexCount;
+    counts[Meshes] = scene.meshCount;
+    counts[Materials] = scene.materialCount;
+    counts[Instances] = scene.instanceCount;
+    counts[Strings] = scene.stringsSize;
+    sizes[Positions] = sizes[Normals] = sizeof(glm::vec3);
+    sizes[UVs] = sizeof(glm::vec2);
+    sizes[Indices] = sizeof(unsigned int);
+    sizes[Meshes] = sizeof(SceneMesh);
+    sizes[Materials] = sizeof(SceneMaterial);
+    sizes[Instances] = sizeof(SceneInstance);
+    sizes[Strings] = 1;
+}
+
+// The size and modification time of a file, false if there is none
+bool fileStamp(const char *path, unsigned long long &size, long long &time)
+{
+    struct stat status;
+    if (stat(path, &status) != 0)
+    {
+        return false;
+    }
+    size = status.st_size;
+    time = status.st_mtime;
+    return true;
+}
+
+#ifdef USE_ASSIMP
+// AssImp matrices are row-major, GLM ones column-major
+glm::mat4 toGlm(const aiMatrix4x4 &m)
+{
+    return glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+}
+
+unsigned int addString(std::vector<char> &strings, const char *s)
+{
+    unsigned int offset = strings.size();
+    strings.insert(strings.end(), s, s + strlen(s) + 1);
+    return offset;
+}
+
+void addInstances(const aiNode *node, const glm::mat4 &parent, const std::vector<unsigned int> &meshes,
+                  ImportedScene &scene)
+{
+    glm::mat4 model = parent * toGlm(node->mTransformation);
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    {
+        unsigned int mesh = meshes[node->mMeshes[i]];
+        if (mesh != ~0u)
+        {
+            SceneInstance instance = {model, mesh};
+            scene.instances.push_back(instance);
+        }
+    }
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+    {
+        addInstances(node->mChildren[i], model, meshes, scene);
+    }
+}
+#endif
+} // namespace
+
+SceneData ImportedScene::data() const
+{
+    SceneData scene = {
+        positions.empty() ? NULL : &positions[0],
+        uvs.empty() ? NULL : &uvs[0],
+        normals.empty() ? NULL : &normals[0],
+        (unsigned int)positions.size(),
+        indices.empty() ? NULL : &indices[0],
+        (unsigned int)indices.size(),
+        meshes.empty() ? NULL : &meshes[0],
+        (unsigned int)meshes.size(),
+        materials.empty() ? NULL : &materials[0],
+        (unsigned int)materials.size(),
+        instances.empty() ? NULL : &instances[0],
+        (unsigned int)instances.size(),
+        strings.empty() ? NULL : &strings[0],
+        (unsigned int)strings.size(),
+    };
+    return scene;
+}
+
+bool importScene(const char *path, unsigned int steps, ImportedScene &scene)
+{
+#ifdef USE_ASSIMP
+    unsigned int flags = 0;
+    flags |= steps & SceneTriangulate ? aiProcess_Triangulate : 0;
+    flags |= steps & SceneJoinIdenticalVertices ? aiProcess_JoinIdenticalVertices : 0;
+    flags |= steps & SceneSortByPType ? aiProcess_SortByPType : 0;
+    flags |= steps & SceneOptimizeMeshes ? aiProcess_OptimizeMeshes : 0;
+    flags |= steps & SceneImproveCacheLocality ? aiProcess_ImproveCacheLocality : 0;
+
+    Assimp::Importer importer;
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+    const aiScene *file = importer.ReadFile(path, flags);
+    if (!file)
+    {
+        fprintf(stderr, "%s\n", importer.GetErrorString());
+        return false;
+    }
+
+    scene = ImportedScene();
+    scene.strings.push_back('\0'); // offset 0 : ""
+    for (unsigned int m = 0; m < file->mNumMaterials; m++)
+    {
+        const aiMaterial *material = file->mMaterials[m];
+        aiString name, texture;
+        aiColor4D diffuse(1.0f, 1.0f, 1.0f, 1.0f);
+        material->Get(AI_MATKEY_NAME, name);
+        material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+        SceneMaterial out = {glm::vec4(diffuse.r, diffuse.g, diffuse.b, diffuse.a),
+                             addString(scene.strings, name.C_Str()), 0};
+        if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texture) == AI_SUCCESS)
+        {
+            out.diffuseTexture = addString(scene.strings, texture.C_Str());
+        }
+        scene.materials.push_back(out);
+    }
+
+    // Where each mesh of the file went, ~0u for those without a triangle
+    std::vector<unsigned int> meshes(file->mNumMeshes, ~0u);
+    std::vector<unsigned int> remap;
+    for (unsigned int m = 0; m < file->mNumMeshes; m++)
+    {
+        // Only the vertices of the triangles, in their order : lines and points may have some of their own
+        const aiMesh *mesh = file->mMeshes[m];
+        remap.assign(mesh->mNumVertices, ~0u);
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+            const aiFace &face = mesh->mFaces[f];
+            for (unsigned int k = 0; k < 3 && face.mNumIndices == 3; k++)
+            {
+                remap[face.mIndices[k]] = 0;
+            }
+        }
+        SceneMesh out = {(unsigned int)scene.indices.size(), 0, (unsigned int)scene.positions.size(), 0,
+                         mesh->mMaterialIndex, glm::vec3(0.0f), glm::vec3(0.0f)};
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            if (remap[i] == ~0u)
+            {
+                continue;
+            }
+            remap[i] = out.vertexCount++;
+            glm::vec3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            out.boundsMin = out.vertexCount == 1 ? position : glm::min(out.boundsMin, position);
+            out.boundsMax = out.vertexCount == 1 ? position : glm::max(out.boundsMax, position);
+            scene.positions.push_back(position);
+            glm::vec2 uv(0.0f);
+            if (mesh->HasTextureCoords(0))
+            {
+                uv = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+            }
+            scene.uvs.push_back(uv);
+            glm::vec3 normal(0.0f);
+            if (mesh->HasNormals())
+            {
+                normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            }
+            scene.normals.push_back(normal);
+        }
+        if (out.vertexCount == 0)
+        {
+            continue;
+        }
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+            const aiFace &face = mesh->mFaces[f];
+            for (unsigned int k = 0; k < 3 && face.mNumIndices == 3; k++)
+            {
+                scene.indices.push_back(remap[face.mIndices[k]]);
+            }
+        }
+        out.indexCount = scene.indices.size() - out.firstIndex;
+        meshes[m] = scene.meshes.size();
+        scene.meshes.push_back(out);
+    }
+
+    addInstances(file->mRootNode, glm::mat4(1.0f), meshes, scene);
+    return true;
+#else
+    fprintf(stderr, "Can't import %s : built without AssImp (USE_ASSIMP)\n", path);
+    return false;
+#endif
+}
+
+bool writeSceneCache(const char *path, const SceneData &scene, unsigned int steps, unsigned long long sourceSize,
+                     long long sourceTime)
+{
+    const void *arrays[ArrayCount];
+    unsigned int sizes[ArrayCount];
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = CacheVersion;
+    header.steps = steps;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    arraysOf(scene, arrays, header.counts, sizes);
+    unsigned long long offset = sizeof(header);
+    for (int a = 0; a < ArrayCount; a++)
+    {
+        header.offsets[a] = offset = align16(offset);
+        offset += (unsigned long long)header.counts[a] * sizes[a];
+    }
+    header.fileSize = offset;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Can't write the scene cache %s\n", path);
+        return false;
+    }
+    static const char padding[16] = {0};
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int a = 0; a < ArrayCount && written; a++)
+    {
+        long position = ftell(file);
+        unsigned long long bytes = (unsigned long long)header.counts[a] * sizes[a];
+        written = fwrite(padding, 1, header.offsets[a] - position, file) == header.offsets[a] - position &&
+                  (bytes == 0 || fwrite(arrays[a], bytes, 1, file) == 1);
+    }
+    written = fclose(file) == 0 && written;
+    if (!written)
+    {
+        fprintf(stderr, "Can't write the scene cache %s\n", path);
+        remove(path);
+    }
+    return written;
+}
+
+SceneCache::SceneCache() : mapping(NULL), mappingSize(0), fileHandle(NULL)
+{
+    memset(&scene, 0, sizeof(scene));
+}
+
+SceneCache::~SceneCache()
+{
+    close();
+}
+
+bool SceneCache::open(const char *path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE fileMapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart >= (LONGLONG)sizeof(CacheHeader))
+    {
+        fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(file); // the mapping keeps it open
+    if (fileMapping == NULL)
+    {
+        return false;
+    }
+    mapping = (const unsigned char *)MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+    if (mapping == NULL)
+    {
+        CloseHandle(fileMapping);
+        return false;
+    }
+    fileHandle = fileMapping;
+    mappingSize = size.QuadPart;
+#else
+    int file = ::open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    void *memory = MAP_FAILED;
+    if (fstat(file, &status) == 0 && status.st_size >= (off_t)sizeof(CacheHeader))
+    {
+        memory = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    ::close(file); // the mapping keeps it open
+    if (memory == MAP_FAILED)
+    {
+        return false;
+    }
+    mapping = (const unsigned char *)memory;
+    mappingSize = status.st_size;
+#endif
+
+    // The header, then every array within the file, then every range within its arrays
+    const CacheHeader &header = *(const CacheHeader *)mapping;
+    bool valid = memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) == 0 && header.version == CacheVersion &&
+                 header.fileSize <= mappingSize;
+    const void *arrays[ArrayCount];
+    unsigned int counts[ArrayCount], sizes[ArrayCount];
+    arraysOf(scene, arrays, counts, sizes); // for the element sizes
+    for (int a = 0; a < ArrayCount && valid; a++)
+    {
+        valid = header.offsets[a] % 16 == 0 && header.offsets[a] >= sizeof(header) &&
+                header.offsets[a] + (unsigned long long)header.counts[a] * sizes[a] <= header.fileSize;
+    }
+    if (!valid)
+    {
+        close();
+        return false;
+    }
+    const unsigned int *count = header.counts;
+    const unsigned long long *offset = header.offsets;
+    scene.positions = (const glm::vec3 *)(mapping + offset[Positions]);
+    scene.uvs = (const glm::vec2 *)(mapping + offset[UVs]);
+    scene.normals = (const glm::vec3 *)(mapping + offset[Normals]);
+    scene.vertexCount = count[Positions];
+    scene.indices = (const unsigned int *)(mapping + offset[Indices]);
+    scene.indexCount = count[Indices];
+    scene.meshes = (const SceneMesh *)(mapping + offset[Meshes]);
+    scene.meshCount = count[Meshes];
+    scene.materials = (const SceneMaterial *)(mapping + offset[Materials]);
+    scene.materialCount = count[Materials];
+    scene.instances = (const SceneInstance *)(mapping + offset[Instances]);
+    scene.instanceCount = count[Instances];
+    scene.strings = (const char *)(mapping + offset[Strings]);
+    scene.stringsSize = count[Strings];
+    valid = count[UVs] == count[Positions] && count[Normals] == count[Positions] &&
+            (scene.stringsSize == 0 || scene.strings[scene.stringsSize - 1] == '\0');
+    for (unsigned int m = 0; m < scene.meshCount && valid; m++)
+    {
+        const SceneMesh &mesh = scene.meshes[m];
+        valid = (unsigned long long)mesh.firstIndex + mesh.indexCount <= scene.indexCount &&
+                (unsigned long long)mesh.baseVertex + mesh.vertexCount <= scene.vertexCount &&
+                mesh.material < scene.materialCount;
+    }
+    for (unsigned int m = 0; m < scene.materialCount && valid; m++)
+    {
+        valid = scene.materials[m].name < scene.stringsSize && scene.materials[m].diffuseTexture < scene.stringsSize;
+    }
+    for (unsigned int i = 0; i < scene.instanceCount && valid; i++)
+    {
+        valid = scene.instances[i].mesh < scene.meshCount;
+    }
+    if (!valid)
+    {
+        close();
+    }
+    return valid;
+}
+
+void SceneCache::close()
+{
+    if (mapping != NULL)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle((HANDLE)fileHandle);
+#else
+        munmap((void *)mapping, mappingSize);
+#endif
+    }
+    mapping = NULL;
+    mappingSize = 0;
+    fileHandle = NULL;
+    memset(&scene, 0, sizeof(scene));
+}
+
+unsigned int SceneCache::steps() const
+{
+    return mapping ? ((const CacheHeader *)mapping)->steps : 0;
+}
+
+unsigned long long SceneCache::sourceSize() const
+{
+    return mapping ? ((const CacheHeader *)mapping)->sourceSize : 0;
+}
+
+long long SceneCache::sourceTime() const
+{
+    return mapping ? ((const CacheHeader *)mapping)->sourceTime : 0;
+}
+
+bool loadScene(const char *path, const char *cachePath, unsigned int steps, SceneCache &cache, bool *imported)
+{
+    // Without the source, any cache of it made with the same steps will do
+    unsigned long long size = 0;
+    long long time = 0;
+    bool hasSource = fileStamp(path, size, time);
+    if (imported)
+    {
+        *imported = false;
+    }
+    if (cache.open(cachePath) && cache.steps() == steps &&
+        (!hasSource || (cache.sourceSize() == size && cache.sourceTime() == time)))
+    {
+        return true;
+    }
+    cache.close();
+
+    ImportedScene scene;
+    if (!importScene(path, steps, scene) || !writeSceneCache(cachePath, scene.data(), steps, size, time))
+    {
+        return false;
+    }
+    if (imported)
+    {
+        *imported = true;
+    }
+    return cache.open(cachePath);
+}
@@ -0,0 +1,131 @@
+#ifndef SCENEIMPORT_HPP
+#define SCENEIMPORT_HPP
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// The post-processing steps of AssImp that importScene() can run, in the order AssImp runs them
+enum SceneImportSteps
+{
+    SceneTriangulate = 1 << 0,            // polygons become triangles ; without it, they are left out
+    SceneJoinIdenticalVertices = 1 << 1,  // one vertex per position, UV and normal, instead of one per corner
+    SceneSortByPType = 1 << 2,            // points and lines left out, by AssImp itself
+    SceneOptimizeMeshes = 1 << 3,         // meshes of the same material merged, fewer draws
+    SceneImproveCacheLocality = 1 << 4,   // triangles reordered for the post-transform vertex cache
+    SceneAllSteps = (1 << 5) - 1
+};
+
+// A range of the vertices and indices of a scene, with the same layout as PoolMesh : indices relative to the first
+// vertex of the mesh, so that it can go to a GeometryPool as it is, or be drawn with glDrawElementsBaseVertex
+struct SceneMesh
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    unsigned int baseVertex;
+    unsigned int vertexCount;
+    unsigned int material;
+    glm::vec3 boundsMin, boundsMax;
+};
+
+// Names and paths are offsets in the strings of the scene, each ending with a 0
+struct SceneMaterial
+{
+    glm::vec4 diffuseColor;
+    unsigned int name;
+    unsigned int diffuseTexture; // "" without a texture : the path is as written in the file
+};
+
+// A mesh where a node of the file puts it
+struct SceneInstance
+{
+    glm::mat4 model;
+    unsigned int mesh;
+};
+
+// What a scene is made of, wherever it lives : in an ImportedScene, or in the file mapped by a SceneCache
+struct SceneData
+{
+    const glm::vec3 *positions;
+    const glm::vec2 *uvs; // UV0, (0, 0) when a mesh has none
+    const glm::vec3 *normals; // (0, 0, 0) when a mesh has none
+    unsigned int vertexCount;
+    const unsigned int *indices;
+    unsigned int indexCount;
+    const SceneMesh *meshes;
+    unsigned int meshCount;
+    const SceneMaterial *materials;
+    unsigned int materialCount;
+    const SceneInstance *instances;
+    unsigned int instanceCount;
+    const char *strings;
+    unsigned int stringsSize;
+};
+
+// A scene read by importScene(), in vectors
+struct ImportedScene
+{
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<unsigned int> indices;
+    std::vector<SceneMesh> meshes;
+    std::vector<SceneMaterial> materials;
+    std::vector<SceneInstance> instances;
+    std::vector<char> strings;
+
+    SceneData data() const;
+};
+
+// Every mesh, material and node of a file, through AssImp, with the 'steps' of SceneImportSteps. Unlike loadAssImp,
+// nothing is assumed : meshes without triangles, and faces that are not triangles, are left out, and the indices are
+// 32 bits. Returns false, with a message, if AssImp can't read the file or if the program is built without it
+// (USE_ASSIMP).
+bool importScene(const char *path, unsigned int steps, ImportedScene &scene);
+
+// The scene in one file that SceneCache maps : a header, then each array of SceneData, aligned on 16 bytes, in the
+// byte order of this machine. 'sourceSize' and 'sourceTime' are those of the file it was imported from, for
+// loadScene() to tell when the cache is stale.
+bool writeSceneCache(const char *path, const SceneData &scene, unsigned int steps, unsigned long long sourceSize,
+                     long long sourceTime);
+
+// A scene cache mapped in memory, read-only : the pages are only read from the disk when something touches them,
+// and open() only checks the header and the ranges of the meshes and instances.
+class SceneCache
+{
+  public:
+    SceneCache();
+    ~SceneCache();
+
+    // False if the file is missing, of another version, truncated, or if its ranges don't fit in its arrays
+    bool open(const char *path);
+    void close();
+
+    bool isOpen() const
+    {
+        return mapping != NULL;
+    }
+    const SceneData &data() const
+    {
+        return scene;
+    }
+    unsigned int steps() const;
+    unsigned long long sourceSize() const;
+    long long sourceTime() const;
+
+  private:
+    SceneCache(const SceneCache &);
+    SceneCache &operator=(const SceneCache &);
+
+    const unsigned char *mapping;
+    unsigned long long mappingSize;
+    void *fileHandle; // Windows only : the file mapping object
+    SceneData scene;
+};
+
+// The scene of 'path' from 'cachePath' when the cache was made from this version of the file with these steps,
+// without AssImp ; otherwise imported, written to 'cachePath', then mapped. 'imported' tells which happened.
+bool loadScene(const char *path, const char *cachePath, unsigned int steps, SceneCache &cache,
+               bool *imported = NULL);
+
+#endif
@@ -3,4 +3,7 @@
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
+// Needs GL 4.3. Returns 0 if the shader does not compile or link.
+GLuint LoadComputeShader(const char * compute_file_path);
+
 #endif
@@ -0,0 +1,265 @@
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SKINNING_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "skinning.hpp"
+
+const unsigned int Skeleton::None;
+
+unsigned int Skeleton::addBone(const std::string &name, unsigned int parent, const glm::mat4 &localBind,
+                               const glm::mat4 &inverseBind)
+{
+    names.push_back(name);
+    parents.push_back(parent);
+    localBindPose.push_back(localBind);
+    inverseBindPose.push_back(inverseBind);
+    return parents.size() - 1;
+}
+
+unsigned int Skeleton::find(const std::string &name) const
+{
+    for (unsigned int bone = 0; bone < names.size(); bone++)
+    {
+        if (names[bone] == name)
+        {
+            return bone;
+        }
+    }
+    return None;
+}
+
+namespace
+{
+// The key at or before 'time', and how far 'time' is from it towards the next one. Before the first key and after
+// the last, the nearest key holds.
+unsigned int findKey(const std::vector<float> &times, float time, float &t)
+{
+    t = 0.0f;
+    unsigned int next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+    if (next == 0)
+    {
+        return 0;
+    }
+    if (next == times.size())
+    {
+        return next - 1;
+    }
+    t = (time - times[next - 1]) / (times[next] - times[next - 1]);
+    return next - 1;
+}
+
+glm::vec3 sampleVector(const std::vector<float> &times, const std::vector<glm::vec3> &values, float time)
+{
+    float t;
+    unsigned int key = findKey(times, time, t);
+    return t == 0.0f ? values[key] : glm::mix(values[key], values[key + 1], t);
+}
+
+glm::quat sampleRotation(const std::vector<float> &times, const std::vector<glm::quat> &values, float time)
+{
+    float t;
+    unsigned int key = findKey(times, time, t);
+    return t == 0.0f ? values[key] : glm::normalize(glm::slerp(values[key], values[key + 1], t));
+}
+
+// translate(position) * mat4_cast(rotation) * scale(scale), without the multiplies by 0
+glm::mat4 composeTransform(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    glm::mat4 m = glm::mat4_cast(rotation);
+    m[0] *= scale.x;
+    m[1] *= scale.y;
+    m[2] *= scale.z;
+    m[3] = glm::vec4(position, 1.0f);
+    return m;
+}
+
+// The local transform of a bone at 'time', what its channel has keys for, the bind pose for the rest
+glm::mat4 sampleChannel(const BoneChannel &channel, const glm::mat4 &bind, float time)
+{
+    glm::vec3 position(bind[3]);
+    glm::vec3 scale(glm::length(glm::vec3(bind[0])), glm::length(glm::vec3(bind[1])), glm::length(glm::vec3(bind[2])));
+    glm::quat rotation;
+    if (!channel.positionTimes.empty())
+    {
+        position = sampleVector(channel.positionTimes, channel.positions, time);
+    }
+    if (!channel.scaleTimes.empty())
+    {
+        scale = sampleVector(channel.scaleTimes, channel.scales, time);
+    }
+    if (!channel.rotationTimes.empty())
+    {
+        rotation = sampleRotation(channel.rotationTimes, channel.rotations, time);
+    }
+    else
+    {
+        rotation = glm::quat_cast(glm::mat3(glm::vec3(bind[0]) / scale.x, glm::vec3(bind[1]) / scale.y,
+                                            glm::vec3(bind[2]) / scale.z));
+    }
+    return composeTransform(position, rotation, scale);
+}
+
+// A column of a matrix : four floats, or one SSE register
+struct Column1
+{
+    float x, y, z, w;
+};
+
+inline Column1 loadColumn(const float *p, Column1)
+{
+    Column1 c = {p[0], p[1], p[2], p[3]};
+    return c;
+}
+
+inline Column1 operator+(Column1 a, Column1 b)
+{
+    Column1 c = {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+    return c;
+}
+
+inline Column1 operator*(Column1 a, float b)
+{
+    Column1 c = {a.x * b, a.y * b, a.z * b, a.w * b};
+    return c;
+}
+
+inline void storeXYZ(Column1 a, glm::vec3 &out)
+{
+    out = glm::vec3(a.x, a.y, a.z);
+}
+
+#ifdef SKINNING_SSE
+struct Column4
+{
+    __m128 v;
+};
+
+inline Column4 loadColumn(const float *p, Column4)
+{
+    Column4 c = {_mm_loadu_ps(p)};
+    return c;
+}
+
+inline Column4 operator+(Column4 a, Column4 b)
+{
+    Column4 c = {_mm_add_ps(a.v, b.v)};
+    return c;
+}
+
+inline Column4 operator*(Column4 a, float b)
+{
+    Column4 c = {_mm_mul_ps(a.v, _mm_set1_ps(b))};
+    return c;
+}
+
+inline void storeXYZ(Column4 a, glm::vec3 &out)
+{
+    _mm_storel_pi(reinterpret_cast<__m64 *>(&out.x), a.v);
+    _mm_store_ss(&out.z, _mm_movehl_ps(a.v, a.v));
+}
+#endif
+
+template <typename Column>
+void skinKernel(const glm::vec3 *positions, const glm::vec3 *normals, const BoneWeights *weights,
+                const glm::mat4 *palette, unsigned int first, unsigned int last, glm::vec3 *outPositions,
+                glm::vec3 *outNormals)
+{
+    const Column type = Column();
+    for (unsigned int i = first; i < last; i++)
+    {
+        // The palette matrices blended column by column, stopping at the first unused slot
+        const BoneWeights &w = weights[i];
+        const float *m = &palette[w.bones[0]][0][0];
+        Column c0 = loadColumn(m, type) * w.weights[0];
+        Column c1 = loadColumn(m + 4, type) * w.weights[0];
+        Column c2 = loadColumn(m + 8, type) * w.weights[0];
+        Column c3 = loadColumn(m + 12, type) * w.weights[0];
+        for (int slot = 1; slot < 4 && w.weights[slot] != 0.0f; slot++)
+        {
+            m = &palette[w.bones[slot]][0][0];
+            c0 = c0 + loadColumn(m, type) * w.weights[slot];
+            c1 = c1 + loadColumn(m + 4, type) * w.weights[slot];
+            c2 = c2 + loadColumn(m + 8, type) * w.weights[slot];
+            c3 = c3 + loadColumn(m + 12, type) * w.weights[slot];
+        }
+
+        const glm::vec3 &p = positions[i];
+        const glm::vec3 &n = normals[i];
+        storeXYZ(c0 * p.x + c1 * p.y + c2 * p.z + c3, outPositions[i - first]);
+        storeXYZ(c0 * n.x + c1 * n.y + c2 * n.z, outNormals[i - first]);
+    }
+}
+} // namespace
+
+void samplePalettes(const Skeleton &skeleton, const SkeletalAnimation &animation, const float *times,
+                    const glm::mat4 *roots, unsigned int first, unsigned int last, glm::mat4 *palettes)
+{
+    unsigned int bones = skeleton.size();
+    std::vector<glm::mat4> globals(bones);
+    for (unsigned int i = first; i < last; i++)
+    {
+        float time = animation.duration > 0.0f ? fmodf(times[i], animation.duration) : 0.0f;
+        if (time < 0.0f)
+        {
+            time += animation.duration;
+        }
+
+        // The local transforms, from the bind pose or the channels, then down the hierarchy
+        std::copy(skeleton.localBindPose.begin(), skeleton.localBindPose.end(), globals.begin());
+        for (unsigned int c = 0; c < animation.channels.size(); c++)
+        {
+            const BoneChannel &channel = animation.channels[c];
+            globals[channel.bone] = sampleChannel(channel, skeleton.localBindPose[channel.bone], time);
+        }
+        glm::mat4 *palette = palettes + (i - first) * bones;
+        for (unsigned int bone = 0; bone < bones; bone++)
+        {
+            unsigned int parent = skeleton.parents[bone];
+            if (parent != Skeleton::None)
+            {
+                globals[bone] = globals[parent] * globals[bone];
+            }
+            else if (roots)
+            {
+                globals[bone] = roots[i] * globals[bone];
+            }
+            palette[bone] = globals[bone] * skeleton.inverseBindPose[bone];
+        }
+    }
+}
+
+void skinVertices(const glm::vec3 *positions, const glm::vec3 *normals, const BoneWeights *weights,
+                  const glm::mat4 *palette, unsigned int first, unsigned int last, glm::vec3 *outPositions,
+                  glm::vec3 *outNormals)
+{
+#ifdef SKINNING_SSE
+    skinKernel<Column4>(positions, normals, weights, palette, first, last, outPositions, outNormals);
+#else
+    skinKernel<Column1>(positions, normals, weights, palette, first, last, outPositions, outNormals);
+#endif
+}
+
+void skinVerticesScalar(const glm::vec3 *positions, const glm::vec3 *normals, const BoneWeights *weights,
+                        const glm::mat4 *palette, unsigned int first, unsigned int last, glm::vec3 *outPositions,
+                        glm::vec3 *outNormals)
+{
+    skinKernel<Column1>(positions, normals, weights, palette, first, last, outPositions, outNormals);
+}
+
+const char *skinningInstructionSet()
+{
+#ifdef SKINNING_SSE
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
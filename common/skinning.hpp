@@ -0,0 +1,81 @@
+#ifndef SKINNING_HPP
+#define SKINNING_HPP
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// The bones that move a vertex, at most 4, and how much each does : the weights add up to 1, in decreasing order.
+// Unused slots come last, with a weight of 0.
+struct BoneWeights
+{
+    unsigned short bones[4];
+    float weights[4];
+};
+
+// A hierarchy of bones, parents before their children, like the nodes of the file it comes from
+struct Skeleton
+{
+    static const unsigned int None = ~0u;
+
+    std::vector<std::string> names;
+    std::vector<unsigned int> parents;        // None for a root
+    std::vector<glm::mat4> localBindPose;     // relative to the parent, for the bones no channel animates
+    std::vector<glm::mat4> inverseBindPose;   // from the mesh to the bone, in the bind pose : the offset matrix
+
+    unsigned int addBone(const std::string &name, unsigned int parent, const glm::mat4 &localBind,
+                         const glm::mat4 &inverseBind = glm::mat4(1.0f));
+    // None if there is no such bone
+    unsigned int find(const std::string &name) const;
+    unsigned int size() const
+    {
+        return parents.size();
+    }
+};
+
+// The keyframes of one bone, in seconds. A bone without keys of a kind keeps the translation, rotation or scale of
+// its bind pose.
+struct BoneChannel
+{
+    unsigned int bone;
+    std::vector<float> positionTimes, rotationTimes, scaleTimes;
+    std::vector<glm::vec3> positions, scales;
+    std::vector<glm::quat> rotations;
+};
+
+struct SkeletalAnimation
+{
+    std::string name;
+    float duration; // seconds : the animation loops
+    std::vector<BoneChannel> channels;
+};
+
+// The palettes of the instances [first, last) of a crowd, each playing 'animation' at its own time : the translations
+// and scales of the keys around that time are interpolated linearly, the rotations with slerp, then composed down the
+// hierarchy and multiplied by the inverse bind pose. Instance i writes skeleton.size() matrices from
+// palettes + (i - first) * skeleton.size(). With 'roots', the matrix of each instance places its skeleton in the
+// world, so that the skinned vertices come out in world space ; without, they stay in the space of the mesh.
+void samplePalettes(const Skeleton &skeleton, const SkeletalAnimation &animation, const float *times,
+                    const glm::mat4 *roots, unsigned int first, unsigned int last, glm::mat4 *palettes);
+
+// The vertices [first, last) of a mesh in its bind pose, moved by the palette of one instance, to
+// outPositions[0] to outPositions[last - first - 1] and the same for the normals. Normals are transformed like
+// directions and not normalized again : the fragment shader does it.
+//
+// Each vertex blends the matrices of its 4 bones into one, then transforms its position and normal with it. With SSE
+// a register holds a column of a matrix, so the same kernel serves AVX builds. The scalar version does the same
+// operations in the same order : they give exactly the same vertices. Ranges are independent, so that the threads of
+// JobSystem::parallelFor can share the vertices of a large mesh, or the instances of a crowd.
+void skinVertices(const glm::vec3 *positions, const glm::vec3 *normals, const BoneWeights *weights,
+                  const glm::mat4 *palette, unsigned int first, unsigned int last, glm::vec3 *outPositions,
+                  glm::vec3 *outNormals);
+void skinVerticesScalar(const glm::vec3 *positions, const glm::vec3 *normals, const BoneWeights *weights,
+                        const glm::mat4 *palette, unsigned int first, unsigned int last, glm::vec3 *outPositions,
+                        glm::vec3 *outNormals);
+
+// "SSE" or "scalar"
+const char *skinningInstructionSet();
+
+#endif
@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "clock.hpp"
+#include "streambuffer.hpp"
+
+StreamBuffer::StreamBuffer()
+    : bufferID(0), persistent(false), mapped(NULL), size(0), regions(0), current(0), used(0), flushed(0)
+{
+    memset(fences, 0, sizeof(fences));
+    resetStats();
+}
+
+bool StreamBuffer::isPersistentSupported()
+{
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+GLint StreamBuffer::uniformAlignment()
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment;
+}
+
+void StreamBuffer::create(unsigned int regionSize, unsigned int regionCount)
+{
+    size = regionSize;
+    regions = regionCount < 2 ? 2 : regionCount > 8 ? 8 : regionCount;
+    current = 0;
+    used = 0;
+    flushed = 0;
+    persistent = isPersistentSupported();
+
+    GLsizeiptr total = (GLsizeiptr)size * regions;
+    glGenBuffers(1, &bufferID);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+    if (persistent)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, total, NULL, flags);
+        mapped = (unsigned char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags);
+    }
+    else
+    {
+        glBufferData(GL_ARRAY_BUFFER, total, NULL, GL_STREAM_DRAW);
+        mapped = new unsigned char[total];
+    }
+}
+
+void StreamBuffer::destroy()
+{
+    for (unsigned int i = 0; i < regions; i++)
+    {
+        if (fences[i] != 0)
+        {
+            glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+    }
+    if (persistent)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    else
+    {
+        delete[] mapped;
+    }
+    glDeleteBuffers(1, &bufferID);
+    bufferID = 0;
+    mapped = NULL;
+}
+
+StreamAllocation StreamBuffer::allocate(unsigned int bytes, unsigned int alignment)
+{
+    StreamAllocation allocation;
+    unsigned int base = current * size;
+    // Aligned in the buffer, not only in the region
+    unsigned int start = (base + used + alignment - 1) / alignment * alignment - base;
+    if (start + bytes > size)
+    {
+        counters.overflows++;
+        allocation.data = NULL;
+        allocation.offset = 0;
+        return allocation;
+    }
+    used = start + bytes;
+    counters.bytes += bytes;
+    allocation.data = mapped + base + start;
+    allocation.offset = base + start;
+    return allocation;
+}
+
+void StreamBuffer::flush()
+{
+    if (persistent || flushed == used)
+    {
+        return;
+    }
+    unsigned int base = current * size;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, base + flushed, used - flushed, mapped + base + flushed);
+    flushed = used;
+}
+
+void StreamBuffer::nextFrame()
+{
+    counters.frames++;
+    // Nothing was drawn from an empty region : keep filling it
+    if (used == 0)
+    {
+        return;
+    }
+    flush();
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current = (current + 1) % regions;
+    used = 0;
+    flushed = 0;
+
+    GLsync fence = fences[current];
+    if (fence == 0)
+    {
+        return;
+    }
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        // The GPU is 'regions - 1' frames behind
+        counters.stalls++;
+        double start = clockTime();
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+        counters.stallTime += clockTime() - start;
+    }
+    glDeleteSync(fence);
+    fences[current] = 0;
+}
+
+void StreamBuffer::resetStats()
+{
+    memset(&counters, 0, sizeof(counters));
+}
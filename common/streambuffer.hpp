@@ -0,0 +1,95 @@
+#ifndef STREAMBUFFER_HPP
+#define STREAMBUFFER_HPP
+
+// Where StreamBuffer::allocate put the data : write 'size' bytes at 'data', and point GL at 'offset' in the buffer
+struct StreamAllocation
+{
+    void *data;    // NULL if the region was full
+    GLintptr offset;
+};
+
+struct StreamBufferStats
+{
+    unsigned int frames;      // calls to nextFrame()
+    unsigned int stalls;      // times nextFrame() found the GPU still reading the region it went to
+    double stallTime;         // in seconds, waiting for those
+    unsigned long long bytes; // handed out by allocate()
+    unsigned int overflows;   // allocations that did not fit in the region
+};
+
+// A buffer for data that is written by the CPU every frame and read by the GPU once : vertices of text, instance
+// matrices, uniform blocks. It is split in 'regionCount' regions (3 : one being written, up to two being read). In a
+// frame, allocate() hands out consecutive pieces of the current region. nextFrame() puts a fence behind the draws
+// of the frame and moves to the next region, waiting for the GPU to be done with it if needed.
+//
+// With GL 4.4 or GL_ARB_buffer_storage, the storage is immutable and mapped once, persistently and coherently :
+// allocate() returns a pointer into the buffer itself and nothing more is needed before drawing. Without it, the
+// data is written to a copy in memory and flush() sends it with glBufferSubData.
+//
+// The buffer can be bound to any target : GL_ARRAY_BUFFER for vertices and instances, GL_UNIFORM_BUFFER with
+// glBindBufferRange (aligned on uniformAlignment()) for uniform blocks.
+class StreamBuffer
+{
+  public:
+    static const unsigned int DefaultRegionCount = 3;
+
+    StreamBuffer();
+
+    static bool isPersistentSupported();
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    static GLint uniformAlignment();
+
+    // Binds the buffer to GL_ARRAY_BUFFER
+    void create(unsigned int regionSize, unsigned int regionCount = DefaultRegionCount);
+    void destroy();
+
+    // 'alignment' can be any size, like the size of an instance for an offset that is a whole number of instances.
+    // Returns a NULL data pointer, and counts an overflow, when the rest of the region is too small : the region size
+    // is the most a frame can use.
+    StreamAllocation allocate(unsigned int size, unsigned int alignment = 16);
+
+    // Makes what was written since the last flush() visible to GL. Binds the buffer to GL_COPY_WRITE_BUFFER when
+    // there is something to send, and does nothing for a persistent mapping.
+    void flush();
+
+    // Call after the last draw that reads from the buffer in this frame
+    void nextFrame();
+
+    GLuint buffer() const
+    {
+        return bufferID;
+    }
+    bool isPersistent() const
+    {
+        return persistent;
+    }
+    unsigned int regionSize() const
+    {
+        return size;
+    }
+    // Bytes left in the current region
+    unsigned int available() const
+    {
+        return size - used;
+    }
+
+    const StreamBufferStats &stats() const
+    {
+        return counters;
+    }
+    void resetStats();
+
+  private:
+    GLuint bufferID;
+    bool persistent;
+    unsigned char *mapped; // the whole buffer, or its copy in memory
+    unsigned int size;     // of a region
+    unsigned int regions;
+    unsigned int current;  // region being written
+    unsigned int used;     // bytes of it handed out
+    unsigned int flushed;  // bytes of it sent to GL, without persistent mapping
+    GLsync fences[8];
+    StreamBufferStats counters;
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include <cstring>
 
 #include <GL/glew.h>
@@ -7,114 +9,290 @@
 #include <glm/gtc/matrix_transform.hpp>
 using namespace glm;
 
+#include "clock.hpp"
+#include "glstate.hpp"
 #include "shader.hpp"
+#include "streambuffer.hpp"
 #include "texture.hpp"
 
 #include "text2D.hpp"
 
+// A string printed in a previous frame. Once it is printed again unchanged, its
+// quads go to the resident buffer, and later frames draw them from there
+// without building or copying them again.
+struct Text2DCacheEntry {
+	std::string text;
+	int x, y, size;
+	unsigned int lastFrame;
+	unsigned int residentFirst;      // first vertex in the resident buffer
+	unsigned int residentGeneration; // resident while equal to Text2DResidentGeneration
+};
+
+// Glyphs drawn by one call, in print order : from the stream, or from the
+// resident buffer. 'first' is the first vertex, given as the base vertex.
+struct Text2DRun {
+	bool resident;
+	unsigned int first;
+	unsigned int glyphs;
+};
+
+// The most glyphs in one draw : their 4 corners must fit in unsigned short indices
+const unsigned int Text2DMaxGlyphs = 16384;
+// The most glyphs of unchanged strings kept in the resident buffer
+const unsigned int Text2DResidentGlyphs = 16384;
+
 unsigned int Text2DTextureID;
-unsigned int Text2DVertexBufferID;
-unsigned int Text2DUVBufferID;
+StreamBuffer Text2DStream;
+unsigned int Text2DIndexBufferID;
+unsigned int Text2DStreamVertexArrayID;
+unsigned int Text2DResidentBufferID;
+unsigned int Text2DResidentVertexArrayID;
 unsigned int Text2DShaderID;
 unsigned int Text2DUniformID;
 
+// The resident buffer is filled from the start ; when it is full, it is
+// emptied, and the strings still printed go back to it one by one
+unsigned int Text2DResidentUsed;
+unsigned int Text2DResidentGeneration;
+std::vector<Text2DVertex> Text2DResidentScratch;
+
+// What was printed since the last draw
+std::vector<Text2DRun> Text2DRuns;
+
+std::unordered_map<unsigned long long, Text2DCacheEntry> Text2DCache;
+unsigned int Text2DFrame;
+
+// In StreamBuffer::nextFrame(), since initText2D()
+double Text2DFenceTime;
+
+// Interleaved position and UV, from vertex 0 of the buffer : the draws pick
+// their quads with the base vertex, so the pointers never change
+void setText2DAttributes(unsigned int vertexArrayID, unsigned int vertexBufferID, unsigned int indexBufferID){
+	glBindVertexArray(vertexArrayID);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Text2DVertex), (void*)0 );
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Text2DVertex), (void*)sizeof(glm::vec2) );
+}
+
 void initText2D(const char * texturePath){
 
 	// Initialize texture
 	Text2DTextureID = loadDDS(texturePath);
 
-	// Initialize VBO
-	glGenBuffers(1, &Text2DVertexBufferID);
-	glGenBuffers(1, &Text2DUVBufferID);
+	// Initialize VBO : the quads of the strings that changed go one after the
+	// other in a ring of 3 regions, each big enough for a full batch
+	Text2DStream.create(Text2DMaxGlyphs * 4 * sizeof(Text2DVertex));
+	glGenBuffers(1, &Text2DResidentBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, Text2DResidentBufferID);
+	glBufferData(GL_ARRAY_BUFFER, Text2DResidentGlyphs * 4 * sizeof(Text2DVertex), NULL, GL_STATIC_DRAW);
+	Text2DResidentUsed = 0;
+	Text2DResidentGeneration = 1;
+	Text2DFrame = 0;
+	Text2DFenceTime = 0.0;
+
+	// Two triangles per quad, the same for every batch
+	std::vector<unsigned short> indices(Text2DMaxGlyphs * 6);
+	for ( unsigned int i=0 ; i<Text2DMaxGlyphs ; i++ ){
+		unsigned short corner = i * 4; // up left, down left, up right, down right
+		unsigned short quad[6] = { corner, (unsigned short)(corner+1), (unsigned short)(corner+2),
+		                           (unsigned short)(corner+3), (unsigned short)(corner+2), (unsigned short)(corner+1) };
+		memcpy(&indices[i * 6], quad, sizeof(quad));
+	}
+	glGenBuffers(1, &Text2DIndexBufferID);
+
+	// Text has its own VAOs, one per vertex buffer, so that its index buffer
+	// does not replace the one of the scene
+	GLint sceneVertexArray = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &sceneVertexArray);
+	glGenVertexArrays(1, &Text2DStreamVertexArrayID);
+	glGenVertexArrays(1, &Text2DResidentVertexArrayID);
+	setText2DAttributes(Text2DStreamVertexArrayID, Text2DStream.buffer(), Text2DIndexBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+	setText2DAttributes(Text2DResidentVertexArrayID, Text2DResidentBufferID, Text2DIndexBufferID);
+	glBindVertexArray(sceneVertexArray);
 
 	// Initialize Shader
 	Text2DShaderID = LoadShaders( "TextVertexShader.vertexshader", "TextVertexShader.fragmentshader" );
 
-	// Initialize uniforms' IDs
+	// Initialize uniforms' IDs : the font is always on texture unit 0
 	Text2DUniformID = glGetUniformLocation( Text2DShaderID, "myTextureSampler" );
+	GLint sceneProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &sceneProgram);
+	glUseProgram(Text2DShaderID);
+	glUniform1i(Text2DUniformID, 0);
+	glUseProgram(sceneProgram);
 
 }
 
-void printText2D(const char * text, int x, int y, int size){
-
-	unsigned int length = strlen(text);
+// FNV-1a of everything that decides the quads
+unsigned long long hashText2D(const char * text, unsigned int length, int x, int y, int size){
+	int numbers[3] = { x, y, size };
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char * bytes = (const unsigned char *)numbers;
+	for ( unsigned int i=0 ; i<sizeof(numbers) ; i++ )
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	for ( unsigned int i=0 ; i<length ; i++ )
+		hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+	return hash;
+}
 
-	// Fill buffers
-	std::vector<glm::vec2> vertices;
-	std::vector<glm::vec2> UVs;
+void buildText2D(const char * text, unsigned int length, int x, int y, int size, Text2DVertex * vertices){
 	for ( unsigned int i=0 ; i<length ; i++ ){
-		
-		glm::vec2 vertex_up_left    = glm::vec2( x+i*size     , y+size );
-		glm::vec2 vertex_up_right   = glm::vec2( x+i*size+size, y+size );
-		glm::vec2 vertex_down_right = glm::vec2( x+i*size+size, y      );
-		glm::vec2 vertex_down_left  = glm::vec2( x+i*size     , y      );
-
-		vertices.push_back(vertex_up_left   );
-		vertices.push_back(vertex_down_left );
-		vertices.push_back(vertex_up_right  );
-
-		vertices.push_back(vertex_down_right);
-		vertices.push_back(vertex_up_right);
-		vertices.push_back(vertex_down_left);
 
 		char character = text[i];
 		float uv_x = (character%16)/16.0f;
 		float uv_y = (character/16)/16.0f;
 
-		glm::vec2 uv_up_left    = glm::vec2( uv_x           , uv_y );
-		glm::vec2 uv_up_right   = glm::vec2( uv_x+1.0f/16.0f, uv_y );
-		glm::vec2 uv_down_right = glm::vec2( uv_x+1.0f/16.0f, (uv_y + 1.0f/16.0f) );
-		glm::vec2 uv_down_left  = glm::vec2( uv_x           , (uv_y + 1.0f/16.0f) );
-		UVs.push_back(uv_up_left   );
-		UVs.push_back(uv_down_left );
-		UVs.push_back(uv_up_right  );
-
-		UVs.push_back(uv_down_right);
-		UVs.push_back(uv_up_right);
-		UVs.push_back(uv_down_left);
+		Text2DVertex * quad = vertices + i * 4;
+		quad[0].position = glm::vec2( x+i*size     , y+size ); // up left
+		quad[0].uv       = glm::vec2( uv_x           , uv_y );
+		quad[1].position = glm::vec2( x+i*size     , y      ); // down left
+		quad[1].uv       = glm::vec2( uv_x           , (uv_y + 1.0f/16.0f) );
+		quad[2].position = glm::vec2( x+i*size+size, y+size ); // up right
+		quad[2].uv       = glm::vec2( uv_x+1.0f/16.0f, uv_y );
+		quad[3].position = glm::vec2( x+i*size+size, y      ); // down right
+		quad[3].uv       = glm::vec2( uv_x+1.0f/16.0f, (uv_y + 1.0f/16.0f) );
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
-	glBufferData(GL_ARRAY_BUFFER, UVs.size() * sizeof(glm::vec2), &UVs[0], GL_STATIC_DRAW);
+}
+
+// Draws everything printed since the last draw, in print order, and forgets it
+void drawText2DBatch(GLStateCache & state){
+
+	if (Text2DRuns.empty())
+		return;
+
+	Text2DStream.flush();
 
 	// Bind shader
-	glUseProgram(Text2DShaderID);
+	state.useProgram(Text2DShaderID);
 
-	// Bind texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, Text2DTextureID);
-	// Set our "myTextureSampler" sampler to use Texture Unit 0
-	glUniform1i(Text2DUniformID, 0);
+	// Bind texture, on the unit of the "myTextureSampler" sampler
+	state.bindTexture(0, GL_TEXTURE_2D, Text2DTextureID);
 
-	// 1rst attribute buffer : vertices
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+	state.enable(GL_BLEND);
+	state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// 2nd attribute buffer : UVs
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+	// One draw call per run : a single one when the strings all changed or all
+	// did not, more when changed and unchanged strings take turns
+	for ( unsigned int i=0 ; i<Text2DRuns.size() ; i++ ){
+		const Text2DRun & run = Text2DRuns[i];
+		state.bindVertexArray(run.resident ? Text2DResidentVertexArrayID : Text2DStreamVertexArrayID);
+		glDrawElementsBaseVertex(GL_TRIANGLES, run.glyphs * 6, GL_UNSIGNED_SHORT, (void*)0, run.first);
+	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	state.disable(GL_BLEND);
 
-	// Draw call
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size() );
+	Text2DRuns.clear();
+}
 
-	glDisable(GL_BLEND);
+// Adds the glyphs to the last run when they follow it in the same buffer
+void addText2DRun(bool resident, unsigned int first, unsigned int glyphs){
+	if (!Text2DRuns.empty()){
+		Text2DRun & last = Text2DRuns.back();
+		if (last.resident == resident && last.first + last.glyphs * 4 == first && last.glyphs + glyphs <= Text2DMaxGlyphs){
+			last.glyphs += glyphs;
+			return;
+		}
+	}
+	Text2DRun run = { resident, first, glyphs };
+	Text2DRuns.push_back(run);
+}
+
+void printText2D(const char * text, int x, int y, int size, GLStateCache & state){
+
+	unsigned int length = strlen(text);
+	if (length == 0 || length > Text2DMaxGlyphs)
+		return;
+
+	unsigned long long hash = hashText2D(text, length, x, y, size);
+	Text2DCacheEntry & entry = Text2DCache[hash];
+	// The entries not printed in the previous frame are gone : a match was printed then, or earlier in this frame
+	bool unchanged = entry.x == x && entry.y == y && entry.size == size && entry.text == text;
+	entry.lastFrame = Text2DFrame;
+
+	// Already resident : nothing to build or copy
+	if (unchanged && entry.residentGeneration == Text2DResidentGeneration){
+		addText2DRun(true, entry.residentFirst, length);
+		return;
+	}
 
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
+	// Printed again unchanged : send it to the resident buffer, once
+	if (unchanged && length <= Text2DResidentGlyphs){
+		if (Text2DResidentUsed + length > Text2DResidentGlyphs){
+			// Full of strings that may not be printed any more : start over.
+			// What was printed before still reads the previous contents.
+			drawText2DBatch(state);
+			state.bindBuffer(GL_ARRAY_BUFFER, Text2DResidentBufferID);
+			glBufferData(GL_ARRAY_BUFFER, Text2DResidentGlyphs * 4 * sizeof(Text2DVertex), NULL, GL_STATIC_DRAW);
+			Text2DResidentUsed = 0;
+			Text2DResidentGeneration++;
+		}
+		Text2DResidentScratch.resize(length * 4);
+		buildText2D(text, length, x, y, size, &Text2DResidentScratch[0]);
+		state.bindBuffer(GL_ARRAY_BUFFER, Text2DResidentBufferID);
+		glBufferSubData(GL_ARRAY_BUFFER, Text2DResidentUsed * 4 * sizeof(Text2DVertex),
+		                length * 4 * sizeof(Text2DVertex), &Text2DResidentScratch[0]);
+		entry.residentFirst = Text2DResidentUsed * 4;
+		entry.residentGeneration = Text2DResidentGeneration;
+		Text2DResidentUsed += length;
+		addText2DRun(true, entry.residentFirst, length);
+		return;
+	}
+
+	// New or changed : remember it, and build its quads right into the stream
+	if (!unchanged){
+		entry.text = text;
+		entry.x = x;
+		entry.y = y;
+		entry.size = size;
+		entry.residentGeneration = 0;
+	}
+	unsigned int bytes = length * 4 * sizeof(Text2DVertex);
+	if (Text2DStream.available() < bytes){
+		// Full : draw what is there, and go on in the next region
+		drawText2DBatch(state);
+		double start = clockTime();
+		Text2DStream.nextFrame();
+		Text2DFenceTime += clockTime() - start;
+	}
+	StreamAllocation allocation = Text2DStream.allocate(bytes, sizeof(Text2DVertex));
+	buildText2D(text, length, x, y, size, (Text2DVertex *)allocation.data);
+	addText2DRun(false, allocation.offset / sizeof(Text2DVertex), length);
+}
+
+void flushText2D(GLStateCache & state){
+
+	drawText2DBatch(state);
+	double start = clockTime();
+	Text2DStream.nextFrame();
+	Text2DFenceTime += clockTime() - start;
+
+	// Forget the strings that were not printed this frame
+	for ( std::unordered_map<unsigned long long, Text2DCacheEntry>::iterator it = Text2DCache.begin() ; it != Text2DCache.end() ; ){
+		if (it->second.lastFrame != Text2DFrame)
+			it = Text2DCache.erase(it);
+		else
+			++it;
+	}
+	Text2DFrame++;
+}
 
+double text2DFenceTime(){
+	return Text2DFenceTime;
 }
 
 void cleanupText2D(){
 
 	// Delete buffers
-	glDeleteBuffers(1, &Text2DVertexBufferID);
-	glDeleteBuffers(1, &Text2DUVBufferID);
+	Text2DStream.destroy();
+	glDeleteBuffers(1, &Text2DResidentBufferID);
+	glDeleteBuffers(1, &Text2DIndexBufferID);
+	glDeleteVertexArrays(1, &Text2DStreamVertexArrayID);
+	glDeleteVertexArrays(1, &Text2DResidentVertexArrayID);
+	Text2DCache.clear();
 
 	// Delete texture
 	glDeleteTextures(1, &Text2DTextureID);
@@ -1,8 +1,28 @@
 #ifndef TEXT2D_HPP
 #define TEXT2D_HPP
 
+#include <glm/glm.hpp>
+
+class GLStateCache;
+
+// Binds its buffers and VAOs directly : call it before the first frame, or invalidate() the GLStateCache after it
 void initText2D(const char * texturePath);
-void printText2D(const char * text, int x, int y, int size);
+// Adds the string to the text of this frame ; nothing is drawn until flushText2D(), unless the batch is full.
+// A string printed again unchanged is drawn from quads kept on the GPU, without building or copying them again.
+void printText2D(const char * text, int x, int y, int size, GLStateCache & state);
+// Draws all the text printed since the last call, through the state cache. Call once per frame, after the scene.
+void flushText2D(GLStateCache & state);
 void cleanupText2D();
+// In seconds, since initText2D() : the time spent putting a fence behind the text and waiting for the GPU to release
+// a region of the stream. A software rasterizer runs the draws of the frame in glFenceSync : they add up here.
+double text2DFenceTime();
+
+// One corner of a glyph quad : position and UV, interleaved
+struct Text2DVertex {
+	glm::vec2 position;
+	glm::vec2 uv;
+};
+// The 4 corners of every glyph of a string, as printText2D() sends them. Needs no OpenGL.
+void buildText2D(const char * text, unsigned int length, int x, int y, int size, Text2DVertex * vertices);
 
 #endif
\ No newline at end of file
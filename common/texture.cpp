@@ -1,30 +1,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 #include <GL/glew.h>
 
 #include <GLFW/glfw3.h>
 
+#include "texture.hpp"
 
-GLuint loadBMP_custom(const char * imagepath){
 
-	printf("Reading image %s\n", imagepath);
+bool readBMP(const char * imagepath, BMPImage & image){
 
 	// Data read from the header of the BMP file
 	unsigned char header[54];
 	unsigned int dataPos;
 	unsigned int imageSize;
-	unsigned int width, height;
-	// Actual RGB data
-	unsigned char * data;
 
 	// Open the file
 	FILE * file = fopen(imagepath,"rb");
 	if (!file){
 		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
 		getchar();
-		return 0;
+		return false;
 	}
 
 	// Read the header, i.e. the 54 first bytes
@@ -33,36 +31,45 @@ GLuint loadBMP_custom(const char * imagepath){
 	if ( fread(header, 1, 54, file)!=54 ){ 
 		printf("Not a correct BMP file\n");
 		fclose(file);
-		return 0;
+		return false;
 	}
 	// A BMP files always begins with "BM"
 	if ( header[0]!='B' || header[1]!='M' ){
 		printf("Not a correct BMP file\n");
 		fclose(file);
-		return 0;
+		return false;
 	}
 	// Make sure this is a 24bpp file
-	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    fclose(file); return 0;}
-	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    fclose(file); return 0;}
+	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    fclose(file); return false;}
+	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    fclose(file); return false;}
 
 	// Read the information about the image
-	dataPos    = *(int*)&(header[0x0A]);
-	imageSize  = *(int*)&(header[0x22]);
-	width      = *(int*)&(header[0x12]);
-	height     = *(int*)&(header[0x16]);
+	dataPos      = *(int*)&(header[0x0A]);
+	imageSize    = *(int*)&(header[0x22]);
+	image.width  = *(int*)&(header[0x12]);
+	image.height = *(int*)&(header[0x16]);
 
 	// Some BMP files are misformatted, guess missing information
-	if (imageSize==0)    imageSize=width*height*3; // 3 : one byte for each Red, Green and Blue component
+	if (imageSize==0)    imageSize=image.width*image.height*3; // 3 : one byte for each Red, Green and Blue component
 	if (dataPos==0)      dataPos=54; // The BMP header is done that way
 
-	// Create a buffer
-	data = new unsigned char [imageSize];
-
 	// Read the actual data from the file into the buffer
-	fread(data,1,imageSize,file);
+	image.data.resize(imageSize);
+	fseek(file, dataPos, SEEK_SET);
+	fread(&image.data[0],1,imageSize,file);
 
 	// Everything is in memory now, the file can be closed.
 	fclose (file);
+	return true;
+}
+
+GLuint loadBMP_custom(const char * imagepath){
+
+	printf("Reading image %s\n", imagepath);
+
+	BMPImage image;
+	if (!readBMP(imagepath, image))
+		return 0;
 
 	// Create one OpenGL texture
 	GLuint textureID;
@@ -72,10 +79,7 @@ GLuint loadBMP_custom(const char * imagepath){
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
 	// Give the image to OpenGL
-	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-
-	// OpenGL has now copied the data. Free our own version
-	delete [] data;
+	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, image.width, image.height, 0, GL_BGR, GL_UNSIGNED_BYTE, &image.data[0]);
 
 	// Poor filtering, or ...
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -124,7 +128,7 @@ GLuint loadBMP_custom(const char * imagepath){
 #define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
 #define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
 
-GLuint loadDDS(const char * imagepath){
+bool readDDS(const char * imagepath, DDSImage & image){
 
 	unsigned char header[124];
 
@@ -134,39 +138,47 @@ GLuint loadDDS(const char * imagepath){
 	fp = fopen(imagepath, "rb"); 
 	if (fp == NULL){
 		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); 
-		return 0;
+		return false;
 	}
    
 	/* verify the type of file */ 
 	char filecode[4]; 
-	fread(filecode, 1, 4, fp); 
-	if (strncmp(filecode, "DDS ", 4) != 0) { 
+	if (fread(filecode, 1, 4, fp) != 4 || strncmp(filecode, "DDS ", 4) != 0) { 
 		fclose(fp); 
-		return 0; 
+		return false; 
 	}
 	
 	/* get the surface desc */ 
-	fread(&header, 124, 1, fp); 
+	if (fread(&header, 124, 1, fp) != 1) {
+		fclose(fp);
+		return false;
+	}
 
-	unsigned int height      = *(unsigned int*)&(header[8 ]);
-	unsigned int width	     = *(unsigned int*)&(header[12]);
-	unsigned int linearSize	 = *(unsigned int*)&(header[16]);
-	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-	unsigned int fourCC      = *(unsigned int*)&(header[80]);
+	image.height             = *(unsigned int*)&(header[8 ]);
+	image.width              = *(unsigned int*)&(header[12]);
+	unsigned int linearSize  = *(unsigned int*)&(header[16]);
+	image.mipMapCount        = *(unsigned int*)&(header[24]);
+	image.fourCC             = *(unsigned int*)&(header[80]);
 
- 
-	unsigned char * buffer;
-	unsigned int bufsize;
 	/* how big is it going to be including all mipmaps? */ 
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize; 
-	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char)); 
-	fread(buffer, 1, bufsize, fp); 
+	unsigned int bufsize = image.mipMapCount > 1 ? linearSize * 2 : linearSize; 
+	image.data.resize(bufsize);
+	if (bufsize > 0)
+		image.data.resize(fread(&image.data[0], 1, bufsize, fp));
 	/* close the file pointer */ 
 	fclose(fp);
 
-	unsigned int components  = (fourCC == FOURCC_DXT1) ? 3 : 4; 
+	return image.fourCC == FOURCC_DXT1 || image.fourCC == FOURCC_DXT3 || image.fourCC == FOURCC_DXT5;
+}
+
+GLuint loadDDS(const char * imagepath){
+
+	DDSImage image;
+	if (!readDDS(imagepath, image))
+		return 0;
+
 	unsigned int format;
-	switch(fourCC) 
+	switch(image.fourCC) 
 	{ 
 	case FOURCC_DXT1: 
 		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; 
@@ -174,12 +186,9 @@ GLuint loadDDS(const char * imagepath){
 	case FOURCC_DXT3: 
 		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; 
 		break; 
-	case FOURCC_DXT5: 
+	default: 
 		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; 
 		break; 
-	default: 
-		free(buffer); 
-		return 0; 
 	}
 
 	// Create one OpenGL texture
@@ -192,13 +201,17 @@ GLuint loadDDS(const char * imagepath){
 	
 	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16; 
 	unsigned int offset = 0;
+	unsigned int width = image.width;
+	unsigned int height = image.height;
 
 	/* load the mipmaps */ 
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level) 
+	for (unsigned int level = 0; level < image.mipMapCount && (width || height); ++level) 
 	{ 
 		unsigned int size = ((width+3)/4)*((height+3)/4)*blockSize; 
+		if (offset + size > image.data.size())
+			break; // a truncated file
 		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,  
-			0, size, buffer + offset); 
+			0, size, &image.data[offset]); 
 	 
 		offset += size; 
 		width  /= 2; 
@@ -210,9 +223,7 @@ GLuint loadDDS(const char * imagepath){
 
 	} 
 
-	free(buffer); 
-
 	return textureID;
 
 
-}
\ No newline at end of file
+}
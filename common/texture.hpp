@@ -1,6 +1,22 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
+#include <vector>
+
+// An image as the loaders read it from the file, before giving it to OpenGL. Neither needs a context.
+struct BMPImage {
+	unsigned int width, height;
+	std::vector<unsigned char> data; // BGR, bottom row first
+};
+struct DDSImage {
+	unsigned int width, height;
+	unsigned int mipMapCount;
+	unsigned int fourCC; // "DXT1", "DXT3" or "DXT5"
+	std::vector<unsigned char> data; // every mipmap, the biggest first
+};
+bool readBMP(const char * imagepath, BMPImage & image);
+bool readDDS(const char * imagepath, DDSImage & image);
+
 // Load a .BMP file using our custom loader
 GLuint loadBMP_custom(const char * imagepath);
 
@@ -0,0 +1,498 @@
+#include <math.h>
+#include <stddef.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORMS_SSE
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX__)
+#define TRANSFORMS_AVX
+#include <immintrin.h>
+#endif
+
+#include "culling.hpp"
+#include "transforms.hpp"
+
+void Transforms::resize(unsigned int count)
+{
+    positionX.resize(count);
+    positionY.resize(count);
+    positionZ.resize(count);
+    rotationX.resize(count);
+    rotationY.resize(count);
+    rotationZ.resize(count);
+    rotationW.resize(count, 1.0f);
+    scaleX.resize(count, 1.0f);
+    scaleY.resize(count, 1.0f);
+    scaleZ.resize(count, 1.0f);
+}
+
+void Transforms::set(unsigned int i, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    positionX[i] = position.x;
+    positionY[i] = position.y;
+    positionZ[i] = position.z;
+    rotationX[i] = rotation.x;
+    rotationY[i] = rotation.y;
+    rotationZ[i] = rotation.z;
+    rotationW[i] = rotation.w;
+    scaleX[i] = scale.x;
+    scaleY[i] = scale.y;
+    scaleZ[i] = scale.z;
+}
+
+namespace
+{
+// The arrays of Transforms, in this order
+const int InputCount = 10;
+// The floats of a glm::mat4 and of an InstanceTransform
+const int ModelOutputs = 16;
+const int InstanceOutputs = sizeof(InstanceTransform) / sizeof(float);
+
+// One instance, or one instance per lane of a SIMD register : the kernel below is written once for all of them.
+struct Float1
+{
+    float v;
+
+    Float1()
+    {
+    }
+    Float1(float f) : v(f)
+    {
+    }
+    static Float1 load(const float *p)
+    {
+        return *p;
+    }
+    static Float1 gather(const float *p, const unsigned int *indices)
+    {
+        return p[indices[0]];
+    }
+    static void store(float *out, const Float1 *values, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            out[i] = values[i].v;
+        }
+    }
+};
+
+inline Float1 operator+(Float1 a, Float1 b)
+{
+    return a.v + b.v;
+}
+inline Float1 operator-(Float1 a, Float1 b)
+{
+    return a.v - b.v;
+}
+inline Float1 operator*(Float1 a, Float1 b)
+{
+    return a.v * b.v;
+}
+inline Float1 operator/(Float1 a, Float1 b)
+{
+    return a.v / b.v;
+}
+
+#ifdef TRANSFORMS_SSE
+
+// Writes the 4 lanes of 'values' as 4 consecutive outputs of 'count' floats, 4 floats of each at a time
+inline void storeLanes(float *out, const __m128 *values, int count)
+{
+    for (int i = 0; i < count; i += 4)
+    {
+        __m128 a = values[i], b = values[i + 1], c = values[i + 2], d = values[i + 3];
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _mm_storeu_ps(out + i, a);
+        _mm_storeu_ps(out + count + i, b);
+        _mm_storeu_ps(out + 2 * count + i, c);
+        _mm_storeu_ps(out + 3 * count + i, d);
+    }
+}
+
+struct Float4
+{
+    __m128 v;
+
+    Float4()
+    {
+    }
+    Float4(float f) : v(_mm_set1_ps(f))
+    {
+    }
+    Float4(__m128 m) : v(m)
+    {
+    }
+    static Float4 load(const float *p)
+    {
+        return _mm_loadu_ps(p);
+    }
+    static Float4 gather(const float *p, const unsigned int *indices)
+    {
+        return _mm_set_ps(p[indices[3]], p[indices[2]], p[indices[1]], p[indices[0]]);
+    }
+    static void store(float *out, const Float4 *values, int count)
+    {
+        storeLanes(out, &values[0].v, count);
+    }
+};
+
+inline Float4 operator+(Float4 a, Float4 b)
+{
+    return _mm_add_ps(a.v, b.v);
+}
+inline Float4 operator-(Float4 a, Float4 b)
+{
+    return _mm_sub_ps(a.v, b.v);
+}
+inline Float4 operator*(Float4 a, Float4 b)
+{
+    return _mm_mul_ps(a.v, b.v);
+}
+inline Float4 operator/(Float4 a, Float4 b)
+{
+    return _mm_div_ps(a.v, b.v);
+}
+
+#endif
+
+#ifdef TRANSFORMS_AVX
+
+struct Float8
+{
+    __m256 v;
+
+    Float8()
+    {
+    }
+    Float8(float f) : v(_mm256_set1_ps(f))
+    {
+    }
+    Float8(__m256 m) : v(m)
+    {
+    }
+    static Float8 load(const float *p)
+    {
+        return _mm256_loadu_ps(p);
+    }
+    static Float8 gather(const float *p, const unsigned int *indices)
+    {
+        return _mm256_set_ps(p[indices[7]], p[indices[6]], p[indices[5]], p[indices[4]], p[indices[3]],
+                             p[indices[2]], p[indices[1]], p[indices[0]]);
+    }
+    // Lanes 0 to 3, then 4 to 7, as with SSE
+    static void store(float *out, const Float8 *values, int count)
+    {
+        __m128 low[InstanceOutputs], high[InstanceOutputs];
+        for (int i = 0; i < count; i++)
+        {
+            low[i] = _mm256_castps256_ps128(values[i].v);
+            high[i] = _mm256_extractf128_ps(values[i].v, 1);
+        }
+        storeLanes(out, low, count);
+        storeLanes(out + 4 * count, high, count);
+    }
+};
+
+inline Float8 operator+(Float8 a, Float8 b)
+{
+    return _mm256_add_ps(a.v, b.v);
+}
+inline Float8 operator-(Float8 a, Float8 b)
+{
+    return _mm256_sub_ps(a.v, b.v);
+}
+inline Float8 operator*(Float8 a, Float8 b)
+{
+    return _mm256_mul_ps(a.v, b.v);
+}
+inline Float8 operator/(Float8 a, Float8 b)
+{
+    return _mm256_div_ps(a.v, b.v);
+}
+
+#endif
+
+// The matrices of the instances of 'in' : the model, then with Outputs == InstanceOutputs the MVP and the normal
+// matrix too, as the floats of a glm::mat4 or of an InstanceTransform. The rotation is glm::mat3_cast().
+template <typename F, int Outputs> inline void transformLanes(const F *in, const F *viewProjection, F *out)
+{
+    F px = in[0], py = in[1], pz = in[2];
+    F x = in[3], y = in[4], z = in[5], w = in[6];
+    F scale[3] = {in[7], in[8], in[9]};
+    F zero(0.0f), one(1.0f), two(2.0f);
+
+    F xx = x * x, yy = y * y, zz = z * z;
+    F xy = x * y, xz = x * z, yz = y * z;
+    F wx = w * x, wy = w * y, wz = w * z;
+    F rotation[3][3] = {{one - two * (yy + zz), two * (xy + wz), two * (xz - wy)},
+                        {two * (xy - wz), one - two * (xx + zz), two * (yz + wx)},
+                        {two * (xz + wy), two * (yz - wx), one - two * (xx + yy)}};
+
+    for (int c = 0; c < 3; c++)
+    {
+        out[4 * c + 0] = rotation[c][0] * scale[c];
+        out[4 * c + 1] = rotation[c][1] * scale[c];
+        out[4 * c + 2] = rotation[c][2] * scale[c];
+        out[4 * c + 3] = zero;
+    }
+    out[12] = px;
+    out[13] = py;
+    out[14] = pz;
+    out[15] = one;
+    if (Outputs == ModelOutputs)
+    {
+        return;
+    }
+
+    // viewProjection * model : the last row of the model is (0, 0, 0, 1)
+    F *mvp = out + 16;
+    for (int c = 0; c < 3; c++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            mvp[4 * c + row] = viewProjection[row] * out[4 * c] + viewProjection[4 + row] * out[4 * c + 1] +
+                               viewProjection[8 + row] * out[4 * c + 2];
+        }
+    }
+    for (int row = 0; row < 4; row++)
+    {
+        mvp[12 + row] = viewProjection[row] * px + viewProjection[4 + row] * py + viewProjection[8 + row] * pz +
+                        viewProjection[12 + row];
+    }
+
+    // The inverse transpose of rotation * scale is rotation / scale
+    F *normal = out + 32;
+    for (int c = 0; c < 3; c++)
+    {
+        F inverseScale = one / scale[c];
+        normal[4 * c + 0] = rotation[c][0] * inverseScale;
+        normal[4 * c + 1] = rotation[c][1] * inverseScale;
+        normal[4 * c + 2] = rotation[c][2] * inverseScale;
+        normal[4 * c + 3] = zero;
+    }
+}
+
+// Instances i to i + width - 1 of the arrays, or of 'indices' when Indexed
+template <typename F, int Outputs, bool Indexed>
+inline void transformBlock(const float *const *arrays, const unsigned int *indices, unsigned int i,
+                           const F *viewProjection, float *out)
+{
+    F in[InputCount];
+    for (int a = 0; a < InputCount; a++)
+    {
+        in[a] = Indexed ? F::gather(arrays[a], indices + i) : F::load(arrays[a] + i);
+    }
+    F result[Outputs];
+    transformLanes<F, Outputs>(in, viewProjection, result);
+    F::store(out, result, Outputs);
+}
+
+template <typename F> void broadcastMatrix(const glm::mat4 &matrix, F *out)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        out[i] = F((&matrix[0][0])[i]);
+    }
+}
+
+// Instances [first, last) of the arrays, or indices[first] to indices[last - 1] when Indexed : out[0] is the first.
+template <int Outputs, bool Indexed>
+void transformInstances(const Transforms &transforms, const glm::mat4 &viewProjection, const unsigned int *indices,
+                        unsigned int first, unsigned int last, float *out, bool simd)
+{
+    if (first >= last)
+    {
+        return;
+    }
+    const float *arrays[InputCount] = {&transforms.positionX[0], &transforms.positionY[0], &transforms.positionZ[0],
+                                       &transforms.rotationX[0], &transforms.rotationY[0], &transforms.rotationZ[0],
+                                       &transforms.rotationW[0], &transforms.scaleX[0],    &transforms.scaleY[0],
+                                       &transforms.scaleZ[0]};
+    unsigned int i = first;
+
+#ifdef TRANSFORMS_AVX
+    if (simd)
+    {
+        Float8 viewProjection8[16];
+        broadcastMatrix(viewProjection, viewProjection8);
+        for (; i + 8 <= last; i += 8)
+        {
+            transformBlock<Float8, Outputs, Indexed>(arrays, indices, i, viewProjection8,
+                                                     out + (size_t)(i - first) * Outputs);
+        }
+    }
+#endif
+#ifdef TRANSFORMS_SSE
+    if (simd)
+    {
+        Float4 viewProjection4[16];
+        broadcastMatrix(viewProjection, viewProjection4);
+        for (; i + 4 <= last; i += 4)
+        {
+            transformBlock<Float4, Outputs, Indexed>(arrays, indices, i, viewProjection4,
+                                                     out + (size_t)(i - first) * Outputs);
+        }
+    }
+#endif
+    Float1 viewProjection1[16];
+    broadcastMatrix(viewProjection, viewProjection1);
+    for (; i < last; i++)
+    {
+        transformBlock<Float1, Outputs, Indexed>(arrays, indices, i, viewProjection1,
+                                                 out + (size_t)(i - first) * Outputs);
+    }
+}
+} // namespace
+
+void computeInstanceTransforms(const Transforms &transforms, const glm::mat4 &viewProjection, unsigned int first,
+                               unsigned int last, InstanceTransform *out)
+{
+    transformInstances<InstanceOutputs, false>(transforms, viewProjection, NULL, first, last, (float *)out, true);
+}
+
+void computeIndexedInstanceTransforms(const Transforms &transforms, const glm::mat4 &viewProjection,
+                                      const unsigned int *indices, unsigned int count, InstanceTransform *out)
+{
+    transformInstances<InstanceOutputs, true>(transforms, viewProjection, indices, 0, count, (float *)out, true);
+}
+
+void computeInstanceTransformsScalar(const Transforms &transforms, const glm::mat4 &viewProjection,
+                                     unsigned int first, unsigned int last, InstanceTransform *out)
+{
+    transformInstances<InstanceOutputs, false>(transforms, viewProjection, NULL, first, last, (float *)out, false);
+}
+
+void computeModelMatrices(const Transforms &transforms, unsigned int first, unsigned int last, glm::mat4 *out)
+{
+    transformInstances<ModelOutputs, false>(transforms, glm::mat4(1.0f), NULL, first, last, &out[0][0][0], true);
+}
+
+void computeModelMatricesScalar(const Transforms &transforms, unsigned int first, unsigned int last, glm::mat4 *out)
+{
+    transformInstances<ModelOutputs, false>(transforms, glm::mat4(1.0f), NULL, first, last, &out[0][0][0], false);
+}
+
+void computeBoundingSpheres(const Transforms &transforms, const glm::vec3 &center, float radius, unsigned int first,
+                            unsigned int last, BoundingSpheres &spheres)
+{
+    for (unsigned int i = first; i < last; i++)
+    {
+        glm::vec3 scale(transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i]);
+        glm::quat rotation(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i],
+                           transforms.rotationZ[i]);
+        glm::vec3 position(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]);
+        float largestScale = glm::max(glm::abs(scale.x), glm::max(glm::abs(scale.y), glm::abs(scale.z)));
+        spheres.set(i, position + rotation * (scale * center), radius * largestScale);
+    }
+}
+
+namespace
+{
+inline void encodeInstance(const Transforms &transforms, unsigned int i, CompactInstance &out)
+{
+    out.rotation[0] = transforms.rotationX[i];
+    out.rotation[1] = transforms.rotationY[i];
+    out.rotation[2] = transforms.rotationZ[i];
+    out.rotation[3] = transforms.rotationW[i];
+    out.position[0] = transforms.positionX[i];
+    out.position[1] = transforms.positionY[i];
+    out.position[2] = transforms.positionZ[i];
+    out.scale = transforms.scaleX[i];
+}
+
+// Rounded to the nearest of the 65535 values : the conversion truncates, so half a step away from 0 first
+inline short quantize(float f)
+{
+    f = glm::clamp(f, -1.0f, 1.0f) * 32767.0f;
+    return (short)(f + copysignf(0.5f, f));
+}
+
+inline void encodeInstance(const Transforms &transforms, unsigned int i, QuantizedInstance &out)
+{
+    out.rotation[0] = quantize(transforms.rotationX[i]);
+    out.rotation[1] = quantize(transforms.rotationY[i]);
+    out.rotation[2] = quantize(transforms.rotationZ[i]);
+    out.rotation[3] = quantize(transforms.rotationW[i]);
+    out.position[0] = transforms.positionX[i];
+    out.position[1] = transforms.positionY[i];
+    out.position[2] = transforms.positionZ[i];
+    out.scale = transforms.scaleX[i];
+}
+
+// Like the vertex shader : the quaternion is normalized again, then rotates the scaled vertex
+void decodeInstance(const glm::quat &rotation, const float *position, float scale, glm::mat4 &model,
+                    glm::mat3 &normal)
+{
+    normal = glm::mat3_cast(glm::normalize(rotation));
+    model = glm::mat4(normal * scale);
+    model[3] = glm::vec4(position[0], position[1], position[2], 1.0f);
+}
+} // namespace
+
+void computeCompactInstances(const Transforms &transforms, unsigned int first, unsigned int last, CompactInstance *out)
+{
+    for (unsigned int i = first; i < last; i++)
+    {
+        encodeInstance(transforms, i, out[i - first]);
+    }
+}
+
+void computeIndexedCompactInstances(const Transforms &transforms, const unsigned int *indices, unsigned int count,
+                                    CompactInstance *out)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        encodeInstance(transforms, indices[i], out[i]);
+    }
+}
+
+void computeQuantizedInstances(const Transforms &transforms, unsigned int first, unsigned int last,
+                               QuantizedInstance *out)
+{
+    for (unsigned int i = first; i < last; i++)
+    {
+        encodeInstance(transforms, i, out[i - first]);
+    }
+}
+
+void computeIndexedQuantizedInstances(const Transforms &transforms, const unsigned int *indices, unsigned int count,
+                                      QuantizedInstance *out)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        encodeInstance(transforms, indices[i], out[i]);
+    }
+}
+
+void decodeCompactInstance(const CompactInstance &instance, glm::mat4 &model, glm::mat3 &normal)
+{
+    glm::quat rotation(instance.rotation[3], instance.rotation[0], instance.rotation[1], instance.rotation[2]);
+    decodeInstance(rotation, instance.position, instance.scale, model, normal);
+}
+
+void decodeQuantizedInstance(const QuantizedInstance &instance, glm::mat4 &model, glm::mat3 &normal)
+{
+    float rotation[4];
+    for (int c = 0; c < 4; c++)
+    {
+        rotation[c] = glm::max(instance.rotation[c] / 32767.0f, -1.0f);
+    }
+    decodeInstance(glm::quat(rotation[3], rotation[0], rotation[1], rotation[2]), instance.position, instance.scale,
+                   model, normal);
+}
+
+const char *transformsInstructionSet()
+{
+#if defined(TRANSFORMS_AVX)
+    return "AVX";
+#elif defined(TRANSFORMS_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,96 @@
+#ifndef TRANSFORMS_HPP
+#define TRANSFORMS_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+struct BoundingSpheres;
+
+// Translation, rotation and scale of many instances, stored as structures of arrays like the bounds of culling.hpp,
+// so that the kernels load the same component of 4 (SSE) or 8 (AVX) instances at once. Rotations are unit
+// quaternions, scales may differ along each axis.
+struct Transforms
+{
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+
+    void resize(unsigned int count);
+    void set(unsigned int i, const glm::vec3 &position, const glm::quat &rotation,
+             const glm::vec3 &scale = glm::vec3(1.0f));
+    unsigned int size() const
+    {
+        return positionX.size();
+    }
+};
+
+// What StandardShadingTransforms.vertexshader reads for an instance, see enableInstanceTransformAttributes()
+struct InstanceTransform
+{
+    glm::mat4 model;     // translate(position) * mat4_cast(rotation) * scale(scale)
+    glm::mat4 mvp;       // viewProjection * model
+    glm::vec4 normal[3]; // inverse transpose of the 3x3 of the model, w unused : right with any scale
+};
+
+// Rigid instances, scaled the same along each axis : 32 bytes instead of the 64 of a model matrix, or 24 with the
+// rotation quantized to 16 bits per component. StandardShadingCompact.vertexshader builds the model matrix from them,
+// see enableCompactInstanceAttributes().
+struct CompactInstance
+{
+    float rotation[4]; // x, y, z, w of a unit quaternion
+    float position[3];
+    float scale;
+};
+
+struct QuantizedInstance
+{
+    short rotation[4]; // x, y, z, w times 32767, read as normalized shorts
+    float position[3];
+    float scale;
+};
+
+// Write the matrices of the instances [first, last) to out[0] to out[last - first - 1], or of the 'count' instances
+// of 'indices' in that order. 'out' can be mapped memory : it is only written, once, in order.
+//
+// The view-projection matrix is computed once by the caller, not once per instance. Like the culling kernels, these
+// work on 4 instances at once with SSE and 8 with AVX (USE_AVX in CMakeLists.txt), and on one at a time with the
+// scalar versions. All do the same operations in the same order : they give exactly the same matrices. Ranges are
+// independent, so that several threads can share the instances with JobSystem::parallelFor.
+void computeInstanceTransforms(const Transforms &transforms, const glm::mat4 &viewProjection, unsigned int first,
+                               unsigned int last, InstanceTransform *out);
+void computeIndexedInstanceTransforms(const Transforms &transforms, const glm::mat4 &viewProjection,
+                                      const unsigned int *indices, unsigned int count, InstanceTransform *out);
+void computeInstanceTransformsScalar(const Transforms &transforms, const glm::mat4 &viewProjection,
+                                     unsigned int first, unsigned int last, InstanceTransform *out);
+
+// The model matrices only, for the code that still wants a glm::mat4 per instance
+void computeModelMatrices(const Transforms &transforms, unsigned int first, unsigned int last, glm::mat4 *out);
+void computeModelMatricesScalar(const Transforms &transforms, unsigned int first, unsigned int last, glm::mat4 *out);
+
+// The instances [first, last), or the 'count' instances of 'indices', in the compact formats above. The scale is the
+// one along X : it must be the same along each axis.
+void computeCompactInstances(const Transforms &transforms, unsigned int first, unsigned int last, CompactInstance *out);
+void computeIndexedCompactInstances(const Transforms &transforms, const unsigned int *indices, unsigned int count,
+                                    CompactInstance *out);
+void computeQuantizedInstances(const Transforms &transforms, unsigned int first, unsigned int last,
+                               QuantizedInstance *out);
+void computeIndexedQuantizedInstances(const Transforms &transforms, const unsigned int *indices, unsigned int count,
+                                      QuantizedInstance *out);
+
+// What the vertex shader does with them, as a reference : the model matrix, and the normal matrix, which is the
+// rotation alone as the scale is uniform. Quantized rotations are divided by 32767 like OpenGL 4.2 and later do,
+// then normalized : the older (2c + 1) / 65535 rule of some drivers gives the same rotation within the quantization.
+void decodeCompactInstance(const CompactInstance &instance, glm::mat4 &model, glm::mat3 &normal);
+void decodeQuantizedInstance(const QuantizedInstance &instance, glm::mat4 &model, glm::mat3 &normal);
+
+// The bounding sphere of a mesh, 'center' and 'radius' in model space, around the instances [first, last) : the
+// radius grows with the largest of the scales
+void computeBoundingSpheres(const Transforms &transforms, const glm::vec3 &center, float radius, unsigned int first,
+                            unsigned int last, BoundingSpheres &spheres);
+
+// "AVX", "SSE" or "scalar"
+const char *transformsInstructionSet();
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef VBOINDEXER_HPP
 #define VBOINDEXER_HPP
 
+// Merges the identical vertices of a list of triangles, with a std::map
 void indexVBO(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
@@ -12,7 +13,19 @@ void indexVBO(
 	std::vector<glm::vec3> & out_normals
 );
 
+// The same, with a linear search for every vertex : quadratic, only for small meshes
+void indexVBO_slow(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<unsigned short> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
 
+// The same, averaging the tangents and bitangents of the merged vertices. Quadratic too.
 void indexVBO_TBN(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
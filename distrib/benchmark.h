@@ -0,0 +1,453 @@
+#ifndef DISTRIB_BENCHMARK_INTERNAL_H
+#define DISTRIB_BENCHMARK_INTERNAL_H
+
+// Headless, deterministic benchmark runs of a tutorial.
+//
+// Like screenshot.h, this replaces the GLFW calls of the file that includes it, right after glfw3.h :
+//  - there is no window : the context is an EGL one, on a pbuffer of the size of the window, on the surfaceless
+//    platform of Mesa when there is one, so that no display is needed
+//  - there is no input : no key is ever pressed, and computeMatricesFromInputs() follows a camera path instead,
+//    one step per frame whatever the frame time, so that every run draws the same frames
+//  - with --physics, tutorial09_AssImp simulates exactly one physics step per frame, for the same reason
+//  - the tutorial runs BENCHMARK_WARMUP frames at the start of the path, then BENCHMARK_FRAMES frames along it,
+//    and stops. Every frame ends with a glFinish(), and the measured ones are timed from one swap to the next.
+//
+// Everything else comes from the environment :
+//  BENCHMARK_WARMUP      frames before the measured ones (10)
+//  BENCHMARK_FRAMES      measured frames (200)
+//  BENCHMARK_PATH        the camera path : one "theta phi radius" keyframe per line, the angles and the distance
+//                        of controls.cpp, spread evenly over the measured frames. By default, one orbit.
+//  BENCHMARK_CSV         writes the time of every measured frame there
+//  BENCHMARK_JSON        writes the statistics and the frame times there
+//  BENCHMARK_SCREENSHOT  writes the last frame there, as a BMP
+//  BENCHMARK_GOLDEN      compares the last frame with this BMP : the run fails, and the program exits with 1,
+//  BENCHMARK_TOLERANCE   when more than 0.1% of the pixels differ by more than this on a channel (8)
+//  BENCHMARK_CAPTURE     captures the measured frames, through common/framecapture.hpp : a BMP or PNG name with the
+//                        %u of the frame ("capture/frame%04u.png"), or a .y4m video. The capture is part of the
+//                        frame times, and its cost and dropped frames are printed with them.
+//
+// The statistics are printed at glfwTerminate(). As in screenshot.h, MSAA is off and rand() always starts from
+// the same seed.
+//
+// Linux only. The build has a *_headless target of each tutorial, compiled with HEADLESS_BENCHMARK :
+//     BENCHMARK_FRAMES=500 BENCHMARK_JSON=run.json ./tutorial09_AssImp_headless --stress 2000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#define DISTRIB_SCREENSHOT_NO_MACROS
+#include "screenshot.h"
+
+#include <common/framecapture.hpp>
+
+// The matrices of common/controls.cpp
+extern glm::mat4 ViewMatrix;
+extern glm::mat4 ProjectionMatrix;
+
+struct BenchmarkRun {
+	EGLDisplay display;
+	EGLSurface surface;
+	EGLContext context;
+	int width, height;
+	int contextMajor, contextMinor;
+	bool coreProfile;
+	const char * title;
+
+	unsigned int warmupFrames, measuredFrames;
+	unsigned int frame;
+	std::vector<glm::vec3> path; // theta, phi, radius
+	std::chrono::steady_clock::time_point clockStart;
+	double lastSwap;
+	std::vector<double> frameTimes; // seconds
+
+	bool goldenChecked, goldenPassed;
+	unsigned int differingPixels;
+
+	FrameCapture capture;
+	double captureTime; // seconds, in capture() : the GLFW clock of framecapture.cpp does not run here
+};
+
+BenchmarkRun benchmark;
+
+unsigned int benchmarkEnvironment(const char * name, unsigned int defaultValue){
+	const char * value = getenv(name);
+	return value != NULL && atoi(value) >= 0 ? (unsigned int)atoi(value) : defaultValue;
+}
+
+void loadBenchmarkPath(){
+	benchmark.path.clear();
+	const char * pathFile = getenv("BENCHMARK_PATH");
+	if (pathFile != NULL){
+		FILE * file = fopen(pathFile, "r");
+		if (file == NULL){
+			fprintf(stderr, "Cannot open the camera path %s, using the default one\n", pathFile);
+		}else{
+			char line[256];
+			while (fgets(line, sizeof(line), file) != NULL){
+				glm::vec3 keyframe;
+				if (line[0] != '#' && sscanf(line, "%f %f %f", &keyframe.x, &keyframe.y, &keyframe.z) == 3)
+					benchmark.path.push_back(keyframe);
+			}
+			fclose(file);
+		}
+	}
+	if (benchmark.path.empty()){
+		// One orbit, from where controls.cpp starts, going up, closer, down and back
+		float pi = 3.14159265f;
+		benchmark.path.push_back(glm::vec3(0.0f,      0.0f,  5.0f));
+		benchmark.path.push_back(glm::vec3(pi/2,      0.4f,  4.0f));
+		benchmark.path.push_back(glm::vec3(pi,        0.0f,  6.0f));
+		benchmark.path.push_back(glm::vec3(3*pi/2,   -0.3f,  4.0f));
+		benchmark.path.push_back(glm::vec3(2*pi,      0.0f,  5.0f));
+	}
+}
+
+int benchmarkInit(){
+	benchmark.width = 1024;
+	benchmark.height = 768;
+	benchmark.contextMajor = 3;
+	benchmark.contextMinor = 3;
+	benchmark.coreProfile = false;
+	benchmark.title = "";
+	benchmark.surface = EGL_NO_SURFACE;
+	benchmark.context = EGL_NO_CONTEXT;
+	benchmark.warmupFrames = benchmarkEnvironment("BENCHMARK_WARMUP", 10);
+	benchmark.measuredFrames = benchmarkEnvironment("BENCHMARK_FRAMES", 200);
+	benchmark.frame = 0;
+	benchmark.clockStart = std::chrono::steady_clock::now();
+	benchmark.lastSwap = 0.0;
+	benchmark.frameTimes.clear();
+	benchmark.goldenChecked = false;
+	benchmark.goldenPassed = true;
+	benchmark.differingPixels = 0;
+	benchmark.captureTime = 0.0;
+	loadBenchmarkPath();
+
+	srand(42); // Always use the same seed
+
+	// No display : Mesa's surfaceless platform, else whatever the default one is
+	benchmark.display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+	const char * extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (extensions != NULL && strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL && getPlatformDisplay != NULL)
+		benchmark.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+	if (benchmark.display == EGL_NO_DISPLAY)
+		benchmark.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (benchmark.display == EGL_NO_DISPLAY || !eglInitialize(benchmark.display, &major, &minor)){
+		fprintf(stderr, "Failed to initialize EGL\n");
+		return GL_FALSE;
+	}
+	return GL_TRUE;
+}
+
+void benchmarkWindowHint(int target, int hint){
+	// Disable MSAA, like screenshot.h : the other hints have no EGL equivalent worth having here
+	if ( target == GLFW_CONTEXT_VERSION_MAJOR )
+		benchmark.contextMajor = hint;
+	else if ( target == GLFW_CONTEXT_VERSION_MINOR )
+		benchmark.contextMinor = hint;
+	else if ( target == GLFW_OPENGL_PROFILE )
+		benchmark.coreProfile = hint == GLFW_OPENGL_CORE_PROFILE;
+}
+
+GLFWwindow * benchmarkCreateWindow(int width, int height, const char * title, GLFWmonitor *, GLFWwindow *){
+	benchmark.width = width;
+	benchmark.height = height;
+	benchmark.title = title;
+
+	EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(benchmark.display, configAttributes, &config, 1, &configCount) || configCount == 0){
+		fprintf(stderr, "No EGL config for an OpenGL pbuffer\n");
+		return NULL;
+	}
+
+	EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+	benchmark.surface = eglCreatePbufferSurface(benchmark.display, config, surfaceAttributes);
+
+	EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, benchmark.contextMajor,
+		EGL_CONTEXT_MINOR_VERSION_KHR, benchmark.contextMinor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, benchmark.coreProfile ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR
+		                                                            : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+		EGL_NONE
+	};
+	eglBindAPI(EGL_OPENGL_API);
+	benchmark.context = eglCreateContext(benchmark.display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (benchmark.surface == EGL_NO_SURFACE || benchmark.context == EGL_NO_CONTEXT){
+		fprintf(stderr, "Failed to create an OpenGL %d.%d context on a %dx%d pbuffer\n",
+		        benchmark.contextMajor, benchmark.contextMinor, width, height);
+		return NULL;
+	}
+
+	// Nothing reads it : any pointer that is not NULL will do
+	return (GLFWwindow *)&benchmark;
+}
+
+void benchmarkMakeContextCurrent(GLFWwindow *){
+	eglMakeCurrent(benchmark.display, benchmark.surface, benchmark.surface, benchmark.context);
+}
+
+double benchmarkTime(){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - benchmark.clockStart).count();
+}
+
+// computeMatricesFromInputs(), along the path instead of from the keys
+void benchmarkCamera(){
+	// The warm-up stays at the start, the measured frames go from the first keyframe to the last
+	float t = 0.0f;
+	if (benchmark.frame >= benchmark.warmupFrames && benchmark.measuredFrames > 1)
+		t = float(benchmark.frame - benchmark.warmupFrames) / float(benchmark.measuredFrames - 1);
+	float position = std::min(t, 1.0f) * float(benchmark.path.size() - 1);
+	size_t keyframe = std::min((size_t)position, benchmark.path.size() - 1);
+	size_t next = std::min(keyframe + 1, benchmark.path.size() - 1);
+	glm::vec3 orbit = glm::mix(benchmark.path[keyframe], benchmark.path[next], position - float(keyframe));
+
+	// As in controls.cpp : theta, phi and the radius, looking at the origin
+	float theta = orbit.x, phi = orbit.y, r = orbit.z;
+	glm::vec3 origin = glm::vec3(0, 0, 0);
+	glm::vec3 eye = glm::vec3(r * cos(phi) * sin(theta), r * sin(phi), r * cos(phi) * cos(theta));
+	glm::vec3 direction = glm::normalize(origin - eye);
+	glm::vec3 up = glm::vec3(0, 1, 0);
+	glm::vec3 right = glm::normalize(glm::cross(up, direction));
+	up = glm::cross(direction, right);
+
+	ProjectionMatrix = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	ViewMatrix = glm::lookAt(eye, origin, up);
+}
+
+// Compares the framebuffer with a BMP written by SaveScreenshot()
+bool compareWithGolden(const char * path, int tolerance){
+	FILE * file = fopen(path, "rb");
+	if (file == NULL){
+		fprintf(stderr, "Cannot open the golden image %s\n", path);
+		return false;
+	}
+	unsigned char header[54];
+	std::vector<unsigned char> golden;
+	bool valid = fread(header, 1, 54, file) == 54 && header[0] == 'B' && header[1] == 'M' && header[0x1C] == 24
+	          && *(int*)&(header[0x12]) == benchmark.width && *(int*)&(header[0x16]) == benchmark.height;
+	int rowSize = (benchmark.width*3 + 3) & ~3;
+	if (valid){
+		golden.resize(rowSize * benchmark.height);
+		fseek(file, *(int*)&(header[0x0A]), SEEK_SET);
+		valid = fread(&golden[0], 1, golden.size(), file) == golden.size();
+	}
+	fclose(file);
+	if (!valid){
+		fprintf(stderr, "%s is not a %dx%d 24 bits BMP\n", path, benchmark.width, benchmark.height);
+		return false;
+	}
+
+	std::vector<unsigned char> pixels(golden.size());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, benchmark.width, benchmark.height, GL_BGR, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	benchmark.differingPixels = 0;
+	for (int y = 0; y < benchmark.height; y++){
+		for (int x = 0; x < benchmark.width; x++){
+			const unsigned char * a = &pixels[y * rowSize + x * 3];
+			const unsigned char * b = &golden[y * rowSize + x * 3];
+			for (int c = 0; c < 3; c++){
+				if (abs(a[c] - b[c]) > tolerance){
+					benchmark.differingPixels++;
+					break;
+				}
+			}
+		}
+	}
+	return benchmark.differingPixels * 1000 <= (unsigned int)(benchmark.width * benchmark.height);
+}
+
+// The format of BENCHMARK_CAPTURE, from its extension
+FrameCaptureFormat benchmarkCaptureFormat(const char * path){
+	const char * extension = strrchr(path, '.');
+	if (extension != NULL && (strcmp(extension, ".png") == 0 || strcmp(extension, ".PNG") == 0))
+		return CapturePNG;
+	if (extension != NULL && (strcmp(extension, ".y4m") == 0 || strcmp(extension, ".Y4M") == 0))
+		return CaptureY4M;
+	return CaptureBMP;
+}
+
+void benchmarkSwapBuffers(GLFWwindow *){
+	// The measured frames, before the glFinish() : the readback is part of the frame, as it would be in a recording
+	const char * capturePath = getenv("BENCHMARK_CAPTURE");
+	if (capturePath != NULL && benchmark.frame >= benchmark.warmupFrames){
+		FrameCaptureFormat format = benchmarkCaptureFormat(capturePath);
+		if (benchmark.frame == benchmark.warmupFrames
+		 && !benchmark.capture.create(benchmark.width, benchmark.height, capturePath, format))
+			fprintf(stderr, "Cannot write %s, not capturing\n", capturePath);
+		double start = benchmarkTime();
+		benchmark.capture.capture();
+		benchmark.captureTime += benchmarkTime() - start;
+	}
+
+	// The frame is only done when the GPU is
+	glFinish();
+	double now = benchmarkTime();
+	if (benchmark.frame >= benchmark.warmupFrames)
+		benchmark.frameTimes.push_back(now - benchmark.lastSwap);
+
+	// The last frame, before the swap
+	if (benchmark.frame + 1 == benchmark.warmupFrames + benchmark.measuredFrames){
+		if (getenv("BENCHMARK_SCREENSHOT") != NULL)
+			SaveScreenshot(getenv("BENCHMARK_SCREENSHOT"), benchmark.width, benchmark.height);
+		if (getenv("BENCHMARK_GOLDEN") != NULL){
+			benchmark.goldenChecked = true;
+			benchmark.goldenPassed = compareWithGolden(getenv("BENCHMARK_GOLDEN"),
+			                                           benchmarkEnvironment("BENCHMARK_TOLERANCE", 8));
+		}
+	}
+
+	eglSwapBuffers(benchmark.display, benchmark.surface);
+	benchmark.frame++;
+	benchmark.lastSwap = benchmarkTime();
+}
+
+int benchmarkWindowShouldClose(GLFWwindow *){
+	return benchmark.frame >= benchmark.warmupFrames + benchmark.measuredFrames;
+}
+
+void writeBenchmarkResults(){
+	std::vector<double> sorted = benchmark.frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (size_t i = 0; i < sorted.size(); i++)
+		total += sorted[i];
+	double mean = total / sorted.size();
+	double p50 = sorted[sorted.size() / 2];
+	double p95 = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+	double p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+	const char * renderer = (const char *)glGetString(GL_RENDERER);
+
+	printf("%s, headless on %s : %u frames after %u warm-up frames, %.3f ms/frame (%.1f fps), "
+	       "min %.3f ms, median %.3f ms, 95%% %.3f ms, 99%% %.3f ms, max %.3f ms\n",
+	       benchmark.title, renderer, (unsigned int)sorted.size(), benchmark.warmupFrames, 1000.0 * mean, 1.0 / mean,
+	       1000.0 * sorted.front(), 1000.0 * p50, 1000.0 * p95, 1000.0 * p99, 1000.0 * sorted.back());
+	if (benchmark.goldenChecked)
+		printf("Golden image %s : %u pixels differ, %s\n", getenv("BENCHMARK_GOLDEN"), benchmark.differingPixels,
+		       benchmark.goldenPassed ? "pass" : "FAIL");
+	FrameCaptureStats capture = benchmark.capture.stats();
+	if (capture.frames > 0)
+		printf("Capture to %s : %u frames, %u written, %u dropped, %u stalls, %.3f ms/frame in capture(), "
+		       "%.1f MB\n", getenv("BENCHMARK_CAPTURE"), capture.frames, capture.written, capture.dropped,
+		       capture.stalls, 1000.0 * benchmark.captureTime / capture.frames, capture.bytes / 1e6);
+
+	if (getenv("BENCHMARK_CSV") != NULL){
+		FILE * file = fopen(getenv("BENCHMARK_CSV"), "w");
+		if (file == NULL){
+			fprintf(stderr, "Cannot write %s\n", getenv("BENCHMARK_CSV"));
+		}else{
+			fprintf(file, "frame,milliseconds\n");
+			for (size_t i = 0; i < benchmark.frameTimes.size(); i++)
+				fprintf(file, "%u,%.6f\n", (unsigned int)i, 1000.0 * benchmark.frameTimes[i]);
+			fclose(file);
+		}
+	}
+
+	if (getenv("BENCHMARK_JSON") != NULL){
+		FILE * file = fopen(getenv("BENCHMARK_JSON"), "w");
+		if (file == NULL){
+			fprintf(stderr, "Cannot write %s\n", getenv("BENCHMARK_JSON"));
+		}else{
+			fprintf(file, "{\n  \"title\": \"%s\",\n  \"renderer\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n",
+			        benchmark.title, renderer, benchmark.width, benchmark.height);
+			fprintf(file, "  \"warmup_frames\": %u,\n  \"frames\": %u,\n", benchmark.warmupFrames,
+			        (unsigned int)sorted.size());
+			fprintf(file, "  \"mean_ms\": %.6f,\n  \"min_ms\": %.6f,\n  \"p50_ms\": %.6f,\n  \"p95_ms\": %.6f,\n"
+			              "  \"p99_ms\": %.6f,\n  \"max_ms\": %.6f,\n",
+			        1000.0 * mean, 1000.0 * sorted.front(), 1000.0 * p50, 1000.0 * p95, 1000.0 * p99,
+			        1000.0 * sorted.back());
+			if (benchmark.goldenChecked)
+				fprintf(file, "  \"golden\": {\"path\": \"%s\", \"differing_pixels\": %u, \"pass\": %s},\n",
+				        getenv("BENCHMARK_GOLDEN"), benchmark.differingPixels, benchmark.goldenPassed ? "true" : "false");
+			if (capture.frames > 0)
+				fprintf(file, "  \"capture\": {\"path\": \"%s\", \"frames\": %u, \"written\": %u, \"dropped\": %u, "
+				              "\"stalls\": %u, \"capture_ms\": %.6f, \"bytes\": %llu},\n",
+				        getenv("BENCHMARK_CAPTURE"), capture.frames, capture.written, capture.dropped, capture.stalls,
+				        1000.0 * benchmark.captureTime / capture.frames, capture.bytes);
+			fprintf(file, "  \"frame_ms\": [");
+			for (size_t i = 0; i < benchmark.frameTimes.size(); i++)
+				fprintf(file, "%s%.6f", i == 0 ? "" : ", ", 1000.0 * benchmark.frameTimes[i]);
+			fprintf(file, "]\n}\n");
+			fclose(file);
+		}
+	}
+}
+
+void benchmarkTerminate(){
+	// Only a run that went to the end has results : the others already failed
+	bool finished = benchmark.context != EGL_NO_CONTEXT && !benchmark.frameTimes.empty()
+	             && benchmarkWindowShouldClose(NULL);
+	// The last frames of the capture, while there is still a context to read them back
+	benchmark.capture.destroy();
+	if (finished)
+		writeBenchmarkResults();
+
+	if (benchmark.display != EGL_NO_DISPLAY){
+		eglMakeCurrent(benchmark.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (benchmark.context != EGL_NO_CONTEXT)
+			eglDestroyContext(benchmark.display, benchmark.context);
+		if (benchmark.surface != EGL_NO_SURFACE)
+			eglDestroySurface(benchmark.display, benchmark.surface);
+		eglTerminate(benchmark.display);
+		benchmark.display = EGL_NO_DISPLAY;
+		benchmark.context = EGL_NO_CONTEXT;
+	}
+
+	if (finished && !benchmark.goldenPassed)
+		exit(1);
+}
+
+int benchmarkGetKey(GLFWwindow *, int){
+	return GLFW_RELEASE;
+}
+
+// glewInit() loads GLX after OpenGL, and asks its version to a display that an EGL context does not have : only the
+// errors of OpenGL matter
+GLenum benchmarkGlewInit(){
+	GLenum result = glewInit();
+	return result == GLEW_ERROR_GLX_VERSION_11_ONLY ? GLEW_OK : result;
+}
+
+
+#define glfwInit() benchmarkInit()
+#define glfwWindowHint(a,b) benchmarkWindowHint(a,b)
+#define glfwCreateWindow(a,b,c,d,e) benchmarkCreateWindow(a,b,c,d,e)
+#define glfwMakeContextCurrent(a) benchmarkMakeContextCurrent(a)
+#define glfwSwapInterval(a)
+#define glfwSetInputMode(a,b,c)
+#define glfwSetCursorPos(a,b,c)
+#define glfwPollEvents()
+#define glfwGetKey(a,b) benchmarkGetKey(a,b)
+#define glfwGetTime() benchmarkTime()
+#define glfwSwapBuffers(a) benchmarkSwapBuffers(a)
+#define glfwWindowShouldClose(a) benchmarkWindowShouldClose(a)
+#define glfwTerminate() benchmarkTerminate()
+#define computeMatricesFromInputs() benchmarkCamera()
+#define glewInit() benchmarkGlewInit()
+
+
+#endif
@@ -2,10 +2,13 @@
 #define DISTRIB_SCREENSHOT_INTERNAL_H
 
 
-void TakeScreenshot(){
-	char * buffer = new char[54 + 1024*768*3];
+// Writes the framebuffer as a 24 bits BMP. Rows are padded to 4 bytes, like glReadPixels does.
+void SaveScreenshot(const char * path, int width, int height){
+	int rowSize = (width*3 + 3) & ~3;
+	int imageSize = rowSize*height;
+	char * buffer = new char[54 + imageSize];
 
-	char header[54] = {
+	unsigned char header[54] = {
 		0x42,0x4D,0x36,0x00,0x24,0x00,0x00,0x00,
 		0x00,0x00,0x36,0x00,0x00,0x00,0x28,0x00,
 		0x00,0x00,0x00,0x04,0x00,0x00,0x00,0x03,
@@ -15,16 +18,24 @@ void TakeScreenshot(){
 		0x00,0x00,0x00,0x00,0x00,0x00
 	};
 	for(int i=0; i<54;i++) buffer[i] = header[i];
-	*(int*)&(buffer[0x22]) = 1024*768*3;
-	*(int*)&(buffer[0x12]) = 1024;
-	*(int*)&(buffer[0x16]) = 768;
+	*(int*)&(buffer[0x02]) = 54 + imageSize;
+	*(int*)&(buffer[0x22]) = imageSize;
+	*(int*)&(buffer[0x12]) = width;
+	*(int*)&(buffer[0x16]) = height;
 
-	glReadPixels(0,0,1024,768, GL_BGR, GL_UNSIGNED_BYTE, buffer+54);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0,0,width,height, GL_BGR, GL_UNSIGNED_BYTE, buffer+54);
 	
-	FILE * file = fopen("screenshot.bmp", "wb");
-	fwrite(buffer, 54+1024*768*3, 1, file);
-	fclose(file);
+	FILE * file = fopen(path, "wb");
+	if (file != NULL){
+		fwrite(buffer, 54+imageSize, 1, file);
+		fclose(file);
+	}
+	delete[] buffer;
+}
 
+void TakeScreenshot(){
+	SaveScreenshot("screenshot.bmp", 1024, 768);
 };
 
 double Zero(){
@@ -40,9 +51,12 @@ void callGlfwWindowHint(int target, int hint){
 }
 
 
+// distrib/benchmark.h only wants the functions
+#ifndef DISTRIB_SCREENSHOT_NO_MACROS
 #define glfwSwapBuffers(a) TakeScreenshot(); break;
 #define glfwGetTime() Zero()
 #define glfwWindowHint(a,b) callGlfwWindowHint(a,b)
+#endif
 
 
 #endif
@@ -52,11 +52,36 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using namespace Assimp;
 
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// Runs ProcessMesh() on the meshes of a scene, and keeps what it returns
+class CalcMeshTangentsTask : public ParallelMeshTask
+{
+public:
+	CalcMeshTangentsTask( CalcTangentsProcess* pProcess, aiScene* pScene, std::vector<unsigned char>& pHas)
+		: mProcess(pProcess), mScene(pScene), mHas(pHas)
+	{}
+
+	void Run( unsigned int pMeshIndex, unsigned int pNumThreads) {
+		mHas[pMeshIndex] = mProcess->ProcessMesh(mScene->mMeshes[pMeshIndex],pMeshIndex,pNumThreads);
+	}
+
+private:
+	CalcTangentsProcess* mProcess;
+	aiScene* mScene;
+	std::vector<unsigned char>& mHas;
+};
+
+} // namespace
+
 // ------------------------------------------------------------------------------------------------
 // Constructor to be privately used by Importer
 CalcTangentsProcess::CalcTangentsProcess()
 {
 	this->configMaxAngle = AI_DEG_TO_RAD(45.f);
+	this->configSourceUV = 0;
+	this->configNumThreads = 0;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -83,6 +108,8 @@ void CalcTangentsProcess::SetupProperties(const Importer* pImp)
 	configMaxAngle = AI_DEG_TO_RAD(configMaxAngle);
 
 	configSourceUV = pImp->GetPropertyInteger(AI_CONFIG_PP_CT_TEXTURE_CHANNEL_INDEX,0);
+
+	configNumThreads = pImp->GetPropertyInteger(AI_CONFIG_PP_NUM_THREADS,0);
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -91,9 +118,28 @@ void CalcTangentsProcess::Execute( aiScene* pScene)
 {
 	DefaultLogger::get()->debug("CalcTangentsProcess begin");
 
+	// ProcessMesh() doesn't log, so tell which meshes it leaves out first
+	for( unsigned int a = 0; a < pScene->mNumMeshes; a++)
+	{
+		const aiMesh* pMesh = pScene->mMeshes[a];
+		if (pMesh->mTangents)
+			continue;
+		if (!(pMesh->mPrimitiveTypes & (aiPrimitiveType_TRIANGLE | aiPrimitiveType_POLYGON)))
+			DefaultLogger::get()->info("Tangents are undefined for line and point meshes");
+		else if( pMesh->mNormals == NULL)
+			DefaultLogger::get()->error("Failed to compute tangents; need normals");
+		else if( configSourceUV >= AI_MAX_NUMBER_OF_TEXTURECOORDS || !pMesh->mTextureCoords[configSourceUV] )
+			DefaultLogger::get()->error((Formatter::format("Failed to compute tangents; need UV data in channel"),configSourceUV));
+	}
+
+	// execute the step, on several meshes at once
+	std::vector<unsigned char> abHas(pScene->mNumMeshes,0);
+	CalcMeshTangentsTask task(this,pScene,abHas);
+	ParallelForMeshes(GetNumThreads(configNumThreads),pScene,task);
+
 	bool bHas = false;
 	for( unsigned int a = 0; a < pScene->mNumMeshes; a++)
-		if(ProcessMesh( pScene->mMeshes[a],a))bHas = true;
+		if(abHas[a])bHas = true;
 
 	if (bHas)DefaultLogger::get()->info("CalcTangentsProcess finished. Tangents have been calculated");
 	else DefaultLogger::get()->debug("CalcTangentsProcess finished");
@@ -101,7 +147,7 @@ void CalcTangentsProcess::Execute( aiScene* pScene)
 
 // ------------------------------------------------------------------------------------------------
 // Calculates tangents and bitangents for the given mesh
-bool CalcTangentsProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
+bool CalcTangentsProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex, unsigned int pNumThreads)
 {
 	// we assume that the mesh is still in the verbose vertex format where each face has its own set
 	// of vertices and no vertices are shared between faces. Sadly I don't know any quick test to 
@@ -113,22 +159,19 @@ bool CalcTangentsProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 
 	// If the mesh consists of lines and/or points but not of
 	// triangles or higher-order polygons the normal vectors
-	// are undefined.
+	// are undefined. Execute() tells it, as well as the missing data below.
 	if (!(pMesh->mPrimitiveTypes & (aiPrimitiveType_TRIANGLE | aiPrimitiveType_POLYGON)))
 	{
-		DefaultLogger::get()->info("Tangents are undefined for line and point meshes");
 		return false;
 	}
 
 	// what we can check, though, is if the mesh has normals and texture coordinates. That's a requirement
 	if( pMesh->mNormals == NULL)
 	{
-		DefaultLogger::get()->error("Failed to compute tangents; need normals");
 		return false;
 	}
 	if( configSourceUV >= AI_MAX_NUMBER_OF_TEXTURECOORDS || !pMesh->mTextureCoords[configSourceUV] )
 	{
-		DefaultLogger::get()->error((Formatter::format("Failed to compute tangents; need UV data in channel"),configSourceUV));
 		return false;
 	}
 	 
@@ -225,7 +268,7 @@ bool CalcTangentsProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 	}
 	if (!vertexFinder)
 	{
-		_vertexFinder.Fill(pMesh->mVertices, pMesh->mNumVertices, sizeof( aiVector3D));
+		_vertexFinder.Fill(pMesh->mVertices, pMesh->mNumVertices, sizeof( aiVector3D), true, pNumThreads);
 		vertexFinder = &_vertexFinder;
 		posEpsilon = ComputePositionEpsilon(pMesh);
 	}
@@ -235,7 +278,7 @@ bool CalcTangentsProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 	std::vector<unsigned int> closeVertices;
 
 	// in the second pass we now smooth out all tangents and bitangents at the same local position 
-	// if they are not too far off.
+	// if they are not too far off. Each vertex depends on those before it, so this stays on a single thread.
 	for( unsigned int a = 0; a < pMesh->mNumVertices; a++)
 	{
 		if( vertexDone[a])
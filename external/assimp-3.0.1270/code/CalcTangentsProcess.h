@@ -88,14 +88,18 @@ public:
 		configMaxAngle =f;
 	}
 
-protected:
-
 	// -------------------------------------------------------------------
-	/** Calculates tangents and bitangents for a specific mesh.
+	/** Calculates tangents and bitangents for a specific mesh. Doesn't
+	* log, so that meshes can be processed on several threads at once.
 	* @param pMesh The mesh to process.
 	* @param meshIndex Index of the mesh
+	* @param pNumThreads Number of threads to sort the positions of a
+	*   large mesh with. The result is the same for any.
 	*/
-	bool ProcessMesh( aiMesh* pMesh, unsigned int meshIndex);
+	bool ProcessMesh( aiMesh* pMesh, unsigned int meshIndex,
+		unsigned int pNumThreads = 1);
+
+protected:
 
 	// -------------------------------------------------------------------
 	/** Executes the post processing step on the given imported data.
@@ -108,6 +112,9 @@ private:
 	/** Configuration option: maximum smoothing angle, in radians*/
 	float configMaxAngle;
 	unsigned int configSourceUV;
+
+	/** Configuration option: number of threads, 0 for one per hardware thread */
+	int configNumThreads;
 };
 
 } // end of namespace Assimp
@@ -45,6 +45,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include "DefaultIOSystem.h"
 #include "DefaultIOStream.h"
+#include "MappedIOStream.h"
 
 #ifdef __unix__
 #include <sys/param.h>
@@ -86,6 +87,13 @@ IOStream* DefaultIOSystem::Open( const char* strFile, const char* strMode)
 	ai_assert(NULL != strFile);
 	ai_assert(NULL != strMode);
 
+	// Files only read are mapped, if they can be
+	if (NULL == ::strpbrk( strMode, "wa+")) {
+		IOStream* mapped = MappedIOStream::Open( strFile);
+		if (NULL != mapped)
+			return mapped;
+	}
+
 	FILE* file = ::fopen( strFile, strMode);
 	if( NULL == file) 
 		return NULL;
@@ -51,11 +51,79 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using namespace Assimp;
 
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// Runs GenMeshVertexNormals() on the meshes of a scene, and keeps what it returns
+class GenMeshNormalsTask : public ParallelMeshTask
+{
+public:
+	GenMeshNormalsTask( GenVertexNormalsProcess* pProcess, aiScene* pScene, std::vector<unsigned char>& pHas)
+		: mProcess(pProcess), mScene(pScene), mHas(pHas)
+	{}
+
+	void Run( unsigned int pMeshIndex, unsigned int pNumThreads) {
+		mHas[pMeshIndex] = mProcess->GenMeshVertexNormals(mScene->mMeshes[pMeshIndex],pMeshIndex,pNumThreads);
+	}
+
+private:
+	GenVertexNormalsProcess* mProcess;
+	aiScene* mScene;
+	std::vector<unsigned char>& mHas; // not std::vector<bool>, its elements share bytes
+};
+
+// ------------------------------------------------------------------------------------------------
+// Smooths the normals of a range of vertices, with a maximum angle : each vertex gets the sum of
+// the face normals at its position which are close enough to its own. Each range is one task.
+class SmoothNormalsTask : public ParallelTask
+{
+public:
+	SmoothNormalsTask( const aiMesh* pMesh, const SpatialSort& pFinder, float pPosEpsilon, float pLimit,
+		unsigned int pRangeSize, aiVector3D* pOut)
+		: mMesh(pMesh), mFinder(pFinder), mPosEpsilon(pPosEpsilon), mLimit(pLimit), mRangeSize(pRangeSize), mOut(pOut)
+	{}
+
+	void Run( unsigned int pIndex) {
+		const unsigned int first = pIndex * mRangeSize;
+		const unsigned int end = std::min(first + mRangeSize, mMesh->mNumVertices);
+		std::vector<unsigned int> verticesFound;
+		for (unsigned int i = first; i < end;++i)	{
+			// Get all vertices that share this one ...
+			mFinder.FindPositions( mMesh->mVertices[i] , mPosEpsilon, verticesFound);
+
+			aiVector3D pcNor; 
+			for (unsigned int a = 0; a < verticesFound.size(); ++a)	{
+				const aiVector3D& v = mMesh->mNormals[verticesFound[a]];
+
+				// check whether the angle between the two normals is not too large
+				// HACK: if v.x is qnan the dot product will become qnan, too
+				//   therefore the comparison against fLimit should be false
+				//   in every case. 
+				if (v * mMesh->mNormals[i] < mLimit)
+					continue;
+
+				pcNor += v;
+			}
+			mOut[i] = pcNor.Normalize();
+		}
+	}
+
+private:
+	const aiMesh* mMesh;
+	const SpatialSort& mFinder;
+	float mPosEpsilon, mLimit;
+	unsigned int mRangeSize;
+	aiVector3D* mOut;
+};
+
+} // namespace
+
 // ------------------------------------------------------------------------------------------------
 // Constructor to be privately used by Importer
 GenVertexNormalsProcess::GenVertexNormalsProcess()
 {
 	this->configMaxAngle = AI_DEG_TO_RAD(175.f);
+	this->configNumThreads = 0;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -79,6 +147,8 @@ void GenVertexNormalsProcess::SetupProperties(const Importer* pImp)
 	// Get the current value of the AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE property
 	configMaxAngle = pImp->GetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE,175.f);
 	configMaxAngle = AI_DEG_TO_RAD(std::max(std::min(configMaxAngle,175.0f),0.0f));
+
+	configNumThreads = pImp->GetPropertyInteger(AI_CONFIG_PP_NUM_THREADS,0);
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -90,10 +160,23 @@ void GenVertexNormalsProcess::Execute( aiScene* pScene)
 	if (pScene->mFlags & AI_SCENE_FLAGS_NON_VERBOSE_FORMAT)
 		throw DeadlyImportError("Post-processing order mismatch: expecting pseudo-indexed (\"verbose\") vertices here");
 
+	// GenMeshVertexNormals() doesn't log, so tell which meshes it leaves out first
+	for( unsigned int a = 0; a < pScene->mNumMeshes; a++)
+	{
+		const aiMesh* pMesh = pScene->mMeshes[a];
+		if (NULL == pMesh->mNormals && !(pMesh->mPrimitiveTypes & (aiPrimitiveType_TRIANGLE | aiPrimitiveType_POLYGON)))
+			DefaultLogger::get()->info("Normal vectors are undefined for line and point meshes");
+	}
+
+	// execute the step, on several meshes at once
+	std::vector<unsigned char> abHas(pScene->mNumMeshes,0);
+	GenMeshNormalsTask task(this,pScene,abHas);
+	ParallelForMeshes(GetNumThreads(configNumThreads),pScene,task);
+
 	bool bHas = false;
 	for( unsigned int a = 0; a < pScene->mNumMeshes; a++)
 	{
-		if(GenMeshVertexNormals( pScene->mMeshes[a],a))
+		if(abHas[a])
 			bHas = true;
 	}
 
@@ -107,17 +190,16 @@ void GenVertexNormalsProcess::Execute( aiScene* pScene)
 
 // ------------------------------------------------------------------------------------------------
 // Executes the post processing step on the given imported data.
-bool GenVertexNormalsProcess::GenMeshVertexNormals (aiMesh* pMesh, unsigned int meshIndex)
+bool GenVertexNormalsProcess::GenMeshVertexNormals (aiMesh* pMesh, unsigned int meshIndex, unsigned int pNumThreads)
 {
 	if (NULL != pMesh->mNormals)
 		return false;
 
 	// If the mesh consists of lines and/or points but not of
 	// triangles or higher-order polygons the normal vectors
-	// are undefined.
+	// are undefined. Execute() tells it.
 	if (!(pMesh->mPrimitiveTypes & (aiPrimitiveType_TRIANGLE | aiPrimitiveType_POLYGON)))
 	{
-		DefaultLogger::get()->info("Normal vectors are undefined for line and point meshes");
 		return false;
 	}
 
@@ -165,7 +247,7 @@ bool GenVertexNormalsProcess::GenMeshVertexNormals (aiMesh* pMesh, unsigned int
 		}
 	}
 	if (!vertexFinder)	{
-		_vertexFinder.Fill(pMesh->mVertices, pMesh->mNumVertices, sizeof( aiVector3D));
+		_vertexFinder.Fill(pMesh->mVertices, pMesh->mNumVertices, sizeof( aiVector3D), true, pNumThreads);
 		vertexFinder = &_vertexFinder;
 		posEpsilon = ComputePositionEpsilon(pMesh);
 	}
@@ -175,7 +257,8 @@ bool GenVertexNormalsProcess::GenMeshVertexNormals (aiMesh* pMesh, unsigned int
 	if (configMaxAngle >= AI_DEG_TO_RAD( 175.f ))	{
 		// There is no angle limit. Thus all vertices with positions close
 		// to each other will receive the same vertex normal. This allows us
-		// to optimize the whole algorithm a little bit ...
+		// to optimize the whole algorithm a little bit ... Each vertex depends
+		// on those before it though, so this stays on a single thread.
 		std::vector<bool> abHad(pMesh->mNumVertices,false);
 		for (unsigned int i = 0; i < pMesh->mNumVertices;++i)	{
 			if (abHad[i]) {
@@ -202,28 +285,13 @@ bool GenVertexNormalsProcess::GenMeshVertexNormals (aiMesh* pMesh, unsigned int
 		}
 	}
 	// Slower code path if a smooth angle is set. There are many ways to achieve
-	// the effect, this one is the most straightforward one.
+	// the effect, this one is the most straightforward one. Every vertex is on
+	// its own, so large meshes are processed in parallel ranges.
 	else	{
 		const float fLimit = ::cos(configMaxAngle); 
-		for (unsigned int i = 0; i < pMesh->mNumVertices;++i)	{
-			// Get all vertices that share this one ...
-			vertexFinder->FindPositions( pMesh->mVertices[i] , posEpsilon, verticesFound);
-
-			aiVector3D pcNor; 
-			for (unsigned int a = 0; a < verticesFound.size(); ++a)	{
-				const aiVector3D& v = pMesh->mNormals[verticesFound[a]];
-
-				// check whether the angle between the two normals is not too large
-				// HACK: if v.x is qnan the dot product will become qnan, too
-				//   therefore the comparison against fLimit should be false
-				//   in every case. 
-				if (v * pMesh->mNormals[i] < fLimit)
-					continue;
-
-				pcNor += v;
-			}
-			pcNew[i] = pcNor.Normalize();
-		}
+		const unsigned int rangeSize = 4096;
+		SmoothNormalsTask task(pMesh,*vertexFinder,posEpsilon,fLimit,rangeSize,pcNew);
+		ParallelFor(pNumThreads,(pMesh->mNumVertices + rangeSize - 1) / rangeSize,task);
 	}
 
 	delete[] pMesh->mNormals;
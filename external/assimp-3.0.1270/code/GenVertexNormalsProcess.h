@@ -94,17 +94,24 @@ public:
 public:
 
 	// -------------------------------------------------------------------
-	/** Computes normals for a specific mesh
+	/** Computes normals for a specific mesh. Doesn't log, so that meshes
+	*  can be processed on several threads at once.
 	*  @param pcMesh Mesh
 	*  @param meshIndex Index of the mesh
+	*  @param pNumThreads Number of threads to smooth the normals of a large
+	*    mesh with. The result is the same for any.
 	*  @return true if vertex normals have been computed
 	*/
-	bool GenMeshVertexNormals (aiMesh* pcMesh, unsigned int meshIndex);
+	bool GenMeshVertexNormals (aiMesh* pcMesh, unsigned int meshIndex,
+		unsigned int pNumThreads = 1);
 
 private:
 
 	/** Configuration option: maximum smoothing angle, in radians*/
 	float configMaxAngle;
+
+	/** Configuration option: number of threads, 0 for one per hardware thread */
+	int configNumThreads;
 };
 
 } // end of namespace Assimp
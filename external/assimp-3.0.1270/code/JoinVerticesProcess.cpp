@@ -52,9 +52,72 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "TinyFormatter.h"
 
 using namespace Assimp;
+
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// Runs ProcessMesh() on the meshes of a scene, and keeps what it returns
+class JoinMeshTask : public ParallelMeshTask
+{
+public:
+	JoinMeshTask( JoinVerticesProcess* pProcess, aiScene* pScene, std::vector<int>& pNumVertices)
+		: mProcess(pProcess), mScene(pScene), mNumVertices(pNumVertices)
+	{}
+
+	void Run( unsigned int pMeshIndex, unsigned int pNumThreads) {
+		mNumVertices[pMeshIndex] = mProcess->ProcessMesh(mScene->mMeshes[pMeshIndex],pMeshIndex,pNumThreads);
+	}
+
+private:
+	JoinVerticesProcess* mProcess;
+	aiScene* mScene;
+	std::vector<int>& mNumVertices;
+};
+
+// ------------------------------------------------------------------------------------------------
+// Finds, for each vertex of a range of a mesh, the vertices at an identical position with a lower
+// index, in the order of the spatial sort : the only ones ProcessMesh() may replace it with. Each
+// range is one task ; pOffsets[a+1] receives the count of vertex a.
+class FindEarlierVerticesTask : public ParallelTask
+{
+public:
+	FindEarlierVerticesTask( const aiMesh* pMesh, const SpatialSort& pFinder, unsigned int pRangeSize,
+		std::vector<unsigned int>& pOffsets, std::vector< std::vector<unsigned int> >& pFound)
+		: mMesh(pMesh), mFinder(pFinder), mRangeSize(pRangeSize), mOffsets(pOffsets), mFound(pFound)
+	{}
+
+	void Run( unsigned int pIndex) {
+		const unsigned int first = pIndex * mRangeSize;
+		const unsigned int end = std::min(first + mRangeSize, mMesh->mNumVertices);
+		std::vector<unsigned int>& found = mFound[pIndex];
+		std::vector<unsigned int> verticesFound;
+		for (unsigned int a = first; a < end; ++a) {
+			mFinder.FindIdenticalPositions(mMesh->mVertices[a],verticesFound);
+			unsigned int count = 0;
+			for (unsigned int b = 0; b < verticesFound.size(); ++b) {
+				if (verticesFound[b] < a) {
+					found.push_back(verticesFound[b]);
+					++count;
+				}
+			}
+			mOffsets[a+1] = count;
+		}
+	}
+
+private:
+	const aiMesh* mMesh;
+	const SpatialSort& mFinder;
+	unsigned int mRangeSize;
+	std::vector<unsigned int>& mOffsets;
+	std::vector< std::vector<unsigned int> >& mFound;
+};
+
+} // namespace
+
 // ------------------------------------------------------------------------------------------------
 // Constructor to be privately used by Importer
 JoinVerticesProcess::JoinVerticesProcess()
+: configNumThreads(0)
 {
 	// nothing to do here
 }
@@ -72,24 +135,58 @@ bool JoinVerticesProcess::IsActive( unsigned int pFlags) const
 {
 	return (pFlags & aiProcess_JoinIdenticalVertices) != 0;
 }
+
+// ------------------------------------------------------------------------------------------------
+// Setup import configuration
+void JoinVerticesProcess::SetupProperties(const Importer* pImp)
+{
+	configNumThreads = pImp->GetPropertyInteger(AI_CONFIG_PP_NUM_THREADS,0);
+}
 // ------------------------------------------------------------------------------------------------
 // Executes the post processing step on the given imported data.
 void JoinVerticesProcess::Execute( aiScene* pScene)
 {
 	DefaultLogger::get()->debug("JoinVerticesProcess begin");
 
-	// get the total number of vertices BEFORE the step is executed
+	// get the number of vertices and bones of each mesh BEFORE the step is executed
 	int iNumOldVertices = 0;
-	if (!DefaultLogger::isNullLogger()) {
-		for( unsigned int a = 0; a < pScene->mNumMeshes; a++)	{
-			iNumOldVertices +=	pScene->mMeshes[a]->mNumVertices;
-		}
+	std::vector<unsigned int> numOldVertices(pScene->mNumMeshes), numOldBones(pScene->mNumMeshes);
+	for( unsigned int a = 0; a < pScene->mNumMeshes; a++)	{
+		numOldVertices[a] = pScene->mMeshes[a]->mNumVertices;
+		numOldBones[a] = pScene->mMeshes[a]->mNumBones;
+		iNumOldVertices +=	numOldVertices[a];
 	}
 
-	// execute the step
+	// execute the step, on several meshes at once
+	std::vector<int> numVertices(pScene->mNumMeshes);
+	JoinMeshTask task(this,pScene,numVertices);
+	ParallelForMeshes(GetNumThreads(configNumThreads),pScene,task);
+
+	// ProcessMesh() doesn't log, so tell what it did now, in the order of the meshes
+	const bool verbose = !DefaultLogger::isNullLogger() && DefaultLogger::get()->getLogSeverity() == Logger::VERBOSE;
 	int iNumVertices = 0;
-	for( unsigned int a = 0; a < pScene->mNumMeshes; a++)
-		iNumVertices +=	ProcessMesh( pScene->mMeshes[a],a);
+	for( unsigned int a = 0; a < pScene->mNumMeshes; a++)	{
+		const aiMesh* pMesh = pScene->mMeshes[a];
+		iNumVertices +=	numVertices[a];
+
+		for (unsigned int b = pMesh->mNumBones; b < numOldBones[a]; ++b) {
+			DefaultLogger::get()->warn("Removing bone -> no weights remaining");
+		}
+
+		if (verbose && pMesh->HasPositions() && pMesh->HasFaces())	{
+			DefaultLogger::get()->debug((Formatter::format(),
+				"Mesh ",a,
+				" (",
+				(pMesh->mName.length ? pMesh->mName.data : "unnamed"),
+				") | Verts in: ",numOldVertices[a],
+				" out: ",
+				pMesh->mNumVertices,
+				" | ~",
+				((numOldVertices[a] - pMesh->mNumVertices) / (float)numOldVertices[a]) * 100.f,
+				"%"
+			));
+		}
+	}
 
 	// if logging is active, print detailed statistics
 	if (!DefaultLogger::isNullLogger())
@@ -113,7 +210,7 @@ void JoinVerticesProcess::Execute( aiScene* pScene)
 
 // ------------------------------------------------------------------------------------------------
 // Unites identical vertices in the given mesh
-int JoinVerticesProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
+int JoinVerticesProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex, unsigned int pNumThreads)
 {
 	BOOST_STATIC_ASSERT( AI_MAX_NUMBER_OF_COLOR_SETS    == 8);
 	BOOST_STATIC_ASSERT( AI_MAX_NUMBER_OF_TEXTURECOORDS == 8);
@@ -166,6 +263,27 @@ int JoinVerticesProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 	std::vector<unsigned int> verticesFound;
 	verticesFound.reserve(10);
 
+	// With several threads, look for the identical positions of all vertices first, in parallel
+	// ranges. Vertices with a higher index are skipped below anyway, as they aren't unique yet, so
+	// only those with a lower one are kept.
+	std::vector<unsigned int> earlierOffsets, earlierFound;
+	if (pNumThreads > 1)	{
+		const unsigned int rangeSize = 4096;
+		const unsigned int numRanges = (pMesh->mNumVertices + rangeSize - 1) / rangeSize;
+		std::vector< std::vector<unsigned int> > rangeFound(numRanges);
+		earlierOffsets.resize(pMesh->mNumVertices + 1, 0);
+		FindEarlierVerticesTask task(pMesh,*vertexFinder,rangeSize,earlierOffsets,rangeFound);
+		ParallelFor(pNumThreads,numRanges,task);
+
+		for( unsigned int a = 0; a < pMesh->mNumVertices; a++)	{
+			earlierOffsets[a+1] += earlierOffsets[a];
+		}
+		earlierFound.reserve(earlierOffsets.back());
+		for( unsigned int a = 0; a < numRanges; a++)	{
+			earlierFound.insert(earlierFound.end(),rangeFound[a].begin(),rangeFound[a].end());
+		}
+	}
+
 	// Run an optimized code path if we don't have multiple UVs or vertex colors.
 	// This should yield false in more than 99% of all imports ...
 	const bool complex = ( pMesh->GetNumColorChannels() > 0 || pMesh->GetNumUVChannels() > 1);
@@ -176,7 +294,12 @@ int JoinVerticesProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 		Vertex v(pMesh,a);
 
 		// collect all vertices that are close enough to the given position
-		vertexFinder->FindIdenticalPositions( v.position, verticesFound);
+		if (earlierOffsets.empty())	{
+			vertexFinder->FindIdenticalPositions( v.position, verticesFound);
+		}
+		else	{
+			verticesFound.assign(earlierFound.begin() + earlierOffsets[a],earlierFound.begin() + earlierOffsets[a+1]);
+		}
 		unsigned int matchIndex = 0xffffffff;
 
 		// check all unique vertices close to the position if this vertex is already present among them
@@ -270,20 +393,6 @@ int JoinVerticesProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 		}
 	}
 
-	if (!DefaultLogger::isNullLogger() && DefaultLogger::get()->getLogSeverity() == Logger::VERBOSE)	{
-		DefaultLogger::get()->debug((Formatter::format(),
-			"Mesh ",meshIndex,
-			" (",
-			(pMesh->mName.length ? pMesh->mName.data : "unnamed"),
-			") | Verts in: ",pMesh->mNumVertices,
-			" out: ",
-			uniqueVertices.size(),
-			" | ~",
-			((pMesh->mNumVertices - uniqueVertices.size()) / (float)pMesh->mNumVertices) * 100.f,
-			"%"
-		));
-	}
-
 	// replace vertex data with the unique data sets
 	pMesh->mNumVertices = (unsigned int)uniqueVertices.size();
 
@@ -405,7 +514,7 @@ int JoinVerticesProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 			}
 
 			--a; 
-			DefaultLogger::get()->warn("Removing bone -> no weights remaining");
+			// Execute() warns about it, as this may run on another thread
 		}
 	}
 	return pMesh->mNumVertices;
@@ -75,6 +75,13 @@ public:
 	*/
 	bool IsActive( unsigned int pFlags) const;
 
+	// -------------------------------------------------------------------
+	/** Called prior to ExecuteOnScene().
+	* The function is a request to the process to update its configuration
+	* basing on the Importer's configuration property list.
+	*/
+	void SetupProperties(const Importer* pImp);
+
 	// -------------------------------------------------------------------
 	/** Executes the post processing step on the given imported data.
 	* At the moment a process is not supposed to fail.
@@ -84,13 +91,20 @@ public:
 
 public:
 	// -------------------------------------------------------------------
-	/** Unites identical vertices in the given mesh.
+	/** Unites identical vertices in the given mesh. Doesn't log, so
+	 * that meshes can be processed on several threads at once.
 	 * @param pMesh The mesh to process.
 	 * @param meshIndex Index of the mesh to process
+	 * @param pNumThreads Number of threads to look for the identical
+	 *   vertices of a large mesh with. The result is the same for any.
 	 */
-	int ProcessMesh( aiMesh* pMesh, unsigned int meshIndex);
+	int ProcessMesh( aiMesh* pMesh, unsigned int meshIndex,
+		unsigned int pNumThreads = 1);
 
 private:
+
+	/** Configuration option: number of threads, 0 for one per hardware thread */
+	int configNumThreads;
 };
 
 } // end of namespace Assimp
@@ -0,0 +1,181 @@
+/*
+---------------------------------------------------------------------------
+Open Asset Import Library (assimp)
+---------------------------------------------------------------------------
+
+Copyright (c) 2006-2012, assimp team
+
+All rights reserved.
+
+Redistribution and use of this software in source and binary forms, 
+with or without modification, are permitted provided that the following 
+conditions are met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the above
+  copyright notice, this list of conditions and the
+  following disclaimer in the documentation and/or other
+  materials provided with the distribution.
+
+* Neither the name of the assimp team, nor the names of its
+  contributors may be used to endorse or promote products
+  derived from this software without specific prior
+  written permission of the assimp team.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+----------------------------------------------------------------------
+*/
+
+/** @file MappedIOStream.cpp
+ *  @brief Read-only file I/O through a memory mapping
+ */
+
+#include "AssimpPCH.h"
+
+#include "MappedIOStream.h"
+
+#ifdef _WIN32
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+using namespace Assimp;
+
+// ----------------------------------------------------------------------------------
+MappedIOStream* MappedIOStream::Open(const char* strFile)
+{
+	ai_assert(NULL != strFile);
+#ifdef _WIN32
+	HANDLE file = ::CreateFileA(strFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (INVALID_HANDLE_VALUE == file) {
+		return NULL;
+	}
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (::GetFileSizeEx(file, &size) && size.QuadPart > 0 && (unsigned long long)size.QuadPart <= (size_t)-1) {
+		mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	::CloseHandle(file); // the mapping keeps it open
+	if (NULL == mapping) {
+		return NULL;
+	}
+	const char* data = (const char*)::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (NULL == data) {
+		::CloseHandle(mapping);
+		return NULL;
+	}
+	return new MappedIOStream(data, (size_t)size.QuadPart, mapping);
+#else
+	int file = ::open(strFile, O_RDONLY);
+	if (file < 0) {
+		return NULL;
+	}
+	struct stat status;
+	void* data = MAP_FAILED;
+	if (0 == ::fstat(file, &status) && S_ISREG(status.st_mode) && status.st_size > 0) {
+		data = ::mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	}
+	::close(file); // the mapping keeps it open
+	if (MAP_FAILED == data) {
+		return NULL;
+	}
+#	ifdef MADV_SEQUENTIAL
+	::madvise(data, status.st_size, MADV_SEQUENTIAL);
+#	endif
+	return new MappedIOStream((const char*)data, status.st_size, NULL);
+#endif
+}
+
+// ----------------------------------------------------------------------------------
+MappedIOStream::MappedIOStream(const char* pData, size_t pSize, void* pHandle)
+	: mData(pData)
+	, mSize(pSize)
+	, mPos(0)
+	, mHandle(pHandle)
+{
+	// empty
+}
+
+// ----------------------------------------------------------------------------------
+MappedIOStream::~MappedIOStream()
+{
+#ifdef _WIN32
+	::UnmapViewOfFile(mData);
+	::CloseHandle((HANDLE)mHandle);
+#else
+	::munmap((void*)mData, mSize);
+#endif
+}
+
+// ----------------------------------------------------------------------------------
+size_t MappedIOStream::Read(void* pvBuffer, 
+	size_t pSize, 
+	size_t pCount)
+{
+	ai_assert(NULL != pvBuffer && 0 != pSize && 0 != pCount);
+	const size_t count = std::min(pCount, (mSize - mPos) / pSize), bytes = pSize * count;
+	::memcpy(pvBuffer, mData + mPos, bytes);
+	mPos += bytes;
+	return count;
+}
+
+// ----------------------------------------------------------------------------------
+size_t MappedIOStream::Write(const void* /*pvBuffer*/, 
+	size_t /*pSize*/,
+	size_t /*pCount*/)
+{
+	return 0;
+}
+
+// ----------------------------------------------------------------------------------
+aiReturn MappedIOStream::Seek(size_t pOffset,
+	 aiOrigin pOrigin)
+{
+	// Like fseek, the end of the file is a valid position
+	size_t base = (aiOrigin_SET == pOrigin ? 0 : (aiOrigin_CUR == pOrigin ? mPos : mSize));
+	if (aiOrigin_END == pOrigin ? pOffset > mSize : pOffset > mSize - base) {
+		return AI_FAILURE;
+	}
+	mPos = (aiOrigin_END == pOrigin ? mSize - pOffset : base + pOffset);
+	return AI_SUCCESS;
+}
+
+// ----------------------------------------------------------------------------------
+size_t MappedIOStream::Tell() const
+{
+	return mPos;
+}
+
+// ----------------------------------------------------------------------------------
+size_t MappedIOStream::FileSize() const
+{
+	return mSize;
+}
+
+// ----------------------------------------------------------------------------------
+void MappedIOStream::Flush()
+{
+	// empty
+}
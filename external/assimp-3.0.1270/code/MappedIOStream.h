@@ -0,0 +1,119 @@
+/*
+Open Asset Import Library (assimp)
+----------------------------------------------------------------------
+
+Copyright (c) 2006-2012, assimp team
+All rights reserved.
+
+Redistribution and use of this software in source and binary forms, 
+with or without modification, are permitted provided that the 
+following conditions are met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the above
+  copyright notice, this list of conditions and the
+  following disclaimer in the documentation and/or other
+  materials provided with the distribution.
+
+* Neither the name of the assimp team, nor the names of its
+  contributors may be used to endorse or promote products
+  derived from this software without specific prior
+  written permission of the assimp team.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+----------------------------------------------------------------------
+*/
+
+/** @file MappedIOStream.h
+ *  @brief Read-only file I/O through a memory mapping of the whole file
+ */
+#ifndef AI_MAPPEDIOSTREAM_H_INC
+#define AI_MAPPEDIOSTREAM_H_INC
+
+#include "../include/assimp/IOStream.hpp"
+
+namespace Assimp	{
+
+// ----------------------------------------------------------------------------------
+//!	@class	MappedIOStream
+//!	@brief	Reads a file mapped in memory (mmap, or MapViewOfFile on Windows).
+//!
+//! DefaultIOSystem opens files to read this way, so that Read() is a memcpy from
+//! the page cache instead of a fread through the buffers of the C library. Text
+//! importers that know about it can parse Data() where it is, without copying
+//! the file at all : see ObjFileImporter. The mapping is not terminated by a 0.
+class MappedIOStream : public IOStream
+{
+public:
+	/** Returns NULL if the file can't be mapped, empty files included :
+	 *  DefaultIOSystem then falls back to DefaultIOStream. */
+	static MappedIOStream* Open(const char* strFile);
+
+	/** Destructor public to allow simple deletion to unmap the file. */
+	~MappedIOStream ();
+
+	// -------------------------------------------------------------------
+	// Read from stream
+	size_t Read(void* pvBuffer, 
+		size_t pSize, 
+		size_t pCount);
+
+	// -------------------------------------------------------------------
+	// Write to stream : fails, the mapping is read-only
+	size_t Write(const void* pvBuffer, 
+		size_t pSize,
+		size_t pCount);
+
+	// -------------------------------------------------------------------
+	// Seek specific position
+	aiReturn Seek(size_t pOffset,
+		aiOrigin pOrigin);
+
+	// -------------------------------------------------------------------
+	// Get current seek position
+	size_t Tell() const;
+
+	// -------------------------------------------------------------------
+	// Get size of file
+	size_t FileSize() const;
+
+	// -------------------------------------------------------------------
+	// Flush file contents : nothing to do
+	void Flush();
+
+	// -------------------------------------------------------------------
+	// The whole file, FileSize() bytes
+	const char* Data() const {
+		return mData;
+	}
+
+private:
+	MappedIOStream (const char* pData, size_t pSize, void* pHandle);
+
+	//!	The mapping of the file
+	const char* mData;
+	//!	Size of the file
+	size_t mSize;
+	//!	Current position in the file
+	size_t mPos;
+	//!	Windows only : the file mapping object
+	void* mHandle;
+};
+
+} // ns assimp
+
+#endif //!!AI_MAPPEDIOSTREAM_H_INC
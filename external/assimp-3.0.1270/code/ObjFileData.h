@@ -59,49 +59,38 @@ struct Material;
 // ------------------------------------------------------------------------------------------------
 //!	\struct	Face
 //!	\brief	Data structure for a simple obj-face, describes discredit,l.ation and materials
+//!
+//!	The indices of its corners are a range of the index arrays of the model, so
+//!	that a face costs no allocation of its own.
 struct Face
 {
-	typedef std::vector<unsigned int> IndexArray;
-
 	//!	Primitive type
 	aiPrimitiveType m_PrimitiveType;
-	//!	Vertex indices
-	IndexArray *m_pVertices;
-	//!	Normal indices
-	IndexArray *m_pNormals;
-	//!	Texture coordinates indices
-	IndexArray *m_pTexturCoords;
+	//!	First corner of the face in Model::m_VertexIndices, m_NormalIndices
+	//!	and m_TextureIndices
+	unsigned int m_uiFirstIndex;
+	//!	Number of corners
+	unsigned int m_uiNumIndices;
+	//!	True, if the corners have normal indices
+	bool m_hasNormals;
+	//!	True, if the corners have texture coordinate indices
+	bool m_hasTexCoords;
 	//!	Pointer to assigned material
 	Material *m_pMaterial;
-	
+
 	//!	\brief	Default constructor
-	//!	\param	pVertices	Pointer to assigned vertex indexbuffer
-	//!	\param	pNormals	Pointer to assigned normals indexbuffer
-	//!	\param	pTexCoords	Pointer to assigned texture indexbuffer
-	Face( std::vector<unsigned int> *pVertices, 
-			std::vector<unsigned int> *pNormals, 
-			std::vector<unsigned int> *pTexCoords,
+	//!	\param	uiFirstIndex	First corner in the index arrays of the model
+	//!	\param	pt				Primitive type
+	Face( unsigned int uiFirstIndex = 0,
 			aiPrimitiveType pt = aiPrimitiveType_POLYGON) : 
 		m_PrimitiveType( pt ), 
-		m_pVertices( pVertices ), 
-		m_pNormals( pNormals ),
-		m_pTexturCoords( pTexCoords ), 
+		m_uiFirstIndex( uiFirstIndex ),
+		m_uiNumIndices( 0 ),
+		m_hasNormals( false ),
+		m_hasTexCoords( false ),
 		m_pMaterial( 0L )
-	{
-		// empty
-	}
-	
-	//!	\brief	Destructor	
-	~Face()
 	{	
-		delete m_pVertices;
-		m_pVertices = NULL;
-
-		delete m_pNormals;
-		m_pNormals = NULL;
-
-		delete m_pTexturCoords;
-		m_pTexturCoords = NULL;
+		// empty
 	}
 };
 
@@ -200,8 +189,8 @@ struct Mesh
 {
 	static const unsigned int NoMaterial = ~0u;
 
-	///	Array with pointer to all stored faces
-	std::vector<Face*> m_Faces;
+	///	Array with all stored faces
+	std::vector<Face> m_Faces;
 	///	Assigned material
 	Material *m_pMaterial;
 	///	Number of stored indices.
@@ -225,11 +214,7 @@ struct Mesh
 	///	Destructor
 	~Mesh() 
 	{
-		for (std::vector<Face*>::iterator it = m_Faces.begin();
-			it != m_Faces.end(); ++it)
-		{
-			delete *it;
-		}
+		// empty
 	}
 };
 
@@ -268,6 +253,12 @@ struct Model
 	std::string m_strActiveGroup;
 	//!	Vector with generated texture coordinates
 	std::vector<aiVector2D> m_TextureCoord;
+	//!	Vertex indices of the corners of all faces, in the order of the faces
+	std::vector<unsigned int> m_VertexIndices;
+	//!	Normal indices of the corners, ~0u for a corner without normal
+	std::vector<unsigned int> m_NormalIndices;
+	//!	Texture coordinate indices of the corners, ~0u for a corner without one
+	std::vector<unsigned int> m_TextureIndices;
 	//!	Current mesh instance
 	Mesh *m_pCurrentMesh;
 	//!	Vector with stored meshes
@@ -43,6 +43,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef ASSIMP_BUILD_NO_OBJ_IMPORTER
 
 #include "DefaultIOSystem.h"
+#include "MappedIOStream.h"
 #include "ObjFileImporter.h"
 #include "ObjFileParser.h"
 #include "ObjFileData.h"
@@ -126,8 +127,33 @@ void ObjFileImporter::InternReadFile( const std::string& pFile, aiScene* pScene,
 	if( fileSize < 16)
 		throw DeadlyImportError( "OBJ-file is too small.");
 
-	// Allocate buffer and read file into it
-	TextFileToBuffer(file.get(),m_Buffer);
+	// Parse the file where it is mapped, if it is UTF-8 and ends with a line end that stops
+	// the parser ; else from a copy, converted to UTF-8 and 0-terminated
+	const char *pData = NULL;
+	MappedIOStream *pMapped = dynamic_cast<MappedIOStream*>( file.get() );
+	if ( NULL != pMapped )
+	{
+		pData = pMapped->Data();
+		const unsigned char *pBytes = reinterpret_cast<const unsigned char*>( pData );
+		const char last = pData[ fileSize - 1 ];
+		if ( pBytes[ 0 ] == 0xef && pBytes[ 1 ] == 0xbb && pBytes[ 2 ] == 0xbf )
+		{
+			pData += 3;
+			fileSize -= 3;
+		}
+		else if ( pBytes[ 0 ] == 0xfe || pBytes[ 0 ] == 0xff || pBytes[ 0 ] == 0x00 )
+		{
+			pData = NULL;
+		}
+		if ( last != '\n' && last != '\r' )
+			pData = NULL;
+	}
+	if ( NULL == pData )
+	{
+		TextFileToBuffer( file.get(), m_Buffer );
+		pData = &m_Buffer[ 0 ];
+		fileSize = m_Buffer.size();
+	}
 
 	// Get the model name
 	std::string  strModelName;
@@ -142,7 +168,7 @@ void ObjFileImporter::InternReadFile( const std::string& pFile, aiScene* pScene,
 	}
 	
 	// parse the file into a temporary representation
-	ObjFileParser parser(m_Buffer, strModelName, pIOHandler);
+	ObjFileParser parser(pData, fileSize, strModelName, pIOHandler);
 
 	// And create the proper return structures out of it
 	CreateDataFromImport(parser.GetModel(), pScene);
@@ -275,12 +301,12 @@ void ObjFileImporter::createTopology(const ObjFile::Model* pModel,
 	pMesh->mNumFaces = 0;
 	for (size_t index = 0; index < pObjMesh->m_Faces.size(); index++)
 	{
-		ObjFile::Face* const inp = pObjMesh->m_Faces[ index ];
-		if (inp->m_PrimitiveType == aiPrimitiveType_LINE) {
-			pMesh->mNumFaces += inp->m_pVertices->size() - 1;
+		const ObjFile::Face& inp = pObjMesh->m_Faces[ index ];
+		if (inp.m_PrimitiveType == aiPrimitiveType_LINE) {
+			pMesh->mNumFaces += inp.m_uiNumIndices - 1;
 		}
-		else if (inp->m_PrimitiveType == aiPrimitiveType_POINT) {
-			pMesh->mNumFaces += inp->m_pVertices->size();
+		else if (inp.m_PrimitiveType == aiPrimitiveType_POINT) {
+			pMesh->mNumFaces += inp.m_uiNumIndices;
 		}
 		else {
 			++pMesh->mNumFaces;
@@ -301,17 +327,17 @@ void ObjFileImporter::createTopology(const ObjFile::Model* pModel,
 		// Copy all data from all stored meshes
 		for (size_t index = 0; index < pObjMesh->m_Faces.size(); index++)
 		{
-			ObjFile::Face* const inp = pObjMesh->m_Faces[ index ];
-			if (inp->m_PrimitiveType == aiPrimitiveType_LINE) {
-				for(size_t i = 0; i < inp->m_pVertices->size() - 1; ++i) {
+			const ObjFile::Face& inp = pObjMesh->m_Faces[ index ];
+			if (inp.m_PrimitiveType == aiPrimitiveType_LINE) {
+				for(size_t i = 0; i < inp.m_uiNumIndices - 1; ++i) {
 					aiFace& f = pMesh->mFaces[ outIndex++ ];
 					uiIdxCount += f.mNumIndices = 2;
 					f.mIndices = new unsigned int[2];
 				}
 				continue;
 			}
-			else if (inp->m_PrimitiveType == aiPrimitiveType_POINT) {
-				for(size_t i = 0; i < inp->m_pVertices->size(); ++i) {
+			else if (inp.m_PrimitiveType == aiPrimitiveType_POINT) {
+				for(size_t i = 0; i < inp.m_uiNumIndices; ++i) {
 					aiFace& f = pMesh->mFaces[ outIndex++ ];
 					uiIdxCount += f.mNumIndices = 1;
 					f.mIndices = new unsigned int[1];
@@ -320,7 +346,7 @@ void ObjFileImporter::createTopology(const ObjFile::Model* pModel,
 			}
 
 			aiFace *pFace = &pMesh->mFaces[ outIndex++ ];
-			const unsigned int uiNumIndices = (unsigned int) pObjMesh->m_Faces[ index ]->m_pVertices->size();
+			const unsigned int uiNumIndices = inp.m_uiNumIndices;
 			uiIdxCount += pFace->mNumIndices = (unsigned int) uiNumIndices;
 			if (pFace->mNumIndices > 0) {
 				pFace->mIndices = new unsigned int[ uiNumIndices ];			
@@ -371,22 +397,26 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model* pModel,
 	unsigned int newIndex = 0, outIndex = 0;
 	for ( size_t index=0; index < pObjMesh->m_Faces.size(); index++ )
 	{
-		// Get source face
-		ObjFile::Face *pSourceFace = pObjMesh->m_Faces[ index ]; 
+		// Get source face, and its corners in the index arrays of the model
+		const ObjFile::Face *pSourceFace = &pObjMesh->m_Faces[ index ]; 
+		const unsigned int *pVertices = &pModel->m_VertexIndices[ pSourceFace->m_uiFirstIndex ];
+		const unsigned int *pNormals = &pModel->m_NormalIndices[ pSourceFace->m_uiFirstIndex ];
+		const unsigned int *pTexturCoords = &pModel->m_TextureIndices[ pSourceFace->m_uiFirstIndex ];
+		const bool hasNormals = pSourceFace->m_hasNormals && !pModel->m_Normals.empty();
 
 		// Copy all index arrays
-		for ( size_t vertexIndex = 0, outVertexIndex = 0; vertexIndex < pSourceFace->m_pVertices->size(); vertexIndex++ )
+		for ( size_t vertexIndex = 0, outVertexIndex = 0; vertexIndex < pSourceFace->m_uiNumIndices; vertexIndex++ )
 		{
-			const unsigned int vertex = pSourceFace->m_pVertices->at( vertexIndex );
+			const unsigned int vertex = pVertices[ vertexIndex ];
 			if ( vertex >= pModel->m_Vertices.size() ) 
 				throw DeadlyImportError( "OBJ: vertex index out of range" );
 			
 			pMesh->mVertices[ newIndex ] = pModel->m_Vertices[ vertex ];
 			
 			// Copy all normals 
-			if ( !pSourceFace->m_pNormals->empty() && !pModel->m_Normals.empty())
+			if ( hasNormals )
 			{
-				const unsigned int normal = pSourceFace->m_pNormals->at( vertexIndex );
+				const unsigned int normal = pNormals[ vertexIndex ];
 				if ( normal >= pModel->m_Normals.size() )
 					throw DeadlyImportError("OBJ: vertex normal index out of range");
 
@@ -396,10 +426,9 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model* pModel,
 			// Copy all texture coordinates
 			if ( !pModel->m_TextureCoord.empty() )
 			{
-				if ( !pSourceFace->m_pTexturCoords->empty() )
+				if ( pSourceFace->m_hasTexCoords )
 				{
-					const unsigned int tex = pSourceFace->m_pTexturCoords->at( vertexIndex );
-					ai_assert( tex < pModel->m_TextureCoord.size() );
+					const unsigned int tex = pTexturCoords[ vertexIndex ];
 					for ( size_t i=0; i < pMesh->GetNumUVChannels(); i++ )
 					{
 						if ( tex >= pModel->m_TextureCoord.size() )
@@ -416,7 +445,7 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model* pModel,
 			// Get destination face
 			aiFace *pDestFace = &pMesh->mFaces[ outIndex ];
 
-			const bool last = ( vertexIndex == pSourceFace->m_pVertices->size() - 1 ); 
+			const bool last = ( vertexIndex == pSourceFace->m_uiNumIndices - 1 ); 
 			if (pSourceFace->m_PrimitiveType != aiPrimitiveType_LINE || !last) 
 			{
 				pDestFace->mIndices[ outVertexIndex ] = newIndex;
@@ -438,7 +467,7 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model* pModel,
 				if (vertexIndex) {
 					if(!last) {
 						pMesh->mVertices[ newIndex+1 ] = pMesh->mVertices[ newIndex ];
-						if ( !pSourceFace->m_pNormals->empty() && !pModel->m_Normals.empty()) {
+						if ( hasNormals ) {
 							pMesh->mNormals[ newIndex+1 ] = pMesh->mNormals[newIndex ];
 						}
 						if ( !pModel->m_TextureCoord.empty() ) {
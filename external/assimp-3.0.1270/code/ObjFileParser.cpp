@@ -58,15 +58,13 @@ const std::string ObjFileParser::DEFAULT_MATERIAL = AI_DEFAULT_MATERIAL_NAME;
 
 // -------------------------------------------------------------------
 //	Constructor with loaded data and directories.
-ObjFileParser::ObjFileParser(std::vector<char> &Data,const std::string &strModelName, IOSystem *io ) :
-	m_DataIt(Data.begin()),
-	m_DataItEnd(Data.end()),
+ObjFileParser::ObjFileParser(const char *pData, size_t uiSize, const std::string &strModelName, IOSystem *io ) :
+	m_DataIt(pData),
+	m_DataItEnd(pData + uiSize),
 	m_pModel(NULL),
 	m_uiLine(0),
 	m_pIO( io )
 {
-	std::fill_n(m_buffer,BUFFERSIZE,0);
-
 	// Create the model instance to store all the data
 	m_pModel = new ObjFile::Model();
 	m_pModel->m_ModelName = strModelName;
@@ -77,6 +75,7 @@ ObjFileParser::ObjFileParser(std::vector<char> &Data,const std::string &strModel
 	m_pModel->m_MaterialMap[ DEFAULT_MATERIAL ] = m_pModel->m_pDefaultMaterial;
 	
 	// Start parsing the file
+	reserveArrays();
 	parseFile();
 }
 
@@ -98,6 +97,54 @@ ObjFile::Model *ObjFileParser::GetModel() const
 	return m_pModel;
 }
 
+// -------------------------------------------------------------------
+//	Counts the vertices, normals, texture coordinates and face corners
+//	of the file in a first pass, which only looks at the start of the
+//	lines and the words of the faces, and reserves the arrays of the
+//	model for them instead of growing them line by line.
+void ObjFileParser::reserveArrays()
+{
+	size_t uiVertices = 0, uiNormals = 0, uiTexCoords = 0, uiCorners = 0;
+	DataArrayIt it = m_DataIt;
+	while ( it != m_DataItEnd )
+	{
+		while ( it != m_DataItEnd && ( *it == ' ' || *it == '\t' ) )
+			++it;
+		if ( it == m_DataItEnd )
+			break;
+
+		// The buffer ends with a line end or a 0, so a keyword is never its last character
+		if ( *it == 'v' )
+		{
+			if ( it[ 1 ] == ' ' || it[ 1 ] == '\t' )
+				++uiVertices;
+			else if ( it[ 1 ] == 'n' )
+				++uiNormals;
+			else if ( it[ 1 ] == 't' )
+				++uiTexCoords;
+		}
+		else if ( *it == 'f' || *it == 'l' || *it == 'p' )
+		{
+			// One corner per word after the keyword
+			for ( ++it; it != m_DataItEnd && !IsLineEnd( *it ); ++it )
+			{
+				if ( !isSeparator( *it ) && isSeparator( it[ -1 ] ) )
+					++uiCorners;
+			}
+		}
+
+		it = static_cast<DataArrayIt>( ::memchr( it, '\n', m_DataItEnd - it ) );
+		it = ( NULL == it ) ? m_DataItEnd : it + 1;
+	}
+
+	m_pModel->m_Vertices.reserve( uiVertices );
+	m_pModel->m_Normals.reserve( uiNormals );
+	m_pModel->m_TextureCoord.reserve( uiTexCoords );
+	m_pModel->m_VertexIndices.reserve( uiCorners );
+	m_pModel->m_NormalIndices.reserve( uiCorners );
+	m_pModel->m_TextureIndices.reserve( uiCorners );
+}
+
 // -------------------------------------------------------------------
 //	File parsing method.
 void ObjFileParser::parseFile()
@@ -112,7 +159,7 @@ void ObjFileParser::parseFile()
 		case 'v': // Parse a vertex texture coordinate
 			{
 				++m_DataIt;
-				if (*m_DataIt == ' ')
+				if (*m_DataIt == ' ' || *m_DataIt == '\t')
 				{
 					// Read in vertex definition
 					getVector3(m_pModel->m_Vertices);
@@ -129,6 +176,11 @@ void ObjFileParser::parseFile()
 					++m_DataIt;
 					getVector3( m_pModel->m_Normals );
 				}
+				else
+				{
+					// Parameter space vertices are not supported
+					m_DataIt = skipLine<DataArrayIt>( m_DataIt, m_DataItEnd, m_uiLine );
+				}
 			}
 			break;
 
@@ -186,53 +238,14 @@ void ObjFileParser::parseFile()
 	}
 }
 
-// -------------------------------------------------------------------
-//	Copy the next word in a temporary buffer
-void ObjFileParser::copyNextWord(char *pBuffer, size_t length)
-{
-	size_t index = 0;
-	m_DataIt = getNextWord<DataArrayIt>(m_DataIt, m_DataItEnd);
-	while ( m_DataIt != m_DataItEnd && !isSeparator(*m_DataIt) )
-	{
-		pBuffer[index] = *m_DataIt;
-		index++;
-		if (index == length-1)
-			break;
-		++m_DataIt;
-	}
-	pBuffer[index] = '\0';
-}
-
-// -------------------------------------------------------------------
-// Copy the next line into a temporary buffer
-void ObjFileParser::copyNextLine(char *pBuffer, size_t length)
-{
-	size_t index = 0;
-	while (m_DataIt != m_DataItEnd)
-	{
-		if (*m_DataIt == '\n' || *m_DataIt == '\r' || index == length-1)
-			break;
-
-		pBuffer[ index ] = *m_DataIt;
-		++index;
-		++m_DataIt;
-	}
-	pBuffer[ index ] = '\0';
-}
-
 // -------------------------------------------------------------------
 //	Get values for a new 3D vector instance
 void ObjFileParser::getVector3(std::vector<aiVector3D> &point3d_array)
 {
 	float x, y, z;
-	copyNextWord(m_buffer, BUFFERSIZE);
-	x = (float) fast_atof(m_buffer);	
-	
-	copyNextWord(m_buffer, BUFFERSIZE);
-	y = (float) fast_atof(m_buffer);
-
-	copyNextWord(m_buffer, BUFFERSIZE);
-	z = (float) fast_atof(m_buffer);
+	m_DataIt = getFloat<DataArrayIt>( m_DataIt, m_DataItEnd, x );
+	m_DataIt = getFloat<DataArrayIt>( m_DataIt, m_DataItEnd, y );
+	m_DataIt = getFloat<DataArrayIt>( m_DataIt, m_DataItEnd, z );
 
 	point3d_array.push_back( aiVector3D( x, y, z ) );
 	//skipLine();
@@ -244,11 +257,8 @@ void ObjFileParser::getVector3(std::vector<aiVector3D> &point3d_array)
 void ObjFileParser::getVector2( std::vector<aiVector2D> &point2d_array )
 {
 	float x, y;
-	copyNextWord(m_buffer, BUFFERSIZE);
-	x = (float) fast_atof(m_buffer);	
-	
-	copyNextWord(m_buffer, BUFFERSIZE);
-	y = (float) fast_atof(m_buffer);
+	m_DataIt = getFloat<DataArrayIt>( m_DataIt, m_DataItEnd, x );
+	m_DataIt = getFloat<DataArrayIt>( m_DataIt, m_DataItEnd, y );
 
 	point2d_array.push_back(aiVector2D(x, y));
 
@@ -259,97 +269,81 @@ void ObjFileParser::getVector2( std::vector<aiVector2D> &point2d_array )
 //	Get values for a new face instance
 void ObjFileParser::getFace(aiPrimitiveType type)
 {
-	copyNextLine(m_buffer, BUFFERSIZE);
-	if (m_DataIt == m_DataItEnd)
-		return;
-
-	char *pPtr = m_buffer;
-	char *pEnd = &pPtr[BUFFERSIZE];
-	pPtr = getNextToken<char*>(pPtr, pEnd);
-	if (pPtr == pEnd || *pPtr == '\0')
-		return;
-
-	std::vector<unsigned int> *pIndices = new std::vector<unsigned int>;
-	std::vector<unsigned int> *pTexID = new std::vector<unsigned int>;
-	std::vector<unsigned int> *pNormalID = new std::vector<unsigned int>;
-	bool hasNormal = false;
+	// Skip the keyword, the corners are read where they are in the line
+	m_DataIt = getNextToken<DataArrayIt>( m_DataIt, m_DataItEnd );
 
+	ObjFile::Face face( (unsigned int) m_pModel->m_VertexIndices.size(), type );
 	const bool vt = (!m_pModel->m_TextureCoord.empty());
 	const bool vn = (!m_pModel->m_Normals.empty());
-	int iStep = 0, iPos = 0;
-	while (pPtr != pEnd)
+	while ( m_DataIt != m_DataItEnd && !IsLineEnd( *m_DataIt ) )
 	{
-		iStep = 1;
-
-		if (IsLineEnd(*pPtr))
-			break;
+		if ( isSeparator( *m_DataIt ) )
+		{
+			++m_DataIt;
+			continue;
+		}
 
-		if (*pPtr=='/' )
+		// A corner : "v", "v/vt", "v//vn" or "v/vt/vn", the slashes give the
+		// position of each index
+		unsigned int uiIndices[ 3 ] = { ~0u, ~0u, ~0u };
+		int iPos = 0;
+		while ( m_DataIt != m_DataItEnd && !isSeparator( *m_DataIt ) && *m_DataIt != '\0' )
 		{
-			if (type == aiPrimitiveType_POINT) {
-				DefaultLogger::get()->error("Obj: Separator unexpected in point statement");
-			}
-			if (iPos == 0)
+			if (*m_DataIt == '/')
 			{
-				//if there are no texture coordinates in the file, but normals
-				if (!vt && vn) {
-					iPos = 1;
-					iStep++;
+				if (type == aiPrimitiveType_POINT) {
+					DefaultLogger::get()->error("Obj: Separator unexpected in point statement");
 				}
+				iPos++;
+				++m_DataIt;
+				continue;
 			}
-			iPos++;
-		}
-		else if ( isSeparator(*pPtr) )
-		{
-			iPos = 0;
-		}
-		else 
-		{
-			//OBJ USES 1 Base ARRAYS!!!!
-			const int iVal = atoi( pPtr );
-			int tmp = iVal;
-			while ( ( tmp = tmp / 10 )!=0 )
-				++iStep;
 
+			//OBJ USES 1 Base ARRAYS!!!!
+			DataArrayIt pNext = m_DataIt;
+			const int iVal = strtol10( m_DataIt, &pNext );
+			m_DataIt = ( pNext == m_DataIt ) ? m_DataIt + 1 : pNext;
 			if ( iVal > 0 )
 			{
 				// Store parsed index
-				if ( 0 == iPos )
-				{
-					pIndices->push_back( iVal-1 );
-				}
-				else if ( 1 == iPos )
-				{	
-					pTexID->push_back( iVal-1 );
-				}
-				else if ( 2 == iPos )
-				{
-					pNormalID->push_back( iVal-1 );
-					hasNormal = true;
-				}
+				if ( iPos < 3 )
+					uiIndices[ iPos ] = iVal - 1;
 				else
-				{
 					reportErrorTokenInFace();
-				}
 			}
 		}
-		pPtr += iStep;
+
+		//if there are no texture coordinates in the file, but normals, "v/vn" is a normal
+		if ( !vt && vn && uiIndices[ 2 ] == ~0u )
+		{
+			uiIndices[ 2 ] = uiIndices[ 1 ];
+			uiIndices[ 1 ] = ~0u;
+		}
+
+		// A corner without vertex is left out
+		if ( uiIndices[ 0 ] == ~0u )
+			continue;
+
+		m_pModel->m_VertexIndices.push_back( uiIndices[ 0 ] );
+		m_pModel->m_TextureIndices.push_back( uiIndices[ 1 ] );
+		m_pModel->m_NormalIndices.push_back( uiIndices[ 2 ] );
+		face.m_hasTexCoords |= ( uiIndices[ 1 ] != ~0u );
+		face.m_hasNormals |= ( uiIndices[ 2 ] != ~0u );
+		++face.m_uiNumIndices;
 	}
 
-	if ( pIndices->empty() ) 
+	if ( 0 == face.m_uiNumIndices )
 	{
 		DefaultLogger::get()->error("Obj: Ignoring empty face");
 		m_DataIt = skipLine<DataArrayIt>( m_DataIt, m_DataItEnd, m_uiLine );
 		return;
 	}
 
-	ObjFile::Face *face = new ObjFile::Face( pIndices, pNormalID, pTexID, type );
-	
 	// Set active material, if one set
 	if (NULL != m_pModel->m_pCurrentMaterial) 
-		face->m_pMaterial = m_pModel->m_pCurrentMaterial;
+		face.m_pMaterial = m_pModel->m_pCurrentMaterial;
 	else 
-		face->m_pMaterial = m_pModel->m_pDefaultMaterial;
+		face.m_pMaterial = m_pModel->m_pDefaultMaterial;
 
 	// Create a default object, if nothing is there
 	if ( NULL == m_pModel->m_pCurrent )
@@ -363,9 +357,10 @@ void ObjFileParser::getFace(aiPrimitiveType type)
 	
 	// Store the face
 	m_pModel->m_pCurrentMesh->m_Faces.push_back( face );
-	m_pModel->m_pCurrentMesh->m_uiNumIndices += (unsigned int)face->m_pVertices->size();
-	m_pModel->m_pCurrentMesh->m_uiUVCoordinates[ 0 ] += (unsigned int)face->m_pTexturCoords[0].size(); 
-	if( !m_pModel->m_pCurrentMesh->m_hasNormals && hasNormal ) 
+	m_pModel->m_pCurrentMesh->m_uiNumIndices += face.m_uiNumIndices;
+	if ( face.m_hasTexCoords )
+		m_pModel->m_pCurrentMesh->m_uiUVCoordinates[ 0 ] += face.m_uiNumIndices;
+	if( !m_pModel->m_pCurrentMesh->m_hasNormals && face.m_hasNormals ) 
 	{
 		m_pModel->m_pCurrentMesh->m_hasNormals = true;
 	}
@@ -391,12 +386,12 @@ void ObjFileParser::getMaterialDesc()
 	if (m_DataIt == m_DataItEnd)
 		return;
 
-	char *pStart = &(*m_DataIt);
+	DataArrayIt pStart = m_DataIt;
 	while ( m_DataIt != m_DataItEnd && !isSeparator(*m_DataIt) )
 		++m_DataIt;
 
 	// Get name
-	std::string strName(pStart, &(*m_DataIt));
+	std::string strName(pStart, m_DataIt);
 	if ( strName.empty())
 		return;
 
@@ -450,12 +445,12 @@ void ObjFileParser::getMaterialLib()
 	if (m_DataIt ==  m_DataItEnd)
 		return;
 	
-	char *pStart = &(*m_DataIt);
+	DataArrayIt pStart = m_DataIt;
 	while (m_DataIt != m_DataItEnd && !isNewLine(*m_DataIt))
 		m_DataIt++;
 
 	// Check for existence
-	const std::string strMatName(pStart, &(*m_DataIt));
+	const std::string strMatName(pStart, m_DataIt);
 	IOStream *pFile = m_pIO->Open(strMatName);
 
 	if (!pFile )
@@ -483,7 +478,7 @@ void ObjFileParser::getNewMaterial()
 	if ( m_DataIt == m_DataItEnd )
 		return;
 
-	char *pStart = &(*m_DataIt);
+	DataArrayIt pStart = m_DataIt;
 	std::string strMat( pStart, *m_DataIt );
 	while ( m_DataIt != m_DataItEnd && isSeparator( *m_DataIt ) )
 		m_DataIt++;
@@ -535,10 +530,10 @@ void ObjFileParser::getGroupName()
 		return;
 
 	// Store the group name in the group library 
-	char *pStart = &(*m_DataIt);
+	DataArrayIt pStart = m_DataIt;
 	while ( m_DataIt != m_DataItEnd && !isSeparator(*m_DataIt) )
 		m_DataIt++;
-	std::string strGroupName( pStart, &(*m_DataIt) );
+	std::string strGroupName( pStart, m_DataIt );
 
 	// Change active group, if necessary
 	if ( m_pModel->m_strActiveGroup != strGroupName )
@@ -582,11 +577,11 @@ void ObjFileParser::getObjectName()
 	m_DataIt = getNextToken<DataArrayIt>(m_DataIt, m_DataItEnd);
 	if (m_DataIt == m_DataItEnd)
 		return;
-	char *pStart = &(*m_DataIt);
+	DataArrayIt pStart = m_DataIt;
 	while ( m_DataIt != m_DataItEnd && !isSeparator( *m_DataIt ) )
 		++m_DataIt;
 
-	std::string strObjectName(pStart, &(*m_DataIt));
+	std::string strObjectName(pStart, m_DataIt);
 	if (!strObjectName.empty()) 
 	{
 		// Reset current object
@@ -674,7 +669,6 @@ bool ObjFileParser::needsNewMesh( const std::string &rMaterialName )
 //	Shows an error in parsing process.
 void ObjFileParser::reportErrorTokenInFace()
 {		
-	m_DataIt = skipLine<DataArrayIt>( m_DataIt, m_DataItEnd, m_uiLine );
 	DefaultLogger::get()->error("OBJ: Not supported token in face description detected");
 }
 
@@ -65,26 +65,22 @@ class IOSystem;
 class ObjFileParser
 {
 public:
-	static const size_t BUFFERSIZE = 4096;
-	typedef std::vector<char> DataArray;
-	typedef std::vector<char>::iterator DataArrayIt;
-	typedef std::vector<char>::const_iterator ConstDataArrayIt;
+	typedef const char* DataArrayIt;
 
 public:
-	///	\brief	Constructor with data array.
-	ObjFileParser(std::vector<char> &Data,const std::string &strModelName, IOSystem* io);
+	///	\brief	Constructor with the data of the file, which is parsed where it is.
+	///	It must end with a line end or a 0, for the last number to stop there.
+	ObjFileParser(const char *pData, size_t uiSize, const std::string &strModelName, IOSystem* io);
 	///	\brief	Destructor
 	~ObjFileParser();
 	///	\brief	Model getter.
 	ObjFile::Model *GetModel() const;
 
 private:
+	///	Reserves the arrays of the model for the statements of the file.
+	void reserveArrays();
 	///	Parse the loadedfile
 	void parseFile();
-	///	Method to copy the new delimited word in the current line.
-	void copyNextWord(char *pBuffer, size_t length);
-	///	Method to copy the new line.
-	void copyNextLine(char *pBuffer, size_t length);
 	///	Stores the following 3d vector.
 	void getVector3( std::vector<aiVector3D> &point3d_array );
 	///	Stores the following 3d vector.
@@ -126,8 +122,6 @@ private:
 	ObjFile::Model *m_pModel;
 	//!	Current line (for debugging)
 	unsigned int m_uiLine;
-	//!	Helper buffer
-	char m_buffer[BUFFERSIZE];
 	///	Pointer to IO system instance.
 	IOSystem *m_pIO;
 };
@@ -205,19 +205,27 @@ inline char_t CopyNextWord( char_t it, char_t end, char *pBuffer, size_t length
 	return it;
 }
 
-/**	@brief	Get next float from given line
+/**	@brief	Get next float from given line, read where it is in the buffer
  *	@param	it		set to current position
- *	@param	end		set to end of scratch buffer for readout
- *	@param	value	Separated float value.
- *	@return	Current-iterator with new position
+ *	@param	end		set to end of scratch buffer for readout, which must end with a
+ *					separator or a 0 for the number to stop there
+ *	@param	value	Separated float value, 0 at the end of the line
+ *	@return	Current-iterator with new position, after the word
  */
 template<class char_t>
 inline char_t getFloat( char_t it, char_t end, float &value )
 {
-	static const size_t BUFFERSIZE = 1024;
-	char buffer[ BUFFERSIZE ];
-	it = CopyNextWord<char_t>( it, end, buffer, BUFFERSIZE );
-	value = (float) fast_atof( buffer );
+	it = getNextWord<char_t>( it, end );
+	if ( isEndOfBuffer( it, end ) || isSeparator( *it ) )
+	{
+		value = 0.0f;
+		return it;
+	}
+
+	const char *pStart = &( *it );
+	it += fast_atoreal_move<float>( pStart, value ) - pStart;
+	while ( !isEndOfBuffer( it, end ) && !isSeparator( *it ) )
+		++it;
 
 	return it;
 }
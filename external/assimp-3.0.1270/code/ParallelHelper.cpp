@@ -0,0 +1,193 @@
+/*
+Open Asset Import Library (assimp)
+----------------------------------------------------------------------
+
+Copyright (c) 2006-2012, assimp team
+All rights reserved.
+
+Redistribution and use of this software in source and binary forms, 
+with or without modification, are permitted provided that the 
+following conditions are met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the above
+  copyright notice, this list of conditions and the
+  following disclaimer in the documentation and/or other
+  materials provided with the distribution.
+
+* Neither the name of the assimp team, nor the names of its
+  contributors may be used to endorse or promote products
+  derived from this software without specific prior
+  written permission of the assimp team.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+----------------------------------------------------------------------
+*/
+
+/** @file ParallelHelper.cpp
+ *  @brief Implementation of the thread helpers of the post processing steps
+ */
+
+#include "AssimpPCH.h"
+#include "ParallelHelper.h"
+
+// std::thread comes with C++11, which MSVC doesn't report in __cplusplus
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700)
+#	define AI_PARALLEL_THREADS
+#	include <atomic>
+#	include <exception>
+#	include <mutex>
+#	include <thread>
+#endif
+
+using namespace Assimp;
+
+#ifdef AI_PARALLEL_THREADS
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// What the threads of a ParallelFor() share
+struct ParallelState
+{
+	ParallelTask* mTask;
+	unsigned int mCount;
+	std::atomic<unsigned int> mNext;
+	std::mutex mErrorMutex;
+	std::exception_ptr mError;
+};
+
+// ------------------------------------------------------------------------------------------------
+// Runs the next index until there is none left, or until a task failed
+void RunParallelTasks( ParallelState* pState)
+{
+	for (;;) {
+		const unsigned int index = pState->mNext.fetch_add(1);
+		if (index >= pState->mCount) {
+			return;
+		}
+		try {
+			pState->mTask->Run(index);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(pState->mErrorMutex);
+			if (!pState->mError) {
+				pState->mError = std::current_exception();
+			}
+			pState->mNext = pState->mCount;
+		}
+	}
+}
+
+} // namespace
+#endif // !! AI_PARALLEL_THREADS
+
+// ------------------------------------------------------------------------------------------------
+unsigned int Assimp::GetNumThreads( int pConfigured)
+{
+#ifdef AI_PARALLEL_THREADS
+	if (pConfigured > 0) {
+		return (unsigned int)pConfigured;
+	}
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 0 ? hardwareThreads : 1;
+#else
+	(void)pConfigured;
+	return 1;
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+void Assimp::ParallelFor( unsigned int pNumThreads, unsigned int pCount, ParallelTask& pTask)
+{
+#ifdef AI_PARALLEL_THREADS
+	const unsigned int numThreads = std::min(pNumThreads, pCount);
+	if (numThreads > 1) {
+		ParallelState state;
+		state.mTask = &pTask;
+		state.mCount = pCount;
+		state.mNext = 0;
+
+		// if a thread can't be started, the others do its share
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads - 1);
+		for (unsigned int i = 1; i < numThreads; ++i) {
+			try {
+				threads.push_back(std::thread(RunParallelTasks, &state));
+			}
+			catch (const std::exception&) {
+				break;
+			}
+		}
+		RunParallelTasks(&state);
+		for (size_t i = 0; i < threads.size(); ++i) {
+			threads[i].join();
+		}
+
+		if (state.mError) {
+			std::rethrow_exception(state.mError);
+		}
+		return;
+	}
+#else
+	(void)pNumThreads;
+#endif
+	for (unsigned int i = 0; i < pCount; ++i) {
+		pTask.Run(i);
+	}
+}
+
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// Runs a ParallelMeshTask on a list of small meshes, one thread each
+class SmallMeshTask : public ParallelTask
+{
+public:
+	SmallMeshTask( ParallelMeshTask& pTask, const std::vector<unsigned int>& pMeshes)
+		: mTask(pTask), mMeshes(pMeshes)
+	{}
+
+	void Run( unsigned int pIndex) {
+		mTask.Run(mMeshes[pIndex], 1);
+	}
+
+private:
+	ParallelMeshTask& mTask;
+	const std::vector<unsigned int>& mMeshes;
+};
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+void Assimp::ParallelForMeshes( unsigned int pNumThreads, const aiScene* pScene, ParallelMeshTask& pTask)
+{
+	std::vector<unsigned int> smallMeshes, largeMeshes;
+	for (unsigned int i = 0; i < pScene->mNumMeshes; ++i) {
+		if (pNumThreads > 1 && pScene->mMeshes[i]->mNumVertices >= AI_PARALLEL_LARGE_MESH_VERTICES) {
+			largeMeshes.push_back(i);
+		}
+		else {
+			smallMeshes.push_back(i);
+		}
+	}
+
+	SmallMeshTask smallTask(pTask, smallMeshes);
+	ParallelFor(pNumThreads, (unsigned int)smallMeshes.size(), smallTask);
+	for (size_t i = 0; i < largeMeshes.size(); ++i) {
+		pTask.Run(largeMeshes[i], pNumThreads);
+	}
+}
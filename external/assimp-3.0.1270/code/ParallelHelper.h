@@ -0,0 +1,112 @@
+/*
+Open Asset Import Library (assimp)
+----------------------------------------------------------------------
+
+Copyright (c) 2006-2012, assimp team
+All rights reserved.
+
+Redistribution and use of this software in source and binary forms, 
+with or without modification, are permitted provided that the 
+following conditions are met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the above
+  copyright notice, this list of conditions and the
+  following disclaimer in the documentation and/or other
+  materials provided with the distribution.
+
+* Neither the name of the assimp team, nor the names of its
+  contributors may be used to endorse or promote products
+  derived from this software without specific prior
+  written permission of the assimp team.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+----------------------------------------------------------------------
+*/
+
+/** @file ParallelHelper.h
+ *  @brief Runs the work of a post processing step on several threads
+ */
+#ifndef AI_PARALLELHELPER_H_INC
+#define AI_PARALLELHELPER_H_INC
+
+struct aiScene;
+
+namespace Assimp	{
+
+// ---------------------------------------------------------------------------
+/** Meshes with at least this many vertices are processed one after the other,
+ *  each on all the threads, instead of one mesh per thread.
+ */
+#define AI_PARALLEL_LARGE_MESH_VERTICES 65536
+
+// ---------------------------------------------------------------------------
+/** Work that ParallelFor() runs for every index of a range, in any order and
+ *  on any thread. Run() must only write what belongs to its index, so that
+ *  the result doesn't depend on the number of threads, and must not log :
+ *  the loggers are not thread-safe.
+ */
+class ParallelTask
+{
+public:
+	virtual ~ParallelTask() {}
+
+	// -------------------------------------------------------------------
+	/** Does the work of one index */
+	virtual void Run( unsigned int pIndex) = 0;
+};
+
+// ---------------------------------------------------------------------------
+/** Work that ParallelForMeshes() runs for every mesh of a scene, with the
+ *  same rules as ParallelTask.
+ */
+class ParallelMeshTask
+{
+public:
+	virtual ~ParallelMeshTask() {}
+
+	// -------------------------------------------------------------------
+	/** Does the work of one mesh, on pNumThreads threads : 1 when the
+	 *  mesh is small, and shares a thread with the others. */
+	virtual void Run( unsigned int pMeshIndex, unsigned int pNumThreads) = 0;
+};
+
+// ---------------------------------------------------------------------------
+/** Returns the number of threads for a value of AI_CONFIG_PP_NUM_THREADS :
+ *  itself, or one per hardware thread for 0. Always 1 if assimp is built
+ *  without std::thread.
+ */
+unsigned int GetNumThreads( int pConfigured);
+
+// ---------------------------------------------------------------------------
+/** Runs the task for every index of [0, pCount) on up to pNumThreads threads,
+ *  the calling one included, each taking the next index once done with the
+ *  last. Returns when all are done, and then throws the first exception a
+ *  Run() threw, if any.
+ */
+void ParallelFor( unsigned int pNumThreads, unsigned int pCount, ParallelTask& pTask);
+
+// ---------------------------------------------------------------------------
+/** Runs the task for every mesh of the scene : the meshes with less than
+ *  AI_PARALLEL_LARGE_MESH_VERTICES vertices in parallel with ParallelFor(),
+ *  then the others one after the other, each with all the threads.
+ */
+void ParallelForMeshes( unsigned int pNumThreads, const aiScene* pScene, ParallelMeshTask& pTask);
+
+} // end of namespace Assimp
+
+#endif // !! AI_PARALLELHELPER_H_INC
@@ -46,6 +46,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "SpatialSort.h"
 #include "BaseProcess.h"
 #include "ParsingUtils.h"
+#include "ParallelHelper.h"
 
 // -------------------------------------------------------------------------------
 // Some extensions to std namespace. Mainly std::min and std::max for all
@@ -320,29 +321,59 @@ aiMesh* MakeSubmesh(const aiMesh *superMesh, const std::vector<unsigned int> &su
 // all steps which use it to speedup its computations.
 class ComputeSpatialSortProcess : public BaseProcess
 {
+public:
+	ComputeSpatialSortProcess()
+		: configNumThreads(0)
+	{}
+
+private:
+	typedef std::pair<SpatialSort, float> _Type; 
+
+	// fills the spatial sort of each mesh, on as many threads as given
+	class FillTask : public ParallelMeshTask
+	{
+	public:
+		FillTask(const aiScene* pScene, std::vector<_Type>& pOut)
+			: mScene(pScene), mOut(pOut)
+		{}
+
+		void Run( unsigned int pMeshIndex, unsigned int pNumThreads)
+		{
+			const aiMesh* mesh = mScene->mMeshes[pMeshIndex];
+			_Type& blubb = mOut[pMeshIndex];
+			blubb.first.Fill(mesh->mVertices,mesh->mNumVertices,sizeof(aiVector3D),true,pNumThreads);
+			blubb.second = ComputePositionEpsilon(mesh);
+		}
+
+	private:
+		const aiScene* mScene;
+		std::vector<_Type>& mOut;
+	};
+
 	bool IsActive( unsigned int pFlags) const
 	{
 		return NULL != shared && 0 != (pFlags & (aiProcess_CalcTangentSpace | 
 			aiProcess_GenNormals | aiProcess_JoinIdenticalVertices));
 	}
 
+	void SetupProperties(const Importer* pImp)
+	{
+		configNumThreads = pImp->GetPropertyInteger(AI_CONFIG_PP_NUM_THREADS,0);
+	}
+
 	void Execute( aiScene* pScene)
 	{
-		typedef std::pair<SpatialSort, float> _Type; 
 		DefaultLogger::get()->debug("Generate spatially-sorted vertex cache");
 
 		std::vector<_Type>* p = new std::vector<_Type>(pScene->mNumMeshes); 
-		std::vector<_Type>::iterator it = p->begin();
-
-		for (unsigned int i = 0; i < pScene->mNumMeshes; ++i, ++it)	{
-			aiMesh* mesh = pScene->mMeshes[i];
-			_Type& blubb = *it;
-			blubb.first.Fill(mesh->mVertices,mesh->mNumVertices,sizeof(aiVector3D));
-			blubb.second = ComputePositionEpsilon(mesh);
-		}
+		FillTask task(pScene,*p);
+		ParallelForMeshes(GetNumThreads(configNumThreads),pScene,task);
 
 		shared->AddProperty(AI_SPP_SPATIAL_SORT,p);
 	}
+
+	/** Configuration option: number of threads, 0 for one per hardware thread */
+	int configNumThreads;
 };
 
 // -------------------------------------------------------------------------------
@@ -43,6 +43,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "AssimpPCH.h"
 #include "SpatialSort.h"
+#include "ParallelHelper.h"
 
 using namespace Assimp;
 
@@ -81,22 +82,103 @@ SpatialSort::~SpatialSort()
 // ------------------------------------------------------------------------------------------------
 void SpatialSort::Fill( const aiVector3D* pPositions, unsigned int pNumPositions, 
 	unsigned int pElementOffset,
-	bool pFinalize /*= true */)
+	bool pFinalize /*= true */,
+	unsigned int pNumThreads /*= 1*/)
 {
 	mPositions.clear();
-	Append(pPositions,pNumPositions,pElementOffset,pFinalize);
+	Append(pPositions,pNumPositions,pElementOffset,pFinalize,pNumThreads);
 }
 
+namespace {
+
+	// --------------------------------------------------------------------------------------------
+	// Sorts each range [pBounds[i], pBounds[i+1]) of an array
+	template <typename T>
+	class SortRangesTask : public ParallelTask
+	{
+	public:
+		SortRangesTask( T* pData, const std::vector<size_t>& pBounds)
+			: mData(pData), mBounds(pBounds)
+		{}
+
+		void Run( unsigned int pIndex) {
+			std::sort( mData + mBounds[pIndex], mData + mBounds[pIndex+1]);
+		}
+
+	private:
+		T* mData;
+		const std::vector<size_t>& mBounds;
+	};
+
+	// --------------------------------------------------------------------------------------------
+	// Merges the sorted ranges 2i and 2i+1 of an array into another. A last range without a
+	// partner is copied as it is.
+	template <typename T>
+	class MergeRangesTask : public ParallelTask
+	{
+	public:
+		MergeRangesTask( const T* pSource, T* pDest, const std::vector<size_t>& pBounds)
+			: mSource(pSource), mDest(pDest), mBounds(pBounds)
+		{}
+
+		void Run( unsigned int pIndex) {
+			const size_t lastBound = mBounds.size() - 1;
+			const size_t first  = mBounds[2*pIndex];
+			const size_t middle = mBounds[std::min<size_t>(2*pIndex+1,lastBound)];
+			const size_t end    = mBounds[std::min<size_t>(2*pIndex+2,lastBound)];
+			std::merge( mSource + first, mSource + middle, mSource + middle, mSource + end, mDest + first);
+		}
+
+	private:
+		const T* mSource;
+		T* mDest;
+		const std::vector<size_t>& mBounds;
+	};
+
+} // namespace
+
 // ------------------------------------------------------------------------------------------------
-void SpatialSort :: Finalize()
+void SpatialSort :: Finalize( unsigned int pNumThreads /*= 1*/)
 {
-	std::sort( mPositions.begin(), mPositions.end());
+	// below the size of a large mesh, threads cost more than they save
+	const size_t numEntries = mPositions.size();
+	if (pNumThreads <= 1 || numEntries < AI_PARALLEL_LARGE_MESH_VERTICES) {
+		std::sort( mPositions.begin(), mPositions.end());
+		return;
+	}
+
+	// sort a range per thread, then merge the ranges pairwise until one is left. As entries
+	// are totally ordered, this gives exactly what a single std::sort() would.
+	std::vector<size_t> bounds;
+	for (unsigned int i = 0; i <= pNumThreads; ++i) {
+		bounds.push_back(numEntries * i / pNumThreads);
+	}
+	SortRangesTask<Entry> sortTask(&mPositions[0],bounds);
+	ParallelFor(pNumThreads,pNumThreads,sortTask);
+
+	std::vector<Entry> merged(numEntries);
+	while (bounds.size() > 2) {
+		const unsigned int numRanges = (unsigned int)bounds.size() - 1;
+		MergeRangesTask<Entry> mergeTask(&mPositions[0],&merged[0],bounds);
+		ParallelFor(pNumThreads,(numRanges + 1) / 2,mergeTask);
+		mPositions.swap(merged);
+
+		std::vector<size_t> mergedBounds;
+		for (size_t i = 0; i < bounds.size(); i += 2) {
+			mergedBounds.push_back(bounds[i]);
+		}
+		if (mergedBounds.back() != numEntries) {
+			mergedBounds.push_back(numEntries);
+		}
+		bounds.swap(mergedBounds);
+	}
 }
 
 // ------------------------------------------------------------------------------------------------
 void SpatialSort::Append( const aiVector3D* pPositions, unsigned int pNumPositions, 
 	unsigned int pElementOffset,
-	bool pFinalize /*= true */)
+	bool pFinalize /*= true */,
+	unsigned int pNumThreads /*= 1*/)
 {
 	// store references to all given positions along with their distance to the reference plane
 	const size_t initial = mPositions.size();
@@ -113,7 +195,7 @@ void SpatialSort::Append( const aiVector3D* pPositions, unsigned int pNumPositio
 
 	if (pFinalize) {
 		// now sort the array ascending by distance.
-		Finalize();
+		Finalize(pNumThreads);
 	}
 }
 
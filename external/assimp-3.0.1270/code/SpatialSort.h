@@ -90,25 +90,31 @@ public:
 	 *   is finalized after the new data has been added. Finalization is
 	 *   required in order to use #FindPosition() or #GenerateMappingTable().
 	 *   If you don't finalize yet, you can use #Append() to add data from
-	 *   other sources.*/
+	 *   other sources.
+	 * @param pNumThreads Number of threads to finalize with, see #Finalize().*/
 	void Fill( const aiVector3D* pPositions, unsigned int pNumPositions, 
 		unsigned int pElementOffset,
-		bool pFinalize = true);
+		bool pFinalize = true,
+		unsigned int pNumThreads = 1);
 
 
 	// ------------------------------------------------------------------------------------
 	/** Same as #Fill(), except the method appends to existing data in the #SpatialSort. */
 	void Append( const aiVector3D* pPositions, unsigned int pNumPositions, 
 		unsigned int pElementOffset,
-		bool pFinalize = true);
+		bool pFinalize = true,
+		unsigned int pNumThreads = 1);
 
 
 	// ------------------------------------------------------------------------------------
 	/** Finalize the spatial hash data structure. This can be useful after
 	 *  multiple calls to #Append() with the pFinalize parameter set to false.
 	 *  This is finally required before one of #FindPositions() and #GenerateMappingTable()
-	 *  can be called to query the spatial sort.*/
-	void Finalize();
+	 *  can be called to query the spatial sort.
+	 * @param pNumThreads Number of threads to sort with. Large arrays are sorted in
+	 *   parallel ranges which are then merged; the order is the same for any number
+	 *   of threads. */
+	void Finalize( unsigned int pNumThreads = 1);
 
 	// ------------------------------------------------------------------------------------
 	/** Returns an iterator for all positions close to the given position.
@@ -158,7 +164,11 @@ protected:
 			: mIndex( pIndex), mPosition( pPosition), mDistance( pDistance)
 		{ 	}
 
-		bool operator < (const Entry& e) const { return mDistance < e.mDistance; }
+		// ordered by index at equal distances, so that the order of a sort doesn't depend
+		// on the algorithm, and the results of the queries don't depend on the thread count
+		bool operator < (const Entry& e) const {
+			return mDistance < e.mDistance || (mDistance == e.mDistance && mIndex < e.mIndex);
+		}
 	};
 
 	// all positions, sorted by distance to the sorting plane
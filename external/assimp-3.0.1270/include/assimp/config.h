@@ -102,6 +102,20 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Various stuff to fine-tune the behavior of a specific post processing step.
 // ###########################################################################
 
+// ---------------------------------------------------------------------------
+/** @brief Number of threads of the JoinVertices, GenSmoothNormals and
+ *  CalcTangentSpace steps.
+ *
+ * The meshes of a scene are processed in parallel, and a mesh of more than
+ * 64K vertices on all threads at once. 0 means one thread per hardware
+ * thread, 1 keeps the steps on the thread of ReadFile(). The output is the
+ * same, bit for bit, for any number of threads. Ignored if Assimp was built
+ * without C++11 std::thread.
+ * Property type: integer. Default value: 0
+ */
+#define AI_CONFIG_PP_NUM_THREADS \
+	"PP_NUM_THREADS"
+
 
 // ---------------------------------------------------------------------------
 /** @brief Maximum bone count per mesh for the SplitbyBoneCount step.
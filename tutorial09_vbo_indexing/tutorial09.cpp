@@ -1,6 +1,7 @@
 // Include standard headers
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 
 // Include GLEW
@@ -9,6 +10,9 @@
 // Include GLFW
 #include <GLFW/glfw3.h>
 GLFWwindow* window;
+#ifdef HEADLESS_BENCHMARK
+#include <distrib/benchmark.h> // no window, no input : see the header
+#endif
 
 // Include GLM
 #include <glm/glm.hpp>
@@ -20,8 +24,11 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/mesh.hpp>
+#include <common/glstate.hpp>
+#include <common/profiler.hpp>
 
-int main( void )
+int main( int argc, char *argv[] )
 {
 	// Initialize GLFW
 	if( !glfwInit() )
@@ -56,6 +63,17 @@ int main( void )
 		return -1;
 	}
 
+	// "--profile trace.json" times the loading and every frame, prints the statistics
+	// and writes a Chrome trace (chrome://tracing) at exit
+	const char * tracePath = NULL;
+	for (int i = 1; i < argc; i++){
+		if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+			tracePath = argv[++i];
+	}
+	Profiler profiler;
+	if (tracePath != NULL)
+		profiler.create();
+
 	// Ensure we can capture the escape key being pressed below
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
     // Hide the mouse and enable unlimited movement
@@ -76,20 +94,23 @@ int main( void )
 	// Cull triangles which normal is not towards the camera
 	glEnable(GL_CULL_FACE);
 
-	GLuint VertexArrayID;
-	glGenVertexArrays(1, &VertexArrayID);
-	glBindVertexArray(VertexArrayID);
+	profiler.beginCpu("loading");
 
 	// Create and compile our GLSL program from the shaders
+	profiler.beginCpu("shaders");
 	GLuint programID = LoadShaders( "StandardShading.vertexshader", "StandardShading.fragmentshader" );
+	profiler.endCpu();
 
 	// Get a handle for our "MVP" uniform
 	GLuint MatrixID = glGetUniformLocation(programID, "MVP");
 	GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
 	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
+	GLuint NormalMatrixID = glGetUniformLocation(programID, "N");
 
 	// Load the texture
+	profiler.beginCpu("texture");
 	GLuint Texture = loadDDS("uvmap.DDS");
+	profiler.endCpu();
 	
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
@@ -98,36 +119,23 @@ int main( void )
 	std::vector<glm::vec3> vertices;
 	std::vector<glm::vec2> uvs;
 	std::vector<glm::vec3> normals;
+	profiler.beginCpu("loadOBJ");
 	bool res = loadOBJ("suzanne.obj", vertices, uvs, normals);
+	profiler.endCpu();
 
 	std::vector<unsigned short> indices;
 	std::vector<glm::vec3> indexed_vertices;
 	std::vector<glm::vec2> indexed_uvs;
 	std::vector<glm::vec3> indexed_normals;
+	profiler.beginCpu("indexVBO");
 	indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
+	profiler.endCpu();
 
-	// Load it into a VBO
-
-	GLuint vertexbuffer;
-	glGenBuffers(1, &vertexbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_vertices.size() * sizeof(glm::vec3), &indexed_vertices[0], GL_STATIC_DRAW);
-
-	GLuint uvbuffer;
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_uvs.size() * sizeof(glm::vec2), &indexed_uvs[0], GL_STATIC_DRAW);
-
-	GLuint normalbuffer;
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_normals.size() * sizeof(glm::vec3), &indexed_normals[0], GL_STATIC_DRAW);
+	// Load it into a VBO, along with the VAO that describes its layout
+	Mesh suzanne;
+	suzanne.create(indexed_vertices, indexed_uvs, indexed_normals, indices);
 
-	// Generate a buffer for the indices as well
-	GLuint elementbuffer;
-	glGenBuffers(1, &elementbuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0] , GL_STATIC_DRAW);
+	profiler.endCpu();
 
 	// Get a handle for our "LightPosition" uniform
 	glUseProgram(programID);
@@ -137,23 +145,31 @@ int main( void )
 	double lastTime = glfwGetTime();
 	int nbFrames = 0;
 
+	// Skips the state changes that would not change anything
+	GLStateCache glState;
+
 	do{
+		glState.beginFrame();
+		profiler.beginFrame();
+		profiler.beginCpu("frame");
 
 		// Measure speed
 		double currentTime = glfwGetTime();
 		nbFrames++;
 		if ( currentTime - lastTime >= 1.0 ){ // If last prinf() was more than 1sec ago
 			// printf and reset
-			printf("%f ms/frame\n", 1000.0/double(nbFrames));
+			const GLStateCounters & stateCalls = glState.lastFrameCounters();
+			printf("%f ms/frame, %u state calls issued, %u elided\n", 1000.0/double(nbFrames), stateCalls.issued, stateCalls.elided);
 			nbFrames = 0;
 			lastTime += 1.0;
 		}
 
 		// Clear the screen
+		profiler.beginGpu("submission");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Use our shader
-		glUseProgram(programID);
+		glState.useProgram(programID);
 
 		// Compute the MVP matrix from keyboard and mouse input
 		computeMatricesFromInputs();
@@ -166,84 +182,49 @@ int main( void )
 		// in the "MVP" uniform
 		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
 		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
+		// The normal matrix, once per object rather than once per vertex
+		glm::mat3 NormalMatrix = glm::transpose(glm::inverse(glm::mat3(ModelMatrix)));
+		glUniformMatrix3fv(NormalMatrixID, 1, GL_FALSE, &NormalMatrix[0][0]);
 		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
 
 		glm::vec3 lightPos = glm::vec3(4,4,4);
 		glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
 
 		// Bind our texture in Texture Unit 0
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, Texture);
+		glState.bindTexture(0, GL_TEXTURE_2D, Texture);
 		// Set our "myTextureSampler" sampler to use Texture Unit 0
 		glUniform1i(TextureID, 0);
 
-		// 1rst attribute buffer : vertices
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glVertexAttribPointer(
-			0,                  // attribute
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// 2nd attribute buffer : UVs
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-		glVertexAttribPointer(
-			1,                                // attribute
-			2,                                // size
-			GL_FLOAT,                         // type
-			GL_FALSE,                         // normalized?
-			0,                                // stride
-			(void*)0                          // array buffer offset
-		);
-
-		// 3rd attribute buffer : normals
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-		glVertexAttribPointer(
-			2,                                // attribute
-			3,                                // size
-			GL_FLOAT,                         // type
-			GL_FALSE,                         // normalized?
-			0,                                // stride
-			(void*)0                          // array buffer offset
-		);
-
-		// Index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+		// Bind the VAO : vertices, UVs, normals and indices are already set up in it
+		glState.bindVertexArray(suzanne.vertexArray());
 
 		// Draw the triangles !
-		glDrawElements(
-			GL_TRIANGLES,      // mode
-			indices.size(),    // count
-			GL_UNSIGNED_SHORT,   // type
-			(void*)0           // element array buffer offset
-		);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
+		suzanne.draw();
+		profiler.endGpu();
 
 		// Swap buffers
+		profiler.beginCpu("swap");
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+		profiler.endCpu();
+
+		profiler.endCpu();
 
 	} // Check if the ESC key was pressed or the window was closed
 	while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
 		   glfwWindowShouldClose(window) == 0 );
 
+	if (profiler.isEnabled()){
+		profiler.writeStatistics(stdout);
+		if (!profiler.writeChromeTrace(tracePath))
+			fprintf(stderr, "Failed to write %s\n", tracePath);
+		profiler.destroy();
+	}
+
 	// Cleanup VBO and shader
-	glDeleteBuffers(1, &vertexbuffer);
-	glDeleteBuffers(1, &uvbuffer);
-	glDeleteBuffers(1, &normalbuffer);
-	glDeleteBuffers(1, &elementbuffer);
+	suzanne.destroy();
 	glDeleteProgram(programID);
 	glDeleteTextures(1, &Texture);
-	glDeleteVertexArrays(1, &VertexArrayID);
 
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
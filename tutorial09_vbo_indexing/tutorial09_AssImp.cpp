@@ -15,6 +15,8 @@ the suzannes chins just touch the plane.
 // Include standard headers
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <vector>
 
 // Include GLEW
@@ -23,6 +25,9 @@ the suzannes chins just touch the plane.
 // Include GLFW
 #include <GLFW/glfw3.h>
 GLFWwindow *window;
+#ifdef HEADLESS_BENCHMARK
+#include <distrib/benchmark.h> // no window, no input : see the header
+#endif
 
 // Include GLM
 #include <glm/glm.hpp>
@@ -30,12 +35,203 @@ GLFWwindow *window;
 using namespace glm;
 
 #include <common/controls.hpp>
+#include <common/culling.hpp>
+#include <common/geometrypool.hpp>
+#include <common/glstate.hpp>
+#include <common/gpuculling.hpp>
+#include <common/instancing.hpp>
+#include <common/jobsystem.hpp>
+#include <common/mesh.hpp>
 #include <common/objloader.hpp>
+#include <common/occlusion.hpp>
+#include <common/physics.hpp>
+#include <common/profiler.hpp>
+#include <common/renderqueue.hpp>
+#include <common/scenegraph.hpp>
 #include <common/shader.hpp>
+#include <common/streambuffer.hpp>
 #include <common/texture.hpp>
+#include <common/transforms.hpp>
 
-int main(void)
+// Places the heads evenly on a circle around the origin, facing radially outward with their chins on the z=0 plane.
+// The radius grows with the number of heads so that the ears keep touching. The heads are children of 'ring' in the
+// scene graph, added one after the other : returns the first one.
+unsigned int buildHeadRing(int numHeads, SceneGraph &scene, unsigned int ring)
 {
+    float radius = 3.75f * numHeads / 8.0f; // trial and error to get ears to touch, looks right
+    float chinOffset = 1.0f;                // more trial and error
+    float anglePerHead = 360.0f / numHeads;
+
+    // Rotate so their chins are touching green rectangle
+    glm::quat chinDown = glm::angleAxis(glm::radians(90.0f), glm::vec3(1, 0, 0));
+
+    // For each head...
+    unsigned int firstHead = scene.size();
+    for (int i = 0; i < numHeads; i++)
+    {
+        float angle = glm::radians(anglePerHead * i);
+
+        // Position head in a circle around the origin
+        float x = radius * cos(angle);
+        float y = radius * sin(angle);
+        float z = chinOffset;
+
+        // Rotate so the head faces radially outward, after the chin rotation
+        glm::quat faceOutward = glm::angleAxis(angle + glm::radians(90.0f), glm::vec3(0, 0, 1));
+
+        scene.addNode(ring, glm::vec3(x, y, z), faceOutward * chinDown);
+    }
+    return firstHead;
+}
+
+// Places the heads above the z=0 plane, ready to fall : layers of a square grid, 3 units apart, four layers deep, each
+// head turned at random (always the same way)
+void buildHeadPile(int numHeads, Transforms &transforms)
+{
+    srand(1);
+    unsigned int side = (unsigned int)ceilf(sqrtf(numHeads / 4.0f));
+    for (int i = 0; i < numHeads; i++)
+    {
+        unsigned int layer = i / (side * side), cell = i % (side * side);
+        glm::vec3 position(3.0f * (cell % side - (side - 1) / 2.0f), 3.0f * (cell / side - (side - 1) / 2.0f),
+                           2.0f + 3.0f * layer);
+        glm::vec3 axis = glm::normalize(
+            glm::vec3(rand() - RAND_MAX / 2, rand() - RAND_MAX / 2, rand() - RAND_MAX / 2) + 1e-3f);
+        float angle = 6.2831853f * rand() / RAND_MAX;
+        transforms.set(i, position, glm::angleAxis(angle, axis));
+    }
+}
+
+// What the default instanced path streams per visible head : every matrix, computed on the CPU, or only the rotation,
+// translation and scale, which the vertex shader turns into a matrix
+enum HeadFormat
+{
+    HeadTransforms, // InstanceTransform, 176 bytes
+    HeadCompact,    // CompactInstance, 32 bytes
+    HeadQuantized   // QuantizedInstance, 24 bytes
+};
+
+unsigned int headInstanceSize(HeadFormat format)
+{
+    return format == HeadCompact     ? sizeof(CompactInstance)
+           : format == HeadQuantized ? sizeof(QuantizedInstance)
+                                     : sizeof(InstanceTransform);
+}
+
+// The per-instance attributes of the suzanne VAO, from the instance 'firstInstance' of the stream
+void enableHeadAttributes(HeadFormat format, const InstanceBuffer &instances, unsigned int firstInstance)
+{
+    if (format == HeadCompact)
+    {
+        enableCompactInstanceAttributes(instances, firstInstance);
+    }
+    else if (format == HeadQuantized)
+    {
+        enableQuantizedInstanceAttributes(instances, firstInstance);
+    }
+    else
+    {
+        enableInstanceTransformAttributes(instances, firstInstance);
+    }
+}
+
+void disableHeadAttributes(HeadFormat format, const InstanceBuffer &instances)
+{
+    if (format == HeadTransforms)
+    {
+        disableInstanceTransformAttributes(instances);
+    }
+    else
+    {
+        disableCompactInstanceAttributes(instances);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // "--stress [N]" scales the ring up to N heads (100k by default) and reports timings once per second.
+    // "--physics [N]" drops N heads (2000 by default) on the ground instead, as Bullet rigid bodies, and reports the
+    // simulation with the timings.
+    // "--no-instancing" draws the heads one by one instead of with a single instanced draw call, for comparison.
+    // "--multi-draw" draws the ground and the heads from a shared geometry pool, one multi-draw per state bucket.
+    // "--occlusion" also skips the heads hidden behind the ground or the nearest heads, from a CPU depth buffer.
+    // "--gpu-culling" culls the instanced heads with a compute shader that feeds an indirect draw (GL 4.3).
+    // "--compact" streams a quaternion, a translation and a scale per head instead of its matrices, and "--quantized"
+    // the same with the quaternion in 16 bit integers.
+    // "--threads N" uses N worker threads besides the main one (one per extra core by default).
+    // "--profile trace.json" times the loading and the frames on the CPU and the GPU, prints the statistics and
+    // writes a Chrome trace at exit.
+    int numHeads = 8;
+    bool stressMode = false;
+    bool physicsMode = false;
+    bool instancing = true;
+    bool multiDraw = false;
+    bool occlusionCulling = false;
+    bool gpuCulling = false;
+    HeadFormat headFormat = HeadTransforms;
+    unsigned int workerThreads = JobSystem::defaultWorkerCount();
+    const char *tracePath = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stress") == 0)
+        {
+            stressMode = true;
+            numHeads = 100000;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+            {
+                numHeads = atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--physics") == 0)
+        {
+            stressMode = true;
+            physicsMode = true;
+            numHeads = 2000;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+            {
+                numHeads = atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--no-instancing") == 0)
+        {
+            instancing = false;
+        }
+        else if (strcmp(argv[i], "--multi-draw") == 0)
+        {
+            multiDraw = true;
+        }
+        else if (strcmp(argv[i], "--occlusion") == 0)
+        {
+            occlusionCulling = true;
+        }
+        else if (strcmp(argv[i], "--gpu-culling") == 0)
+        {
+            gpuCulling = true;
+        }
+        else if (strcmp(argv[i], "--compact") == 0)
+        {
+            headFormat = HeadCompact;
+        }
+        else if (strcmp(argv[i], "--quantized") == 0)
+        {
+            headFormat = HeadQuantized;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            workerThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+    }
+    if (gpuCulling && (multiDraw || occlusionCulling || !instancing))
+    {
+        // Those need to know on the CPU which heads are visible
+        fprintf(stderr, "--gpu-culling only works with the default instanced path, ignoring it\n");
+        gpuCulling = false;
+    }
+
     // Initialize GLFW
     if (!glfwInit())
     {
@@ -45,7 +241,7 @@ int main(void)
     }
 
     glfwWindowHint(GLFW_SAMPLES, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, gpuCulling ? 4 : 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy; should not be needed
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -72,9 +268,21 @@ int main(void)
         return -1;
     }
 
+    Profiler profiler;
+    if (tracePath != NULL)
+    {
+        profiler.create();
+    }
+
     // Ensure we can capture any key being pressed (in our case, L or esc)
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
+    // Don't let vsync hide the cost of submitting the heads
+    if (stressMode)
+    {
+        glfwSwapInterval(0);
+    }
+
     // Dark blue background
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
@@ -87,31 +295,66 @@ int main(void)
     // Cull triangles which normal is not towards the camera
     glEnable(GL_CULL_FACE);
 
-    // Create and bind a vertex array
-    GLuint VertexArrayID;
-    glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
+    // Loading and per-head work is spread over worker threads. GL calls stay on this thread.
+    JobSystem jobs;
+    jobs.create(workerThreads);
+    if (profiler.isEnabled())
+    {
+        JobHooks profilerHooks = {Profiler::jobStarted, Profiler::jobFinished, &profiler};
+        jobs.setHooks(profilerHooks);
+    }
+    profiler.beginCpu("loading");
+
+    // Read our .obj file on a worker, while this thread compiles the shaders and loads the texture
+    std::vector<unsigned short> indices;
+    std::vector<glm::vec3> indexed_vertices;
+    std::vector<glm::vec2> indexed_uvs;
+    std::vector<glm::vec3> indexed_normals;
+    bool res = false;
+    Job *loadSuzanne = jobs.createJob(
+        [&]() { res = loadAssImp("suzanne.obj", indices, indexed_vertices, indexed_uvs, indexed_normals); });
+    loadSuzanne->name = "loadAssImp";
+    jobs.run(loadSuzanne);
 
     // Create and compile our GLSL program from the shaders
+    profiler.beginCpu("shaders");
     GLuint programID = LoadShaders("StandardShading.vertexshader", "StandardShading.fragmentshader");
+    profiler.endCpu();
 
-    // Get a handle for our "MVP" uniform
-    GLuint MatrixID = glGetUniformLocation(programID, "MVP");
-    GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
-    GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
+    // The MVP, M and V uniforms are looked up by the render queue
 
     // Load the texture
+    profiler.beginCpu("texture");
     GLuint Texture = loadDDS("uvmap.DDS");
+    profiler.endCpu();
 
     // Get a handle for our "myTextureSampler" uniform
     GLuint TextureID = glGetUniformLocation(programID, "myTextureSampler");
 
-    // Read our .obj file
-    std::vector<unsigned short> indices;
-    std::vector<glm::vec3> indexed_vertices;
-    std::vector<glm::vec2> indexed_uvs;
-    std::vector<glm::vec3> indexed_normals;
-    bool res = loadAssImp("suzanne.obj", indices, indexed_vertices, indexed_uvs, indexed_normals);
+    // Same shading, but the model matrix comes from the instance buffer
+    profiler.beginCpu("shaders");
+    GLuint instancedProgramID =
+        LoadShaders("StandardShadingInstanced.vertexshader", "StandardShading.fragmentshader");
+    profiler.endCpu();
+    GLuint InstancedVPID = glGetUniformLocation(instancedProgramID, "VP");
+    GLuint InstancedViewMatrixID = glGetUniformLocation(instancedProgramID, "V");
+    GLuint InstancedTextureID = glGetUniformLocation(instancedProgramID, "myTextureSampler");
+
+    // And with every matrix of the instance computed on the CPU : the default path
+    profiler.beginCpu("shaders");
+    GLuint transformsProgramID = LoadShaders("StandardShadingTransforms.vertexshader", "StandardShading.fragmentshader");
+    profiler.endCpu();
+    GLuint TransformsTextureID = glGetUniformLocation(transformsProgramID, "myTextureSampler");
+
+    // Or with the model matrix rebuilt from the rotation, translation and scale by the vertex shader
+    profiler.beginCpu("shaders");
+    GLuint compactProgramID = LoadShaders("StandardShadingCompact.vertexshader", "StandardShading.fragmentshader");
+    profiler.endCpu();
+    GLuint CompactTextureID = glGetUniformLocation(compactProgramID, "myTextureSampler");
+
+    profiler.beginCpu("wait for loadAssImp");
+    jobs.wait(loadSuzanne);
+    profiler.endCpu();
 
     // Lets check if we successfully loaded suzanne
     if (!res)
@@ -120,28 +363,10 @@ int main(void)
         return -1;
     }
 
-    // Load it into a VBO
-
-    GLuint vertexbuffer;
-    glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, indexed_vertices.size() * sizeof(glm::vec3), &indexed_vertices[0], GL_STATIC_DRAW);
-
-    GLuint uvbuffer;
-    glGenBuffers(1, &uvbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glBufferData(GL_ARRAY_BUFFER, indexed_uvs.size() * sizeof(glm::vec2), &indexed_uvs[0], GL_STATIC_DRAW);
-
-    GLuint normalbuffer;
-    glGenBuffers(1, &normalbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glBufferData(GL_ARRAY_BUFFER, indexed_normals.size() * sizeof(glm::vec3), &indexed_normals[0], GL_STATIC_DRAW);
-
-    // Generate a buffer for the indices as well
-    GLuint elementbuffer;
-    glGenBuffers(1, &elementbuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+    // Load it into a VBO, along with the VAO that describes its layout
+    Mesh suzanne;
+    suzanne.create(indexed_vertices, indexed_uvs, indexed_normals, indices);
+    profiler.endCpu();
 
     // Get a handle for our "LightPosition" uniform
     glUseProgram(programID);
@@ -149,38 +374,129 @@ int main(void)
     // Set lighting info
     GLuint lightOnID = glGetUniformLocation(programID, "lightOn");
     glUniform1i(lightOnID, 1);
+    GLuint instancedLightOnID = glGetUniformLocation(instancedProgramID, "lightOn");
+    glUseProgram(instancedProgramID);
+    glUniform1i(instancedLightOnID, 1);
+    GLuint transformsLightOnID = glGetUniformLocation(transformsProgramID, "lightOn");
+    glUseProgram(transformsProgramID);
+    glUniform1i(transformsLightOnID, 1);
+    GLuint compactLightOnID = glGetUniformLocation(compactProgramID, "lightOn");
+    glUseProgram(compactProgramID);
+    glUniform1i(compactLightOnID, 1);
+
+    // The world translation and rotation of each head. Every frame, the model, MVP and normal matrices of the visible
+    // ones are written straight into a ring of three buffers that stays mapped, which the GPU reads from while the
+    // next frames fill the other two. With --compact or --quantized, that is only their rotation, translation and
+    // scale. The paths that are not the default one want a model matrix per head instead.
+    Transforms headTransforms;
+    headTransforms.resize(numHeads);
+    std::vector<glm::mat4> headModelMatrices;
+    StreamBuffer headStream;
+    headStream.create(numHeads * sizeof(InstanceTransform));
+    InstanceBuffer headInstances;
+    headInstances.buffer = headStream.buffer();
+    headInstances.firstLocation = 3;
+    headInstances.capacity = numHeads;
+    headInstances.count = 0;
+
+    // The suzanne VAO remembers the per-instance attributes as well
+    suzanne.bind();
+    enableHeadAttributes(headFormat, headInstances, 0);
+
+    // Heads outside of the view are not drawn
+    glm::vec3 suzanneCenter;
+    float suzanneRadius;
+    computeBoundingSphere(indexed_vertices, suzanneCenter, suzanneRadius);
+    BoundingSpheres headBounds;
+    headBounds.resize(numHeads);
+    std::vector<unsigned int> visibleHeads;
+
+    // The ground and the ring of heads are placed once, in a scene graph. Every frame, only what moved since the last
+    // one gets new world transforms, and only those of the heads are copied to the arrays above. With --physics, the
+    // heads are not in the graph : the bodies move them.
+    SceneGraph scene;
+    unsigned int groundNode = scene.addNode(SceneGraph::None);
+    unsigned int ringNode = scene.addNode(SceneGraph::None);
+    unsigned int firstHeadNode = physicsMode ? scene.size() : buildHeadRing(numHeads, scene, ringNode);
+    for (int i = 0; i < numHeads && !physicsMode; i++)
+    {
+        scene.setBounds(firstHeadNode + i, suzanneCenter, suzanneRadius);
+    }
+
+    // Copying the heads and building their instances is split in jobs of this many heads : a small ring stays on
+    // this thread
+    const unsigned int headsPerJob = 4096;
+
+    // With --gpu-culling, the spheres and the matrices of the whole ring go to a compute shader instead, which
+    // writes the visible matrices to its own instance buffer : the suzanne VAO reads that one
+    GpuCuller gpuCuller;
+    if (gpuCulling)
+    {
+        if (!GpuCuller::isSupported() || !gpuCuller.create("CullInstances.computeshader", 3, numHeads))
+        {
+            fprintf(stderr, "GPU culling is not available, culling on the CPU\n");
+            gpuCulling = false;
+        }
+        else
+        {
+            suzanne.bind();
+            disableHeadAttributes(headFormat, headInstances);
+            enableInstanceAttributes(gpuCuller.visibleInstances());
+        }
+    }
+    bool needModelMatrices = !instancing || multiDraw || occlusionCulling || gpuCulling;
+    if (needModelMatrices)
+    {
+        headModelMatrices.resize(numHeads);
+    }
+
+    // With --physics, a body per head with the convex hull of suzanne, which writes where it is every frame straight
+    // into the arrays of the heads. The simulation runs in steps of 1/60 s, however long the frames take.
+    PhysicsWorld physics;
+    InstanceTargets headTargets = {&headTransforms, &headBounds, needModelMatrices ? &headModelMatrices[0] : NULL,
+                                   suzanneCenter};
+    if (physicsMode)
+    {
+        buildHeadPile(numHeads, headTransforms);
+        computeBoundingSpheres(headTransforms, suzanneCenter, suzanneRadius, 0, numHeads, headBounds);
+        if (needModelMatrices)
+        {
+            computeModelMatrices(headTransforms, 0, numHeads, &headModelMatrices[0]);
+        }
+        physics.create(numHeads);
+        unsigned int suzanneHull = physics.addConvexHull(indexed_vertices);
+        for (int i = 0; i < numHeads; i++)
+        {
+            physics.addBody(suzanneHull, 1.0f, &headTargets, i);
+        }
+    }
+
+    // With --occlusion, the ground and the nearest heads are rasterized on the CPU, and the heads whose box is
+    // behind them are not drawn either
+    const unsigned int maxOccluders = 16;
+    glm::vec3 suzanneMin, suzanneMax;
+    computeBoundingBox(indexed_vertices, suzanneMin, suzanneMax);
+    OcclusionBuffer occlusionBuffer;
+    occlusionBuffer.create(256, 192);
+    std::vector<std::pair<float, unsigned int> > occluderCandidates;
 
     // Vertex positions for a 10x10 rectangle on the z=0 plane
-    static const GLfloat ground_vertices[] = {-5.0f, -5.0f, 0.0f, 5.0f, -5.0f, 0.0f,
-                                              -5.0f, 5.0f,  0.0f, 5.0f, 5.0f,  0.0f};
+    static const glm::vec3 ground_vertices[] = {glm::vec3(-5.0f, -5.0f, 0.0f), glm::vec3(5.0f, -5.0f, 0.0f),
+                                                glm::vec3(-5.0f, 5.0f, 0.0f), glm::vec3(5.0f, 5.0f, 0.0f)};
 
     // UV texture coords
-    static const GLfloat ground_uvs[] = {
-        0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-    };
+    static const glm::vec2 ground_uvs[] = {glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.0f, 1.0f),
+                                           glm::vec2(1.0f, 1.0f)};
 
     // Vertex normals (all facing Z direction) for flat lighting across the rectangle
-    static const GLfloat ground_normals[] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+    static const glm::vec3 ground_normals[] = {glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+                                               glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f)};
 
     // Indices that create the triangles that make the rectangle
     static const GLuint ground_indices[] = {0, 1, 2, 2, 1, 3};
 
-    GLuint groundVertexBuffer, groundUVBuffer, groundNormalBuffer, groundElementBuffer;
-    glGenBuffers(1, &groundVertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, groundVertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ground_vertices), ground_vertices, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &groundUVBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, groundUVBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ground_uvs), ground_uvs, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &groundNormalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, groundNormalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ground_normals), ground_normals, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &groundElementBuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, groundElementBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(ground_indices), ground_indices, GL_STATIC_DRAW);
+    Mesh ground;
+    ground.create(ground_vertices, ground_uvs, ground_normals, 4, ground_indices, 6);
 
     GLuint greenTex;
     glGenTextures(1, &greenTex);
@@ -191,14 +507,130 @@ int main(void)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    // Texture units never change, so the samplers can be set once
+    glUseProgram(programID);
+    glUniform1i(TextureID, 0);
+    glUseProgram(instancedProgramID);
+    glUniform1i(InstancedTextureID, 0);
+    glUseProgram(transformsProgramID);
+    glUniform1i(TransformsTextureID, 0);
+    glUseProgram(compactProgramID);
+    glUniform1i(CompactTextureID, 0);
+
+    // Every frame, the ground and the heads go through the render queue, which draws them in state order
+    RenderQueue renderQueue;
+    unsigned int standardProgram = renderQueue.addProgram(programID);
+    unsigned int transformsProgram = renderQueue.addProgram(transformsProgramID);
+    unsigned int compactProgram = renderQueue.addProgram(compactProgramID);
+    unsigned int uvmapTexture = renderQueue.addTexture(Texture);
+    unsigned int greenTexture = renderQueue.addTexture(greenTex);
+    unsigned int suzanneMesh = renderQueue.addMesh(suzanne);
+    unsigned int groundMesh = renderQueue.addMesh(ground, true); // visible from both sides
+
+    // The same two meshes again, in a pool where a single multi-draw can reach both
+    GeometryPool geometryPool;
+    geometryPool.create(indexed_vertices.size() + 4, indices.size() + 6);
+    PoolMesh suzanneInPool, groundInPool;
+    geometryPool.addMesh(indexed_vertices, indexed_uvs, indexed_normals, indices, suzanneInPool);
+    geometryPool.addMesh(ground_vertices, ground_uvs, ground_normals, 4, ground_indices, 6, groundInPool);
+
+    // One batch per state bucket : the ground (green, not culled), and the heads
+    IndirectBatch groundBatch, headBatch;
+    groundBatch.create(3);
+    headBatch.create(3);
+
+    // For speed computation
+    double lastTime = glfwGetTime();
+#ifndef HEADLESS_BENCHMARK
+    double lastFrameTime = lastTime; // for the physics
+#endif
+    double submitTime = 0.0;
+    double sortTime = 0.0;
+    double cullTime = 0.0;
+    double occlusionTime = 0.0;
+    double updatedNodes = 0.0;
+    unsigned int drawCalls = 0; // in the last frame
+    int nbFrames = 0;
+
+    // Everything the frame loop binds or enables goes through the cache, which skips what is already set
+    GLStateCache glState;
+
     do
     {
+        glState.beginFrame();
+        profiler.beginFrame();
+        profiler.beginCpu("frame");
+
+        // Measure speed
+        double currentTime = glfwGetTime();
+        if (stressMode && currentTime - lastTime >= 1.0)
+        {
+            const GLStateCounters &stateCalls = glState.lastFrameCounters();
+            const RenderQueueStats &queueStats = renderQueue.stats();
+            printf("%d heads (%s, %u worker threads): %f ms/frame, %f ms/frame CPU submit, %u draw calls, "
+                   "%u state calls issued, %u elided\n",
+                   numHeads, multiDraw ? "multi-draw" : instancing ? "instanced" : "one draw per head",
+                   jobs.workerCount(), 1000.0 * (currentTime - lastTime) / nbFrames, 1000.0 * submitTime / nbFrames,
+                   drawCalls, stateCalls.issued, stateCalls.elided);
+            printf("    %u scene nodes, %.1f updated per frame\n", scene.size(), updatedNodes / nbFrames);
+            if (physicsMode)
+            {
+                // The steps are not part of the CPU submit time above
+                const PhysicsStats &physicsStats = physics.stats();
+                printf("    %u of %u bodies awake, %.2f steps per frame, %f ms/frame stepping, %f ms/frame "
+                       "rendering\n",
+                       physics.activeBodies(), physics.bodyCount(), double(physicsStats.steps) / nbFrames,
+                       1000.0 * physicsStats.stepTime / nbFrames, 1000.0 * submitTime / nbFrames);
+                physics.resetStats();
+            }
+            if (gpuCulling)
+            {
+                // The number of visible heads never comes back from the GPU
+                printf("    heads culled on the GPU, %f ms/frame CPU side of the culling\n",
+                       1000.0 * cullTime / nbFrames);
+            }
+            else
+            {
+                printf("    %u heads visible, %f ms/frame culling (%s)\n", (unsigned int)visibleHeads.size(),
+                       1000.0 * cullTime / nbFrames, cullingInstructionSet());
+            }
+            if (occlusionCulling)
+            {
+                const OcclusionStats &occlusionStats = occlusionBuffer.stats();
+                printf("    %u of %u heads culled by occlusion (%.1f%%), %u outside of its buffer, %u occluder triangles, "
+                       "%f ms/frame occlusion (%s)\n",
+                       occlusionStats.culled, occlusionStats.tested, 100.0f * occlusionStats.culledRatio(),
+                       occlusionStats.offscreen, occlusionStats.triangles, 1000.0 * occlusionTime / nbFrames,
+                       occlusionInstructionSet());
+            }
+            if (!multiDraw)
+            {
+                printf("    %u packets, %u state switches, %f ms/frame sorting\n", queueStats.packets,
+                       queueStats.stateSwitches(), 1000.0 * sortTime / nbFrames);
+            }
+            if (instancing && !multiDraw && !gpuCulling)
+            {
+                const StreamBufferStats &streamStats = headStream.stats();
+                printf("    instance stream (%s, %u bytes per head): %.1f MB/s written, %u stalls, %f ms/frame "
+                       "stalled\n",
+                       headStream.isPersistent() ? "persistent" : "copied", headInstanceSize(headFormat),
+                       streamStats.bytes / (1048576.0 * (currentTime - lastTime)), streamStats.stalls,
+                       1000.0 * streamStats.stallTime / nbFrames);
+                headStream.resetStats();
+            }
+            nbFrames = 0;
+            submitTime = 0.0;
+            sortTime = 0.0;
+            cullTime = 0.0;
+            occlusionTime = 0.0;
+            updatedNodes = 0.0;
+            lastTime = currentTime;
+        }
+        nbFrames++;
+
         // Clear the screen
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Use our shader
-        glUseProgram(programID);
-
         // Lighting things
         static bool lastL = false;
         static bool lightOn = true;
@@ -207,8 +639,14 @@ int main(void)
             if (!lastL)
             {
                 lightOn = !lightOn; // toggle the light on or off
-                GLuint lightOnID = glGetUniformLocation(programID, "lightOn");
+                glState.useProgram(programID);
                 glUniform1i(lightOnID, lightOn);
+                glState.useProgram(instancedProgramID);
+                glUniform1i(instancedLightOnID, lightOn);
+                glState.useProgram(transformsProgramID);
+                glUniform1i(transformsLightOnID, lightOn);
+                glState.useProgram(compactProgramID);
+                glUniform1i(compactLightOnID, lightOn);
             }
             lastL = true;
         }
@@ -221,131 +659,262 @@ int main(void)
         computeMatricesFromInputs();
         glm::mat4 ProjectionMatrix = getProjectionMatrix();
         glm::mat4 ViewMatrix = getViewMatrix();
+        glm::mat4 ViewProjectionMatrix = ProjectionMatrix * ViewMatrix; // once per frame, not once per head
 
-        // Do some work to draw the green rectangle
+        // Move the bodies by the time the last frame took. Bodies that fall asleep are written one last time.
+        bool bodiesMoved = false;
+        if (physicsMode)
         {
-            // Set up the ground transformation
-            glm::mat4 groundModel = glm::mat4(1.0f);
-            glm::mat4 groundMVP = ProjectionMatrix * ViewMatrix * groundModel;
-
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &groundMVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &groundModel[0][0]);
-            glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-
-            // Needed to ensure ground plane is visible from both sides
-            glDisable(GL_CULL_FACE);
-
-            // First attr. buffer, vertices
-            glEnableVertexAttribArray(0);
-            glBindBuffer(GL_ARRAY_BUFFER, groundVertexBuffer);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
-
-            // Second attr. buffer, UVs
-            glEnableVertexAttribArray(1);
-            glBindBuffer(GL_ARRAY_BUFFER, groundUVBuffer);
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
-
-            // Third attr. buffer, normals
-            glEnableVertexAttribArray(2);
-            glBindBuffer(GL_ARRAY_BUFFER, groundNormalBuffer);
-            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
-
-            // Bind our green 1x1 texture to 0 so green color populates
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, greenTex);
-            glUniform1i(TextureID, 0);
-
-            // index and draw
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, groundElementBuffer);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void *)0);
-
-            // cleanup attributes
-            glDisableVertexAttribArray(0);
-            glDisableVertexAttribArray(1);
-            glDisableVertexAttribArray(2);
-
-            glEnable(GL_CULL_FACE); // re-enable cull face for monkeys
+            profiler.beginCpu("physics");
+            bodiesMoved = physics.activeBodies() > 0;
+#ifdef HEADLESS_BENCHMARK
+            // One step per frame, like the camera path, whatever the frame took : every run draws the same pile
+            physics.update(physics.timeStep());
+#else
+            physics.update(currentTime - lastFrameTime);
+#endif
+            profiler.endCpu();
         }
-        // Set up some values for drawing heads
-        int numHeads = 8;
-        float radius = 3.75f;    // trial and error to get ears to touch, looks right
-        float chinOffset = 1.0f; // more trial and error
-
-        // For each head...
-        for (int i = 0; i < numHeads; i++)
+#ifndef HEADLESS_BENCHMARK
+        lastFrameTime = currentTime;
+#endif
+
+        double submitStart = glfwGetTime();
+
+        // Bring the world transforms up to date, and the copies of those of the heads that moved : all of them the
+        // first frame, none after that unless something edits the graph
+        profiler.beginCpu("scene");
+        scene.update();
+        const std::vector<unsigned int> &changedNodes = scene.changedNodes();
+        jobs.parallelFor(0, changedNodes.size(), headsPerJob, [&](unsigned int first, unsigned int last) {
+            for (unsigned int i = first; i < last; i++)
+            {
+                unsigned int head = changedNodes[i] - firstHeadNode;
+                if (changedNodes[i] < firstHeadNode || head >= (unsigned int)numHeads)
+                {
+                    continue;
+                }
+                glm::vec3 position, scale, center;
+                glm::quat rotation;
+                float radius;
+                scene.getWorldTransform(changedNodes[i], position, rotation, scale);
+                scene.getWorldBounds(changedNodes[i], center, radius);
+                headTransforms.set(head, position, rotation, scale);
+                headBounds.set(head, center, radius);
+                if (needModelMatrices)
+                {
+                    headModelMatrices[head] = scene.worldMatrix(changedNodes[i]);
+                }
+            }
+        });
+        bool headsMoved = !changedNodes.empty() || bodiesMoved;
+        updatedNodes += scene.stats().updated;
+        const glm::mat4 &groundMatrix = scene.worldMatrix(groundNode);
+        profiler.endCpu();
+
+        // Keep the heads that the camera can see
+        double cullStart = glfwGetTime();
+        profiler.beginGpu("culling");
+        Frustum frustum = extractFrustumPlanes(ViewProjectionMatrix);
+        if (gpuCulling)
         {
-            float anglePerHead = 360 / numHeads;
-            float angle = glm::radians(anglePerHead * i);
-
-            // Position head in a circle around the origin
-            float x = radius * cos(angle);
-            float y = radius * sin(angle);
-            float z = chinOffset;
-
-            glm::mat4 ModelMatrix = glm::mat4(1.0f);
-
-            // Translate the head into position
-            ModelMatrix = glm::translate(ModelMatrix, glm::vec3(x, y, z));
+            // The buffers of the last frame are still right if no head moved
+            if (headsMoved)
+            {
+                gpuCuller.upload(headBounds, headModelMatrices, glState);
+            }
+            gpuCuller.cull(frustum, suzanne, glState);
+        }
+        else
+        {
+            cullSpheres(frustum, headBounds, visibleHeads);
+        }
+        profiler.endGpu();
+        cullTime += glfwGetTime() - cullStart;
 
-            // Rotate so the head faces radially outward
-            ModelMatrix = glm::rotate(ModelMatrix, angle + glm::radians(90.0f), glm::vec3(0, 0, 1));
+        if (occlusionCulling)
+        {
+            double occlusionStart = glfwGetTime();
+            profiler.beginCpu("occlusion");
+            occlusionBuffer.begin(ViewProjectionMatrix);
+            occlusionBuffer.addOccluder(ground_vertices, 4, ground_indices, 6, groundMatrix, true);
+
+            // The heads closest to the camera hide the most
+            occluderCandidates.resize(visibleHeads.size());
+            for (unsigned int i = 0; i < visibleHeads.size(); i++)
+            {
+                glm::vec4 center =
+                    ViewProjectionMatrix * headModelMatrices[visibleHeads[i]] * glm::vec4(suzanneCenter, 1.0f);
+                occluderCandidates[i] = std::make_pair(center.w, visibleHeads[i]);
+            }
+            unsigned int occluderCount = std::min((unsigned int)occluderCandidates.size(), maxOccluders);
+            std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + occluderCount,
+                              occluderCandidates.end());
+            for (unsigned int i = 0; i < occluderCount; i++)
+            {
+                occlusionBuffer.addOccluder(indexed_vertices, indices, headModelMatrices[occluderCandidates[i].second]);
+            }
+            occlusionBuffer.rasterize(&jobs);
 
-            // Rotate so their chins are touching green rectangle
-            ModelMatrix = glm::rotate(ModelMatrix, glm::radians(90.0f), glm::vec3(1, 0, 0));
+            unsigned int kept = 0;
+            for (unsigned int i = 0; i < visibleHeads.size(); i++)
+            {
+                if (occlusionBuffer.isBoxVisible(suzanneMin, suzanneMax, headModelMatrices[visibleHeads[i]]))
+                {
+                    visibleHeads[kept++] = visibleHeads[i];
+                }
+            }
+            visibleHeads.resize(kept);
+            profiler.endCpu();
+            occlusionTime += glfwGetTime() - occlusionStart;
+        }
 
-            // Send our transformation to the currently bound shader,
-            // in the "MVP" uniform
-            glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-            glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
+        profiler.beginGpu("submission");
+        if (multiDraw)
+        {
+            glState.useProgram(instancedProgramID);
+            glUniformMatrix4fv(InstancedVPID, 1, GL_FALSE, &ViewProjectionMatrix[0][0]);
+            glUniformMatrix4fv(InstancedViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
+
+            groundBatch.clear();
+            groundBatch.add(groundInPool, groundMatrix);
+            glState.disable(GL_CULL_FACE);
+            glState.bindTexture(0, GL_TEXTURE_2D, greenTex);
+            drawCalls = groundBatch.submit(geometryPool, glState);
+
+            headBatch.clear();
+            for (unsigned int i = 0; i < visibleHeads.size(); i++)
+            {
+                headBatch.add(suzanneInPool, headModelMatrices[visibleHeads[i]]);
+            }
+            glState.enable(GL_CULL_FACE);
+            glState.bindTexture(0, GL_TEXTURE_2D, Texture);
+            drawCalls += headBatch.submit(geometryPool, glState);
+        }
+        else
+        {
+            renderQueue.begin(ViewMatrix, ProjectionMatrix);
 
-            // Bind our texture in Texture 0
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, Texture);
-            glUniform1i(TextureID, 0);
+            // The green rectangle, on the z=0 plane
+            renderQueue.add(RenderQueue::Opaque, standardProgram, greenTexture, groundMesh, groundMatrix);
 
-            // First attribute buffer : vertices
-            glEnableVertexAttribArray(0);
-            glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+            if (gpuCulling)
+            {
+                // Drawn after the queue, as the instance count is only known to the GPU
+            }
+            else if (instancing)
+            {
+                // Per-instance attributes : model, MVP and normal matrices, or what the compact formats keep of the
+                // transforms, computed by all the threads right where the GPU reads them. The whole ring is a single
+                // packet.
+                if (!visibleHeads.empty())
+                {
+                    unsigned int instanceSize = headInstanceSize(headFormat);
+                    StreamAllocation slice = headStream.allocate(visibleHeads.size() * instanceSize, instanceSize);
+                    jobs.parallelFor(0, visibleHeads.size(), headsPerJob, [&](unsigned int first, unsigned int last) {
+                        if (headFormat == HeadCompact)
+                        {
+                            computeIndexedCompactInstances(headTransforms, &visibleHeads[first], last - first,
+                                                           static_cast<CompactInstance *>(slice.data) + first);
+                        }
+                        else if (headFormat == HeadQuantized)
+                        {
+                            computeIndexedQuantizedInstances(headTransforms, &visibleHeads[first], last - first,
+                                                             static_cast<QuantizedInstance *>(slice.data) + first);
+                        }
+                        else
+                        {
+                            computeIndexedInstanceTransforms(headTransforms, ViewProjectionMatrix,
+                                                             &visibleHeads[first], last - first,
+                                                             static_cast<InstanceTransform *>(slice.data) + first);
+                        }
+                    });
+                    headStream.flush();
+
+                    // The suzanne VAO reads this frame's part of the ring
+                    glState.bindVertexArray(suzanne.vertexArray());
+                    glState.bindBuffer(GL_ARRAY_BUFFER, headStream.buffer());
+                    enableHeadAttributes(headFormat, headInstances, slice.offset / instanceSize);
+                    unsigned int headProgram = headFormat == HeadTransforms ? transformsProgram : compactProgram;
+                    renderQueue.add(RenderQueue::Opaque, headProgram, uvmapTexture, suzanneMesh, glm::mat4(1.0f),
+                                    visibleHeads.size());
+                }
+            }
+            else
+            {
+                // One packet per head, so that they get drawn front to back
+                for (unsigned int i = 0; i < visibleHeads.size(); i++)
+                {
+                    renderQueue.add(RenderQueue::Opaque, standardProgram, uvmapTexture, suzanneMesh,
+                                    headModelMatrices[visibleHeads[i]]);
+                }
+            }
 
-            // Second attribute buffer : UVs
-            glEnableVertexAttribArray(1);
-            glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+            double sortStart = glfwGetTime();
+            profiler.beginCpu("sort");
+            renderQueue.sort();
+            profiler.endCpu();
+            sortTime += glfwGetTime() - sortStart;
 
-            // Third attribute buffer : normals
-            glEnableVertexAttribArray(2);
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+            renderQueue.submit(glState);
+            headStream.nextFrame();
 
-            // Index buffer
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+            drawCalls = renderQueue.stats().packets;
 
-            // Draw
-            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT, (void *)0);
+            if (gpuCulling)
+            {
+                glState.useProgram(instancedProgramID);
+                glUniformMatrix4fv(InstancedVPID, 1, GL_FALSE, &ViewProjectionMatrix[0][0]);
+                glUniformMatrix4fv(InstancedViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
+                glState.enable(GL_CULL_FACE);
+                glState.bindTexture(0, GL_TEXTURE_2D, Texture);
+                gpuCuller.draw(suzanne, glState);
+                drawCalls++;
+            }
         }
 
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glDisableVertexAttribArray(2);
+        profiler.endGpu();
+        submitTime += glfwGetTime() - submitStart;
 
         // Swap buffers
+        profiler.beginCpu("swap");
         glfwSwapBuffers(window);
         glfwPollEvents();
+        profiler.endCpu();
+
+        profiler.endCpu();
 
     } // Check if the ESC key was pressed or the window was closed
     while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
 
+    if (profiler.isEnabled())
+    {
+        profiler.writeStatistics(stdout);
+        if (!profiler.writeChromeTrace(tracePath))
+        {
+            fprintf(stderr, "Failed to write %s\n", tracePath);
+        }
+        profiler.destroy();
+    }
+
     // Cleanup VBO and shader
-    glDeleteBuffers(1, &vertexbuffer);
-    glDeleteBuffers(1, &uvbuffer);
-    glDeleteBuffers(1, &normalbuffer);
-    glDeleteBuffers(1, &elementbuffer);
+    suzanne.destroy();
+    ground.destroy();
+    headStream.destroy();
+    jobs.destroy();
+    if (gpuCulling)
+    {
+        gpuCuller.destroy();
+    }
+    groundBatch.destroy();
+    headBatch.destroy();
+    geometryPool.destroy();
     glDeleteProgram(programID);
+    glDeleteProgram(instancedProgramID);
+    glDeleteProgram(transformsProgramID);
+    glDeleteProgram(compactProgramID);
     glDeleteTextures(1, &Texture);
-    glDeleteVertexArrays(1, &VertexArrayID);
+    glDeleteTextures(1, &greenTex);
 
     // Close OpenGL window and terminate GLFW
     glfwTerminate();